@@ -157,6 +157,36 @@ fn build_exe(
     });
     exe.root_module.addImport("shd", shd_mod);
 
+    // zig build bench
+    const bench = b.addExecutable(.{
+        .name = "bench_frame_dispatch",
+        .root_module = b.createModule(.{
+            .target = target,
+            .optimize = .ReleaseFast,
+            .root_source_file = b.path("src/bench_frame_dispatch.zig"),
+            .link_libc = true,
+        }),
+    });
+    bench.root_module.addImport("c", c_mod);
+    bench.root_module.addImport("openxr", openxr_mod);
+    const run_bench = b.addRunArtifact(bench);
+    b.step("bench", "Time the per view dispatch of the desktop frame loop").dependOn(&run_bench.step);
+
+    // zig build test
+    const test_step = b.step("test", "Run the unit tests");
+    for ([_][]const u8{ "src/xr_linear.zig", "src/Bvh.zig" }) |path| {
+        const tests = b.addTest(.{
+            .root_module = b.createModule(.{
+                .target = target,
+                .optimize = optimize,
+                .root_source_file = b.path(path),
+                .link_libc = true,
+            }),
+        });
+        tests.root_module.addImport("c", c_mod);
+        test_step.dependOn(&b.addRunArtifact(tests).step);
+    }
+
     return exe;
 }
 
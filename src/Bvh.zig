@@ -0,0 +1,646 @@
+// Bounding volume hierarchy over an indexed triangle mesh, for ray queries and frustum culling.
+//
+// Built once with a binned surface area heuristic, which also reorders the triangles of the
+// index buffer so that every node covers one contiguous triangle range. Nodes are stored depth
+// first: the left child directly follows its parent, the right child is at `right`. A culled
+// draw is then a handful of index ranges, and a ray visits a few dozen nodes for a room sized
+// mesh of hundreds of thousands of triangles.
+const std = @import("std");
+const c = @import("c");
+
+pub const Vec3 = @Vector(3, f32);
+
+// Triangles per leaf. Small leaves keep ray queries cheap, the build stops splitting below it.
+const LEAF_SIZE = 4;
+// Larger leaves are split even where the heuristic prefers a leaf.
+const MAX_LEAF_SIZE = 16;
+const BIN_COUNT = 12;
+// Deeper than any tree built from a sane mesh, which is what bounds the traversal stacks.
+const MAX_DEPTH = 64;
+
+pub const Aabb = struct {
+    min: Vec3 = @splat(std.math.inf(f32)),
+    max: Vec3 = @splat(-std.math.inf(f32)),
+
+    pub fn grow(self: *@This(), p: Vec3) void {
+        self.min = @min(self.min, p);
+        self.max = @max(self.max, p);
+    }
+
+    pub fn merge(self: *@This(), other: @This()) void {
+        self.min = @min(self.min, other.min);
+        self.max = @max(self.max, other.max);
+    }
+
+    pub fn area(self: @This()) f32 {
+        const e = self.max - self.min;
+        if (e[0] < 0) {
+            return 0;
+        }
+        return 2 * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+    }
+};
+
+pub const Node = struct {
+    bounds: Aabb,
+    // The triangles of the whole subtree.
+    first: u32,
+    count: u32,
+    // Index of the right child, 0 for a leaf. The left child is the next node.
+    right: u32,
+};
+
+// A range of triangles, index offset 3 * first.
+pub const Range = struct {
+    first: u32,
+    count: u32,
+};
+
+pub const Hit = struct {
+    distance: f32,
+    triangle: u32,
+};
+
+// A plane as (normal, d), inside where dot(normal, p) + d >= 0.
+pub const Plane = @Vector(4, f32);
+
+allocator: std.mem.Allocator,
+nodes: []Node,
+depth: u32,
+
+// Build over positions and indices, reordering the triangles of indices in place.
+pub fn build(allocator: std.mem.Allocator, positions: []const c.XrVector3f, indices: []u32) !@This() {
+    const triangleCount: u32 = @intCast(indices.len / 3);
+    var builder = Builder{
+        .bounds = try allocator.alloc(Aabb, triangleCount),
+        .centroids = try allocator.alloc(Vec3, triangleCount),
+        .order = try allocator.alloc(u32, triangleCount),
+        .nodes = try .initCapacity(allocator, @max(1, 2 * triangleCount)),
+    };
+    defer allocator.free(builder.bounds);
+    defer allocator.free(builder.centroids);
+    defer allocator.free(builder.order);
+    errdefer builder.nodes.deinit();
+
+    for (0..triangleCount) |i| {
+        var bounds = Aabb{};
+        for (indices[3 * i ..][0..3]) |index| {
+            bounds.grow(vec3(positions[index]));
+        }
+        builder.bounds[i] = bounds;
+        builder.centroids[i] = (bounds.min + bounds.max) * @as(Vec3, @splat(0.5));
+        builder.order[i] = @intCast(i);
+    }
+    try builder.split(0, triangleCount, 0);
+
+    // Apply the order to the index buffer, so node ranges index it directly.
+    const sorted = try allocator.alloc(u32, indices.len);
+    defer allocator.free(sorted);
+    for (builder.order, 0..) |triangle, i| {
+        @memcpy(sorted[3 * i ..][0..3], indices[3 * triangle ..][0..3]);
+    }
+    @memcpy(indices, sorted);
+
+    return .{
+        .allocator = allocator,
+        .nodes = try builder.nodes.toOwnedSlice(),
+        .depth = builder.depth,
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    self.allocator.free(self.nodes);
+}
+
+pub fn rootBounds(self: @This()) Aabb {
+    return if (self.nodes.len > 0) self.nodes[0].bounds else .{};
+}
+
+// The nearest triangle hit by the ray origin + t * dir with 0 <= t <= maxDistance. dir need not
+// be normalized, distance is in units of its length. positions and indices are those passed to
+// build.
+pub fn raycast(
+    self: @This(),
+    positions: []const c.XrVector3f,
+    indices: []const u32,
+    origin: Vec3,
+    dir: Vec3,
+    maxDistance: f32,
+) ?Hit {
+    if (self.nodes.len == 0) {
+        return null;
+    }
+    // Division by a zero component gives an infinity, which the slab test handles.
+    const invDir = @as(Vec3, @splat(1)) / dir;
+    var nearest: ?Hit = null;
+    var limit = maxDistance;
+
+    var stack: [MAX_DEPTH]u32 = undefined;
+    var top: usize = 0;
+    var index: u32 = 0;
+    while (true) {
+        const node = self.nodes[index];
+        if (node.right == 0) {
+            for (node.first..node.first + node.count) |triangle| {
+                const tri = indices[3 * triangle ..][0..3];
+                if (intersectTriangle(origin, dir, vec3(positions[tri[0]]), vec3(positions[tri[1]]), vec3(positions[tri[2]]))) |t| {
+                    if (t <= limit) {
+                        limit = t;
+                        nearest = .{ .distance = t, .triangle = @intCast(triangle) };
+                    }
+                }
+            }
+        } else {
+            // Descend into the nearer child first, so the farther one is often pruned by limit.
+            const left = index + 1;
+            const tLeft = intersectAabb(self.nodes[left].bounds, origin, invDir, limit);
+            const tRight = intersectAabb(self.nodes[node.right].bounds, origin, invDir, limit);
+            if (tLeft != null and tRight != null) {
+                const leftFirst = tLeft.? <= tRight.?;
+                stack[top] = if (leftFirst) node.right else left;
+                top += 1;
+                index = if (leftFirst) left else node.right;
+                continue;
+            }
+            if (tLeft != null) {
+                index = left;
+                continue;
+            }
+            if (tRight != null) {
+                index = node.right;
+                continue;
+            }
+        }
+        if (top == 0) {
+            break;
+        }
+        top -= 1;
+        index = stack[top];
+    }
+    return nearest;
+}
+
+// Append the triangle ranges of the nodes inside all planes. A node entirely inside, or with at
+// most minTriangles triangles, is appended whole instead of being refined further, so a range
+// count stays small. Adjacent ranges are merged.
+pub fn cull(
+    self: @This(),
+    planes: []const Plane,
+    minTriangles: u32,
+    out: *std.array_list.Managed(Range),
+) !void {
+    if (self.nodes.len == 0) {
+        return;
+    }
+    var stack: [MAX_DEPTH]u32 = undefined;
+    var top: usize = 0;
+    var index: u32 = 0;
+    while (true) {
+        const node = self.nodes[index];
+        switch (classify(node.bounds, planes)) {
+            .outside => {},
+            .inside => try appendRange(out, node.first, node.count),
+            .intersecting => if (node.right == 0 or node.count <= minTriangles) {
+                try appendRange(out, node.first, node.count);
+            } else {
+                stack[top] = node.right;
+                top += 1;
+                index += 1;
+                continue;
+            },
+        }
+        if (top == 0) {
+            break;
+        }
+        top -= 1;
+        index = stack[top];
+    }
+}
+
+// The depth first order visits ranges in ascending order, so a range can only extend the last.
+fn appendRange(out: *std.array_list.Managed(Range), first: u32, count: u32) !void {
+    if (out.items.len > 0) {
+        const last = &out.items[out.items.len - 1];
+        if (last.first + last.count == first) {
+            last.count += count;
+            return;
+        }
+    }
+    try out.append(.{ .first = first, .count = count });
+}
+
+const Classification = enum { outside, inside, intersecting };
+
+fn classify(box: Aabb, planes: []const Plane) Classification {
+    const center = (box.min + box.max) * @as(Vec3, @splat(0.5));
+    const extent = (box.max - box.min) * @as(Vec3, @splat(0.5));
+    var result = Classification.inside;
+    for (planes) |plane| {
+        const normal = Vec3{ plane[0], plane[1], plane[2] };
+        const distance = @reduce(.Add, normal * center) + plane[3];
+        const radius = @reduce(.Add, @abs(normal) * extent);
+        if (distance < -radius) {
+            return .outside;
+        }
+        if (distance < radius) {
+            result = .intersecting;
+        }
+    }
+    return result;
+}
+
+// Entry distance of the ray into box if it is within limit.
+fn intersectAabb(box: Aabb, origin: Vec3, invDir: Vec3, limit: f32) ?f32 {
+    const t0 = (box.min - origin) * invDir;
+    const t1 = (box.max - origin) * invDir;
+    const tNear = @max(@reduce(.Max, @min(t0, t1)), 0);
+    const tFar = @min(@reduce(.Min, @max(t0, t1)), limit);
+    return if (tNear <= tFar) tNear else null;
+}
+
+// Möller-Trumbore, both faces.
+fn intersectTriangle(origin: Vec3, dir: Vec3, v0: Vec3, v1: Vec3, v2: Vec3) ?f32 {
+    const e1 = v1 - v0;
+    const e2 = v2 - v0;
+    const p = cross(dir, e2);
+    const det = dot(e1, p);
+    if (@abs(det) < 1e-12) {
+        return null;
+    }
+    const invDet = 1 / det;
+    const s = origin - v0;
+    const u = dot(s, p) * invDet;
+    if (u < 0 or u > 1) {
+        return null;
+    }
+    const q = cross(s, e1);
+    const v = dot(dir, q) * invDet;
+    if (v < 0 or u + v > 1) {
+        return null;
+    }
+    const t = dot(e2, q) * invDet;
+    return if (t >= 0) t else null;
+}
+
+pub fn vec3(v: c.XrVector3f) Vec3 {
+    return .{ v.x, v.y, v.z };
+}
+
+pub fn dot(a: Vec3, b: Vec3) f32 {
+    return @reduce(.Add, a * b);
+}
+
+pub fn cross(a: Vec3, b: Vec3) Vec3 {
+    return .{
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0],
+    };
+}
+
+const Builder = struct {
+    bounds: []Aabb,
+    centroids: []Vec3,
+    // Triangle of each sorted slot.
+    order: []u32,
+    nodes: std.array_list.Managed(Node),
+    depth: u32 = 0,
+
+    const Bin = struct {
+        bounds: Aabb = .{},
+        count: u32 = 0,
+    };
+
+    fn split(self: *@This(), first: u32, count: u32, depth: u32) !void {
+        self.depth = @max(self.depth, depth + 1);
+        const index: u32 = @intCast(self.nodes.items.len);
+        var nodeBounds = Aabb{};
+        var centroidBounds = Aabb{};
+        for (self.order[first..][0..count]) |triangle| {
+            nodeBounds.merge(self.bounds[triangle]);
+            centroidBounds.grow(self.centroids[triangle]);
+        }
+        try self.nodes.append(.{ .bounds = nodeBounds, .first = first, .count = count, .right = 0 });
+
+        if (count <= LEAF_SIZE or depth + 1 >= MAX_DEPTH) {
+            return;
+        }
+        const mid = self.partition(first, count, nodeBounds, centroidBounds) orelse return;
+        try self.split(first, mid - first, depth + 1);
+        self.nodes.items[index].right = @intCast(self.nodes.items.len);
+        try self.split(mid, first + count - mid, depth + 1);
+    }
+
+    // Sort the range around the cheapest binned split along the widest centroid axis and return
+    // the first slot of the right half, or null when a leaf is cheaper.
+    fn partition(self: *@This(), first: u32, count: u32, nodeBounds: Aabb, centroidBounds: Aabb) ?u32 {
+        const extent = centroidBounds.max - centroidBounds.min;
+        var axis: usize = 0;
+        if (extent[1] > extent[axis]) axis = 1;
+        if (extent[2] > extent[axis]) axis = 2;
+        if (extent[axis] <= 0) {
+            // All centroids coincide, no split separates them.
+            return null;
+        }
+        const scale = BIN_COUNT / extent[axis];
+        const lo = centroidBounds.min[axis];
+        const binOf = struct {
+            fn f(x: f32, l: f32, s: f32) usize {
+                return @min(BIN_COUNT - 1, @as(usize, @intFromFloat((x - l) * s)));
+            }
+        }.f;
+
+        var bins = [_]Bin{.{}} ** BIN_COUNT;
+        for (self.order[first..][0..count]) |triangle| {
+            const bin = &bins[binOf(self.centroids[triangle][axis], lo, scale)];
+            bin.bounds.merge(self.bounds[triangle]);
+            bin.count += 1;
+        }
+
+        // Sweep from the right for the suffix costs, then from the left for the best plane.
+        var rightArea: [BIN_COUNT]f32 = undefined;
+        var rightCount: [BIN_COUNT]u32 = undefined;
+        var acc = Aabb{};
+        var n: u32 = 0;
+        var i: usize = BIN_COUNT;
+        while (i > 1) {
+            i -= 1;
+            acc.merge(bins[i].bounds);
+            n += bins[i].count;
+            rightArea[i] = acc.area();
+            rightCount[i] = n;
+        }
+        var bestCost = std.math.inf(f32);
+        var bestPlane: usize = 0;
+        acc = .{};
+        n = 0;
+        for (1..BIN_COUNT) |plane| {
+            acc.merge(bins[plane - 1].bounds);
+            n += bins[plane - 1].count;
+            if (n == 0 or rightCount[plane] == 0) {
+                continue;
+            }
+            const cost = acc.area() * @as(f32, @floatFromInt(n)) + rightArea[plane] * @as(f32, @floatFromInt(rightCount[plane]));
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestPlane = plane;
+            }
+        }
+        // A leaf costs one intersection per triangle, a split adds a traversal step.
+        const leafCost = nodeBounds.area() * @as(f32, @floatFromInt(count));
+        if (bestPlane == 0 or (bestCost >= leafCost and count <= MAX_LEAF_SIZE)) {
+            return null;
+        }
+
+        var left = first;
+        var right = first + count;
+        while (left < right) {
+            if (binOf(self.centroids[self.order[left]][axis], lo, scale) < bestPlane) {
+                left += 1;
+            } else {
+                right -= 1;
+                std.mem.swap(u32, &self.order[left], &self.order[right]);
+            }
+        }
+        return left;
+    }
+};
+
+const TestMesh = struct {
+    positions: std.array_list.Managed(c.XrVector3f),
+    indices: std.array_list.Managed(u32),
+
+    fn init() @This() {
+        return .{
+            .positions = .init(std.testing.allocator),
+            .indices = .init(std.testing.allocator),
+        };
+    }
+
+    fn deinit(self: *@This()) void {
+        self.positions.deinit();
+        self.indices.deinit();
+    }
+
+    fn triangle(self: *@This(), v0: Vec3, v1: Vec3, v2: Vec3) !void {
+        const base: u32 = @intCast(self.positions.items.len);
+        for ([_]Vec3{ v0, v1, v2 }) |v| {
+            try self.positions.append(.{ .x = v[0], .y = v[1], .z = v[2] });
+        }
+        try self.indices.appendSlice(&.{ base, base + 1, base + 2 });
+    }
+};
+
+const TestRandom = struct {
+    prng: std.Random.DefaultPrng = .init(0xb5),
+
+    fn float(self: *@This(), min: f32, max: f32) f32 {
+        return min + (max - min) * self.prng.random().float(f32);
+    }
+
+    fn vector(self: *@This(), min: f32, max: f32) Vec3 {
+        return .{ self.float(min, max), self.float(min, max), self.float(min, max) };
+    }
+
+    fn direction(self: *@This()) Vec3 {
+        while (true) {
+            const v = self.vector(-1, 1);
+            const length = @sqrt(dot(v, v));
+            if (length > 0.1) {
+                return v / @as(Vec3, @splat(length));
+            }
+        }
+    }
+
+    // Small random triangles in a 10 m box, with every eighth one collapsed to a line or a point.
+    fn triangles(self: *@This(), mesh: *TestMesh, count: usize) !void {
+        for (0..count) |i| {
+            const v0 = self.vector(-5, 5);
+            const v1 = v0 + self.vector(-0.5, 0.5);
+            const v2 = switch (i % 8) {
+                0 => v0,
+                1 => v0 + (v1 - v0) * @as(Vec3, @splat(0.5)),
+                else => v0 + self.vector(-0.5, 0.5),
+            };
+            try mesh.triangle(v0, v1, v2);
+        }
+    }
+};
+
+fn bruteRaycast(positions: []const c.XrVector3f, indices: []const u32, origin: Vec3, dir: Vec3, maxDistance: f32) ?f32 {
+    var nearest: ?f32 = null;
+    for (0..indices.len / 3) |triangle| {
+        const tri = indices[3 * triangle ..][0..3];
+        if (intersectTriangle(origin, dir, vec3(positions[tri[0]]), vec3(positions[tri[1]]), vec3(positions[tri[2]]))) |t| {
+            if (t <= maxDistance and (nearest == null or t < nearest.?)) {
+                nearest = t;
+            }
+        }
+    }
+    return nearest;
+}
+
+fn expectRaycast(bvh: @This(), mesh: TestMesh, origin: Vec3, dir: Vec3, maxDistance: f32) !void {
+    const expected = bruteRaycast(mesh.positions.items, mesh.indices.items, origin, dir, maxDistance);
+    const actual = bvh.raycast(mesh.positions.items, mesh.indices.items, origin, dir, maxDistance);
+    try std.testing.expectEqual(expected != null, actual != null);
+    if (expected) |t| {
+        try std.testing.expectApproxEqAbs(t, actual.?.distance, 1e-5 * @max(1.0, t));
+    }
+}
+
+// Every triangle whose bounds are not outside a plane is in a range, and the ranges are sorted,
+// merged and within the mesh.
+fn expectCull(bvh: @This(), mesh: TestMesh, planes: []const Plane) !void {
+    var ranges = std.array_list.Managed(Range).init(std.testing.allocator);
+    defer ranges.deinit();
+    try bvh.cull(planes, 0, &ranges);
+
+    const triangleCount = mesh.indices.items.len / 3;
+    for (ranges.items, 0..) |range, i| {
+        try std.testing.expect(range.count > 0);
+        try std.testing.expect(range.first + range.count <= triangleCount);
+        if (i > 0) {
+            const prev = ranges.items[i - 1];
+            try std.testing.expect(prev.first + prev.count < range.first);
+        }
+    }
+    for (0..triangleCount) |triangle| {
+        var bounds = Aabb{};
+        for (mesh.indices.items[3 * triangle ..][0..3]) |index| {
+            bounds.grow(vec3(mesh.positions.items[index]));
+        }
+        if (classify(bounds, planes) == .outside) {
+            continue;
+        }
+        var covered = false;
+        for (ranges.items) |range| {
+            covered = covered or (triangle >= range.first and triangle < range.first + range.count);
+        }
+        try std.testing.expect(covered);
+    }
+}
+
+fn randomPlanes(random: *TestRandom, planes: []Plane) void {
+    for (planes) |*plane| {
+        const normal = random.direction();
+        plane.* = .{ normal[0], normal[1], normal[2], random.float(-2, 4) };
+    }
+}
+
+test "raycast and cull match brute force on random triangles" {
+    var random = TestRandom{};
+    var mesh = TestMesh.init();
+    defer mesh.deinit();
+    try random.triangles(&mesh, 2000);
+    var bvh = try build(std.testing.allocator, mesh.positions.items, mesh.indices.items);
+    defer bvh.deinit();
+    try std.testing.expect(bvh.depth <= MAX_DEPTH);
+
+    for (0..500) |_| {
+        try expectRaycast(bvh, mesh, random.vector(-8, 8), random.direction(), random.float(0.5, 20));
+    }
+    var planes: [6]Plane = undefined;
+    for (0..100) |i| {
+        randomPlanes(&random, planes[0 .. 1 + i % 6]);
+        try expectCull(bvh, mesh, planes[0 .. 1 + i % 6]);
+    }
+}
+
+test "cull without planes returns the whole mesh as one range" {
+    var random = TestRandom{};
+    var mesh = TestMesh.init();
+    defer mesh.deinit();
+    try random.triangles(&mesh, 300);
+    var bvh = try build(std.testing.allocator, mesh.positions.items, mesh.indices.items);
+    defer bvh.deinit();
+
+    var ranges = std.array_list.Managed(Range).init(std.testing.allocator);
+    defer ranges.deinit();
+    try bvh.cull(&.{}, 0, &ranges);
+    try std.testing.expectEqualSlices(Range, &.{.{ .first = 0, .count = 300 }}, ranges.items);
+}
+
+test "coplanar triangles, rays through and within their plane" {
+    var random = TestRandom{};
+    var mesh = TestMesh.init();
+    defer mesh.deinit();
+    for (0..500) |_| {
+        const v0 = Vec3{ random.float(-5, 5), random.float(-5, 5), 0 };
+        try mesh.triangle(
+            v0,
+            v0 + Vec3{ random.float(-0.5, 0.5), random.float(-0.5, 0.5), 0 },
+            v0 + Vec3{ random.float(-0.5, 0.5), random.float(-0.5, 0.5), 0 },
+        );
+    }
+    var bvh = try build(std.testing.allocator, mesh.positions.items, mesh.indices.items);
+    defer bvh.deinit();
+
+    for (0..200) |_| {
+        const origin = Vec3{ random.float(-6, 6), random.float(-6, 6), random.float(0.1, 3) };
+        try expectRaycast(bvh, mesh, origin, random.direction(), 20);
+        // Parallel to the plane, never a hit.
+        const flat = Vec3{ random.float(-6, 6), random.float(-6, 6), 0 };
+        try expectRaycast(bvh, mesh, flat, Vec3{ 1, 0, 0 }, 20);
+    }
+    var planes: [4]Plane = undefined;
+    for (0..50) |_| {
+        randomPlanes(&random, &planes);
+        try expectCull(bvh, mesh, &planes);
+    }
+}
+
+test "coincident triangles and an empty mesh" {
+    var mesh = TestMesh.init();
+    defer mesh.deinit();
+    for (0..40) |_| {
+        try mesh.triangle(.{ -1, -1, 2 }, .{ 1, -1, 2 }, .{ 0, 1, 2 });
+    }
+    var bvh = try build(std.testing.allocator, mesh.positions.items, mesh.indices.items);
+    defer bvh.deinit();
+    // No split separates equal centroids, so this is one leaf.
+    try std.testing.expectEqual(1, bvh.nodes.len);
+    try expectRaycast(bvh, mesh, .{ 0, 0, 0 }, .{ 0, 0, 1 }, 10);
+
+    var empty = TestMesh.init();
+    defer empty.deinit();
+    var emptyBvh = try build(std.testing.allocator, empty.positions.items, empty.indices.items);
+    defer emptyBvh.deinit();
+    try std.testing.expectEqual(null, emptyBvh.raycast(empty.positions.items, empty.indices.items, .{ 0, 0, 0 }, .{ 0, 0, 1 }, 10));
+}
+
+fn subtreeDepth(nodes: []const Node, index: u32) u32 {
+    const node = nodes[index];
+    if (node.right == 0) {
+        return 1;
+    }
+    return 1 + @max(subtreeDepth(nodes, index + 1), subtreeDepth(nodes, node.right));
+}
+
+test "a skewed mesh stays within the MAX_DEPTH traversal stacks" {
+    // Each triangle twice as far out as the previous one, so every split only peels off the
+    // outermost few and the tree is as deep as binning allows.
+    var random = TestRandom{};
+    var mesh = TestMesh.init();
+    defer mesh.deinit();
+    var x: f32 = 1;
+    for (0..100) |_| {
+        try mesh.triangle(.{ x, -1, -1 }, .{ x, 1, -1 }, .{ x, 0, 1 });
+        x *= 2;
+    }
+    var bvh = try build(std.testing.allocator, mesh.positions.items, mesh.indices.items);
+    defer bvh.deinit();
+    try std.testing.expectEqual(bvh.depth, subtreeDepth(bvh.nodes, 0));
+    try std.testing.expect(bvh.depth <= MAX_DEPTH);
+
+    for (0..200) |_| {
+        const origin = Vec3{ -1, random.float(-0.9, 0.9), random.float(-0.9, 0.5) };
+        try expectRaycast(bvh, mesh, origin, .{ 1, 0, 0 }, std.math.inf(f32));
+        try expectRaycast(bvh, mesh, origin, random.direction(), 1e30);
+    }
+    var planes: [3]Plane = undefined;
+    for (0..50) |_| {
+        randomPlanes(&random, &planes);
+        try expectCull(bvh, mesh, &planes);
+    }
+}
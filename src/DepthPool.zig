@@ -0,0 +1,89 @@
+// Depth is cleared at the start of every view and never read back, so every color image
+// with the same (width, height, format, samples) renders against one shared renderbuffer
+// instead of owning a full-resolution depth texture each.
+const std = @import("std");
+const c = @import("c");
+const slot_map = @import("slot_map.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+
+pub const Key = struct {
+    width: i32,
+    height: i32,
+    format: u32,
+    samples: i32,
+
+    pub fn byteSize(self: @This()) usize {
+        // DEPTH24_STENCIL8 is 4 bytes per sample.
+        return @as(usize, @intCast(self.width)) * @as(usize, @intCast(self.height)) * @as(usize, @intCast(self.samples)) * 4;
+    }
+};
+
+// The renderbuffers belong to pool, the table only points into it.
+fn keep(_: u32) void {}
+
+pool: std.AutoHashMap(Key, u32),
+// The depth buffer matched with each color image, so a view looks it up without hashing.
+colorToDepth: slot_map.ImageTable(u32, keep),
+pooledBytes: usize = 0,
+unpooledBytes: usize = 0,
+
+pub fn init(allocator: std.mem.Allocator) @This() {
+    return .{
+        .pool = .init(allocator),
+        .colorToDepth = .init(allocator),
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    var it = self.pool.valueIterator();
+    while (it.next()) |depthBuffer| {
+        c.glDeleteRenderbuffers(1, depthBuffer);
+    }
+    self.pool.deinit();
+    self.colorToDepth.deinit();
+}
+
+// Drop the color image associations when the swapchains are destroyed. The pooled renderbuffers
+// stay alive for the next swapchains, which usually have the same size.
+pub fn releaseColorImages(self: *@This()) void {
+    self.colorToDepth.clear();
+    self.unpooledBytes = 0;
+}
+
+// Returns the GL_DEPTH24_STENCIL8 renderbuffer to attach together with color.
+pub fn get(self: *@This(), color: GraphicsPlugin.SwapchainTexture, width: i32, height: i32) !u32 {
+    // If this back-buffer has already been matched with a pooled depth buffer, use it.
+    if (self.colorToDepth.get(color.images, color.index)) |depthBuffer| {
+        return depthBuffer;
+    }
+
+    // Swapchains are single-sampled, see getSupportedSwapchainSampleCount.
+    const key = Key{
+        .width = width,
+        .height = height,
+        .format = c.GL_DEPTH24_STENCIL8,
+        .samples = 1,
+    };
+
+    const depthBuffer = self.pool.get(key) orelse blk: {
+        var newBuffer: u32 = undefined;
+        c.glGenRenderbuffers(1, &newBuffer);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, newBuffer);
+        c.glRenderbufferStorage(c.GL_RENDERBUFFER, key.format, width, height);
+        c.glBindRenderbuffer(c.GL_RENDERBUFFER, 0);
+        try self.pool.put(key, newBuffer);
+        self.pooledBytes += key.byteSize();
+        break :blk newBuffer;
+    };
+
+    try self.colorToDepth.put(color.images, color.index, depthBuffer);
+    self.unpooledBytes += key.byteSize();
+    std.log.info("depth pool: {} color images share {} depth buffers ({d:.1} MB instead of {d:.1} MB)", .{
+        self.colorToDepth.count(),
+        self.pool.count(),
+        @as(f64, @floatFromInt(self.pooledBytes)) / (1024.0 * 1024.0),
+        @as(f64, @floatFromInt(self.unpooledBytes)) / (1024.0 * 1024.0),
+    });
+
+    return depthBuffer;
+}
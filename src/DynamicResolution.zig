@@ -0,0 +1,63 @@
+// Picks how much of each swapchain image to render into from the measured GPU frame time.
+//
+// Swapchains are allocated at maxImageRect size and every view renders into a sub-rect of
+// scale * size, which the projection layer submits as imageRect so the compositor upsamples it.
+// Over budget the scale drops on the next frame; under budget it only grows after a run of cheap
+// frames, so it does not oscillate around the threshold.
+const std = @import("std");
+const c = @import("c");
+
+// Fraction of the display period the GPU may spend on a frame.
+const BUDGET = 0.9;
+// Grow only after GROW_FRAMES frames below this fraction of the budget.
+const GROW_THRESHOLD = 0.75;
+const GROW_FRAMES = 30;
+const GROW_STEP = 0.05;
+// Never shrink by more than this per frame.
+const MAX_SHRINK = 0.1;
+
+scale: f32,
+minScale: f32,
+maxScale: f32 = 1.0,
+cheapFrames: u32 = 0,
+
+// recommendedScale is recommendedImageRect / maxImageRect; the controller starts there and may go
+// down to half of it.
+pub fn init(recommendedScale: f32) @This() {
+    return .{
+        .scale = recommendedScale,
+        .minScale = recommendedScale * 0.5,
+    };
+}
+
+pub fn update(self: *@This(), gpuTime: u64, displayPeriod: i64) void {
+    if (displayPeriod <= 0) {
+        return;
+    }
+    const budget = BUDGET * @as(f32, @floatFromInt(displayPeriod));
+    const load = @as(f32, @floatFromInt(gpuTime)) / budget;
+    if (load > 1.0) {
+        // GPU time follows the pixel count, which goes with the square of the scale.
+        const factor = @max(1.0 - MAX_SHRINK, @sqrt(1.0 / load));
+        self.scale = @max(self.minScale, self.scale * factor);
+        self.cheapFrames = 0;
+    } else if (load < GROW_THRESHOLD) {
+        self.cheapFrames += 1;
+        if (self.cheapFrames >= GROW_FRAMES) {
+            self.scale = @min(self.maxScale, self.scale + GROW_STEP);
+            self.cheapFrames = 0;
+        }
+    } else {
+        self.cheapFrames = 0;
+    }
+}
+
+pub fn imageRect(self: @This(), width: u32, height: u32) c.XrRect2Di {
+    return .{
+        .offset = .{ .x = 0, .y = 0 },
+        .extent = .{
+            .width = @max(1, @as(i32, @intFromFloat(@as(f32, @floatFromInt(width)) * self.scale))),
+            .height = @max(1, @as(i32, @intFromFloat(@as(f32, @floatFromInt(height)) * self.scale))),
+        },
+    };
+}
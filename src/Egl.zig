@@ -1,6 +1,7 @@
 const std = @import("std");
 const xr_util = @import("xr_util.zig");
 const c = @import("c");
+const GlUploader = @import("GlUploader.zig");
 
 const ksGpuSurfaceColorFormat = enum {
     KS_GPU_SURFACE_COLOR_FORMAT_R5G6B5,
@@ -107,11 +108,74 @@ const ksGpuSurfaceBits = struct {
 };
 
 display: c.EGLDisplay,
-//     EGLConfig config;
+config: c.EGLConfig,
 //     EGLSurface tinySurface;
 //     EGLSurface mainSurface;
 context: c.EGLContext,
 
+// A context in the share group of the render context, for use on a loader thread.
+pub const SharedContext = struct {
+    display: c.EGLDisplay,
+    surface: c.EGLSurface,
+    context: c.EGLContext,
+
+    pub fn deinit(self: *@This()) void {
+        _ = c.eglDestroySurface(self.display, self.surface);
+        _ = c.eglDestroyContext(self.display, self.context);
+    }
+
+    pub fn uploaderContext(self: *@This()) GlUploader.Context {
+        return .{
+            .ptr = self,
+            .makeCurrent = &makeCurrent,
+            .unsetCurrent = &unsetCurrent,
+        };
+    }
+
+    fn makeCurrent(ptr: *anyopaque) bool {
+        const self: *@This() = @ptrCast(@alignCast(ptr));
+        return c.eglMakeCurrent(self.display, self.surface, self.surface, self.context) == c.EGL_TRUE;
+    }
+
+    fn unsetCurrent(ptr: *anyopaque) void {
+        const self: *@This() = @ptrCast(@alignCast(ptr));
+        _ = c.eglMakeCurrent(self.display, c.EGL_NO_SURFACE, c.EGL_NO_SURFACE, c.EGL_NO_CONTEXT);
+    }
+};
+
+pub fn createShared(self: @This()) ?SharedContext {
+    const contextAttribs = [_]c.EGLint{
+        c.EGL_CONTEXT_CLIENT_VERSION,
+        3,
+        c.EGL_NONE,
+    };
+    const context = c.eglCreateContext(self.display, self.config, self.context, &contextAttribs[0]);
+    if (context == c.EGL_NO_CONTEXT) {
+        std.log.err("eglCreateContext(shared) failed: {s}", .{EglErrorString(c.eglGetError())});
+        return null;
+    }
+
+    const surfaceAttribs = [_]c.EGLint{
+        c.EGL_WIDTH,
+        16,
+        c.EGL_HEIGHT,
+        16,
+        c.EGL_NONE,
+    };
+    const surface = c.eglCreatePbufferSurface(self.display, self.config, &surfaceAttribs[0]);
+    if (surface == c.EGL_NO_SURFACE) {
+        std.log.err("eglCreatePbufferSurface(shared) failed: {s}", .{EglErrorString(c.eglGetError())});
+        _ = c.eglDestroyContext(self.display, context);
+        return null;
+    }
+
+    return .{
+        .display = self.display,
+        .surface = surface,
+        .context = context,
+    };
+}
+
 // #if defined(OS_ANDROID) || defined(OS_LINUX_WAYLAND)
 //
 // #define EGL(func)                                                      \
@@ -147,7 +211,7 @@ fn ksGpuContext_CreateForSurface(
     colorFormat: ksGpuSurfaceColorFormat,
     depthFormat: ksGpuSurfaceDepthFormat,
     sampleCount: ksGpuSampleCount,
-) ?c.EGLContext {
+) ?struct { context: c.EGLContext, config: c.EGLConfig } {
 
     // Do NOT use eglChooseConfig, because the Android EGL code pushes in multisample
     // flags in eglChooseConfig when the user has selected the "force 4x MSAA" option in
@@ -248,7 +312,7 @@ fn ksGpuContext_CreateForSurface(
     }
     // context->mainSurface = context->tinySurface;
 
-    return context;
+    return .{ .context = context, .config = config };
 }
 
 // void ksGpuContext_Destroy(ksGpuContext *context) {
@@ -294,7 +358,7 @@ pub fn init(
     }
     std.log.info("EGL {}.{}", .{ majorVersion, minorVersion });
 
-    const context = ksGpuContext_CreateForSurface(
+    const created = ksGpuContext_CreateForSurface(
         @ptrCast(display),
         colorFormat,
         depthFormat,
@@ -303,13 +367,14 @@ pub fn init(
         return null;
     };
 
-    if (c.eglMakeCurrent(display, null, null, context) != c.EGL_TRUE) {
+    if (c.eglMakeCurrent(display, null, null, created.context) != c.EGL_TRUE) {
         std.log.err("eglMakeCurrent", .{});
         return null;
     }
 
     return @This(){
         .display = display,
-        .context = context,
+        .config = created.config,
+        .context = created.context,
     };
 }
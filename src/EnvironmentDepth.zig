@@ -0,0 +1,133 @@
+// XR_META_environment_depth: a depth map of the real world per eye, for occluding virtual content
+// with the passthrough it is composited over.
+//
+// The runtime renders into a two-layer depth swapchain of its own, one layer per eye, each with
+// the pose and fov it was captured from. The renderer binds the acquired layer as a texture,
+// reprojects every fragment into it and fades the fragment out where the real surface is closer.
+// Nothing is read back to the CPU. An acquired image stays valid until the next acquire, there is
+// no release. Desktop GL only, where the passthrough layer is submitted.
+const std = @import("std");
+const c = @import("c");
+const xr_gen = @import("openxr");
+const xr_result = @import("xr_result.zig");
+const xr_linear = @import("xr_linear.zig");
+const get_proc = @import("get_proc.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+
+pub const EXTENSION_NAME = c.XR_META_ENVIRONMENT_DEPTH_EXTENSION_NAME;
+
+const VIEW_COUNT = 2;
+
+// What a renderer needs to occlude one view.
+pub const Occlusion = struct {
+    // GL_TEXTURE_2D_ARRAY of depth, layer per view.
+    texture: u32,
+    layer: u32,
+    nearZ: f32,
+    // 0 for an infinite far plane.
+    farZ: f32,
+    // Projects app space into the depth layer, with the depth camera's pose and fov.
+    viewProjection: xr_linear.Matrix4x4f,
+};
+
+pub const Frame = struct {
+    texture: u32,
+    nearZ: f32,
+    farZ: f32,
+    viewProjections: [VIEW_COUNT]xr_linear.Matrix4x4f,
+
+    pub fn occlusion(self: @This(), view: usize) Occlusion {
+        return .{
+            .texture = self.texture,
+            .layer = @intCast(view),
+            .nearZ = self.nearZ,
+            .farZ = if (std.math.isInf(self.farZ)) 0 else self.farZ,
+            .viewProjection = self.viewProjections[view],
+        };
+    }
+};
+
+ext: xr_gen.extensions.XR_META_environment_depth,
+provider: c.XrEnvironmentDepthProviderMETA = null,
+swapchain: c.XrEnvironmentDepthSwapchainMETA = null,
+images: GraphicsPlugin.SwapchainImages = undefined,
+width: u32 = 0,
+height: u32 = 0,
+
+pub fn init(instance: c.XrInstance, session: c.XrSession, graphics: *GraphicsPlugin) !@This() {
+    var self = @This(){
+        .ext = .{},
+    };
+    get_proc.getProcs(@ptrCast(instance), &self.ext);
+
+    const providerCreateInfo = c.XrEnvironmentDepthProviderCreateInfoMETA{
+        .type = c.XR_TYPE_ENVIRONMENT_DEPTH_PROVIDER_CREATE_INFO_META,
+    };
+    try xr_result.check(self.ext.xrCreateEnvironmentDepthProviderMETA.?(session, &providerCreateInfo, &self.provider));
+    errdefer _ = self.ext.xrDestroyEnvironmentDepthProviderMETA.?(self.provider);
+
+    const swapchainCreateInfo = c.XrEnvironmentDepthSwapchainCreateInfoMETA{
+        .type = c.XR_TYPE_ENVIRONMENT_DEPTH_SWAPCHAIN_CREATE_INFO_META,
+    };
+    try xr_result.check(self.ext.xrCreateEnvironmentDepthSwapchainMETA.?(self.provider, &swapchainCreateInfo, &self.swapchain));
+    errdefer _ = self.ext.xrDestroyEnvironmentDepthSwapchainMETA.?(self.swapchain);
+
+    var state = c.XrEnvironmentDepthSwapchainStateMETA{
+        .type = c.XR_TYPE_ENVIRONMENT_DEPTH_SWAPCHAIN_STATE_META,
+    };
+    try xr_result.check(self.ext.xrGetEnvironmentDepthSwapchainStateMETA.?(self.swapchain, &state));
+    self.width = state.width;
+    self.height = state.height;
+
+    var imageCount: u32 = 0;
+    try xr_result.check(self.ext.xrEnumerateEnvironmentDepthSwapchainImagesMETA.?(self.swapchain, 0, &imageCount, null));
+    const images = graphics.allocateSwapchainImageStructs(imageCount, &self.images);
+    try xr_result.check(self.ext.xrEnumerateEnvironmentDepthSwapchainImagesMETA.?(self.swapchain, imageCount, &imageCount, images));
+
+    try xr_result.check(self.ext.xrStartEnvironmentDepthProviderMETA.?(self.provider));
+    std.log.info("environment depth: {}x{} x {} images", .{ self.width, self.height, imageCount });
+    return self;
+}
+
+pub fn deinit(self: *@This(), graphics: GraphicsPlugin) void {
+    _ = self.ext.xrStopEnvironmentDepthProviderMETA.?(self.provider);
+    graphics.freeSwapchainImageStructs(self.images);
+    _ = self.ext.xrDestroyEnvironmentDepthSwapchainMETA.?(self.swapchain);
+    _ = self.ext.xrDestroyEnvironmentDepthProviderMETA.?(self.provider);
+}
+
+// The depth image for displayTime in space. Null until the provider has produced a first image.
+pub fn acquire(self: @This(), graphics: GraphicsPlugin, space: c.XrSpace, displayTime: i64) !?Frame {
+    const acquireInfo = c.XrEnvironmentDepthImageAcquireInfoMETA{
+        .type = c.XR_TYPE_ENVIRONMENT_DEPTH_IMAGE_ACQUIRE_INFO_META,
+        .space = space,
+        .displayTime = displayTime,
+    };
+    var image = c.XrEnvironmentDepthImageMETA{
+        .type = c.XR_TYPE_ENVIRONMENT_DEPTH_IMAGE_META,
+    };
+    for (&image.views) |*view| {
+        view.type = c.XR_TYPE_ENVIRONMENT_DEPTH_IMAGE_VIEW_META;
+        view.next = null;
+    }
+    const res = self.ext.xrAcquireEnvironmentDepthImageMETA.?(self.provider, &acquireInfo, &image);
+    if (res == c.XR_ENVIRONMENT_DEPTH_NOT_AVAILABLE_META) {
+        return null;
+    }
+    try xr_result.check(res);
+
+    var frame = Frame{
+        .texture = switch (graphics.getSwapchainImage(self.images, image.swapchainIndex)) {
+            .OpenGL => |gl| gl.image,
+            else => return error.unsupported_graphics,
+        },
+        .nearZ = image.nearZ,
+        .farZ = image.farZ,
+        .viewProjections = undefined,
+    };
+    // Only x/w, y/w and w are used, so the plugin's near and far planes do not matter.
+    for (&frame.viewProjections, image.views) |*vp, view| {
+        vp.* = graphics.calcViewProjectionMatrix(view.fov, view.pose);
+    }
+    return frame;
+}
@@ -0,0 +1,386 @@
+// Uploads textures and buffers on a loader thread so the render thread never blocks on a transfer.
+//
+// The loader thread owns a GL context in the render context's share group. Pixels are streamed
+// through a pixel unpack buffer, and every finished upload is followed by a glFenceSync that the
+// render thread polls without waiting; the object is handed out only once the fence has signaled.
+// An id stays valid until the caller releases it, after which submit reuses its slot.
+//
+// If the loader thread cannot make its context current, every queued upload fails and submit
+// returns error.UploaderFailed from then on. Callers upload with upload on their own thread then.
+const std = @import("std");
+const c = @import("c");
+
+// A context shared with the render context, made current on the loader thread.
+pub const Context = struct {
+    ptr: *anyopaque,
+    makeCurrent: *const fn (ptr: *anyopaque) bool,
+    unsetCurrent: *const fn (ptr: *anyopaque) void,
+};
+
+pub const Request = union(enum) {
+    // RGBA8, tightly packed.
+    texture: struct {
+        width: i32,
+        height: i32,
+        pixels: []const u8,
+    },
+    buffer: struct {
+        data: []const u8,
+        usage: u32 = c.GL_STATIC_DRAW,
+    },
+};
+
+pub const Status = union(enum) {
+    pending,
+    // The texture or buffer name, owned by the caller once it releases the id.
+    ready: u32,
+    // The upload could not be written, e.g. glMapBufferRange failed, or the loader thread has no
+    // context. Nothing was created.
+    failed,
+};
+
+const State = enum {
+    free,
+    queued,
+    fenced,
+    ready,
+    failed,
+    // Released while the loader thread still had it, which deletes the object when done.
+    cancelled,
+};
+
+const Slot = struct {
+    state: State = .queued,
+    kind: std.meta.Tag(Request),
+    name: u32 = 0,
+    fence: c.GLsync = null,
+};
+
+const Job = struct {
+    id: u32,
+    request: Request,
+};
+
+allocator: std.mem.Allocator,
+context: Context,
+thread: ?std.Thread = null,
+mutex: std.Thread.Mutex = .{},
+cond: std.Thread.Condition = .{},
+quit: bool = false,
+// Set when the loader thread could not make its context current.
+failed: bool = false,
+jobs: std.array_list.Managed(Job),
+slots: std.array_list.Managed(Slot),
+// Indices of free slots.
+free: std.array_list.Managed(u32),
+
+pub fn create(allocator: std.mem.Allocator, context: Context) !*@This() {
+    const self = try allocator.create(@This());
+    self.* = .{
+        .allocator = allocator,
+        .context = context,
+        .jobs = .init(allocator),
+        .slots = .init(allocator),
+        .free = .init(allocator),
+    };
+    self.thread = try std.Thread.spawn(.{}, run, .{self});
+    return self;
+}
+
+pub fn destroy(self: *@This()) void {
+    {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.quit = true;
+    }
+    self.cond.signal();
+    if (self.thread) |thread| {
+        thread.join();
+    }
+
+    for (self.jobs.items) |job| {
+        self.freeRequest(job.request);
+    }
+    self.jobs.deinit();
+    for (self.slots.items) |slot| {
+        if (slot.fence != null) {
+            c.glDeleteSync(slot.fence);
+        }
+    }
+    self.slots.deinit();
+    self.free.deinit();
+    self.allocator.destroy(self);
+}
+
+// Queue an upload. The data is copied, so the caller may free it right away.
+pub fn submit(self: *@This(), request: Request) !u32 {
+    return (try self.submitAll(1, .{request}))[0];
+}
+
+// Queue n uploads, all of them or none, so a caller on another thread never holds an id it would
+// have to release. The data is copied.
+pub fn submitAll(self: *@This(), comptime n: usize, requests: [n]Request) ![n]u32 {
+    var owned: [n]Request = undefined;
+    var ownedCount: usize = 0;
+    errdefer for (owned[0..ownedCount]) |request| {
+        self.freeRequest(request);
+    };
+    for (requests, &owned) |request, *dst| {
+        dst.* = switch (request) {
+            .texture => |t| .{ .texture = .{
+                .width = t.width,
+                .height = t.height,
+                .pixels = try self.allocator.dupe(u8, t.pixels),
+            } },
+            .buffer => |b| .{ .buffer = .{
+                .data = try self.allocator.dupe(u8, b.data),
+                .usage = b.usage,
+            } },
+        };
+        ownedCount += 1;
+    }
+
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    if (self.failed) {
+        return error.UploaderFailed;
+    }
+    try self.jobs.ensureUnusedCapacity(n);
+    try self.slots.ensureUnusedCapacity(n);
+    try self.free.ensureTotalCapacity(self.slots.items.len + n);
+    var ids: [n]u32 = undefined;
+    for (owned, &ids) |request, *id| {
+        id.* = self.free.pop() orelse blk: {
+            self.slots.appendAssumeCapacity(.{ .kind = request });
+            break :blk @as(u32, @intCast(self.slots.items.len - 1));
+        };
+        self.slots.items[id.*] = .{ .kind = request };
+        self.jobs.appendAssumeCapacity(.{ .id = id.*, .request = request });
+    }
+    self.cond.signal();
+    return ids;
+}
+
+// True once the loader thread has given up, see error.UploaderFailed.
+pub fn isFailed(self: *@This()) bool {
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    return self.failed;
+}
+
+// Upload on the calling thread, whose context must be current, for when submit has failed. The
+// name is usable right away, or null as for Status.failed.
+pub fn upload(request: Request) ?u32 {
+    return switch (request) {
+        .texture => |t| uploadTexture(t.width, t.height, t.pixels),
+        .buffer => |b| uploadBuffer(b.data, b.usage),
+    };
+}
+
+// Called on the render thread. The texture or buffer name once the GPU has finished the upload.
+// Never blocks, and answers the same until the id is released.
+pub fn poll(self: *@This(), id: u32) Status {
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    const slot = self.slotAt(id);
+    switch (slot.state) {
+        .queued => return .pending,
+        .fenced => {
+            const status = c.glClientWaitSync(slot.fence, 0, 0);
+            if (status != c.GL_ALREADY_SIGNALED and status != c.GL_CONDITION_SATISFIED) {
+                return .pending;
+            }
+            c.glDeleteSync(slot.fence);
+            slot.fence = null;
+            slot.state = .ready;
+            return .{ .ready = slot.name };
+        },
+        .ready => return .{ .ready = slot.name },
+        .failed => return .failed,
+        .free, .cancelled => unreachable,
+    }
+}
+
+// Called on the render thread when the caller is done with id. A name poll has returned now
+// belongs to the caller; an upload still in flight is deleted once it lands.
+pub fn release(self: *@This(), id: u32) void {
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    const slot = self.slotAt(id);
+    switch (slot.state) {
+        .queued => {
+            slot.state = .cancelled;
+            return;
+        },
+        .fenced => {
+            c.glDeleteSync(slot.fence);
+            deleteObject(slot.kind, slot.name);
+        },
+        .ready, .failed => {},
+        .free, .cancelled => unreachable,
+    }
+    self.recycle(id);
+}
+
+fn slotAt(self: *@This(), id: u32) *Slot {
+    std.debug.assert(id < self.slots.items.len);
+    return &self.slots.items[id];
+}
+
+// With the mutex held.
+fn recycle(self: *@This(), id: u32) void {
+    self.slots.items[id] = .{ .state = .free, .kind = self.slots.items[id].kind };
+    // Capacity for every slot is reserved by submit.
+    self.free.appendAssumeCapacity(id);
+}
+
+fn deleteObject(kind: std.meta.Tag(Request), name: u32) void {
+    switch (kind) {
+        .texture => c.glDeleteTextures(1, &name),
+        .buffer => c.glDeleteBuffers(1, &name),
+    }
+}
+
+fn freeRequest(self: *@This(), request: Request) void {
+    switch (request) {
+        .texture => |t| self.allocator.free(t.pixels),
+        .buffer => |b| self.allocator.free(b.data),
+    }
+}
+
+// Without a context nothing queued will ever be uploaded, so fail it all now.
+fn fail(self: *@This()) void {
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    self.failed = true;
+    for (self.jobs.items) |job| {
+        self.freeRequest(job.request);
+        const slot = &self.slots.items[job.id];
+        if (slot.state == .cancelled) {
+            self.recycle(job.id);
+        } else {
+            slot.state = .failed;
+        }
+    }
+    self.jobs.clearRetainingCapacity();
+}
+
+fn run(self: *@This()) void {
+    if (!self.context.makeCurrent(self.context.ptr)) {
+        std.log.err("GlUploader: failed to make the shared context current", .{});
+        self.fail();
+        return;
+    }
+    defer self.context.unsetCurrent(self.context.ptr);
+
+    while (true) {
+        const job = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            while (self.jobs.items.len == 0 and !self.quit) {
+                self.cond.wait(&self.mutex);
+            }
+            if (self.quit) {
+                return;
+            }
+            break :blk self.jobs.orderedRemove(0);
+        };
+
+        const name = upload(job.request);
+        // The fence must reach the GPU before another context can observe it.
+        const fence = if (name != null) c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0) else null;
+        c.glFlush();
+        self.freeRequest(job.request);
+        if (name == null) {
+            std.log.err("GlUploader: {s} upload failed to map", .{@tagName(job.request)});
+        }
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        const slot = &self.slots.items[job.id];
+        if (slot.state == .cancelled) {
+            if (name) |n| {
+                c.glDeleteSync(fence);
+                deleteObject(slot.kind, n);
+            }
+            self.recycle(job.id);
+            continue;
+        }
+        slot.* = if (name) |n| .{
+            .state = .fenced,
+            .kind = slot.kind,
+            .name = n,
+            .fence = fence,
+        } else .{
+            .state = .failed,
+            .kind = slot.kind,
+        };
+    }
+}
+
+// null when the staging buffer cannot be written, nothing is left behind then.
+fn uploadTexture(width: i32, height: i32, pixels: []const u8) ?u32 {
+    var pbo: c.GLuint = 0;
+    c.glGenBuffers(1, &pbo);
+    c.glBindBuffer(c.GL_PIXEL_UNPACK_BUFFER, pbo);
+    c.glBufferData(c.GL_PIXEL_UNPACK_BUFFER, @intCast(pixels.len), null, c.GL_STREAM_DRAW);
+    const mapped = c.glMapBufferRange(
+        c.GL_PIXEL_UNPACK_BUFFER,
+        0,
+        @intCast(pixels.len),
+        c.GL_MAP_WRITE_BIT | c.GL_MAP_INVALIDATE_BUFFER_BIT,
+    ) orelse {
+        c.glBindBuffer(c.GL_PIXEL_UNPACK_BUFFER, 0);
+        c.glDeleteBuffers(1, &pbo);
+        return null;
+    };
+    @memcpy(@as([*]u8, @ptrCast(mapped))[0..pixels.len], pixels);
+    // GL_FALSE means the store was corrupted while mapped and has to be written again.
+    if (c.glUnmapBuffer(c.GL_PIXEL_UNPACK_BUFFER) == c.GL_FALSE) {
+        c.glBindBuffer(c.GL_PIXEL_UNPACK_BUFFER, 0);
+        c.glDeleteBuffers(1, &pbo);
+        return null;
+    }
+
+    var texture: c.GLuint = 0;
+    c.glGenTextures(1, &texture);
+    c.glBindTexture(c.GL_TEXTURE_2D, texture);
+    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
+    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
+    c.glTexStorage2D(c.GL_TEXTURE_2D, 1, c.GL_RGBA8, width, height);
+    // With a pixel unpack buffer bound the data pointer is an offset into it.
+    c.glTexSubImage2D(c.GL_TEXTURE_2D, 0, 0, 0, width, height, c.GL_RGBA, c.GL_UNSIGNED_BYTE, null);
+    c.glBindTexture(c.GL_TEXTURE_2D, 0);
+
+    c.glBindBuffer(c.GL_PIXEL_UNPACK_BUFFER, 0);
+    // Deletion is deferred by GL until the pending copy has consumed it.
+    c.glDeleteBuffers(1, &pbo);
+    return texture;
+}
+
+// null when the buffer cannot be written, it is deleted again then.
+fn uploadBuffer(data: []const u8, usage: u32) ?u32 {
+    // GL_COPY_WRITE_BUFFER does not disturb any VAO or pipeline binding.
+    var buffer: c.GLuint = 0;
+    c.glGenBuffers(1, &buffer);
+    c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, buffer);
+    defer c.glBindBuffer(c.GL_COPY_WRITE_BUFFER, 0);
+    c.glBufferData(c.GL_COPY_WRITE_BUFFER, @intCast(data.len), null, usage);
+    const mapped = c.glMapBufferRange(
+        c.GL_COPY_WRITE_BUFFER,
+        0,
+        @intCast(data.len),
+        c.GL_MAP_WRITE_BIT | c.GL_MAP_INVALIDATE_BUFFER_BIT,
+    ) orelse {
+        c.glDeleteBuffers(1, &buffer);
+        return null;
+    };
+    @memcpy(@as([*]u8, @ptrCast(mapped))[0..data.len], data);
+    if (c.glUnmapBuffer(c.GL_COPY_WRITE_BUFFER) == c.GL_FALSE) {
+        c.glDeleteBuffers(1, &buffer);
+        return null;
+    }
+    return buffer;
+}
@@ -0,0 +1,58 @@
+// GPU frame time from GL_TIME_ELAPSED queries. Results are read back a few frames later, only
+// once they are available, so measuring never stalls the pipeline.
+const c = @import("c");
+
+const QUERY_COUNT = 4;
+
+queries: [QUERY_COUNT]c.GLuint = .{0} ** QUERY_COUNT,
+pending: [QUERY_COUNT]bool = .{false} ** QUERY_COUNT,
+next: usize = 0,
+oldest: usize = 0,
+active: bool = false,
+
+pub fn init() @This() {
+    var self = @This(){};
+    c.glGenQueries(QUERY_COUNT, &self.queries[0]);
+    return self;
+}
+
+pub fn deinit(self: *@This()) void {
+    c.glDeleteQueries(QUERY_COUNT, &self.queries[0]);
+}
+
+// Frames are skipped while every query is still in flight.
+pub fn begin(self: *@This()) void {
+    if (self.pending[self.next]) {
+        return;
+    }
+    c.glBeginQuery(c.GL_TIME_ELAPSED, self.queries[self.next]);
+    self.active = true;
+}
+
+pub fn end(self: *@This()) void {
+    if (!self.active) {
+        return;
+    }
+    c.glEndQuery(c.GL_TIME_ELAPSED);
+    self.active = false;
+    self.pending[self.next] = true;
+    self.next = (self.next + 1) % QUERY_COUNT;
+}
+
+// Returns the newest finished measurement in nanoseconds, if any finished since the last call.
+pub fn poll(self: *@This()) ?u64 {
+    var latest: ?u64 = null;
+    while (self.pending[self.oldest]) {
+        var available: c.GLint = 0;
+        c.glGetQueryObjectiv(self.queries[self.oldest], c.GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == 0) {
+            break;
+        }
+        var elapsed: c.GLuint64 = 0;
+        c.glGetQueryObjectui64v(self.queries[self.oldest], c.GL_QUERY_RESULT, &elapsed);
+        latest = elapsed;
+        self.pending[self.oldest] = false;
+        self.oldest = (self.oldest + 1) % QUERY_COUNT;
+    }
+    return latest;
+}
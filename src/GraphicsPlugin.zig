@@ -3,6 +3,7 @@ const geometry = @import("geometry.zig");
 const xr_result = @import("xr_result.zig");
 const xr_linear = @import("xr_linear.zig");
 const c = @import("c");
+const slot_map = @import("slot_map.zig");
 
 pub const SwapchainImage = if (builtin.abi.isAndroid())
     union(enum) {
@@ -14,9 +15,27 @@ else
         D3D11: c.XrSwapchainImageD3D11KHR,
     };
 
+// The image structs of one swapchain. Resolve it once when the swapchain is created, every
+// getSwapchainImage after that is an array index.
+pub const SwapchainImages = slot_map.Handle;
+
+// An acquired image as the GL renderers take it: the texture to draw into, and the handle and image
+// index their per image state is kept under, see slot_map.ImageTable.
+pub const SwapchainTexture = struct {
+    images: SwapchainImages,
+    index: u32,
+    texture: u32,
+};
+
+// Clip planes of calcViewProjectionMatrix, also reported to the runtime with submitted depth.
+pub const NEAR_Z = 0.05;
+pub const FAR_Z = 100.0;
+
 pub const VTable = struct {
     getInstanceExtensions: *const fn () []const []const u8,
     selectColorSwapchainFormat: *const fn (runtime_formats: []i64) ?i64,
+    // null when the renderer cannot render into a depth swapchain.
+    selectDepthSwapchainFormat: *const fn (runtime_formats: []i64) ?i64,
     getSupportedSwapchainSampleCount: *const fn (config: c.XrViewConfigurationView) u32,
     calcViewProjectionMatrix: *const fn (fov: c.XrFovf, view_pose: c.XrPosef) xr_linear.Matrix4x4f,
     //
@@ -29,10 +48,11 @@ pub const VTable = struct {
     getGraphicsBinding: *const fn (ptr: *anyopaque) ?*const c.XrBaseInStructure,
     allocateSwapchainImageStructs: *const fn (
         ptr: *anyopaque,
-        swapchain: c.XrSwapchain,
         image_count: u32,
+        images: *SwapchainImages,
     ) *c.XrSwapchainImageBaseHeader,
-    getSwapchainImage: *const fn (ptr: *anyopaque, swapchain: c.XrSwapchain, image_index: u32) SwapchainImage,
+    freeSwapchainImageStructs: *const fn (ptr: *anyopaque, images: SwapchainImages) void,
+    getSwapchainImage: *const fn (ptr: *anyopaque, images: SwapchainImages, image_index: u32) SwapchainImage,
 };
 
 ptr: *anyopaque,
@@ -48,6 +68,10 @@ pub fn selectColorSwapchainFormat(self: @This(), runtimeFormats: []i64) ?i64 {
     return self.vtable.selectColorSwapchainFormat(runtimeFormats);
 }
 
+pub fn selectDepthSwapchainFormat(self: @This(), runtimeFormats: []i64) ?i64 {
+    return self.vtable.selectDepthSwapchainFormat(runtimeFormats);
+}
+
 pub fn getSupportedSwapchainSampleCount(self: @This(), config: c.XrViewConfigurationView) u32 {
     return self.vtable.getSupportedSwapchainSampleCount(config);
 }
@@ -74,14 +98,19 @@ pub fn getGraphicsBinding(self: @This()) ?*const c.XrBaseInStructure {
     return self.vtable.getGraphicsBinding(self.ptr);
 }
 
+// Returns the buffer for xrEnumerateSwapchainImages and sets images to its handle.
 pub fn allocateSwapchainImageStructs(
     self: *@This(),
-    swapchain: c.XrSwapchain,
     image_count: u32,
+    images: *SwapchainImages,
 ) *c.XrSwapchainImageBaseHeader {
-    return self.vtable.allocateSwapchainImageStructs(self.ptr, swapchain, image_count);
+    return self.vtable.allocateSwapchainImageStructs(self.ptr, image_count, images);
+}
+
+pub fn freeSwapchainImageStructs(self: @This(), images: SwapchainImages) void {
+    self.vtable.freeSwapchainImageStructs(self.ptr, images);
 }
 
-pub fn getSwapchainImage(self: @This(), swapchain: c.XrSwapchain, image_index: u32) SwapchainImage {
-    return self.vtable.getSwapchainImage(self.ptr, swapchain, image_index);
+pub fn getSwapchainImage(self: @This(), images: SwapchainImages, image_index: u32) SwapchainImage {
+    return self.vtable.getSwapchainImage(self.ptr, images, image_index);
 }
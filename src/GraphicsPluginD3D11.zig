@@ -1,5 +1,6 @@
 const std = @import("std");
 const GraphicsPlugin = @import("GraphicsPlugin.zig");
+const SlotMap = @import("slot_map.zig").SlotMap;
 const xr_util = @import("xr_util.zig");
 const xr_result = @import("xr_result.zig");
 const xr_linear = @import("xr_linear.zig");
@@ -12,6 +13,11 @@ pub fn getInstanceExtensions() []const []const u8 {
     return &INSTANCE_EXTENSIONS;
 }
 
+// The D3D11 renderer keeps its own depth buffers, so no depth is submitted.
+pub fn selectDepthSwapchainFormat(_: []i64) ?i64 {
+    return null;
+}
+
 pub fn selectColorSwapchainFormat(runtimeFormats: []i64) ?i64 {
     // List of supported color swapchain formats.
     const SupportedColorSwapchainFormats = [_]i64{
@@ -40,13 +46,14 @@ pub fn calcViewProjectionMatrix(fov: c.XrFovf, view_pose: c.XrPosef) xr_linear.M
     const proj = xr_linear.Matrix4x4f.createProjectionFov(.D3D, fov, 0.05, 100.0);
     const toView = xr_linear.Matrix4x4f.createFromRigidTransform(view_pose);
     const view = toView.invertRigidBody();
-    const vp = proj.multiply(view);
+    const vp = proj.multiplySimd(view);
     return vp;
 }
 
 const vtable = GraphicsPlugin.VTable{
     .getInstanceExtensions = &getInstanceExtensions,
     .selectColorSwapchainFormat = &selectColorSwapchainFormat,
+    .selectDepthSwapchainFormat = &selectDepthSwapchainFormat,
     .getSupportedSwapchainSampleCount = &getSupportedSwapchainSampleCount,
     .calcViewProjectionMatrix = &calcViewProjectionMatrix,
     //
@@ -54,18 +61,19 @@ const vtable = GraphicsPlugin.VTable{
     .initializeDevice = &initializeDevice,
     .getGraphicsBinding = &getGraphicsBinding,
     .allocateSwapchainImageStructs = &allocateSwapchainImageStructs,
+    .freeSwapchainImageStructs = &freeSwapchainImageStructs,
     .getSwapchainImage = &getSwapchainImage,
 };
 
 allocator: std.mem.Allocator,
-swapchainBufferMap: std.AutoHashMap(c.XrSwapchain, []c.XrSwapchainImageD3D11KHR),
+swapchainImages: SlotMap([]c.XrSwapchainImageD3D11KHR),
 impl: *anyopaque,
 
 pub fn create(allocator: std.mem.Allocator) !*@This() {
     const self = try allocator.create(@This());
     self.* = .{
         .allocator = allocator,
-        .swapchainBufferMap = .init(allocator),
+        .swapchainImages = .init(allocator),
         .impl = c.create().?,
     };
     return self;
@@ -80,11 +88,11 @@ pub fn init(allocator: std.mem.Allocator) !GraphicsPlugin {
 
 pub fn destroy(_self: *anyopaque) void {
     const self: *@This() = @ptrCast(@alignCast(_self));
-    var it = self.swapchainBufferMap.iterator();
-    while (it.next()) |entry| {
-        self.allocator.free(entry.value_ptr.*);
+    var it = self.swapchainImages.iterator();
+    while (it.next()) |images| {
+        self.allocator.free(images.*);
     }
-    self.swapchainBufferMap.deinit();
+    self.swapchainImages.deinit();
     c.destroy(self.impl);
     self.allocator.destroy(self);
 }
@@ -105,8 +113,8 @@ pub fn getGraphicsBinding(_self: *anyopaque) *const c.XrBaseInStructure {
 
 pub fn allocateSwapchainImageStructs(
     _self: *anyopaque,
-    swapchain: c.XrSwapchain,
     image_count: u32,
+    handle: *GraphicsPlugin.SwapchainImages,
 ) *c.XrSwapchainImageBaseHeader {
     const self: *@This() = @ptrCast(@alignCast(_self));
     // Allocate and initialize the buffer of image structs
@@ -118,16 +126,24 @@ pub fn allocateSwapchainImageStructs(
             .type = c.XR_TYPE_SWAPCHAIN_IMAGE_D3D11_KHR,
         };
     }
-    self.swapchainBufferMap.put(swapchain, images) catch @panic("OOM");
+    handle.* = self.swapchainImages.insert(images) catch @panic("OOM");
     return @ptrCast(&images[0]);
 }
 
+// Drop the image structs of a swapchain that is about to be destroyed.
+pub fn freeSwapchainImageStructs(_self: *anyopaque, handle: GraphicsPlugin.SwapchainImages) void {
+    const self: *@This() = @ptrCast(@alignCast(_self));
+    if (self.swapchainImages.remove(handle)) |images| {
+        self.allocator.free(images);
+    }
+}
+
 pub fn getSwapchainImage(
     _self: *anyopaque,
-    swapchain: c.XrSwapchain,
+    handle: GraphicsPlugin.SwapchainImages,
     image_index: u32,
 ) GraphicsPlugin.SwapchainImage {
     const self: *@This() = @ptrCast(@alignCast(_self));
-    const textures = self.swapchainBufferMap.get(swapchain).?;
-    return .{ .D3D11 = textures[image_index] };
+    const textures = self.swapchainImages.get(handle).?;
+    return .{ .D3D11 = textures.*[image_index] };
 }
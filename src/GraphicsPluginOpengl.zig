@@ -1,6 +1,7 @@
 const std = @import("std");
 const builtin = @import("builtin");
 const GraphicsPlugin = @import("GraphicsPlugin.zig");
+const SlotMap = @import("slot_map.zig").SlotMap;
 const xr_util = @import("xr_util.zig");
 // const c = xr_util.c;
 const xr_result = @import("xr_result.zig");
@@ -8,6 +9,7 @@ const geometry = @import("geometry.zig");
 const xr_linear = @import("xr_linear.zig");
 const xr_gl = @import("xr_gl.zig");
 const c = @import("c");
+const GlUploader = @import("GlUploader.zig");
 
 const INSTANCE_EXTENSIONS = [_][]const u8{"XR_KHR_opengl_enable"};
 
@@ -19,21 +21,26 @@ pub fn selectColorSwapchainFormat(runtimeFormats: []i64) ?i64 {
     return xr_gl.selectColorSwapchainFormat(runtimeFormats);
 }
 
+pub fn selectDepthSwapchainFormat(runtimeFormats: []i64) ?i64 {
+    return xr_gl.selectDepthSwapchainFormat(runtimeFormats);
+}
+
 pub fn getSupportedSwapchainSampleCount(_: c.XrViewConfigurationView) u32 {
     return 1;
 }
 
 pub fn calcViewProjectionMatrix(fov: c.XrFovf, view_pose: c.XrPosef) xr_linear.Matrix4x4f {
-    const proj = xr_linear.Matrix4x4f.createProjectionFov(.OPENGL, fov, 0.05, 100.0);
+    const proj = xr_linear.Matrix4x4f.createProjectionFov(.OPENGL, fov, GraphicsPlugin.NEAR_Z, GraphicsPlugin.FAR_Z);
     const toView = xr_linear.Matrix4x4f.createFromRigidTransform(view_pose);
     const view = toView.invertRigidBody();
-    const vp = proj.multiply(view);
+    const vp = proj.multiplySimd(view);
     return vp;
 }
 
 const vtable = GraphicsPlugin.VTable{
     .getInstanceExtensions = &getInstanceExtensions,
     .selectColorSwapchainFormat = &selectColorSwapchainFormat,
+    .selectDepthSwapchainFormat = &selectDepthSwapchainFormat,
     .getSupportedSwapchainSampleCount = &getSupportedSwapchainSampleCount,
     .calcViewProjectionMatrix = &calcViewProjectionMatrix,
     //
@@ -41,20 +48,25 @@ const vtable = GraphicsPlugin.VTable{
     .initializeDevice = &initializeDevice,
     .getGraphicsBinding = &getGraphicsBinding,
     .allocateSwapchainImageStructs = &allocateSwapchainImageStructs,
+    .freeSwapchainImageStructs = &freeSwapchainImageStructs,
     .getSwapchainImage = &getSwapchainImage,
 };
 
 allocator: std.mem.Allocator,
 window: c.ksGpuWindow = .{},
+// Shares objects with window.context, for the loader thread.
+sharedContext: ?c.ksGpuContext = null,
 graphicsBinding: c.XrGraphicsBindingOpenGLWin32KHR = .{},
+// Set once the window and its context exist. A restarted program reuses them.
+deviceCreated: bool = false,
 
-swapchainBufferMap: std.AutoHashMap(c.XrSwapchain, []c.XrSwapchainImageOpenGLKHR),
+swapchainImages: SlotMap([]c.XrSwapchainImageOpenGLKHR),
 
 pub fn create(allocator: std.mem.Allocator) !*@This() {
     const self = try allocator.create(@This());
     self.* = .{
         .allocator = allocator,
-        .swapchainBufferMap = .init(allocator),
+        .swapchainImages = .init(allocator),
     };
     return self;
 }
@@ -70,16 +82,45 @@ pub fn destroy(_self: *anyopaque) void {
     const self: *@This() = @ptrCast(@alignCast(_self));
     std.log.debug("#### GraphicsPluginOpengl.deinit ####", .{});
     {
-        var it = self.swapchainBufferMap.iterator();
-        while (it.next()) |entry| {
-            self.allocator.free(entry.value_ptr.*);
+        var it = self.swapchainImages.iterator();
+        while (it.next()) |images| {
+            self.allocator.free(images.*);
         }
     }
-    self.swapchainBufferMap.deinit();
+    self.swapchainImages.deinit();
+    if (self.sharedContext) |*sharedContext| {
+        c.ksGpuContext_Destroy(sharedContext);
+    }
     self.allocator.destroy(self);
     // c.ksGpuWindow_Destroy(&self.window);
 }
 
+// Create a context in the share group of the render context. Call after initializeDevice, while
+// the render context is not yet shared with any other thread.
+pub fn createSharedContext(self: *@This()) !GlUploader.Context {
+    var sharedContext = c.ksGpuContext{};
+    if (!c.ksGpuContext_CreateShared(&sharedContext, &self.window.context, 0)) {
+        return error.ksGpuContext_CreateShared;
+    }
+    self.sharedContext = sharedContext;
+    return .{
+        .ptr = &self.sharedContext.?,
+        .makeCurrent = &makeSharedCurrent,
+        .unsetCurrent = &unsetSharedCurrent,
+    };
+}
+
+fn makeSharedCurrent(ptr: *anyopaque) bool {
+    const context: *c.ksGpuContext = @ptrCast(@alignCast(ptr));
+    c.ksGpuContext_SetCurrent(context);
+    return c.ksGpuContext_CheckCurrent(context);
+}
+
+fn unsetSharedCurrent(ptr: *anyopaque) void {
+    const context: *c.ksGpuContext = @ptrCast(@alignCast(ptr));
+    c.ksGpuContext_UnsetCurrent(context);
+}
+
 pub fn initializeDevice(
     _self: *anyopaque,
     instance: c.XrInstance,
@@ -87,7 +128,8 @@ pub fn initializeDevice(
 ) xr_result.Error!void {
     const self: *@This() = @ptrCast(@alignCast(_self));
 
-    try xr_gl.initializeDevice(instance, systemId, &self.window);
+    try xr_gl.initializeDevice(instance, systemId, &self.window, self.deviceCreated);
+    self.deviceCreated = true;
     if (builtin.target.os.tag == .windows) {
         self.graphicsBinding = .{
             .type = c.XR_TYPE_GRAPHICS_BINDING_OPENGL_WIN32_KHR,
@@ -106,8 +148,8 @@ pub fn getGraphicsBinding(_self: *anyopaque) *const c.XrBaseInStructure {
 
 pub fn allocateSwapchainImageStructs(
     _self: *anyopaque,
-    swapchain: c.XrSwapchain,
     image_count: u32,
+    handle: *GraphicsPlugin.SwapchainImages,
 ) *c.XrSwapchainImageBaseHeader {
     const self: *@This() = @ptrCast(@alignCast(_self));
     // Allocate and initialize the buffer of image structs
@@ -119,7 +161,7 @@ pub fn allocateSwapchainImageStructs(
             .type = c.XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR,
         };
     }
-    self.swapchainBufferMap.put(swapchain, images) catch @panic("OOM");
+    handle.* = self.swapchainImages.insert(images) catch @panic("OOM");
     return @ptrCast(&images[0]);
 }
 
@@ -141,12 +183,33 @@ pub fn allocateSwapchainImageStructs(
 //     }
 // }
 
+// Drop the image structs of a swapchain that is about to be destroyed.
+pub fn freeSwapchainImageStructs(_self: *anyopaque, handle: GraphicsPlugin.SwapchainImages) void {
+    const self: *@This() = @ptrCast(@alignCast(_self));
+    if (self.swapchainImages.remove(handle)) |images| {
+        self.allocator.free(images);
+    }
+}
+
 pub fn getSwapchainImage(
     _self: *anyopaque,
-    swapchain: c.XrSwapchain,
+    handle: GraphicsPlugin.SwapchainImages,
     image_index: u32,
 ) GraphicsPlugin.SwapchainImage {
     const self: *@This() = @ptrCast(@alignCast(_self));
-    const textures = self.swapchainBufferMap.get(swapchain).?;
-    return .{ .OpenGL = textures[image_index] };
+    return .{ .OpenGL = self.swapchainImage(handle, image_index) };
+}
+
+// getSwapchainImage without the vtable, for callers that know the plugin is OpenGL.
+pub fn swapchainImage(self: *@This(), handle: GraphicsPlugin.SwapchainImages, image_index: u32) c.XrSwapchainImageOpenGLKHR {
+    const textures = self.swapchainImages.get(handle).?;
+    return textures.*[image_index];
+}
+
+pub fn swapchainTexture(self: *@This(), handle: GraphicsPlugin.SwapchainImages, image_index: u32) GraphicsPlugin.SwapchainTexture {
+    return .{
+        .images = handle,
+        .index = image_index,
+        .texture = self.swapchainImage(handle, image_index).image,
+    };
 }
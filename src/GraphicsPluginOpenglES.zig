@@ -1,5 +1,6 @@
 const std = @import("std");
 const GraphicsPlugin = @import("GraphicsPlugin.zig");
+const SlotMap = @import("slot_map.zig").SlotMap;
 const xr_util = @import("xr_util.zig");
 // const c = xr_util.c;
 const c = @import("c");
@@ -24,21 +25,32 @@ pub fn selectColorSwapchainFormat(runtimeFormats: []i64) ?i64 {
     return null;
 }
 
+pub fn selectDepthSwapchainFormat(runtimeFormats: []i64) ?i64 {
+    const supportedDepthSwapchainFormats = [_]i64{ c.GL_DEPTH_COMPONENT24, c.GL_DEPTH_COMPONENT32F, c.GL_DEPTH_COMPONENT16 };
+    for (supportedDepthSwapchainFormats) |supported| {
+        if (std.mem.indexOfScalar(i64, runtimeFormats, supported) != null) {
+            return supported;
+        }
+    }
+    return null;
+}
+
 pub fn getSupportedSwapchainSampleCount(_: c.XrViewConfigurationView) u32 {
     return 1;
 }
 
 pub fn calcViewProjectionMatrix(fov: c.XrFovf, view_pose: c.XrPosef) xr_linear.Matrix4x4f {
-    const proj = xr_linear.Matrix4x4f.createProjectionFov(.OPENGL_ES, fov, 0.05, 100.0);
+    const proj = xr_linear.Matrix4x4f.createProjectionFov(.OPENGL_ES, fov, GraphicsPlugin.NEAR_Z, GraphicsPlugin.FAR_Z);
     const toView = xr_linear.Matrix4x4f.createFromRigidTransform(view_pose);
     const view = toView.invertRigidBody();
-    const vp = proj.multiply(view);
+    const vp = proj.multiplySimd(view);
     return vp;
 }
 
 const vtable = GraphicsPlugin.VTable{
     .getInstanceExtensions = &getInstanceExtensions,
     .selectColorSwapchainFormat = &selectColorSwapchainFormat,
+    .selectDepthSwapchainFormat = &selectDepthSwapchainFormat,
     .getSupportedSwapchainSampleCount = &getSupportedSwapchainSampleCount,
     .calcViewProjectionMatrix = &calcViewProjectionMatrix,
     //
@@ -46,11 +58,12 @@ const vtable = GraphicsPlugin.VTable{
     .initializeDevice = &initializeDevice,
     .getGraphicsBinding = &getGraphicsBinding,
     .allocateSwapchainImageStructs = &allocateSwapchainImageStructs,
+    .freeSwapchainImageStructs = &freeSwapchainImageStructs,
     .getSwapchainImage = &getSwapchainImage,
 };
 
 allocator: std.mem.Allocator,
-swapchainBufferMap: std.AutoHashMap(c.XrSwapchain, []c.XrSwapchainImageOpenGLESKHR),
+swapchainImages: SlotMap([]c.XrSwapchainImageOpenGLESKHR),
 graphicsBinding: c.XrGraphicsBindingOpenGLESAndroidKHR = .{},
 
 pub const InitOptions = struct {
@@ -64,7 +77,7 @@ pub fn create(opts: InitOptions) !*@This() {
     const self = try opts.allocator.create(@This());
     self.* = .{
         .allocator = opts.allocator,
-        .swapchainBufferMap = .init(opts.allocator),
+        .swapchainImages = .init(opts.allocator),
         .graphicsBinding = .{
             .type = c.XR_TYPE_GRAPHICS_BINDING_OPENGL_ES_ANDROID_KHR,
             .next = null,
@@ -85,11 +98,11 @@ pub fn init(opts: InitOptions) !GraphicsPlugin {
 
 pub fn destroy(_self: *anyopaque) void {
     const self: *@This() = @ptrCast(@alignCast(_self));
-    var it = self.swapchainBufferMap.iterator();
-    while (it.next()) |entry| {
-        self.allocator.free(entry.value_ptr.*);
+    var it = self.swapchainImages.iterator();
+    while (it.next()) |images| {
+        self.allocator.free(images.*);
     }
-    self.swapchainBufferMap.deinit();
+    self.swapchainImages.deinit();
     self.allocator.destroy(self);
 }
 
@@ -173,8 +186,8 @@ pub fn getGraphicsBinding(_self: *anyopaque) ?*const c.XrBaseInStructure {
 
 pub fn allocateSwapchainImageStructs(
     _self: *anyopaque,
-    swapchain: c.XrSwapchain,
     image_count: u32,
+    handle: *GraphicsPlugin.SwapchainImages,
 ) *c.XrSwapchainImageBaseHeader {
     const self: *@This() = @ptrCast(@alignCast(_self));
     // Allocate and initialize the buffer of image structs
@@ -186,16 +199,34 @@ pub fn allocateSwapchainImageStructs(
             .type = c.XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR,
         };
     }
-    self.swapchainBufferMap.put(swapchain, images) catch @panic("OOM");
+    handle.* = self.swapchainImages.insert(images) catch @panic("OOM");
     return @ptrCast(&images[0]);
 }
 
+// Drop the image structs of a swapchain that is about to be destroyed.
+pub fn freeSwapchainImageStructs(_self: *anyopaque, handle: GraphicsPlugin.SwapchainImages) void {
+    const self: *@This() = @ptrCast(@alignCast(_self));
+    if (self.swapchainImages.remove(handle)) |images| {
+        self.allocator.free(images);
+    }
+}
+
 pub fn getSwapchainImage(
     _self: *anyopaque,
-    swapchain: c.XrSwapchain,
+    handle: GraphicsPlugin.SwapchainImages,
     image_index: u32,
 ) GraphicsPlugin.SwapchainImage {
     const self: *@This() = @ptrCast(@alignCast(_self));
-    const textures = self.swapchainBufferMap.get(swapchain).?;
-    return .{ .OpenGLES = textures[image_index] };
+    const textures = self.swapchainImages.get(handle).?;
+    return .{ .OpenGLES = textures.*[image_index] };
+}
+
+// A swapchain image resolved without the vtable, for the renderer to key by handle and index.
+pub fn swapchainTexture(self: *@This(), handle: GraphicsPlugin.SwapchainImages, image_index: u32) GraphicsPlugin.SwapchainTexture {
+    const textures = self.swapchainImages.get(handle).?;
+    return .{
+        .images = handle,
+        .index = image_index,
+        .texture = textures.*[image_index].image,
+    };
 }
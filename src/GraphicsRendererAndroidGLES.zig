@@ -6,27 +6,42 @@ const c = @cImport({
     @cInclude("GLES3/gl3.h");
     @cInclude("GLES3/gl31.h");
 });
-const xr = @import("openxr");
+const xr = @import("openxr").c;
 const xr_linear = @import("xr_linear.zig");
 const geometry = @import("geometry.zig");
+const DepthPool = @import("DepthPool.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
 
 // The version statement has come on first line.
+// One instance per cube, the model transform is built from the per-instance pose and scale.
 const VertexShaderGlsl =
     \\#version 320 es
     \\
     \\in vec3 VertexPos;
     \\in vec3 VertexColor;
+    \\in vec4 InstanceOrientation;
+    \\in vec3 InstancePosition;
+    \\in vec3 InstanceScale;
     \\
     \\out vec3 PSVertexColor;
     \\
-    \\uniform mat4 ModelViewProjection;
+    \\uniform mat4 ViewProjection;
+    \\
+    \\vec3 rotate(vec4 q, vec3 v) {
+    \\   return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+    \\}
     \\
     \\void main() {
-    \\   gl_Position = ModelViewProjection * vec4(VertexPos, 1.0);
+    \\   vec3 world = InstancePosition + rotate(InstanceOrientation, VertexPos * InstanceScale);
+    \\   gl_Position = ViewProjection * vec4(world, 1.0);
     \\   PSVertexColor = VertexColor;
     \\}
 ;
 
+const INSTANCE_ORIENTATION = 2;
+const INSTANCE_POSITION = 3;
+const INSTANCE_SCALE = 4;
+
 // The version statement has come on first line.
 const FragmentShaderGlsl =
     \\#version 320 es
@@ -65,19 +80,23 @@ fn CheckShader(shader: c.GLuint) !void {
 
 swapchainFramebuffer: c.GLuint = 0,
 program: c.GLuint = 0,
-modelViewProjectionUniformLocation: c.GLint = 0,
+viewProjectionUniformLocation: c.GLint = 0,
 vertexAttribCoords: c.GLuint = 0,
 vertexAttribColor: c.GLuint = 0,
 vao: c.GLuint = 0,
 cubeVertexBuffer: c.GLuint = 0,
 cubeIndexBuffer: c.GLuint = 0,
+// Streamed by uploadInstances, drawn by every view that follows.
+instanceBuffer: c.GLuint = 0,
+instances: std.array_list.Managed(geometry.Instance),
 
 clearColor: [4]f32 = .{ 0, 0, 0, 0 },
-colorToDepthMap: std.AutoHashMap(u32, u32),
+depthPool: DepthPool,
 
 pub fn init(allocator: std.mem.Allocator) !@This() {
     var self = @This(){
-        .colorToDepthMap = .init(allocator),
+        .depthPool = .init(allocator),
+        .instances = .init(allocator),
     };
 
     std.log.debug("initializeResources", .{});
@@ -97,13 +116,16 @@ pub fn init(allocator: std.mem.Allocator) !@This() {
     self.program = c.glCreateProgram();
     c.glAttachShader(self.program, vertexShader);
     c.glAttachShader(self.program, fragmentShader);
+    c.glBindAttribLocation(self.program, INSTANCE_ORIENTATION, "InstanceOrientation");
+    c.glBindAttribLocation(self.program, INSTANCE_POSITION, "InstancePosition");
+    c.glBindAttribLocation(self.program, INSTANCE_SCALE, "InstanceScale");
     c.glLinkProgram(self.program);
     try CheckProgram(self.program);
 
     c.glDeleteShader(vertexShader);
     c.glDeleteShader(fragmentShader);
 
-    self.modelViewProjectionUniformLocation = @intCast(c.glGetUniformLocation(self.program, "ModelViewProjection"));
+    self.viewProjectionUniformLocation = @intCast(c.glGetUniformLocation(self.program, "ViewProjection"));
 
     self.vertexAttribCoords = @intCast(c.glGetAttribLocation(self.program, "VertexPos"));
     self.vertexAttribColor = @intCast(c.glGetAttribLocation(self.program, "VertexColor"));
@@ -142,20 +164,53 @@ pub fn init(allocator: std.mem.Allocator) !@This() {
         @ptrFromInt(@sizeOf(xr.XrVector3f)),
     );
 
+    c.glGenBuffers(1, &self.instanceBuffer);
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, self.instanceBuffer);
+    const stride = @sizeOf(geometry.Instance);
+    const FloatAttrib = struct { location: c.GLuint, size: c.GLint, offset: usize };
+    for ([_]FloatAttrib{
+        .{ .location = INSTANCE_ORIENTATION, .size = 4, .offset = @offsetOf(geometry.Instance, "Orientation") },
+        .{ .location = INSTANCE_POSITION, .size = 3, .offset = @offsetOf(geometry.Instance, "Position") },
+        .{ .location = INSTANCE_SCALE, .size = 3, .offset = @offsetOf(geometry.Instance, "Scale") },
+    }) |attrib| {
+        c.glEnableVertexAttribArray(attrib.location);
+        c.glVertexAttribPointer(attrib.location, attrib.size, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(attrib.offset));
+        c.glVertexAttribDivisor(attrib.location, 1);
+    }
+    c.glBindVertexArray(0);
+
     return self;
 }
 
 pub fn deinit(self: *@This()) void {
-    self.colorToDepthMap.deinit();
+    self.depthPool.deinit();
+    c.glDeleteBuffers(1, &self.instanceBuffer);
+    self.instances.deinit();
+}
+
+// Stream the cubes into the instance buffer once, before the views that draw them.
+pub fn uploadInstances(self: *@This(), cubes: []const geometry.Cube) void {
+    self.instances.resize(cubes.len) catch @panic("OOM");
+    for (cubes, self.instances.items) |cube, *instance| {
+        instance.* = .fromCube(cube);
+    }
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, self.instanceBuffer);
+    c.glBufferData(
+        c.GL_ARRAY_BUFFER,
+        @intCast(self.instances.items.len * @sizeOf(geometry.Instance)),
+        if (self.instances.items.len > 0) &self.instances.items[0] else null,
+        c.GL_STREAM_DRAW,
+    );
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
 }
 
+// Draw the cubes of the last uploadInstances.
 pub fn render(
     self: *@This(),
-    color_texture: u32,
+    color: GraphicsPlugin.SwapchainTexture,
     viewport_width: i32,
     viewport_height: i32,
     vp: xr_linear.Matrix4x4f,
-    cubes: []geometry.Cube,
 ) void {
     c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.swapchainFramebuffer);
 
@@ -171,10 +226,12 @@ pub fn render(
     c.glEnable(c.GL_CULL_FACE);
     c.glEnable(c.GL_DEPTH_TEST);
 
-    const depth_texture = self.getDepthTexture(color_texture);
+    const depth_buffer = self.depthPool.get(color, viewport_width, viewport_height) catch {
+        @panic("OOM");
+    };
 
-    c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, color_texture, 0);
-    c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_DEPTH_ATTACHMENT, c.GL_TEXTURE_2D, depth_texture, 0);
+    c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, color.texture, 0);
+    c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, depth_buffer);
 
     // Clear swapchain and depth buffer.
     c.glClearColor(self.clearColor[0], self.clearColor[1], self.clearColor[2], self.clearColor[3]);
@@ -183,33 +240,18 @@ pub fn render(
 
     // Set shaders and uniform variables.
     c.glUseProgram(self.program);
+    c.glUniformMatrix4fv(self.viewProjectionUniformLocation, 1, c.GL_FALSE, &vp.m[0]);
 
     // Set cube primitive data.
     c.glBindVertexArray(self.vao);
 
-    // Render each cube
-    for (cubes) |cube| {
-        // Compute the model-view-projection transform and set it..
-        const model = xr_linear.Matrix4x4f.createTranslationRotationScale(
-            cube.Pose.position,
-            cube.Pose.orientation,
-            cube.Scale,
-        );
-        const mvp = vp.multiply(model);
-
-        c.glUniformMatrix4fv(
-            self.modelViewProjectionUniformLocation,
-            1,
-            c.GL_FALSE,
-            &mvp.m[0],
-        );
-
-        // Draw the cube.
-        c.glDrawElements(
+    if (self.instances.items.len > 0) {
+        c.glDrawElementsInstanced(
             c.GL_TRIANGLES,
-            @sizeOf(@TypeOf(geometry.c_cubeIndices)),
+            geometry.c_cubeIndices.len,
             c.GL_UNSIGNED_SHORT,
             null,
+            @intCast(self.instances.items.len),
         );
     }
 
@@ -217,41 +259,3 @@ pub fn render(
     c.glUseProgram(0);
     c.glBindFramebuffer(c.GL_FRAMEBUFFER, 0);
 }
-
-fn getDepthTexture(self: *@This(), colorTexture: u32) u32 {
-    // If a depth-stencil view has already been created for this back-buffer, use it.
-    if (self.colorToDepthMap.get(colorTexture)) |depthBuffer| {
-        return depthBuffer;
-    }
-
-    // This back-buffer has no corresponding depth-stencil texture, so create one with matching dimensions.
-    var width: c.GLint = undefined;
-    var height: c.GLint = undefined;
-    c.glBindTexture(c.GL_TEXTURE_2D, colorTexture);
-    c.glGetTexLevelParameteriv(c.GL_TEXTURE_2D, 0, c.GL_TEXTURE_WIDTH, &width);
-    c.glGetTexLevelParameteriv(c.GL_TEXTURE_2D, 0, c.GL_TEXTURE_HEIGHT, &height);
-
-    var depthTexture: u32 = undefined;
-    c.glGenTextures(1, &depthTexture);
-    c.glBindTexture(c.GL_TEXTURE_2D, depthTexture);
-    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
-    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST);
-    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
-    c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
-    c.glTexImage2D(
-        c.GL_TEXTURE_2D,
-        0,
-        c.GL_DEPTH_COMPONENT24,
-        width,
-        height,
-        0,
-        c.GL_DEPTH_COMPONENT,
-        c.GL_UNSIGNED_INT,
-        null,
-    );
-
-    self.colorToDepthMap.put(colorTexture, depthTexture) catch {
-        @panic("OOM");
-    };
-    return depthTexture;
-}
@@ -5,48 +5,319 @@ const xr_util = @import("xr_util.zig");
 const c = @import("c");
 const geometry = @import("geometry.zig");
 const xr_linear = @import("xr_linear.zig");
-
+const DepthPool = @import("DepthPool.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+const LateLatch = @import("LateLatch.zig");
+const SceneStore = @import("SceneStore.zig");
+const HandMesh = @import("HandMesh.zig");
+const EnvironmentDepth = @import("EnvironmentDepth.zig");
+const SceneModel = @import("SceneModel.zig");
+const Bvh = @import("Bvh.zig");
+
+// One instance per cube. The model transform is translation(rotation(scale(vertex))) from the
+// per-instance pose and scale, see geometry.Instance.
 const VertexShaderGlsl =
     \\#version 410
     \\
     \\in vec3 VertexPos;
     \\in vec3 VertexColor;
+    \\in vec4 InstanceOrientation;
+    \\in vec3 InstancePosition;
+    \\in vec3 InstanceScale;
+    \\in vec4 InstanceColor;
     \\
     \\out vec3 PSVertexColor;
+    \\out vec3 PSWorld;
+    \\
+    \\uniform mat4 ViewProjection;
     \\
-    \\uniform mat4 ModelViewProjection;
+    \\vec3 rotate(vec4 q, vec3 v) {
+    \\   return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+    \\}
     \\
     \\void main() {
-    \\   gl_Position = ModelViewProjection * vec4(VertexPos, 1.0);
-    \\   PSVertexColor = VertexColor;
+    \\   vec3 world = InstancePosition + rotate(InstanceOrientation, VertexPos * InstanceScale);
+    \\   gl_Position = ViewProjection * vec4(world, 1.0);
+    \\   PSVertexColor = VertexColor * InstanceColor.rgb;
+    \\   PSWorld = world;
     \\}
 ;
 
+// Reads the view-projection and the hand corrections from the late-latched pose buffer.
+const LateLatchVertexShaderGlsl =
+    \\#version 410
+    \\
+    \\in vec3 VertexPos;
+    \\in vec3 VertexColor;
+    \\in vec4 InstanceOrientation;
+    \\in vec3 InstancePosition;
+    \\in vec3 InstanceScale;
+    \\in uint InstanceAttachment;
+    \\in vec4 InstanceColor;
+    \\
+    \\out vec3 PSVertexColor;
+    \\out vec3 PSWorld;
+    \\
+    \\layout(std140) uniform LatePoses {
+    \\    mat4 ViewProjection;
+    \\    mat4 Attachment[3];
+    \\};
+    \\
+    \\vec3 rotate(vec4 q, vec3 v) {
+    \\   return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+    \\}
+    \\
+    \\void main() {
+    \\   vec3 world = InstancePosition + rotate(InstanceOrientation, VertexPos * InstanceScale);
+    \\   vec4 latched = Attachment[InstanceAttachment] * vec4(world, 1.0);
+    \\   gl_Position = ViewProjection * latched;
+    \\   PSVertexColor = VertexColor * InstanceColor.rgb;
+    \\   PSWorld = latched.xyz;
+    \\}
+;
+
+// Skins the hand mesh with up to four joint matrices per vertex. Built twice, with LATE_LATCH
+// defined the view-projection comes from the late-latched pose buffer like the cubes'.
+const HandVertexShaderGlsl =
+    \\in vec3 VertexPos;
+    \\in vec3 VertexNormal;
+    \\in ivec4 VertexJoints;
+    \\in vec4 VertexWeights;
+    \\
+    \\out vec3 PSVertexColor;
+    \\out vec3 PSWorld;
+    \\
+    \\#ifdef LATE_LATCH
+    \\layout(std140) uniform LatePoses {
+    \\    mat4 ViewProjection;
+    \\    mat4 Attachment[3];
+    \\};
+    \\#else
+    \\uniform mat4 ViewProjection;
+    \\#endif
+    \\uniform mat4 Joints[JOINT_COUNT];
+    \\
+    \\void main() {
+    \\   mat4 skin = Joints[VertexJoints.x] * VertexWeights.x +
+    \\               Joints[VertexJoints.y] * VertexWeights.y +
+    \\               Joints[VertexJoints.z] * VertexWeights.z +
+    \\               Joints[VertexJoints.w] * VertexWeights.w;
+    \\   vec4 world = skin * vec4(VertexPos, 1.0);
+    \\   gl_Position = ViewProjection * world;
+    \\   PSWorld = world.xyz;
+    \\   // Lit from above, so the fingers stand out against each other.
+    \\   vec3 normal = normalize(mat3(skin) * VertexNormal);
+    \\   PSVertexColor = vec3(0.8, 0.6, 0.5) * (0.4 + 0.6 * max(normal.y, 0.0));
+    \\}
+;
+
+// A scene model mesh in its anchor space. Built twice like the hand program.
+const SceneVertexShaderGlsl =
+    \\in vec3 VertexPos;
+    \\
+    \\out vec3 PSWorld;
+    \\
+    \\#ifdef LATE_LATCH
+    \\layout(std140) uniform LatePoses {
+    \\    mat4 ViewProjection;
+    \\    mat4 Attachment[3];
+    \\};
+    \\#else
+    \\uniform mat4 ViewProjection;
+    \\#endif
+    \\uniform mat4 Model;
+    \\
+    \\void main() {
+    \\   vec4 world = Model * vec4(VertexPos, 1.0);
+    \\   gl_Position = ViewProjection * world;
+    \\   PSWorld = world.xyz;
+    \\}
+;
+
+// The mesh has no normals, so it is flat shaded from the derivatives of the world position. It is
+// the real room, so it is never occluded by the environment depth, only tinted over passthrough.
+const SceneFragmentShaderGlsl =
+    \\#version 410
+    \\
+    \\in vec3 PSWorld;
+    \\out vec4 FragColor;
+    \\
+    \\void main() {
+    \\   vec3 normal = normalize(cross(dFdx(PSWorld), dFdy(PSWorld)));
+    \\   FragColor = vec4(vec3(0.3, 0.7, 1.0) * (0.5 + 0.5 * abs(normal.y)), 0.3);
+    \\}
+;
+
+const SCENE_VERTEX_POSITION = 0;
+
+const HAND_VERTEX_POSITION = 0;
+const HAND_VERTEX_NORMAL = 1;
+const HAND_VERTEX_JOINTS = 2;
+const HAND_VERTEX_WEIGHTS = 3;
+
+// Mesh buffers of one hand, uploaded once by loadHandMeshes.
+const HandBuffers = struct {
+    vao: c.GLuint = 0,
+    vertexBuffer: c.GLuint = 0,
+    indexBuffer: c.GLuint = 0,
+    indexCount: usize = 0,
+    // Joint matrices of this frame, null to skip the hand.
+    skin: ?HandMesh.Skin = null,
+};
+
+// Instance attributes are bound to fixed locations in both programs, so they share the cube VAO.
+const INSTANCE_ORIENTATION = 2;
+const INSTANCE_POSITION = 3;
+const INSTANCE_SCALE = 4;
+const INSTANCE_ATTACHMENT = 5;
+const INSTANCE_COLOR = 6;
+
+// Instance slots the scene buffer starts with, it doubles when the store outgrows it.
+const INITIAL_STORE_CAPACITY = 1024;
+
+const LATE_POSES_BINDING = 0;
+
+// Shared by every program. With Occlusion the fragment is reprojected into the environment depth
+// layer of this view and fades out where the real surface is in front of it, over a band that
+// widens with distance as the depth map gets coarser. The projection layer is submitted with
+// unpremultiplied alpha over passthrough.
 const FragmentShaderGlsl =
     \\#version 410
     \\
     \\in vec3 PSVertexColor;
+    \\in vec3 PSWorld;
     \\out vec4 FragColor;
     \\
+    \\uniform bool Occlusion;
+    \\uniform sampler2DArray EnvironmentDepth;
+    \\uniform mat4 DepthViewProjection;
+    \\uniform float DepthLayer;
+    \\// Far is 0 for an infinite far plane.
+    \\uniform vec2 DepthNearFar;
+    \\
+    \\float linearDepth(float depth) {
+    \\   float ndc = depth * 2.0 - 1.0;
+    \\   float near = DepthNearFar.x;
+    \\   float far = DepthNearFar.y;
+    \\   if (far == 0.0) {
+    \\       return 2.0 * near / max(1.0 - ndc, 1e-6);
+    \\   }
+    \\   return 2.0 * near * far / (far + near - ndc * (far - near));
+    \\}
+    \\
     \\void main() {
-    \\   FragColor = vec4(PSVertexColor, 1);
+    \\   float alpha = 1.0;
+    \\   if (Occlusion) {
+    \\       vec4 clip = DepthViewProjection * vec4(PSWorld, 1.0);
+    \\       vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+    \\       if (clip.w > 0.0 && all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)))) {
+    \\           float real = linearDepth(texture(EnvironmentDepth, vec3(uv, DepthLayer)).r);
+    \\           float band = 0.02 + 0.02 * clip.w;
+    \\           alpha = clamp((real - clip.w) / band + 0.5, 0.0, 1.0);
+    \\       }
+    \\   }
+    \\   FragColor = vec4(PSVertexColor, alpha);
     \\}
 ;
 
+// Uniform locations of the occlusion part of FragmentShaderGlsl in one program.
+const OcclusionUniforms = struct {
+    enabled: c.GLint = -1,
+    depth: c.GLint = -1,
+    viewProjection: c.GLint = -1,
+    layer: c.GLint = -1,
+    nearFar: c.GLint = -1,
+
+    fn init(program: c.GLuint) @This() {
+        return .{
+            .enabled = c.glGetUniformLocation(program, "Occlusion"),
+            .depth = c.glGetUniformLocation(program, "EnvironmentDepth"),
+            .viewProjection = c.glGetUniformLocation(program, "DepthViewProjection"),
+            .layer = c.glGetUniformLocation(program, "DepthLayer"),
+            .nearFar = c.glGetUniformLocation(program, "DepthNearFar"),
+        };
+    }
+
+    // For the program in use. The depth texture goes to unit 0.
+    fn apply(self: @This(), occlusion: ?EnvironmentDepth.Occlusion) void {
+        const o = occlusion orelse {
+            c.glUniform1i(self.enabled, 0);
+            return;
+        };
+        c.glActiveTexture(c.GL_TEXTURE0);
+        c.glBindTexture(c.GL_TEXTURE_2D_ARRAY, o.texture);
+        // Sampled as plain depth values, not compared.
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_COMPARE_MODE, c.GL_NONE);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_MIN_FILTER, c.GL_LINEAR);
+        c.glTexParameteri(c.GL_TEXTURE_2D_ARRAY, c.GL_TEXTURE_MAG_FILTER, c.GL_LINEAR);
+        c.glUniform1i(self.enabled, 1);
+        c.glUniform1i(self.depth, 0);
+        c.glUniformMatrix4fv(self.viewProjection, 1, c.GL_FALSE, &o.viewProjection.m[0]);
+        c.glUniform1f(self.layer, @floatFromInt(o.layer));
+        c.glUniform2f(self.nearFar, o.nearZ, o.farZ);
+    }
+};
+
 swapchainFramebuffer: c.GLuint = 0,
 program: c.GLuint = 0,
-modelViewProjectionUniformLocation: c.GLint = 0,
+viewProjectionUniformLocation: c.GLint = 0,
+occlusionUniforms: OcclusionUniforms = .{},
 vertexAttribCoords: c.GLuint = 0,
 vertexAttribColor: c.GLuint = 0,
 vao: c.GLuint = 0,
 cubeVertexBuffer: c.GLuint = 0,
 cubeIndexBuffer: c.GLuint = 0,
-
-colorToDepthMap: std.AutoHashMap(u32, u32),
+// Streamed by uploadInstances.
+instanceBuffer: c.GLuint = 0,
+// Kept across frames and patched by uploadStore.
+storeBuffer: c.GLuint = 0,
+storeCapacity: usize = 0,
+// Staging for both uploads.
+instances: std.array_list.Managed(geometry.Instance),
+dirtyRanges: std.array_list.Managed(SceneStore.Range),
+// The buffer of the last upload, drawn by every view that follows, and the buffer the VAO
+// instance attributes currently point into.
+drawBuffer: c.GLuint = 0,
+drawCount: usize = 0,
+attribBuffer: c.GLuint = 0,
+
+depthPool: DepthPool,
+
+lateLatchProgram: c.GLuint = 0,
+lateLatchOcclusionUniforms: OcclusionUniforms = .{},
+lateLatch: ?LateLatch = null,
+
+handProgram: c.GLuint = 0,
+handViewProjectionLocation: c.GLint = 0,
+handJointsLocation: c.GLint = 0,
+handOcclusionUniforms: OcclusionUniforms = .{},
+lateLatchHandProgram: c.GLuint = 0,
+lateLatchHandJointsLocation: c.GLint = 0,
+lateLatchHandOcclusionUniforms: OcclusionUniforms = .{},
+
+sceneProgram: c.GLuint = 0,
+sceneViewProjectionLocation: c.GLint = 0,
+sceneModelLocation: c.GLint = 0,
+lateLatchSceneProgram: c.GLuint = 0,
+lateLatchSceneModelLocation: c.GLint = 0,
+// The meshes of setSceneMeshes, drawn by every view that follows.
+sceneMeshes: []const SceneModel.Mesh = &.{},
+// Index aligned with sceneMeshes, 0 until the mesh is first drawn. SceneModel only appends meshes.
+sceneVaos: std.array_list.Managed(c.GLuint),
+// Staging for the culled ranges of one mesh.
+sceneRanges: std.array_list.Managed(Bvh.Range),
+
+// Environment depth of the view being rendered, see setOcclusion.
+occlusion: ?EnvironmentDepth.Occlusion = null,
+hands: [2]HandBuffers = .{ .{}, .{} },
 
 pub fn init(allocator: std.mem.Allocator) @This() {
     var self = @This(){
-        .colorToDepthMap = .init(allocator),
+        .depthPool = .init(allocator),
+        .instances = .init(allocator),
+        .dirtyRanges = .init(allocator),
+        .sceneVaos = .init(allocator),
+        .sceneRanges = .init(allocator),
     };
 
     c.glGenFramebuffers(1, &self.swapchainFramebuffer);
@@ -65,13 +336,15 @@ pub fn init(allocator: std.mem.Allocator) @This() {
     self.program = c.glCreateProgram();
     c.glAttachShader(self.program, vertexShader);
     c.glAttachShader(self.program, fragmentShader);
+    bindInstanceAttribLocations(self.program);
     c.glLinkProgram(self.program);
     checkProgram(self.program);
 
     c.glDeleteShader(vertexShader);
     c.glDeleteShader(fragmentShader);
 
-    self.modelViewProjectionUniformLocation = @intCast(c.glGetUniformLocation(self.program, "ModelViewProjection"));
+    self.viewProjectionUniformLocation = @intCast(c.glGetUniformLocation(self.program, "ViewProjection"));
+    self.occlusionUniforms = .init(self.program);
 
     self.vertexAttribCoords = @intCast(c.glGetAttribLocation(self.program, "VertexPos"));
     self.vertexAttribColor = @intCast(c.glGetAttribLocation(self.program, "VertexColor"));
@@ -117,9 +390,325 @@ pub fn init(allocator: std.mem.Allocator) @This() {
         @ptrFromInt(@sizeOf(xr.XrVector3f)),
     );
 
+    c.glGenBuffers(1, &self.instanceBuffer);
+    c.glGenBuffers(1, &self.storeBuffer);
+    for ([_]c.GLuint{ INSTANCE_ORIENTATION, INSTANCE_POSITION, INSTANCE_SCALE, INSTANCE_ATTACHMENT, INSTANCE_COLOR }) |location| {
+        c.glEnableVertexAttribArray(location);
+        c.glVertexAttribDivisor(location, 1);
+    }
+    self.bindInstanceAttribs(self.instanceBuffer);
+    c.glBindVertexArray(0);
+
     return self;
 }
 
+// Point the instance attributes of the bound VAO into buffer.
+fn bindInstanceAttribs(self: *@This(), buffer: c.GLuint) void {
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, buffer);
+    const stride = @sizeOf(geometry.Instance);
+    const Attrib = struct { location: c.GLuint, size: c.GLint, type: c.GLenum, normalized: c.GLboolean, offset: usize };
+    for ([_]Attrib{
+        .{ .location = INSTANCE_ORIENTATION, .size = 4, .type = c.GL_FLOAT, .normalized = c.GL_FALSE, .offset = @offsetOf(geometry.Instance, "Orientation") },
+        .{ .location = INSTANCE_POSITION, .size = 3, .type = c.GL_FLOAT, .normalized = c.GL_FALSE, .offset = @offsetOf(geometry.Instance, "Position") },
+        .{ .location = INSTANCE_SCALE, .size = 3, .type = c.GL_FLOAT, .normalized = c.GL_FALSE, .offset = @offsetOf(geometry.Instance, "Scale") },
+        .{ .location = INSTANCE_COLOR, .size = 4, .type = c.GL_UNSIGNED_BYTE, .normalized = c.GL_TRUE, .offset = @offsetOf(geometry.Instance, "Color") },
+    }) |attrib| {
+        c.glVertexAttribPointer(attrib.location, attrib.size, attrib.type, attrib.normalized, stride, @ptrFromInt(attrib.offset));
+    }
+    c.glVertexAttribIPointer(
+        INSTANCE_ATTACHMENT,
+        1,
+        c.GL_UNSIGNED_INT,
+        stride,
+        @ptrFromInt(@offsetOf(geometry.Instance, "Attachment")),
+    );
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
+    self.attribBuffer = buffer;
+}
+
+fn bindInstanceAttribLocations(program: c.GLuint) void {
+    c.glBindAttribLocation(program, INSTANCE_ORIENTATION, "InstanceOrientation");
+    c.glBindAttribLocation(program, INSTANCE_POSITION, "InstancePosition");
+    c.glBindAttribLocation(program, INSTANCE_SCALE, "InstanceScale");
+    c.glBindAttribLocation(program, INSTANCE_ATTACHMENT, "InstanceAttachment");
+    c.glBindAttribLocation(program, INSTANCE_COLOR, "InstanceColor");
+}
+
+// Build the late-latch program and its pose buffer. Attributes are bound to the same locations as
+// the default program, so both share the cube VAO.
+pub fn enableLateLatch(self: *@This()) void {
+    // The pose buffer is a persistent mapping.
+    if (c.GLAD_GL_VERSION_4_4 == 0) {
+        std.log.warn("late latch needs OpenGL 4.4, disabled", .{});
+        return;
+    }
+
+    const vertexShader = c.glCreateShader(c.GL_VERTEX_SHADER);
+    c.glShaderSource(vertexShader, 1, &&LateLatchVertexShaderGlsl[0], null);
+    c.glCompileShader(vertexShader);
+    checkShader(vertexShader);
+
+    const fragmentShader = c.glCreateShader(c.GL_FRAGMENT_SHADER);
+    c.glShaderSource(fragmentShader, 1, &&FragmentShaderGlsl[0], null);
+    c.glCompileShader(fragmentShader);
+    checkShader(fragmentShader);
+
+    self.lateLatchProgram = c.glCreateProgram();
+    c.glAttachShader(self.lateLatchProgram, vertexShader);
+    c.glAttachShader(self.lateLatchProgram, fragmentShader);
+    c.glBindAttribLocation(self.lateLatchProgram, self.vertexAttribCoords, "VertexPos");
+    c.glBindAttribLocation(self.lateLatchProgram, self.vertexAttribColor, "VertexColor");
+    bindInstanceAttribLocations(self.lateLatchProgram);
+    c.glLinkProgram(self.lateLatchProgram);
+    checkProgram(self.lateLatchProgram);
+
+    c.glDeleteShader(vertexShader);
+    c.glDeleteShader(fragmentShader);
+
+    c.glUniformBlockBinding(
+        self.lateLatchProgram,
+        c.glGetUniformBlockIndex(self.lateLatchProgram, "LatePoses"),
+        LATE_POSES_BINDING,
+    );
+    self.lateLatchOcclusionUniforms = .init(self.lateLatchProgram);
+
+    self.lateLatch = LateLatch.init();
+}
+
+// Upload the hand meshes once, replacing those of an earlier session. Builds the hand programs the
+// first time a mesh is loaded, call it after enableLateLatch.
+pub fn loadHandMeshes(self: *@This(), meshes: [2]?HandMesh) void {
+    for (&self.hands, meshes) |*hand, maybe_mesh| {
+        if (hand.vao != 0) {
+            c.glDeleteVertexArrays(1, &hand.vao);
+            c.glDeleteBuffers(1, &hand.vertexBuffer);
+            c.glDeleteBuffers(1, &hand.indexBuffer);
+            hand.* = .{};
+        }
+        const mesh = maybe_mesh orelse continue;
+
+        if (self.handProgram == 0) {
+            self.handProgram = buildHandProgram(false);
+            self.handViewProjectionLocation = c.glGetUniformLocation(self.handProgram, "ViewProjection");
+            self.handJointsLocation = c.glGetUniformLocation(self.handProgram, "Joints");
+            self.handOcclusionUniforms = .init(self.handProgram);
+            if (self.lateLatch != null) {
+                self.lateLatchHandProgram = buildHandProgram(true);
+                self.lateLatchHandJointsLocation = c.glGetUniformLocation(self.lateLatchHandProgram, "Joints");
+                self.lateLatchHandOcclusionUniforms = .init(self.lateLatchHandProgram);
+                c.glUniformBlockBinding(
+                    self.lateLatchHandProgram,
+                    c.glGetUniformBlockIndex(self.lateLatchHandProgram, "LatePoses"),
+                    LATE_POSES_BINDING,
+                );
+            }
+        }
+
+        c.glGenVertexArrays(1, &hand.vao);
+        c.glBindVertexArray(hand.vao);
+
+        c.glGenBuffers(1, &hand.vertexBuffer);
+        c.glBindBuffer(c.GL_ARRAY_BUFFER, hand.vertexBuffer);
+        c.glBufferData(
+            c.GL_ARRAY_BUFFER,
+            @intCast(mesh.vertices.len * @sizeOf(HandMesh.Vertex)),
+            mesh.vertices.ptr,
+            c.GL_STATIC_DRAW,
+        );
+        const stride = @sizeOf(HandMesh.Vertex);
+        c.glEnableVertexAttribArray(HAND_VERTEX_POSITION);
+        c.glVertexAttribPointer(HAND_VERTEX_POSITION, 3, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(@offsetOf(HandMesh.Vertex, "position")));
+        c.glEnableVertexAttribArray(HAND_VERTEX_NORMAL);
+        c.glVertexAttribPointer(HAND_VERTEX_NORMAL, 3, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(@offsetOf(HandMesh.Vertex, "normal")));
+        c.glEnableVertexAttribArray(HAND_VERTEX_JOINTS);
+        c.glVertexAttribIPointer(HAND_VERTEX_JOINTS, 4, c.GL_SHORT, stride, @ptrFromInt(@offsetOf(HandMesh.Vertex, "joints")));
+        c.glEnableVertexAttribArray(HAND_VERTEX_WEIGHTS);
+        c.glVertexAttribPointer(HAND_VERTEX_WEIGHTS, 4, c.GL_FLOAT, c.GL_FALSE, stride, @ptrFromInt(@offsetOf(HandMesh.Vertex, "weights")));
+
+        c.glGenBuffers(1, &hand.indexBuffer);
+        c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, hand.indexBuffer);
+        c.glBufferData(
+            c.GL_ELEMENT_ARRAY_BUFFER,
+            @intCast(mesh.indices.len * @sizeOf(u16)),
+            mesh.indices.ptr,
+            c.GL_STATIC_DRAW,
+        );
+        hand.indexCount = mesh.indices.len;
+
+        c.glBindVertexArray(0);
+        c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
+    }
+}
+
+fn buildHandProgram(lateLatched: bool) c.GLuint {
+    const sources = [_][*c]const u8{
+        "#version 410\n",
+        (if (lateLatched) "#define LATE_LATCH\n" else "\n").ptr,
+        std.fmt.comptimePrint("#define JOINT_COUNT {}\n", .{HandMesh.MAX_JOINTS}),
+        HandVertexShaderGlsl,
+    };
+    const vertexShader = c.glCreateShader(c.GL_VERTEX_SHADER);
+    c.glShaderSource(vertexShader, sources.len, &sources[0], null);
+    c.glCompileShader(vertexShader);
+    checkShader(vertexShader);
+
+    const fragmentShader = c.glCreateShader(c.GL_FRAGMENT_SHADER);
+    c.glShaderSource(fragmentShader, 1, &&FragmentShaderGlsl[0], null);
+    c.glCompileShader(fragmentShader);
+    checkShader(fragmentShader);
+
+    const program = c.glCreateProgram();
+    c.glAttachShader(program, vertexShader);
+    c.glAttachShader(program, fragmentShader);
+    c.glBindAttribLocation(program, HAND_VERTEX_POSITION, "VertexPos");
+    c.glBindAttribLocation(program, HAND_VERTEX_NORMAL, "VertexNormal");
+    c.glBindAttribLocation(program, HAND_VERTEX_JOINTS, "VertexJoints");
+    c.glBindAttribLocation(program, HAND_VERTEX_WEIGHTS, "VertexWeights");
+    c.glLinkProgram(program);
+    checkProgram(program);
+
+    c.glDeleteShader(vertexShader);
+    c.glDeleteShader(fragmentShader);
+    return program;
+}
+
+// Joint matrices for the views that follow, see Scene.handSkins. A hand without a loaded mesh is
+// skipped either way.
+pub fn setHandSkins(self: *@This(), skins: [2]?HandMesh.Skin) void {
+    for (&self.hands, skins) |*hand, skin| {
+        hand.skin = skin;
+    }
+}
+
+// One draw per hand. The program's view-projection is already set.
+fn drawHands(self: *const @This(), jointsLocation: c.GLint) void {
+    // The runtime's mesh winds counter-clockwise, unlike the cube.
+    c.glFrontFace(c.GL_CCW);
+    for (self.hands) |hand| {
+        const skin = hand.skin orelse continue;
+        if (hand.vao == 0) {
+            continue;
+        }
+        c.glUniformMatrix4fv(jointsLocation, HandMesh.MAX_JOINTS, c.GL_FALSE, &skin[0].m[0]);
+        c.glBindVertexArray(hand.vao);
+        c.glDrawElements(c.GL_TRIANGLES, @intCast(hand.indexCount), c.GL_UNSIGNED_SHORT, null);
+    }
+    c.glFrontFace(c.GL_CW);
+}
+
+// Draw the scene model meshes in the views that follow. The slice must stay valid until then.
+// Builds the scene programs the first time, call it after enableLateLatch.
+pub fn setSceneMeshes(self: *@This(), meshes: []const SceneModel.Mesh) void {
+    self.sceneMeshes = meshes;
+    if (meshes.len == 0 or self.sceneProgram != 0) {
+        return;
+    }
+    self.sceneProgram = buildSceneProgram(false);
+    self.sceneViewProjectionLocation = c.glGetUniformLocation(self.sceneProgram, "ViewProjection");
+    self.sceneModelLocation = c.glGetUniformLocation(self.sceneProgram, "Model");
+    if (self.lateLatch != null) {
+        self.lateLatchSceneProgram = buildSceneProgram(true);
+        self.lateLatchSceneModelLocation = c.glGetUniformLocation(self.lateLatchSceneProgram, "Model");
+        c.glUniformBlockBinding(
+            self.lateLatchSceneProgram,
+            c.glGetUniformBlockIndex(self.lateLatchSceneProgram, "LatePoses"),
+            LATE_POSES_BINDING,
+        );
+    }
+}
+
+// Call before the SceneModel that owns the meshes is destroyed.
+pub fn releaseSceneMeshes(self: *@This()) void {
+    for (self.sceneVaos.items) |*vao| {
+        if (vao.* != 0) {
+            c.glDeleteVertexArrays(1, vao);
+        }
+    }
+    self.sceneVaos.clearRetainingCapacity();
+    self.sceneMeshes = &.{};
+}
+
+fn buildSceneProgram(lateLatched: bool) c.GLuint {
+    const sources = [_][*c]const u8{
+        "#version 410\n",
+        (if (lateLatched) "#define LATE_LATCH\n" else "\n").ptr,
+        SceneVertexShaderGlsl,
+    };
+    const vertexShader = c.glCreateShader(c.GL_VERTEX_SHADER);
+    c.glShaderSource(vertexShader, sources.len, &sources[0], null);
+    c.glCompileShader(vertexShader);
+    checkShader(vertexShader);
+
+    const fragmentShader = c.glCreateShader(c.GL_FRAGMENT_SHADER);
+    c.glShaderSource(fragmentShader, 1, &&SceneFragmentShaderGlsl[0], null);
+    c.glCompileShader(fragmentShader);
+    checkShader(fragmentShader);
+
+    const program = c.glCreateProgram();
+    c.glAttachShader(program, vertexShader);
+    c.glAttachShader(program, fragmentShader);
+    c.glBindAttribLocation(program, SCENE_VERTEX_POSITION, "VertexPos");
+    c.glLinkProgram(program);
+    checkProgram(program);
+
+    c.glDeleteShader(vertexShader);
+    c.glDeleteShader(fragmentShader);
+    return program;
+}
+
+// VAOs are not shared between contexts, so the one for a mesh uploaded on the loader thread is
+// made here.
+fn sceneVao(self: *@This(), index: usize, mesh: SceneModel.Mesh) c.GLuint {
+    if (index >= self.sceneVaos.items.len) {
+        self.sceneVaos.appendNTimes(0, index + 1 - self.sceneVaos.items.len) catch @panic("OOM");
+    }
+    const vao = &self.sceneVaos.items[index];
+    if (vao.* == 0) {
+        c.glGenVertexArrays(1, vao);
+        c.glBindVertexArray(vao.*);
+        c.glBindBuffer(c.GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        c.glEnableVertexAttribArray(SCENE_VERTEX_POSITION);
+        c.glVertexAttribPointer(SCENE_VERTEX_POSITION, 3, c.GL_FLOAT, c.GL_FALSE, @sizeOf(xr.XrVector3f), null);
+        c.glBindBuffer(c.GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+        c.glBindVertexArray(0);
+        c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
+    }
+    return vao.*;
+}
+
+// One draw per visible range of every uploaded and located mesh. Blended without depth writes, so
+// the cubes behind a wall still show through it. The program's view-projection is already set, vp
+// is the one to cull with.
+fn drawSceneMeshes(self: *@This(), modelLocation: c.GLint, vp: xr_linear.Matrix4x4f) void {
+    c.glEnable(c.GL_BLEND);
+    c.glBlendFuncSeparate(c.GL_SRC_ALPHA, c.GL_ONE_MINUS_SRC_ALPHA, c.GL_ONE, c.GL_ONE_MINUS_SRC_ALPHA);
+    c.glDepthMask(c.GL_FALSE);
+    // The runtime does not promise a winding.
+    c.glDisable(c.GL_CULL_FACE);
+    for (self.sceneMeshes, 0..) |mesh, i| {
+        if (mesh.vertexBuffer == 0 or mesh.pose == null) {
+            continue;
+        }
+        mesh.cull(vp, &self.sceneRanges) catch @panic("OOM");
+        if (self.sceneRanges.items.len == 0) {
+            continue;
+        }
+        c.glUniformMatrix4fv(modelLocation, 1, c.GL_FALSE, &mesh.model.m[0]);
+        c.glBindVertexArray(self.sceneVao(i, mesh));
+        for (self.sceneRanges.items) |range| {
+            c.glDrawElements(
+                c.GL_TRIANGLES,
+                @intCast(3 * range.count),
+                c.GL_UNSIGNED_INT,
+                @ptrFromInt(3 * @as(usize, range.first) * @sizeOf(u32)),
+            );
+        }
+    }
+    c.glEnable(c.GL_CULL_FACE);
+    c.glDepthMask(c.GL_TRUE);
+    c.glDisable(c.GL_BLEND);
+}
+
 fn checkShader(shader: c.GLuint) void {
     var r: c.GLint = 0;
     c.glGetShaderiv(shader, c.GL_COMPILE_STATUS, &r);
@@ -143,7 +732,31 @@ fn checkProgram(prog: c.GLuint) void {
 }
 
 pub fn deinit(self: *@This()) void {
-    self.colorToDepthMap.deinit();
+    if (self.lateLatch) |*lateLatch| {
+        lateLatch.deinit();
+        c.glDeleteProgram(self.lateLatchProgram);
+    }
+    self.loadHandMeshes(.{ null, null });
+    if (self.handProgram != 0) {
+        c.glDeleteProgram(self.handProgram);
+    }
+    if (self.lateLatchHandProgram != 0) {
+        c.glDeleteProgram(self.lateLatchHandProgram);
+    }
+    self.releaseSceneMeshes();
+    if (self.sceneProgram != 0) {
+        c.glDeleteProgram(self.sceneProgram);
+    }
+    if (self.lateLatchSceneProgram != 0) {
+        c.glDeleteProgram(self.lateLatchSceneProgram);
+    }
+    self.sceneVaos.deinit();
+    self.sceneRanges.deinit();
+    self.depthPool.deinit();
+    c.glDeleteBuffers(1, &self.instanceBuffer);
+    c.glDeleteBuffers(1, &self.storeBuffer);
+    self.instances.deinit();
+    self.dirtyRanges.deinit();
     //         if (m_swapchainFramebuffer != 0) {
     //             glDeleteFramebuffers(1, &m_swapchainFramebuffer);
     //         }
@@ -168,22 +781,199 @@ pub fn deinit(self: *@This()) void {
     //     }
 }
 
+// Call when the swapchains go away but the GL context stays, e.g. on a session restart. GL may
+// hand out the same texture names for the next swapchains.
+pub fn releaseSwapchainImages(self: *@This()) void {
+    self.depthPool.releaseColorImages();
+}
+
+// Stream the cubes into the instance buffer once, before the views that draw them. Orphans the
+// previous storage, so draws still queued against it are not stalled.
+pub fn uploadInstances(self: *@This(), cubes: []const geometry.Cube) void {
+    self.instances.resize(cubes.len) catch @panic("OOM");
+    for (cubes, self.instances.items) |cube, *instance| {
+        instance.* = .fromCube(cube);
+    }
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, self.instanceBuffer);
+    c.glBufferData(
+        c.GL_ARRAY_BUFFER,
+        @intCast(self.instances.items.len * @sizeOf(geometry.Instance)),
+        if (self.instances.items.len > 0) &self.instances.items[0] else null,
+        c.GL_STREAM_DRAW,
+    );
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
+    self.drawBuffer = self.instanceBuffer;
+    self.drawCount = cubes.len;
+}
+
+// Copy the dirty objects of the store into the scene buffer, which keeps every other instance from
+// earlier frames, and clear the dirty bits. Only a grown store uploads everything again. Draws
+// still queued against the old contents are the driver's to preserve, as with any glBufferSubData.
+pub fn uploadStore(self: *@This(), store: *SceneStore) void {
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, self.storeBuffer);
+    if (store.len() > self.storeCapacity) {
+        self.storeCapacity = @max(store.len(), 2 * self.storeCapacity, INITIAL_STORE_CAPACITY);
+        c.glBufferData(
+            c.GL_ARRAY_BUFFER,
+            @intCast(self.storeCapacity * @sizeOf(geometry.Instance)),
+            null,
+            c.GL_DYNAMIC_DRAW,
+        );
+        store.markAllDirty();
+    }
+
+    self.dirtyRanges.resize(0) catch unreachable;
+    store.dirtyRanges(&self.dirtyRanges) catch @panic("OOM");
+    for (self.dirtyRanges.items) |range| {
+        self.instances.resize(range.end - range.begin) catch @panic("OOM");
+        store.writeInstances(range, self.instances.items);
+        c.glBufferSubData(
+            c.GL_ARRAY_BUFFER,
+            @intCast(range.begin * @sizeOf(geometry.Instance)),
+            @intCast(self.instances.items.len * @sizeOf(geometry.Instance)),
+            &self.instances.items[0],
+        );
+    }
+    store.clearDirty();
+    c.glBindBuffer(c.GL_ARRAY_BUFFER, 0);
+
+    self.drawBuffer = self.storeBuffer;
+    self.drawCount = store.len();
+}
+
+// Occlude the views that follow with this environment depth layer, null to draw over everything.
+pub fn setOcclusion(self: *@This(), occlusion: ?EnvironmentDepth.Occlusion) void {
+    self.occlusion = occlusion;
+}
+
+// Draw the instances of the last uploadInstances or uploadStore.
+// image_width/image_height is the size of the swapchain image, viewport the imageRect rendered into.
+// depth is the depth swapchain image submitted with the layer, null to use a pooled one.
 pub fn render(
     self: *@This(),
-    color_texture: u32,
-    viewport_width: i32,
-    viewport_height: i32,
+    color: GraphicsPlugin.SwapchainTexture,
+    depth: ?GraphicsPlugin.SwapchainTexture,
+    image_width: i32,
+    image_height: i32,
+    viewport: c.XrRect2Di,
     clear_color: [4]f32,
     vp: xr_linear.Matrix4x4f,
-    cubes: []geometry.Cube,
 ) void {
+    if (!self.beginView(color, depth, image_width, image_height, viewport, clear_color)) {
+        return;
+    }
+
+    // Set shaders and uniform variables.
+    c.glUseProgram(self.program);
+    c.glUniformMatrix4fv(self.viewProjectionUniformLocation, 1, c.GL_FALSE, &vp.m[0]);
+    self.occlusionUniforms.apply(self.occlusion);
+
+    // Set cube primitive data.
+    c.glBindVertexArray(self.vao);
+    self.drawInstances();
+
+    if (self.handProgram != 0) {
+        c.glUseProgram(self.handProgram);
+        c.glUniformMatrix4fv(self.handViewProjectionLocation, 1, c.GL_FALSE, &vp.m[0]);
+        self.handOcclusionUniforms.apply(self.occlusion);
+        self.drawHands(self.handJointsLocation);
+    }
+
+    if (self.sceneProgram != 0) {
+        c.glUseProgram(self.sceneProgram);
+        c.glUniformMatrix4fv(self.sceneViewProjectionLocation, 1, c.GL_FALSE, &vp.m[0]);
+        self.drawSceneMeshes(self.sceneModelLocation, vp);
+    }
+
+    endView();
+}
+
+fn drawInstances(self: *@This()) void {
+    if (self.drawCount == 0) {
+        return;
+    }
+    if (self.attribBuffer != self.drawBuffer) {
+        self.bindInstanceAttribs(self.drawBuffer);
+    }
+    c.glDrawElementsInstanced(
+        c.GL_TRIANGLES,
+        geometry.c_cubeIndices.len,
+        c.GL_UNSIGNED_SHORT,
+        null,
+        @intCast(self.drawCount),
+    );
+}
+
+// Like render, but the view-projection and hand poses come from a late-latch slot that stays
+// writable until the swapchain image is released. Returns the slot for latch.
+pub fn renderLateLatched(
+    self: *@This(),
+    color: GraphicsPlugin.SwapchainTexture,
+    depth: ?GraphicsPlugin.SwapchainTexture,
+    image_width: i32,
+    image_height: i32,
+    viewport: c.XrRect2Di,
+    clear_color: [4]f32,
+    poses: LateLatch.Block,
+) ?usize {
+    if (self.lateLatch == null) {
+        return null;
+    }
+    const lateLatch = &self.lateLatch.?;
+    if (!self.beginView(color, depth, image_width, image_height, viewport, clear_color)) {
+        return null;
+    }
+
+    const slot = lateLatch.acquire();
+    lateLatch.write(slot, poses);
+    lateLatch.bind(slot, LATE_POSES_BINDING);
+
+    c.glUseProgram(self.lateLatchProgram);
+    self.lateLatchOcclusionUniforms.apply(self.occlusion);
+    c.glBindVertexArray(self.vao);
+    self.drawInstances();
+
+    if (self.lateLatchHandProgram != 0) {
+        c.glUseProgram(self.lateLatchHandProgram);
+        self.lateLatchHandOcclusionUniforms.apply(self.occlusion);
+        self.drawHands(self.lateLatchHandJointsLocation);
+    }
+
+    if (self.lateLatchSceneProgram != 0) {
+        c.glUseProgram(self.lateLatchSceneProgram);
+        // Culled with the recorded view-projection, the latched one is only a small correction.
+        self.drawSceneMeshes(self.lateLatchSceneModelLocation, .{ .m = poses.viewProjection });
+    }
+
+    lateLatch.fence(slot);
+    endView();
+    return slot;
+}
+
+// Overwrite the poses of a recorded view. Only useful before the draws have run, so call it right
+// before xrReleaseSwapchainImage.
+pub fn latch(self: *@This(), slot: usize, poses: LateLatch.Block) void {
+    if (self.lateLatch) |*lateLatch| {
+        lateLatch.write(slot, poses);
+    }
+}
+
+fn beginView(
+    self: *@This(),
+    color: GraphicsPlugin.SwapchainTexture,
+    depth: ?GraphicsPlugin.SwapchainTexture,
+    image_width: i32,
+    image_height: i32,
+    viewport: c.XrRect2Di,
+    clear_color: [4]f32,
+) bool {
     c.glBindFramebuffer(c.GL_FRAMEBUFFER, self.swapchainFramebuffer);
 
     c.glViewport(
-        0,
-        0,
-        viewport_width,
-        viewport_height,
+        viewport.offset.x,
+        viewport.offset.y,
+        viewport.extent.width,
+        viewport.extent.height,
     );
 
     c.glFrontFace(c.GL_CW);
@@ -191,80 +981,28 @@ pub fn render(
     c.glEnable(c.GL_CULL_FACE);
     c.glEnable(c.GL_DEPTH_TEST);
 
-    const depth_texture = self.getDepthTexture(color_texture) catch {
-        return;
-    };
-
-    c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, color_texture, 0);
-    c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_DEPTH_ATTACHMENT, c.GL_TEXTURE_2D, depth_texture, 0);
+    c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_COLOR_ATTACHMENT0, c.GL_TEXTURE_2D, color.texture, 0);
+    if (depth) |depth_image| {
+        // Depth only, so drop a pooled depth-stencil buffer left attached by an earlier view.
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, 0);
+        c.glFramebufferTexture2D(c.GL_FRAMEBUFFER, c.GL_DEPTH_ATTACHMENT, c.GL_TEXTURE_2D, depth_image.texture, 0);
+    } else {
+        // The depth buffer covers the whole image, whatever part of it this frame renders into.
+        const depth_buffer = self.depthPool.get(color, image_width, image_height) catch {
+            return false;
+        };
+        c.glFramebufferRenderbuffer(c.GL_FRAMEBUFFER, c.GL_DEPTH_STENCIL_ATTACHMENT, c.GL_RENDERBUFFER, depth_buffer);
+    }
 
     // Clear swapchain and depth buffer.
     c.glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
     c.glClearDepth(1.0);
     c.glClear(c.GL_COLOR_BUFFER_BIT | c.GL_DEPTH_BUFFER_BIT | c.GL_STENCIL_BUFFER_BIT);
+    return true;
+}
 
-    // Set shaders and uniform variables.
-    c.glUseProgram(self.program);
-
-    // Set cube primitive data.
-    c.glBindVertexArray(self.vao);
-
-    // Render each cube
-    for (cubes) |cube| {
-        // Compute the model-view-projection transform and set it..
-        const model = xr_linear.Matrix4x4f.createTranslationRotationScale(
-            cube.Pose.position,
-            cube.Pose.orientation,
-            cube.Scale,
-        );
-        const mvp = vp.multiply(model);
-        c.glUniformMatrix4fv(self.modelViewProjectionUniformLocation, 1, c.GL_FALSE, &mvp.m[0]);
-
-        // Draw the cube.
-        c.glDrawElements(c.GL_TRIANGLES, geometry.c_cubeIndices.len, c.GL_UNSIGNED_SHORT, null);
-    }
-
+fn endView() void {
     c.glBindVertexArray(0);
     c.glUseProgram(0);
     c.glBindFramebuffer(c.GL_FRAMEBUFFER, 0);
 }
-
-fn getDepthTexture(self: *@This(), colorTexture: u32) !u32 {
-    // If a depth-stencil view has already been created for this back-buffer, use it.
-    if (self.colorToDepthMap.get(colorTexture)) |depthBuffer| {
-        return depthBuffer;
-    }
-
-    {
-        // This back-buffer has no corresponding depth-stencil texture, so create one with matching dimensions.
-        c.glBindTexture(c.GL_TEXTURE_2D, colorTexture);
-
-        var width: c.GLint = undefined;
-        c.glGetTexLevelParameteriv(c.GL_TEXTURE_2D, 0, c.GL_TEXTURE_WIDTH, &width);
-        var height: c.GLint = undefined;
-        c.glGetTexLevelParameteriv(c.GL_TEXTURE_2D, 0, c.GL_TEXTURE_HEIGHT, &height);
-
-        var depthTexture: u32 = undefined;
-        c.glGenTextures(1, &depthTexture);
-        c.glBindTexture(c.GL_TEXTURE_2D, depthTexture);
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MAG_FILTER, c.GL_NEAREST);
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_MIN_FILTER, c.GL_NEAREST);
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_S, c.GL_CLAMP_TO_EDGE);
-        c.glTexParameteri(c.GL_TEXTURE_2D, c.GL_TEXTURE_WRAP_T, c.GL_CLAMP_TO_EDGE);
-        c.glTexImage2D(
-            c.GL_TEXTURE_2D,
-            0,
-            c.GL_DEPTH_COMPONENT32,
-            width,
-            height,
-            0,
-            c.GL_DEPTH_COMPONENT,
-            c.GL_FLOAT,
-            null,
-        );
-
-        try self.colorToDepthMap.put(colorTexture, depthTexture);
-
-        return depthTexture;
-    }
-}
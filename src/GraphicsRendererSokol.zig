@@ -1,26 +1,93 @@
 const std = @import("std");
 const geometry = @import("geometry.zig");
 const xr_linear = @import("xr_linear.zig");
+const DepthPool = @import("DepthPool.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+const slot_map = @import("slot_map.zig");
+const HandMesh = @import("HandMesh.zig");
+const SceneModel = @import("SceneModel.zig");
+const Bvh = @import("Bvh.zig");
 
 const sokol = @import("sokol");
 const slog = sokol.log;
 const sg = sokol.gfx;
 const shd = @import("shd");
 
+// Vertex buffer slots. The cube mesh is per vertex, the model matrices are per instance.
+const CUBE_BUFFER = 0;
+const MODEL_BUFFER = 1;
+const PREV_MODEL_BUFFER = 2;
+
+comptime {
+    std.debug.assert(@typeInfo(@FieldType(shd.HandParams, "joints")).array.len == HandMesh.MAX_JOINTS);
+}
+
+// Initial instance buffer capacity, doubled whenever a frame has more cubes.
+const INITIAL_INSTANCES = 256;
+
 const State = struct {
     pip: sg.Pipeline = .{},
     bind: sg.Bindings = .{},
+    // XR_FB_space_warp motion vectors, see SpaceWarp.zig.
+    velocityPip: sg.Pipeline = .{},
+    // Skinned hand meshes, see HandMesh.zig.
+    handPip: sg.Pipeline = .{},
+    handBind: [2]sg.Bindings = .{ .{}, .{} },
+    handIndexCount: [2]usize = .{ 0, 0 },
+    handVelocityPip: sg.Pipeline = .{},
+    // Scene model meshes, see SceneModel.zig.
+    scenePip: sg.Pipeline = .{},
+    sceneVelocityPip: sg.Pipeline = .{},
+};
+
+// A swapchain texture wrapped for sokol. pooledDepth is the depth view a color image renders
+// against when the layer has no depth swapchain image, owned by depthMap and looked up on the first
+// such pass.
+const Wrapped = struct {
+    image: sg.Image,
+    view: sg.View,
+    pooledDepth: sg.View = .{},
+
+    fn destroy(self: @This()) void {
+        sg.destroyView(self.view);
+        sg.destroyImage(self.image);
+    }
+};
+
+const PooledDepth = struct {
+    image: sg.Image,
+    view: sg.View,
 };
 
 allocator: std.mem.Allocator,
-imageMap: std.AutoHashMap(u32, sg.Attachments),
+// Every color, depth and motion vector swapchain image passed in, by its handle and image index.
+wrapped: slot_map.ImageTable(Wrapped, Wrapped.destroy),
+pooledColorImages: usize = 0,
+// One depth attachment per (width, height, format, samples), shared by all color images.
+depthMap: std.AutoHashMap(DepthPool.Key, PooledDepth),
+depthPooledBytes: usize = 0,
+depthUnpooledBytes: usize = 0,
 
 state: State = .{},
+// Model matrices of this frame, uploaded once by beginFrame and drawn by every view.
+models: std.array_list.Managed(xr_linear.Matrix4x4f),
+instanceCapacity: usize = 0,
+instanceCount: usize = 0,
+// Joint matrices of this frame, null to skip the hand.
+handSkins: [2]?HandMesh.Skin = .{ null, null },
+// The meshes of setSceneMeshes and, by vertex buffer, the bindings that wrap their GL buffers.
+sceneMeshes: []const SceneModel.Mesh = &.{},
+sceneBinds: std.AutoHashMap(u32, sg.Bindings),
+sceneRanges: std.array_list.Managed(Bvh.Range),
 
 pub fn init(allocator: std.mem.Allocator) !@This() {
     var self = @This(){
         .allocator = allocator,
-        .imageMap = .init(allocator),
+        .wrapped = .init(allocator),
+        .depthMap = .init(allocator),
+        .models = .init(allocator),
+        .sceneBinds = .init(allocator),
+        .sceneRanges = .init(allocator),
     };
 
     sg.setup(.{
@@ -30,7 +97,7 @@ pub fn init(allocator: std.mem.Allocator) !@This() {
 
     // cube vertex buffer
     const s = 0.5;
-    self.state.bind.vertex_buffers[0] = sg.makeBuffer(.{
+    self.state.bind.vertex_buffers[CUBE_BUFFER] = sg.makeBuffer(.{
         .data = sg.asRange(&[_]f32{
             // positions        colors
             -s, -s, -s, 1.0, 0.0, 0.0, 1.0,
@@ -78,13 +145,48 @@ pub fn init(allocator: std.mem.Allocator) !@This() {
         }),
     });
 
+    self.growInstanceBuffers(INITIAL_INSTANCES);
+
     // shader and pipeline object
     self.state.pip = sg.makePipeline(.{
         .shader = sg.makeShader(shd.cubeShaderDesc(sg.queryBackend())),
         .layout = init: {
             var l = sg.VertexLayoutState{};
-            l.attrs[shd.ATTR_cube_position].format = .FLOAT3;
-            l.attrs[shd.ATTR_cube_color0].format = .FLOAT4;
+            l.attrs[shd.ATTR_cube_position] = .{ .format = .FLOAT3, .buffer_index = CUBE_BUFFER };
+            l.attrs[shd.ATTR_cube_color0] = .{ .format = .FLOAT4, .buffer_index = CUBE_BUFFER };
+            l.buffers[MODEL_BUFFER].step_func = .PER_INSTANCE;
+            l.attrs[shd.ATTR_cube_model0] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.attrs[shd.ATTR_cube_model1] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.attrs[shd.ATTR_cube_model2] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.attrs[shd.ATTR_cube_model3] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            break :init l;
+        },
+        .index_type = .UINT16,
+        .depth = .{
+            .compare = .LESS_EQUAL,
+            .write_enabled = true,
+            .pixel_format = .DEPTH,
+        },
+        .cull_mode = .BACK,
+    });
+
+    // Reads the positions only, so the stride skips the colors.
+    self.state.velocityPip = sg.makePipeline(.{
+        .shader = sg.makeShader(shd.velocityShaderDesc(sg.queryBackend())),
+        .layout = init: {
+            var l = sg.VertexLayoutState{};
+            l.buffers[CUBE_BUFFER].stride = 7 * @sizeOf(f32);
+            l.attrs[shd.ATTR_velocity_position] = .{ .format = .FLOAT3, .buffer_index = CUBE_BUFFER };
+            l.buffers[MODEL_BUFFER].step_func = .PER_INSTANCE;
+            l.attrs[shd.ATTR_velocity_model0] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.attrs[shd.ATTR_velocity_model1] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.attrs[shd.ATTR_velocity_model2] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.attrs[shd.ATTR_velocity_model3] = .{ .format = .FLOAT4, .buffer_index = MODEL_BUFFER };
+            l.buffers[PREV_MODEL_BUFFER].step_func = .PER_INSTANCE;
+            l.attrs[shd.ATTR_velocity_prev_model0] = .{ .format = .FLOAT4, .buffer_index = PREV_MODEL_BUFFER };
+            l.attrs[shd.ATTR_velocity_prev_model1] = .{ .format = .FLOAT4, .buffer_index = PREV_MODEL_BUFFER };
+            l.attrs[shd.ATTR_velocity_prev_model2] = .{ .format = .FLOAT4, .buffer_index = PREV_MODEL_BUFFER };
+            l.attrs[shd.ATTR_velocity_prev_model3] = .{ .format = .FLOAT4, .buffer_index = PREV_MODEL_BUFFER };
             break :init l;
         },
         .index_type = .UINT16,
@@ -93,28 +195,272 @@ pub fn init(allocator: std.mem.Allocator) !@This() {
             .write_enabled = true,
             .pixel_format = .DEPTH,
         },
+        .colors = .{
+            .{ .pixel_format = .RGBA16F },
+            .{},
+            .{},
+            .{},
+        },
         .cull_mode = .BACK,
     });
 
+    // The runtime's mesh winds counter-clockwise, unlike the cube.
+    self.state.handPip = sg.makePipeline(.{
+        .shader = sg.makeShader(shd.handShaderDesc(sg.queryBackend())),
+        .layout = init: {
+            var l = sg.VertexLayoutState{};
+            l.buffers[0].stride = @sizeOf(HandMesh.Vertex);
+            l.attrs[shd.ATTR_hand_position] = .{ .format = .FLOAT3, .offset = @offsetOf(HandMesh.Vertex, "position") };
+            l.attrs[shd.ATTR_hand_normal] = .{ .format = .FLOAT3, .offset = @offsetOf(HandMesh.Vertex, "normal") };
+            l.attrs[shd.ATTR_hand_joint_indices] = .{ .format = .SHORT4, .offset = @offsetOf(HandMesh.Vertex, "joints") };
+            l.attrs[shd.ATTR_hand_joint_weights] = .{ .format = .FLOAT4, .offset = @offsetOf(HandMesh.Vertex, "weights") };
+            break :init l;
+        },
+        .index_type = .UINT16,
+        .depth = .{
+            .compare = .LESS_EQUAL,
+            .write_enabled = true,
+            .pixel_format = .DEPTH,
+        },
+        .cull_mode = .BACK,
+        .face_winding = .CCW,
+    });
+
+    self.state.handVelocityPip = sg.makePipeline(.{
+        .shader = sg.makeShader(shd.handVelocityShaderDesc(sg.queryBackend())),
+        .layout = init: {
+            var l = sg.VertexLayoutState{};
+            l.buffers[0].stride = @sizeOf(HandMesh.Vertex);
+            l.attrs[shd.ATTR_hand_velocity_position] = .{ .format = .FLOAT3, .offset = @offsetOf(HandMesh.Vertex, "position") };
+            l.attrs[shd.ATTR_hand_velocity_normal] = .{ .format = .FLOAT3, .offset = @offsetOf(HandMesh.Vertex, "normal") };
+            l.attrs[shd.ATTR_hand_velocity_joint_indices] = .{ .format = .SHORT4, .offset = @offsetOf(HandMesh.Vertex, "joints") };
+            l.attrs[shd.ATTR_hand_velocity_joint_weights] = .{ .format = .FLOAT4, .offset = @offsetOf(HandMesh.Vertex, "weights") };
+            break :init l;
+        },
+        .index_type = .UINT16,
+        .depth = .{
+            .compare = .LESS_EQUAL,
+            .write_enabled = true,
+            .pixel_format = .DEPTH,
+        },
+        .colors = .{
+            .{ .pixel_format = .RGBA16F },
+            .{},
+            .{},
+            .{},
+        },
+        .cull_mode = .BACK,
+        .face_winding = .CCW,
+    });
+
+    // Blended without depth writes, so the cubes behind a wall still show through it. The runtime
+    // does not promise a winding.
+    self.state.scenePip = sg.makePipeline(.{
+        .shader = sg.makeShader(shd.sceneShaderDesc(sg.queryBackend())),
+        .layout = init: {
+            var l = sg.VertexLayoutState{};
+            l.attrs[shd.ATTR_scene_position] = .{ .format = .FLOAT3 };
+            break :init l;
+        },
+        .index_type = .UINT32,
+        .depth = .{
+            .compare = .LESS_EQUAL,
+            .write_enabled = false,
+            .pixel_format = .DEPTH,
+        },
+        .colors = .{
+            .{ .blend = .{
+                .enabled = true,
+                .src_factor_rgb = .SRC_ALPHA,
+                .dst_factor_rgb = .ONE_MINUS_SRC_ALPHA,
+                .src_factor_alpha = .ONE,
+                .dst_factor_alpha = .ONE_MINUS_SRC_ALPHA,
+            } },
+            .{},
+            .{},
+            .{},
+        },
+        .cull_mode = .NONE,
+    });
+
+    // Writes depth only, drawn last so a cube seen through a wall keeps its motion vector.
+    self.state.sceneVelocityPip = sg.makePipeline(.{
+        .shader = sg.makeShader(shd.sceneVelocityShaderDesc(sg.queryBackend())),
+        .layout = init: {
+            var l = sg.VertexLayoutState{};
+            l.attrs[shd.ATTR_scene_velocity_position] = .{ .format = .FLOAT3 };
+            break :init l;
+        },
+        .index_type = .UINT32,
+        .depth = .{
+            .compare = .LESS_EQUAL,
+            .write_enabled = true,
+            .pixel_format = .DEPTH,
+        },
+        .colors = .{
+            .{ .pixel_format = .RGBA16F, .write_mask = .NONE },
+            .{},
+            .{},
+            .{},
+        },
+        .cull_mode = .NONE,
+    });
+
     return self;
 }
 
+// Upload the hand meshes once, replacing those of an earlier session.
+pub fn loadHandMeshes(self: *@This(), meshes: [2]?HandMesh) void {
+    for (&self.state.handBind, &self.state.handIndexCount, meshes) |*bind, *indexCount, maybe_mesh| {
+        if (indexCount.* > 0) {
+            sg.destroyBuffer(bind.vertex_buffers[0]);
+            sg.destroyBuffer(bind.index_buffer);
+            bind.* = .{};
+            indexCount.* = 0;
+        }
+        const mesh = maybe_mesh orelse continue;
+        bind.vertex_buffers[0] = sg.makeBuffer(.{
+            .data = sg.asRange(mesh.vertices),
+        });
+        bind.index_buffer = sg.makeBuffer(.{
+            .usage = .{ .index_buffer = true },
+            .data = sg.asRange(mesh.indices),
+        });
+        indexCount.* = mesh.indices.len;
+    }
+}
+
+// Joint matrices for the views that follow, see Scene.handSkins.
+pub fn setHandSkins(self: *@This(), skins: [2]?HandMesh.Skin) void {
+    self.handSkins = skins;
+}
+
+// Draw the scene model meshes in the views that follow. The slice must stay valid until then.
+pub fn setSceneMeshes(self: *@This(), meshes: []const SceneModel.Mesh) void {
+    self.sceneMeshes = meshes;
+}
+
+// Call before the SceneModel that owns the meshes is destroyed. Only the wrappers go, the GL
+// buffers belong to the SceneModel.
+pub fn releaseSceneMeshes(self: *@This()) void {
+    var it = self.sceneBinds.valueIterator();
+    while (it.next()) |bind| {
+        sg.destroyBuffer(bind.vertex_buffers[0]);
+        sg.destroyBuffer(bind.index_buffer);
+    }
+    self.sceneBinds.clearRetainingCapacity();
+    self.sceneMeshes = &.{};
+}
+
+// The buffers were made by the GlUploader's context, so they are wrapped rather than created.
+fn sceneBind(self: *@This(), mesh: SceneModel.Mesh) sg.Bindings {
+    const entry = self.sceneBinds.getOrPut(mesh.vertexBuffer) catch @panic("OOM");
+    if (!entry.found_existing) {
+        entry.value_ptr.* = .{};
+        entry.value_ptr.vertex_buffers[0] = sg.makeBuffer(.{
+            .size = mesh.positions.len * @sizeOf(@TypeOf(mesh.positions[0])),
+            .gl_buffers = .{ mesh.vertexBuffer, 0 },
+        });
+        entry.value_ptr.index_buffer = sg.makeBuffer(.{
+            .usage = .{ .index_buffer = true },
+            .size = mesh.indices.len * @sizeOf(u32),
+            .gl_buffers = .{ mesh.indexBuffer, 0 },
+        });
+    }
+    return entry.value_ptr.*;
+}
+
 pub fn deinit(self: *@This()) void {
-    self.imageMap.deinit();
+    self.releaseSceneMeshes();
+    self.sceneBinds.deinit();
+    self.sceneRanges.deinit();
+    self.models.deinit();
+    self.releaseAttachments();
+    self.wrapped.deinit();
+    self.depthMap.deinit();
     sg.shutdown();
 }
 
-fn getAttachment(self: *@This(), colorTexture: u32, width: i32, height: i32) sg.Attachments {
-    const attachments = self.imageMap.get(colorTexture) orelse blk: {
-        const color_img = sg.makeImage(.{
-            .usage = .{ .color_attachment = true },
-            .width = width,
-            .height = height,
-            .sample_count = 1,
-            .pixel_format = .RGBA8,
-            .gl_textures = .{ colorTexture, 0 },
+// Destroy the images and views that wrap swapchain textures. Call before the swapchains are
+// destroyed, the next render wraps the textures it is given anew.
+pub fn releaseAttachments(self: *@This()) void {
+    self.wrapped.clear();
+    self.pooledColorImages = 0;
+    var depths = self.depthMap.valueIterator();
+    while (depths.next()) |depth| {
+        sg.destroyView(depth.view);
+        sg.destroyImage(depth.image);
+    }
+    self.depthMap.clearRetainingCapacity();
+    self.depthPooledBytes = 0;
+    self.depthUnpooledBytes = 0;
+}
+
+fn getAttachment(
+    self: *@This(),
+    color: GraphicsPlugin.SwapchainTexture,
+    depth: ?GraphicsPlugin.SwapchainTexture,
+    width: i32,
+    height: i32,
+) sg.Attachments {
+    const colorWrapped = self.wrap(color, .RGBA8, width, height);
+    if (depth == null and colorWrapped.pooledDepth.id == sg.invalid_id) {
+        colorWrapped.pooledDepth = self.getDepthView(width, height);
+        self.pooledColorImages += 1;
+        std.log.info("depth pool: {} color images share {} depth buffers ({d:.1} MB instead of {d:.1} MB)", .{
+            self.pooledColorImages,
+            self.depthMap.count(),
+            @as(f64, @floatFromInt(self.depthPooledBytes)) / (1024.0 * 1024.0),
+            @as(f64, @floatFromInt(self.depthUnpooledBytes)) / (1024.0 * 1024.0),
         });
+    }
+    // Read before wrapping the depth image, which may grow the table under colorWrapped.
+    const colorView = colorWrapped.view;
+    const pooledDepth = colorWrapped.pooledDepth;
+    return .{
+        .colors = .{ colorView, .{}, .{}, .{} },
+        .depth_stencil = if (depth) |depth_image|
+            self.wrap(depth_image, .DEPTH, width, height).view
+        else
+            pooledDepth,
+    };
+}
 
+// The sokol image and view over a swapchain texture, made on the first pass into it.
+fn wrap(self: *@This(), texture: GraphicsPlugin.SwapchainTexture, format: sg.PixelFormat, width: i32, height: i32) *Wrapped {
+    if (self.wrapped.getPtr(texture.images, texture.index)) |wrapped| {
+        return wrapped;
+    }
+    const isDepth = format == .DEPTH;
+    const image = sg.makeImage(.{
+        .usage = .{ .color_attachment = !isDepth, .depth_stencil_attachment = isDepth },
+        .width = width,
+        .height = height,
+        .sample_count = 1,
+        .pixel_format = format,
+        .gl_textures = .{ texture.texture, 0 },
+    });
+    self.wrapped.put(texture.images, texture.index, .{
+        .image = image,
+        .view = sg.makeView(if (isDepth)
+            .{ .depth_stencil_attachment = .{ .image = image } }
+        else
+            .{ .color_attachment = .{ .image = image } }),
+    }) catch @panic("OOM");
+    return self.wrapped.getPtr(texture.images, texture.index).?;
+}
+
+// Depth is cleared every pass and never sampled, so images of the same size share one depth attachment.
+fn getDepthView(self: *@This(), width: i32, height: i32) sg.View {
+    const key = DepthPool.Key{
+        .width = width,
+        .height = height,
+        .format = @intCast(@intFromEnum(sg.PixelFormat.DEPTH)),
+        .samples = 1,
+    };
+    self.depthUnpooledBytes += key.byteSize();
+
+    const pooled = self.depthMap.get(key) orelse blk: {
         const depth_img = sg.makeImage(.{
             .usage = .{ .depth_stencil_attachment = true },
             .width = width,
@@ -122,32 +468,130 @@ fn getAttachment(self: *@This(), colorTexture: u32, width: i32, height: i32) sg.
             .sample_count = 1,
             .pixel_format = .DEPTH,
         });
+        const new_pooled = PooledDepth{
+            .image = depth_img,
+            .view = sg.makeView(.{ .depth_stencil_attachment = .{ .image = depth_img } }),
+        };
+        self.depthMap.put(key, new_pooled) catch @panic("OOM");
+        self.depthPooledBytes += key.byteSize();
+        break :blk new_pooled;
+    };
+    return pooled.view;
+}
+
+fn getVelocityAttachment(
+    self: *@This(),
+    motionVector: GraphicsPlugin.SwapchainTexture,
+    depth: GraphicsPlugin.SwapchainTexture,
+    width: i32,
+    height: i32,
+) sg.Attachments {
+    return .{
+        .colors = .{ self.wrap(motionVector, .RGBA16F, width, height).view, .{}, .{}, .{} },
+        .depth_stencil = self.wrap(depth, .DEPTH, width, height).view,
+    };
+}
+
+// Stream buffers can be updated once per frame, so a frame that outgrows them gets new ones.
+fn growInstanceBuffers(self: *@This(), count: usize) void {
+    if (count <= self.instanceCapacity) {
+        return;
+    }
+    var capacity = @max(self.instanceCapacity, INITIAL_INSTANCES);
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    for ([_]usize{ MODEL_BUFFER, PREV_MODEL_BUFFER }) |slot| {
+        if (self.instanceCapacity > 0) {
+            sg.destroyBuffer(self.state.bind.vertex_buffers[slot]);
+        }
+        self.state.bind.vertex_buffers[slot] = sg.makeBuffer(.{
+            .usage = .{ .vertex_buffer = true, .stream_update = true },
+            .size = capacity * @sizeOf(xr_linear.Matrix4x4f),
+        });
+    }
+    self.instanceCapacity = capacity;
+}
+
+// Upload the model matrices of this frame once, before the views are rendered. prev_models is
+// index aligned with cubes and only needed for renderVelocity.
+pub fn beginFrame(
+    self: *@This(),
+    cubes: []const geometry.Cube,
+    prev_models: ?[]const xr_linear.Matrix4x4f,
+) void {
+    self.models.resize(cubes.len) catch @panic("OOM");
+    geometry.Cube.modelMatrices(cubes, self.models.items);
+    self.instanceCount = cubes.len;
+    if (self.instanceCount == 0) {
+        return;
+    }
+
+    self.growInstanceBuffers(self.instanceCount);
+    sg.updateBuffer(self.state.bind.vertex_buffers[MODEL_BUFFER], sg.asRange(self.models.items));
+    if (prev_models) |prev| {
+        std.debug.assert(prev.len == self.instanceCount);
+        sg.updateBuffer(self.state.bind.vertex_buffers[PREV_MODEL_BUFFER], sg.asRange(prev));
+    }
+}
 
-        const new_attachments = sg.Attachments{
+// Submit every pass of the frame at once.
+pub fn endFrame(self: *@This()) void {
+    _ = self;
+    sg.commit();
+}
+
+// Render motion vectors and depth for XR_FB_space_warp, with the previous models passed to
+// beginFrame. The hands and scene meshes have no previous pose and go in with zero motion, so the
+// depth still covers everything the color pass draws.
+pub fn renderVelocity(
+    self: *@This(),
+    motion_vector: GraphicsPlugin.SwapchainTexture,
+    depth: GraphicsPlugin.SwapchainTexture,
+    width: i32,
+    height: i32,
+    vp: xr_linear.Matrix4x4f,
+) void {
+    sg.beginPass(.{
+        .action = .{
             .colors = .{
-                sg.makeView(.{ .color_attachment = .{ .image = color_img } }),
+                .{
+                    .load_action = .CLEAR,
+                    .clear_value = .{ .r = 0, .g = 0, .b = 0, .a = 0 },
+                },
                 .{},
                 .{},
                 .{},
             },
-            .depth_stencil = sg.makeView(.{ .depth_stencil_attachment = .{ .image = depth_img } }),
-        };
+        },
+        .attachments = self.getVelocityAttachment(motion_vector, depth, width, height),
+    });
 
-        self.imageMap.put(colorTexture, new_attachments) catch @panic("OOM");
+    if (self.instanceCount > 0) {
+        sg.applyPipeline(self.state.velocityPip);
+        sg.applyBindings(self.state.bind);
+        var velocity_params = shd.VelocityParams{
+            .vp = vp.m,
+        };
+        sg.applyUniforms(shd.UB_velocity_params, sg.asRange(&velocity_params));
+        sg.draw(0, 36, @intCast(self.instanceCount));
+    }
+    self.drawHands(self.state.handVelocityPip, vp);
+    self.drawSceneMeshes(self.state.sceneVelocityPip, vp);
 
-        break :blk new_attachments;
-    };
-    return attachments;
+    sg.endPass();
 }
 
+// Draw the cubes passed to beginFrame. depth is the depth swapchain image submitted with the layer,
+// null to use a pooled one.
 pub fn render(
     self: *@This(),
-    color_texture: u32,
+    color: GraphicsPlugin.SwapchainTexture,
+    depth: ?GraphicsPlugin.SwapchainTexture,
     viewport_width: i32,
     viewport_height: i32,
     clear_color: [4]f32,
     vp: xr_linear.Matrix4x4f,
-    cubes: []geometry.Cube,
 ) void {
     sg.beginPass(.{
         .action = .{
@@ -167,33 +611,76 @@ pub fn render(
             },
         },
         .attachments = self.getAttachment(
-            color_texture,
+            color,
+            depth,
             viewport_width,
             viewport_height,
         ),
     });
 
-    {
-        for (cubes) |cube| {
-            sg.applyPipeline(self.state.pip);
-            sg.applyBindings(self.state.bind);
-
-            const model = xr_linear.Matrix4x4f.createTranslationRotationScale(
-                cube.Pose.position,
-                cube.Pose.orientation,
-                cube.Scale,
-            );
-            const mvp = vp.multiply(model);
+    if (self.instanceCount > 0) {
+        sg.applyPipeline(self.state.pip);
+        sg.applyBindings(self.state.bind);
+        var vs_params = shd.VsParams{
+            .vp = vp.m,
+        };
+        sg.applyUniforms(shd.UB_vs_params, sg.asRange(&vs_params));
+        sg.draw(0, 36, @intCast(self.instanceCount));
+    }
+    self.drawHands(self.state.handPip, vp);
+    self.drawSceneMeshes(self.state.scenePip, vp);
 
-            var vs_params = shd.VsParams{
-                .mvp = mvp.m,
-            };
+    sg.endPass();
+}
 
-            sg.applyUniforms(shd.UB_vs_params, sg.asRange(&vs_params));
-            sg.draw(0, 36, 1);
+// One draw per hand with a loaded mesh and a skin, with handPip or handVelocityPip.
+fn drawHands(self: *const @This(), pip: sg.Pipeline, vp: xr_linear.Matrix4x4f) void {
+    var pipelineApplied = false;
+    for (self.state.handBind, self.state.handIndexCount, self.handSkins) |bind, indexCount, maybe_skin| {
+        const skin = maybe_skin orelse continue;
+        if (indexCount == 0) {
+            continue;
+        }
+        if (!pipelineApplied) {
+            sg.applyPipeline(pip);
+            pipelineApplied = true;
+        }
+        sg.applyBindings(bind);
+        var hand_params = shd.HandParams{
+            .vp = vp.m,
+        };
+        for (&hand_params.joints, skin) |*joint, matrix| {
+            joint.* = matrix.m;
         }
+        sg.applyUniforms(shd.UB_hand_params, sg.asRange(&hand_params));
+        sg.draw(0, @intCast(indexCount), 1);
     }
+}
 
-    sg.endPass();
-    sg.commit();
+// One draw per visible range of every uploaded and located mesh, with scenePip or
+// sceneVelocityPip.
+fn drawSceneMeshes(self: *@This(), pip: sg.Pipeline, vp: xr_linear.Matrix4x4f) void {
+    var pipelineApplied = false;
+    for (self.sceneMeshes) |mesh| {
+        if (mesh.vertexBuffer == 0 or mesh.pose == null) {
+            continue;
+        }
+        mesh.cull(vp, &self.sceneRanges) catch @panic("OOM");
+        if (self.sceneRanges.items.len == 0) {
+            continue;
+        }
+        if (!pipelineApplied) {
+            sg.applyPipeline(pip);
+            pipelineApplied = true;
+        }
+        sg.applyBindings(self.sceneBind(mesh));
+        var scene_params = shd.SceneParams{
+            .vp = vp.m,
+            .model = mesh.model.m,
+        };
+        sg.applyUniforms(shd.UB_scene_params, sg.asRange(&scene_params));
+        for (self.sceneRanges.items) |range| {
+            sg.draw(3 * range.first, 3 * range.count, 1);
+        }
+    }
 }
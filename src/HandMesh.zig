@@ -0,0 +1,114 @@
+// The runtime's skinned hand mesh from XR_FB_hand_tracking_mesh, read once per hand.
+//
+// The renderers upload vertices and indices to the GPU once and skin them in the vertex shader
+// with up to four joints per vertex. Per frame only the joint matrices change: the located joint
+// pose times the inverse bind pose, both in the space the joints were located in.
+const std = @import("std");
+const c = @import("c");
+const xr_gen = @import("openxr");
+const xr_result = @import("xr_result.zig");
+const xr_linear = @import("xr_linear.zig");
+const xr_util = @import("xr_util.zig");
+
+pub const EXTENSION_NAME = c.XR_FB_HAND_TRACKING_MESH_EXTENSION_NAME;
+
+pub const MAX_JOINTS = c.XR_HAND_JOINT_COUNT_EXT;
+
+pub const Vertex = extern struct {
+    position: c.XrVector3f,
+    normal: c.XrVector3f,
+    // Joint indices, unused slots have a zero weight.
+    joints: [4]i16,
+    weights: [4]f32,
+};
+
+pub const Skin = [MAX_JOINTS]xr_linear.Matrix4x4f;
+
+allocator: std.mem.Allocator,
+vertices: []Vertex,
+// Counter-clockwise triangles.
+indices: []u16,
+jointCount: usize,
+inverseBindPoses: Skin,
+
+pub fn load(
+    allocator: std.mem.Allocator,
+    ext: xr_gen.extensions.XR_FB_hand_tracking_mesh,
+    tracker: c.XrHandTrackerEXT,
+) !@This() {
+    var mesh = c.XrHandTrackingMeshFB{
+        .type = c.XR_TYPE_HAND_TRACKING_MESH_FB,
+    };
+    try xr_result.check(ext.xrGetHandMeshFB.?(tracker, &mesh));
+    try xr_util.assert(mesh.jointCountOutput <= MAX_JOINTS);
+
+    var bindPoses: [MAX_JOINTS]c.XrPosef = undefined;
+    var radii: [MAX_JOINTS]f32 = undefined;
+    var parents: [MAX_JOINTS]c.XrHandJointEXT = undefined;
+    const positions = try allocator.alloc(c.XrVector3f, mesh.vertexCountOutput);
+    defer allocator.free(positions);
+    const normals = try allocator.alloc(c.XrVector3f, mesh.vertexCountOutput);
+    defer allocator.free(normals);
+    const uvs = try allocator.alloc(c.XrVector2f, mesh.vertexCountOutput);
+    defer allocator.free(uvs);
+    const blendIndices = try allocator.alloc(c.XrVector4sFB, mesh.vertexCountOutput);
+    defer allocator.free(blendIndices);
+    const blendWeights = try allocator.alloc(c.XrVector4f, mesh.vertexCountOutput);
+    defer allocator.free(blendWeights);
+    const indices = try allocator.alloc(i16, mesh.indexCountOutput);
+    defer allocator.free(indices);
+
+    mesh.jointCapacityInput = mesh.jointCountOutput;
+    mesh.jointBindPoses = &bindPoses[0];
+    mesh.jointRadii = &radii[0];
+    mesh.jointParents = &parents[0];
+    mesh.vertexCapacityInput = mesh.vertexCountOutput;
+    mesh.vertexPositions = positions.ptr;
+    mesh.vertexNormals = normals.ptr;
+    mesh.vertexUVs = uvs.ptr;
+    mesh.vertexBlendIndices = blendIndices.ptr;
+    mesh.vertexBlendWeights = blendWeights.ptr;
+    mesh.indexCapacityInput = mesh.indexCountOutput;
+    mesh.indices = indices.ptr;
+    try xr_result.check(ext.xrGetHandMeshFB.?(tracker, &mesh));
+
+    var self = @This(){
+        .allocator = allocator,
+        .vertices = try allocator.alloc(Vertex, mesh.vertexCountOutput),
+        .indices = try allocator.alloc(u16, mesh.indexCountOutput),
+        .jointCount = mesh.jointCountOutput,
+        .inverseBindPoses = .{xr_linear.Matrix4x4f{}} ** MAX_JOINTS,
+    };
+    for (self.vertices, positions, normals, blendIndices, blendWeights) |*vertex, position, normal, joints, weights| {
+        vertex.* = .{
+            .position = position,
+            .normal = normal,
+            .joints = .{ joints.x, joints.y, joints.z, joints.w },
+            .weights = .{ weights.x, weights.y, weights.z, weights.w },
+        };
+    }
+    for (self.indices, indices) |*dst, src| {
+        dst.* = @bitCast(src);
+    }
+    for (self.inverseBindPoses[0..self.jointCount], bindPoses[0..self.jointCount]) |*inverse, pose| {
+        inverse.* = xr_linear.Matrix4x4f.createFromRigidTransform(pose).invertRigidBody();
+    }
+    std.log.info("hand mesh: {} joints, {} vertices, {} triangles", .{
+        self.jointCount,
+        self.vertices.len,
+        self.indices.len / 3,
+    });
+    return self;
+}
+
+pub fn deinit(self: *@This()) void {
+    self.allocator.free(self.vertices);
+    self.allocator.free(self.indices);
+}
+
+// Joint matrices for the located joints. Joints past the mesh's joint count stay identity.
+pub fn skin(self: @This(), joints: []const c.XrHandJointLocationEXT, out: *Skin) void {
+    for (out[0..self.jointCount], self.inverseBindPoses[0..self.jointCount], joints[0..self.jointCount]) |*matrix, inverse, joint| {
+        matrix.* = xr_linear.Matrix4x4f.createFromRigidTransform(joint.pose).multiplySimd(inverse);
+    }
+}
@@ -0,0 +1,198 @@
+// Locates both hands on a thread of its own, so xrLocateHandJointsEXT is off the render thread.
+//
+// The render loop requests the predicted display time of each frame right after xrWaitFrame. The
+// worker locates both hands for it, with XrHandJointVelocitiesEXT chained, and publishes the
+// result into one of two snapshot slots. Scene.update reads the newest snapshot without waiting:
+// usually the one for its own display time, otherwise an older one extrapolated along the joint
+// velocities. Slots carry a sequence number like InputSampler's ring, odd while written, and a
+// reader that sees it change while copying keeps its previous snapshot.
+const std = @import("std");
+const c = @import("c");
+const InputSampler = @import("InputSampler.zig");
+
+pub const JOINT_COUNT = c.XR_HAND_JOINT_COUNT_EXT;
+
+// Extrapolation is a straight line, which only holds for a frame or two.
+const MAX_EXTRAPOLATION = 50 * std.time.ns_per_ms;
+
+pub const Snapshot = struct {
+    time: i64 = 0,
+    active: [2]bool = .{ false, false },
+    joints: [2][JOINT_COUNT]c.XrHandJointLocationEXT = undefined,
+    velocities: [2][JOINT_COUNT]c.XrHandJointVelocityEXT = undefined,
+};
+
+const Slot = struct {
+    // 2 * index + 1 while snapshot index is written, 2 * index + 2 once it is complete.
+    seq: std.atomic.Value(u64) = .init(0),
+    snapshot: Snapshot = .{},
+};
+
+hands: InputSampler.HandTrackers,
+space: c.XrSpace,
+
+slots: [2]Slot = .{ .{}, .{} },
+// Number of snapshots published so far. Snapshot i lives in slots[i % 2].
+head: std.atomic.Value(u64) = .init(0),
+// Display time the worker locates for next.
+requested: std.atomic.Value(i64) = .init(0),
+wake: std.Thread.ResetEvent = .{},
+stop: std.atomic.Value(bool) = .init(false),
+thread: ?std.Thread = null,
+
+// Owned by the reader: the newest snapshot it has copied out.
+current: Snapshot = .{},
+currentIndex: ?u64 = null,
+
+// Heap allocated and started, since the thread holds a pointer to it.
+pub fn create(allocator: std.mem.Allocator, hands: InputSampler.HandTrackers, space: c.XrSpace) !*@This() {
+    const self = try allocator.create(@This());
+    errdefer allocator.destroy(self);
+    self.* = .{
+        .hands = hands,
+        .space = space,
+    };
+    self.thread = try std.Thread.spawn(.{}, run, .{self});
+    return self;
+}
+
+pub fn destroy(self: *@This(), allocator: std.mem.Allocator) void {
+    self.stop.store(true, .release);
+    self.wake.set();
+    if (self.thread) |thread| {
+        thread.join();
+    }
+    allocator.destroy(self);
+}
+
+// Call once per frame right after xrWaitFrame, as early as possible.
+pub fn request(self: *@This(), predictedDisplayTime: i64) void {
+    self.requested.store(predictedDisplayTime, .release);
+    self.wake.set();
+}
+
+// The joints of hand at time, into out. Null while the hand is not tracked or nothing has been
+// located yet. Never blocks.
+pub fn locate(
+    self: *@This(),
+    hand: usize,
+    time: i64,
+    out: *[JOINT_COUNT]c.XrHandJointLocationEXT,
+) ?[]c.XrHandJointLocationEXT {
+    self.refresh();
+    if (self.currentIndex == null or !self.current.active[hand]) {
+        return null;
+    }
+    const dt = std.math.clamp(time - self.current.time, 0, MAX_EXTRAPOLATION);
+    const seconds = @as(f32, @floatFromInt(dt)) / std.time.ns_per_s;
+    for (out, self.current.joints[hand], self.current.velocities[hand]) |*joint, location, velocity| {
+        joint.* = location;
+        if (dt > 0) {
+            extrapolate(&joint.pose, velocity, seconds);
+        }
+    }
+    return out;
+}
+
+// Copy the newest published snapshot, unless it is the one already held.
+fn refresh(self: *@This()) void {
+    const head = self.head.load(.acquire);
+    if (head == 0 or self.currentIndex == head - 1) {
+        return;
+    }
+    const index = head - 1;
+    const slot = &self.slots[index % 2];
+    const seq = slot.seq.load(.acquire);
+    if (seq != 2 * index + 2) {
+        return;
+    }
+    const snapshot = slot.snapshot;
+    // The acquire-release read-modify-write keeps the copy above from moving past the check.
+    if (slot.seq.fetchAdd(0, .acq_rel) != seq) {
+        return;
+    }
+    self.current = snapshot;
+    self.currentIndex = index;
+}
+
+fn run(self: *@This()) void {
+    var located: i64 = 0;
+    // Log an error once, not every frame.
+    var lastError: ?anyerror = null;
+    while (!self.stop.load(.acquire)) {
+        // The timeout only bounds how long a stop can go unnoticed.
+        self.wake.timedWait(100 * std.time.ns_per_ms) catch {};
+        self.wake.reset();
+        const time = self.requested.load(.acquire);
+        if (time == 0 or time == located) {
+            continue;
+        }
+        located = time;
+
+        const index = self.head.raw;
+        const slot = &self.slots[index % 2];
+        // A reader copying the snapshot this slot held before sees the odd value and drops it.
+        _ = slot.seq.swap(2 * index + 1, .acq_rel);
+        slot.snapshot.time = time;
+        for (0..2) |hand| {
+            slot.snapshot.active[hand] = self.locateHand(hand, time, &slot.snapshot) catch |e| blk: {
+                if (lastError != e) {
+                    std.log.warn("hand tracking service: {s}", .{@errorName(e)});
+                }
+                lastError = e;
+                break :blk false;
+            };
+        }
+        slot.seq.store(2 * index + 2, .release);
+        self.head.store(index + 1, .release);
+    }
+}
+
+fn locateHand(self: *@This(), hand: usize, time: i64, snapshot: *Snapshot) !bool {
+    const locateInfo = c.XrHandJointsLocateInfoEXT{
+        .type = c.XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT,
+        .baseSpace = self.space,
+        .time = time,
+    };
+    var velocities = c.XrHandJointVelocitiesEXT{
+        .type = c.XR_TYPE_HAND_JOINT_VELOCITIES_EXT,
+        .jointCount = JOINT_COUNT,
+        .jointVelocities = &snapshot.velocities[hand][0],
+    };
+    var locations = c.XrHandJointLocationsEXT{
+        .type = c.XR_TYPE_HAND_JOINT_LOCATIONS_EXT,
+        .next = &velocities,
+        .jointCount = JOINT_COUNT,
+        .jointLocations = &snapshot.joints[hand][0],
+    };
+    if (self.hands.ext.xrLocateHandJointsEXT.?(self.hands.trackers[hand], &locateInfo, &locations) != c.XR_SUCCESS) {
+        return error.xrLocateHandJointsEXT;
+    }
+    return locations.isActive != 0;
+}
+
+// Move pose along velocity for seconds. The angular velocity is in the base space, so the rotation
+// it makes is applied on the left.
+fn extrapolate(pose: *c.XrPosef, velocity: c.XrHandJointVelocityEXT, seconds: f32) void {
+    if ((velocity.velocityFlags & c.XR_SPACE_VELOCITY_LINEAR_VALID_BIT) != 0) {
+        pose.position.x += velocity.linearVelocity.x * seconds;
+        pose.position.y += velocity.linearVelocity.y * seconds;
+        pose.position.z += velocity.linearVelocity.z * seconds;
+    }
+    if ((velocity.velocityFlags & c.XR_SPACE_VELOCITY_ANGULAR_VALID_BIT) != 0) {
+        const w = velocity.angularVelocity;
+        const speed = @sqrt(w.x * w.x + w.y * w.y + w.z * w.z);
+        if (speed > 0) {
+            const half = 0.5 * speed * seconds;
+            const s = @sin(half) / speed;
+            const d = c.XrQuaternionf{ .x = w.x * s, .y = w.y * s, .z = w.z * s, .w = @cos(half) };
+            const q = pose.orientation;
+            pose.orientation = .{
+                .x = d.w * q.x + d.x * q.w + d.y * q.z - d.z * q.y,
+                .y = d.w * q.y - d.x * q.z + d.y * q.w + d.z * q.x,
+                .z = d.w * q.z + d.x * q.y - d.y * q.x + d.z * q.w,
+                .w = d.w * q.w - d.x * q.x - d.y * q.y - d.z * q.z,
+            };
+        }
+    }
+}
@@ -0,0 +1,325 @@
+// Samples actions, controller grip poses and hand palms on a thread of its own, at a fixed rate
+// well above the display rate, into a ring of timestamped samples.
+//
+// The thread owns xrSyncActions while it runs, so the render loop reads the grab state from the
+// latest sample instead of polling actions itself. Readers never block the sampler: every slot
+// carries a sequence number that is odd while the slot is written, and a reader that sees it
+// change while copying drops the sample. Time stamps are XrTime from the platform monotonic clock
+// through XR_KHR_convert_timespec_time or XR_KHR_win32_convert_performance_counter_time.
+const std = @import("std");
+const builtin = @import("builtin");
+const c = @import("c");
+const xr_gen = @import("openxr");
+const xr_result = @import("xr_result.zig");
+const xr_linear = @import("xr_linear.zig");
+const InputState = @import("InputState.zig");
+
+pub const CLOCK_EXTENSION_NAME = if (builtin.os.tag == .windows)
+    c.XR_KHR_WIN32_CONVERT_PERFORMANCE_COUNTER_TIME_EXTENSION_NAME
+else
+    c.XR_KHR_CONVERT_TIMESPEC_TIME_EXTENSION_NAME;
+
+// Two seconds of history at 500Hz.
+pub const CAPACITY = 1024;
+
+pub const Sample = struct {
+    time: i64,
+    // Grip pose action spaces in the base space, null while not tracked.
+    grip: [InputState.Side.COUNT]?c.XrPosef,
+    // Palm joint of the tracked hands, null while not tracked.
+    palm: [InputState.Side.COUNT]?c.XrPosef,
+    // Grab action value, null while the action is not active.
+    grab: [InputState.Side.COUNT]?f32,
+};
+
+pub const HandTrackers = struct {
+    ext: xr_gen.extensions.XR_EXT_hand_tracking,
+    trackers: [InputState.Side.COUNT]c.XrHandTrackerEXT,
+};
+
+const Slot = struct {
+    // 2 * index + 1 while sample index is written, 2 * index + 2 once it is complete.
+    seq: std.atomic.Value(u64) = .init(0),
+    sample: Sample = undefined,
+};
+
+const Clock = struct {
+    const ConvertFn = if (builtin.os.tag == .windows)
+        c.PFN_xrConvertWin32PerformanceCounterToTimeKHR
+    else
+        c.PFN_xrConvertTimespecTimeToTimeKHR;
+
+    convert: ConvertFn = null,
+
+    fn init(instance: c.XrInstance) !@This() {
+        var self = @This(){};
+        const name = if (builtin.os.tag == .windows)
+            "xrConvertWin32PerformanceCounterToTimeKHR"
+        else
+            "xrConvertTimespecTimeToTimeKHR";
+        try xr_result.check(c.xrGetInstanceProcAddr(instance, name, @ptrCast(&self.convert)));
+        return self;
+    }
+
+    fn now(self: @This(), instance: c.XrInstance) !i64 {
+        var time: c.XrTime = 0;
+        if (builtin.os.tag == .windows) {
+            var counter: c.LARGE_INTEGER = undefined;
+            _ = c.QueryPerformanceCounter(&counter);
+            try xr_result.check(self.convert.?(instance, &counter, &time));
+        } else {
+            var ts: c.struct_timespec = undefined;
+            _ = c.clock_gettime(c.CLOCK_MONOTONIC, &ts);
+            try xr_result.check(self.convert.?(instance, &ts, &time));
+        }
+        return time;
+    }
+};
+
+instance: c.XrInstance,
+session: c.XrSession,
+input: *const InputState,
+space: c.XrSpace,
+hands: ?HandTrackers,
+clock: Clock,
+period: u64,
+joints: [c.XR_HAND_JOINT_COUNT_EXT]c.XrHandJointLocationEXT = undefined,
+
+slots: [CAPACITY]Slot = .{Slot{}} ** CAPACITY,
+// Number of samples written so far. Sample i lives in slots[i % CAPACITY].
+head: std.atomic.Value(u64) = .init(0),
+stop: std.atomic.Value(bool) = .init(false),
+thread: ?std.Thread = null,
+
+// Poses are sampled in space. input must have its actions initialized and outlive the sampler.
+pub fn init(
+    instance: c.XrInstance,
+    session: c.XrSession,
+    input: *const InputState,
+    space: c.XrSpace,
+    hands: ?HandTrackers,
+    rate: u32,
+) !@This() {
+    return .{
+        .instance = instance,
+        .session = session,
+        .input = input,
+        .space = space,
+        .hands = hands,
+        .clock = try Clock.init(instance),
+        .period = std.time.ns_per_s / @max(rate, 1),
+    };
+}
+
+// Heap allocated and started, since the ring is large and the thread holds a pointer to it.
+pub fn create(
+    allocator: std.mem.Allocator,
+    instance: c.XrInstance,
+    session: c.XrSession,
+    input: *const InputState,
+    space: c.XrSpace,
+    hands: ?HandTrackers,
+    rate: u32,
+) !*@This() {
+    const self = try allocator.create(@This());
+    errdefer allocator.destroy(self);
+    self.* = try init(instance, session, input, space, hands, rate);
+    try self.start();
+    return self;
+}
+
+pub fn destroy(self: *@This(), allocator: std.mem.Allocator) void {
+    self.deinit();
+    allocator.destroy(self);
+}
+
+// The sampler is referenced by its thread, so it must not move until stop.
+pub fn start(self: *@This()) !void {
+    std.log.info("input sampler: {d}Hz", .{std.time.ns_per_s / self.period});
+    self.stop.store(false, .release);
+    self.thread = try std.Thread.spawn(.{}, run, .{self});
+}
+
+pub fn deinit(self: *@This()) void {
+    self.stop.store(true, .release);
+    if (self.thread) |thread| {
+        thread.join();
+        self.thread = null;
+    }
+}
+
+// The newest complete sample.
+pub fn latest(self: *const @This()) ?Sample {
+    const head = self.head.load(.acquire);
+    return if (head == 0) null else self.read(head - 1);
+}
+
+// Grab state for the render loop from the newest sample, in place of InputState.pollActions.
+pub fn updateInput(self: *const @This(), input: *InputState) void {
+    const sample = self.latest() orelse return;
+    for (0..InputState.Side.COUNT) |hand| {
+        if (sample.grab[hand]) |grab| {
+            input.setGrab(hand, grab);
+        }
+        input.handActive[hand] = if (sample.grip[hand] != null) c.XR_TRUE else c.XR_FALSE;
+    }
+}
+
+// Interpolated between the two samples around time. Newer than the newest sample returns the
+// newest, older than the retained history returns null.
+pub fn sampleAt(self: *const @This(), time: i64) ?Sample {
+    const head = self.head.load(.acquire);
+    if (head == 0) {
+        return null;
+    }
+    var newer = self.read(head - 1) orelse return null;
+    if (newer.time <= time) {
+        return newer;
+    }
+    var i = head - 1;
+    while (i > 0 and head - i < CAPACITY) {
+        i -= 1;
+        const older = self.read(i) orelse return null;
+        if (older.time <= time) {
+            const fraction = @as(f32, @floatFromInt(time - older.time)) /
+                @as(f32, @floatFromInt(newer.time - older.time));
+            return lerp(older, newer, fraction);
+        }
+        newer = older;
+    }
+    return null;
+}
+
+// Copy the samples written since cursor into out, oldest first, and advance cursor past them.
+// Samples that were overwritten before the call are skipped. Each reader keeps its own cursor.
+pub fn drain(self: *const @This(), cursor: *u64, out: []Sample) []Sample {
+    const head = self.head.load(.acquire);
+    if (head > CAPACITY and cursor.* < head - CAPACITY) {
+        cursor.* = head - CAPACITY;
+    }
+    var count: usize = 0;
+    while (cursor.* < head and count < out.len) : (cursor.* += 1) {
+        if (self.read(cursor.*)) |sample| {
+            out[count] = sample;
+            count += 1;
+        }
+    }
+    return out[0..count];
+}
+
+fn read(self: *const @This(), index: u64) ?Sample {
+    const slot = &self.slots[index % CAPACITY];
+    const seq = slot.seq.load(.acquire);
+    if (seq != 2 * index + 2) {
+        return null;
+    }
+    const sample = slot.sample;
+    // The acquire-release read-modify-write keeps the copy above from moving past the check.
+    const slot_mut: *Slot = @constCast(slot);
+    if (slot_mut.seq.fetchAdd(0, .acq_rel) != seq) {
+        return null;
+    }
+    return sample;
+}
+
+fn push(self: *@This(), sample: Sample) void {
+    const index = self.head.raw;
+    const slot = &self.slots[index % CAPACITY];
+    // Readers of the sample this slot held before see the odd value and drop their copy.
+    _ = slot.seq.swap(2 * index + 1, .acq_rel);
+    slot.sample = sample;
+    slot.seq.store(2 * index + 2, .release);
+    self.head.store(index + 1, .release);
+}
+
+fn run(self: *@This()) void {
+    // Log an error once, not at the sample rate.
+    var lastError: ?anyerror = null;
+    while (!self.stop.load(.acquire)) {
+        const begin = std.time.Instant.now() catch return;
+        if (self.takeSample()) |s| {
+            self.push(s);
+            lastError = null;
+        } else |e| {
+            if (lastError != e) {
+                std.log.warn("input sampler: {s}", .{@errorName(e)});
+            }
+            lastError = e;
+        }
+
+        const end = std.time.Instant.now() catch return;
+        const elapsed = end.since(begin);
+        if (elapsed < self.period) {
+            std.Thread.sleep(self.period - elapsed);
+        }
+    }
+}
+
+fn takeSample(self: *@This()) !Sample {
+    var s = Sample{
+        .time = try self.clock.now(self.instance),
+        .grip = .{ null, null },
+        .palm = .{ null, null },
+        .grab = .{ null, null },
+    };
+
+    try self.input.syncActions(self.session);
+    for (0..InputState.Side.COUNT) |hand| {
+        s.grab[hand] = try self.input.getGrab(self.session, hand);
+
+        var spaceLocation = c.XrSpaceLocation{
+            .type = c.XR_TYPE_SPACE_LOCATION,
+        };
+        const res = c.xrLocateSpace(self.input.handSpace[hand], self.space, s.time, &spaceLocation);
+        if (c.XR_UNQUALIFIED_SUCCESS(res) and isPoseValid(spaceLocation.locationFlags)) {
+            s.grip[hand] = spaceLocation.pose;
+        }
+
+        if (self.hands) |hands| {
+            s.palm[hand] = self.locatePalm(hands, hand, s.time);
+        }
+    }
+    return s;
+}
+
+fn locatePalm(self: *@This(), hands: HandTrackers, hand: usize, time: i64) ?c.XrPosef {
+    const locateInfo = c.XrHandJointsLocateInfoEXT{
+        .type = c.XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT,
+        .baseSpace = self.space,
+        .time = time,
+    };
+    var locations = c.XrHandJointLocationsEXT{
+        .type = c.XR_TYPE_HAND_JOINT_LOCATIONS_EXT,
+        .jointCount = @intCast(self.joints.len),
+        .jointLocations = &self.joints[0],
+    };
+    if (hands.ext.xrLocateHandJointsEXT.?(hands.trackers[hand], &locateInfo, &locations) != 0 or
+        locations.isActive == 0)
+    {
+        return null;
+    }
+    const palm = self.joints[c.XR_HAND_JOINT_PALM_EXT];
+    return if (isPoseValid(palm.locationFlags)) palm.pose else null;
+}
+
+fn isPoseValid(flags: c.XrSpaceLocationFlags) bool {
+    return (flags & c.XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 and
+        (flags & c.XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0;
+}
+
+fn lerp(a: Sample, b: Sample, fraction: f32) Sample {
+    var s = b;
+    s.time = a.time + @as(i64, @intFromFloat(fraction * @as(f32, @floatFromInt(b.time - a.time))));
+    for (0..InputState.Side.COUNT) |hand| {
+        if (a.grip[hand] != null and b.grip[hand] != null) {
+            s.grip[hand] = xr_linear.posefLerp(a.grip[hand].?, b.grip[hand].?, fraction);
+        }
+        if (a.palm[hand] != null and b.palm[hand] != null) {
+            s.palm[hand] = xr_linear.posefLerp(a.palm[hand].?, b.palm[hand].?, fraction);
+        }
+        if (a.grab[hand] != null and b.grab[hand] != null) {
+            s.grab[hand] = a.grab[hand].? + fraction * (b.grab[hand].? - a.grab[hand].?);
+        }
+    }
+    return s;
+}
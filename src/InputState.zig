@@ -1,203 +1,181 @@
+const std = @import("std");
 const c = @import("c");
 const xr_result = @import("xr_result.zig");
 
+pub const Side = struct {
+    pub const LEFT = 0;
+    pub const RIGHT = 1;
+    pub const COUNT = 2;
+};
+
 actionSet: c.XrActionSet = null,
-// XrAction grabAction{XR_NULL_HANDLE};
-// XrAction poseAction{XR_NULL_HANDLE};
-// XrAction vibrateAction{XR_NULL_HANDLE};
-// XrAction quitAction{XR_NULL_HANDLE};
-// std::array<XrPath, Side::COUNT> handSubactionPath;
-handSpace: [2]c.XrSpace = .{ null, null },
-handScale: [2]f32 = .{ 1.0, 1.0 },
-handActive: [2]c.XrBool32 = .{ c.XR_FALSE, c.XR_FALSE },
-
-pub fn initializeActions(self: *@This()) !void {
+grabAction: c.XrAction = null,
+poseAction: c.XrAction = null,
+handSubactionPath: [Side.COUNT]c.XrPath = .{ c.XR_NULL_PATH, c.XR_NULL_PATH },
+handSpace: [Side.COUNT]c.XrSpace = .{ null, null },
+handScale: [Side.COUNT]f32 = .{ 1.0, 1.0 },
+handActive: [Side.COUNT]c.XrBool32 = .{ c.XR_FALSE, c.XR_FALSE },
+
+pub fn initializeActions(self: *@This(), instance: c.XrInstance, session: c.XrSession) !void {
     // Create an action set.
     {
         var actionSetInfo = c.XrActionSetCreateInfo{
             .type = c.XR_TYPE_ACTION_SET_CREATE_INFO,
             .priority = 0,
         };
-        //     strcpy_s(actionSetInfo.actionSetName, "gameplay");
-        //     strcpy_s(actionSetInfo.localizedActionSetName, "Gameplay");
-        try xr_result.check(c.xrCreateActionSet(self.instance, &actionSetInfo, &self.input.actionSet));
+        copyName(&actionSetInfo.actionSetName, "gameplay");
+        copyName(&actionSetInfo.localizedActionSetName, "Gameplay");
+        try xr_result.check(c.xrCreateActionSet(instance, &actionSetInfo, &self.actionSet));
     }
 
-    // // Get the XrPath for the left and right hands - we will use them as subaction paths.
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left", &m_input.handSubactionPath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right", &m_input.handSubactionPath[Side::RIGHT]));
-    //
-    // // Create actions.
-    // {
-    //     // Create an input action for grabbing objects with the left and right hands.
-    //     XrActionCreateInfo actionInfo{XR_TYPE_ACTION_CREATE_INFO};
-    //     actionInfo.actionType = XR_ACTION_TYPE_FLOAT_INPUT;
-    //     strcpy_s(actionInfo.actionName, "grab_object");
-    //     strcpy_s(actionInfo.localizedActionName, "Grab Object");
-    //     actionInfo.countSubactionPaths = uint32_t(m_input.handSubactionPath.size());
-    //     actionInfo.subactionPaths = m_input.handSubactionPath.data();
-    //     xr_result.check(xrCreateAction(m_input.actionSet, &actionInfo, &m_input.grabAction));
-    //
-    //     // Create an input action getting the left and right hand poses.
-    //     actionInfo.actionType = XR_ACTION_TYPE_POSE_INPUT;
-    //     strcpy_s(actionInfo.actionName, "hand_pose");
-    //     strcpy_s(actionInfo.localizedActionName, "Hand Pose");
-    //     actionInfo.countSubactionPaths = uint32_t(m_input.handSubactionPath.size());
-    //     actionInfo.subactionPaths = m_input.handSubactionPath.data();
-    //     xr_result.check(xrCreateAction(m_input.actionSet, &actionInfo, &m_input.poseAction));
-    //
-    //     // Create output actions for vibrating the left and right controller.
-    //     actionInfo.actionType = XR_ACTION_TYPE_VIBRATION_OUTPUT;
-    //     strcpy_s(actionInfo.actionName, "vibrate_hand");
-    //     strcpy_s(actionInfo.localizedActionName, "Vibrate Hand");
-    //     actionInfo.countSubactionPaths = uint32_t(m_input.handSubactionPath.size());
-    //     actionInfo.subactionPaths = m_input.handSubactionPath.data();
-    //     xr_result.check(xrCreateAction(m_input.actionSet, &actionInfo, &m_input.vibrateAction));
-    //
-    //     // Create input actions for quitting the session using the left and right controller.
-    //     // Since it doesn't matter which hand did this, we do not specify subaction paths for it.
-    //     // We will just suggest bindings for both hands, where possible.
-    //     actionInfo.actionType = XR_ACTION_TYPE_BOOLEAN_INPUT;
-    //     strcpy_s(actionInfo.actionName, "quit_session");
-    //     strcpy_s(actionInfo.localizedActionName, "Quit Session");
-    //     actionInfo.countSubactionPaths = 0;
-    //     actionInfo.subactionPaths = nullptr;
-    //     xr_result.check(xrCreateAction(m_input.actionSet, &actionInfo, &m_input.quitAction));
-    // }
-    //
-    // std::array<XrPath, Side::COUNT> selectPath;
-    // std::array<XrPath, Side::COUNT> squeezeValuePath;
-    // std::array<XrPath, Side::COUNT> squeezeForcePath;
-    // std::array<XrPath, Side::COUNT> squeezeClickPath;
-    // std::array<XrPath, Side::COUNT> posePath;
-    // std::array<XrPath, Side::COUNT> hapticPath;
-    // std::array<XrPath, Side::COUNT> menuClickPath;
-    // std::array<XrPath, Side::COUNT> bClickPath;
-    // std::array<XrPath, Side::COUNT> triggerValuePath;
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/select/click", &selectPath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/select/click", &selectPath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/squeeze/value", &squeezeValuePath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/squeeze/value", &squeezeValuePath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/squeeze/force", &squeezeForcePath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/squeeze/force", &squeezeForcePath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/squeeze/click", &squeezeClickPath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/squeeze/click", &squeezeClickPath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/grip/pose", &posePath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/grip/pose", &posePath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/output/haptic", &hapticPath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/output/haptic", &hapticPath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/menu/click", &menuClickPath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/menu/click", &menuClickPath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/b/click", &bClickPath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/b/click", &bClickPath[Side::RIGHT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/left/input/trigger/value", &triggerValuePath[Side::LEFT]));
-    // xr_result.check(xrStringToPath(m_instance, "/user/hand/right/input/trigger/value", &triggerValuePath[Side::RIGHT]));
-    // // Suggest bindings for KHR Simple.
-    // {
-    //     XrPath khrSimpleInteractionProfilePath;
-    //     xr_result.check(xrStringToPath(m_instance, "/interaction_profiles/khr/simple_controller", &khrSimpleInteractionProfilePath));
-    //     std::vector<XrActionSuggestedBinding> bindings{{// Fall back to a click input for the grab action.
-    //                                                     {m_input.grabAction, selectPath[Side::LEFT]},
-    //                                                     {m_input.grabAction, selectPath[Side::RIGHT]},
-    //                                                     {m_input.poseAction, posePath[Side::LEFT]},
-    //                                                     {m_input.poseAction, posePath[Side::RIGHT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::LEFT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::RIGHT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::LEFT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::RIGHT]}}};
-    //     XrInteractionProfileSuggestedBinding suggestedBindings{XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING};
-    //     suggestedBindings.interactionProfile = khrSimpleInteractionProfilePath;
-    //     suggestedBindings.suggestedBindings = bindings.data();
-    //     suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
-    //     xr_result.check(xrSuggestInteractionProfileBindings(m_instance, &suggestedBindings));
-    // }
-    // // Suggest bindings for the Oculus Touch.
-    // {
-    //     XrPath oculusTouchInteractionProfilePath;
-    //     xr_result.check(
-    //         xrStringToPath(m_instance, "/interaction_profiles/oculus/touch_controller", &oculusTouchInteractionProfilePath));
-    //     std::vector<XrActionSuggestedBinding> bindings{{{m_input.grabAction, squeezeValuePath[Side::LEFT]},
-    //                                                     {m_input.grabAction, squeezeValuePath[Side::RIGHT]},
-    //                                                     {m_input.poseAction, posePath[Side::LEFT]},
-    //                                                     {m_input.poseAction, posePath[Side::RIGHT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::LEFT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::LEFT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::RIGHT]}}};
-    //     XrInteractionProfileSuggestedBinding suggestedBindings{XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING};
-    //     suggestedBindings.interactionProfile = oculusTouchInteractionProfilePath;
-    //     suggestedBindings.suggestedBindings = bindings.data();
-    //     suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
-    //     xr_result.check(xrSuggestInteractionProfileBindings(m_instance, &suggestedBindings));
-    // }
-    // // Suggest bindings for the Vive Controller.
-    // {
-    //     XrPath viveControllerInteractionProfilePath;
-    //     xr_result.check(xrStringToPath(m_instance, "/interaction_profiles/htc/vive_controller", &viveControllerInteractionProfilePath));
-    //     std::vector<XrActionSuggestedBinding> bindings{{{m_input.grabAction, triggerValuePath[Side::LEFT]},
-    //                                                     {m_input.grabAction, triggerValuePath[Side::RIGHT]},
-    //                                                     {m_input.poseAction, posePath[Side::LEFT]},
-    //                                                     {m_input.poseAction, posePath[Side::RIGHT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::LEFT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::RIGHT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::LEFT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::RIGHT]}}};
-    //     XrInteractionProfileSuggestedBinding suggestedBindings{XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING};
-    //     suggestedBindings.interactionProfile = viveControllerInteractionProfilePath;
-    //     suggestedBindings.suggestedBindings = bindings.data();
-    //     suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
-    //     xr_result.check(xrSuggestInteractionProfileBindings(m_instance, &suggestedBindings));
-    // }
-    //
-    // // Suggest bindings for the Valve Index Controller.
-    // {
-    //     XrPath indexControllerInteractionProfilePath;
-    //     xr_result.check(
-    //         xrStringToPath(m_instance, "/interaction_profiles/valve/index_controller", &indexControllerInteractionProfilePath));
-    //     std::vector<XrActionSuggestedBinding> bindings{{{m_input.grabAction, squeezeForcePath[Side::LEFT]},
-    //                                                     {m_input.grabAction, squeezeForcePath[Side::RIGHT]},
-    //                                                     {m_input.poseAction, posePath[Side::LEFT]},
-    //                                                     {m_input.poseAction, posePath[Side::RIGHT]},
-    //                                                     {m_input.quitAction, bClickPath[Side::LEFT]},
-    //                                                     {m_input.quitAction, bClickPath[Side::RIGHT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::LEFT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::RIGHT]}}};
-    //     XrInteractionProfileSuggestedBinding suggestedBindings{XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING};
-    //     suggestedBindings.interactionProfile = indexControllerInteractionProfilePath;
-    //     suggestedBindings.suggestedBindings = bindings.data();
-    //     suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
-    //     xr_result.check(xrSuggestInteractionProfileBindings(m_instance, &suggestedBindings));
-    // }
-    //
-    // // Suggest bindings for the Microsoft Mixed Reality Motion Controller.
-    // {
-    //     XrPath microsoftMixedRealityInteractionProfilePath;
-    //     xr_result.check(xrStringToPath(m_instance, "/interaction_profiles/microsoft/motion_controller",
-    //                                &microsoftMixedRealityInteractionProfilePath));
-    //     std::vector<XrActionSuggestedBinding> bindings{{{m_input.grabAction, squeezeClickPath[Side::LEFT]},
-    //                                                     {m_input.grabAction, squeezeClickPath[Side::RIGHT]},
-    //                                                     {m_input.poseAction, posePath[Side::LEFT]},
-    //                                                     {m_input.poseAction, posePath[Side::RIGHT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::LEFT]},
-    //                                                     {m_input.quitAction, menuClickPath[Side::RIGHT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::LEFT]},
-    //                                                     {m_input.vibrateAction, hapticPath[Side::RIGHT]}}};
-    //     XrInteractionProfileSuggestedBinding suggestedBindings{XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING};
-    //     suggestedBindings.interactionProfile = microsoftMixedRealityInteractionProfilePath;
-    //     suggestedBindings.suggestedBindings = bindings.data();
-    //     suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
-    //     xr_result.check(xrSuggestInteractionProfileBindings(m_instance, &suggestedBindings));
-    // }
-    // XrActionSpaceCreateInfo actionSpaceInfo{XR_TYPE_ACTION_SPACE_CREATE_INFO};
-    // actionSpaceInfo.action = m_input.poseAction;
-    // actionSpaceInfo.poseInActionSpace.orientation.w = 1.f;
-    // actionSpaceInfo.subactionPath = m_input.handSubactionPath[Side::LEFT];
-    // xr_result.check(xrCreateActionSpace(m_session, &actionSpaceInfo, &m_input.handSpace[Side::LEFT]));
-    // actionSpaceInfo.subactionPath = m_input.handSubactionPath[Side::RIGHT];
-    // xr_result.check(xrCreateActionSpace(m_session, &actionSpaceInfo, &m_input.handSpace[Side::RIGHT]));
-    //
-    // XrSessionActionSetsAttachInfo attachInfo{XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO};
-    // attachInfo.countActionSets = 1;
-    // attachInfo.actionSets = &m_input.actionSet;
-    // xr_result.check(xrAttachSessionActionSets(m_session, &attachInfo));
+    // Get the XrPath for the left and right hands - we will use them as subaction paths.
+    self.handSubactionPath[Side.LEFT] = try stringToPath(instance, "/user/hand/left");
+    self.handSubactionPath[Side.RIGHT] = try stringToPath(instance, "/user/hand/right");
+
+    // Create actions.
+    {
+        // Create an input action for grabbing objects with the left and right hands.
+        var actionInfo = c.XrActionCreateInfo{
+            .type = c.XR_TYPE_ACTION_CREATE_INFO,
+            .actionType = c.XR_ACTION_TYPE_FLOAT_INPUT,
+            .countSubactionPaths = Side.COUNT,
+            .subactionPaths = &self.handSubactionPath[0],
+        };
+        copyName(&actionInfo.actionName, "grab_object");
+        copyName(&actionInfo.localizedActionName, "Grab Object");
+        try xr_result.check(c.xrCreateAction(self.actionSet, &actionInfo, &self.grabAction));
+
+        // Create an input action getting the left and right hand poses.
+        actionInfo.actionType = c.XR_ACTION_TYPE_POSE_INPUT;
+        copyName(&actionInfo.actionName, "hand_pose");
+        copyName(&actionInfo.localizedActionName, "Hand Pose");
+        try xr_result.check(c.xrCreateAction(self.actionSet, &actionInfo, &self.poseAction));
+    }
+
+    // Suggest bindings per interaction profile, with the grab input each controller has.
+    const Profile = struct {
+        path: [:0]const u8,
+        grab: [:0]const u8,
+    };
+    const profiles = [_]Profile{
+        // Fall back to a click input for the grab action.
+        .{ .path = "/interaction_profiles/khr/simple_controller", .grab = "select/click" },
+        .{ .path = "/interaction_profiles/oculus/touch_controller", .grab = "squeeze/value" },
+        .{ .path = "/interaction_profiles/htc/vive_controller", .grab = "trigger/value" },
+        .{ .path = "/interaction_profiles/valve/index_controller", .grab = "squeeze/force" },
+        .{ .path = "/interaction_profiles/microsoft/motion_controller", .grab = "squeeze/click" },
+    };
+    inline for (profiles) |profile| {
+        const bindings = [_]c.XrActionSuggestedBinding{
+            .{ .action = self.grabAction, .binding = try stringToPath(instance, "/user/hand/left/input/" ++ profile.grab) },
+            .{ .action = self.grabAction, .binding = try stringToPath(instance, "/user/hand/right/input/" ++ profile.grab) },
+            .{ .action = self.poseAction, .binding = try stringToPath(instance, "/user/hand/left/input/grip/pose") },
+            .{ .action = self.poseAction, .binding = try stringToPath(instance, "/user/hand/right/input/grip/pose") },
+        };
+        const suggestedBindings = c.XrInteractionProfileSuggestedBinding{
+            .type = c.XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING,
+            .interactionProfile = try stringToPath(instance, profile.path),
+            .suggestedBindings = &bindings[0],
+            .countSuggestedBindings = bindings.len,
+        };
+        // A runtime may not know every profile, which does not keep the others from binding.
+        xr_result.check(c.xrSuggestInteractionProfileBindings(instance, &suggestedBindings)) catch |e| {
+            std.log.warn("xrSuggestInteractionProfileBindings {s}: {s}", .{ profile.path, @errorName(e) });
+        };
+    }
+
+    for (0..Side.COUNT) |hand| {
+        const actionSpaceInfo = c.XrActionSpaceCreateInfo{
+            .type = c.XR_TYPE_ACTION_SPACE_CREATE_INFO,
+            .action = self.poseAction,
+            .subactionPath = self.handSubactionPath[hand],
+            .poseInActionSpace = .{
+                .orientation = .{ .x = 0, .y = 0, .z = 0, .w = 1 },
+                .position = .{ .x = 0, .y = 0, .z = 0 },
+            },
+        };
+        try xr_result.check(c.xrCreateActionSpace(session, &actionSpaceInfo, &self.handSpace[hand]));
+    }
+
+    const attachInfo = c.XrSessionActionSetsAttachInfo{
+        .type = c.XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO,
+        .countActionSets = 1,
+        .actionSets = &self.actionSet,
+    };
+    try xr_result.check(c.xrAttachSessionActionSets(session, &attachInfo));
 }
 
+// Destroys the actions and their spaces with it.
+pub fn deinit(self: *@This()) void {
+    if (self.actionSet != null) {
+        _ = c.xrDestroyActionSet(self.actionSet);
+    }
+    self.* = .{};
+}
+
+pub fn syncActions(self: @This(), session: c.XrSession) !void {
+    const activeActionSet = c.XrActiveActionSet{
+        .actionSet = self.actionSet,
+        .subactionPath = c.XR_NULL_PATH,
+    };
+    const syncInfo = c.XrActionsSyncInfo{
+        .type = c.XR_TYPE_ACTIONS_SYNC_INFO,
+        .countActiveActionSets = 1,
+        .activeActionSets = &activeActionSet,
+    };
+    try xr_result.check(c.xrSyncActions(session, &syncInfo));
+}
+
+// Grab value of a hand, null while the action is not active.
+pub fn getGrab(self: @This(), session: c.XrSession, hand: usize) !?f32 {
+    const getInfo = c.XrActionStateGetInfo{
+        .type = c.XR_TYPE_ACTION_STATE_GET_INFO,
+        .action = self.grabAction,
+        .subactionPath = self.handSubactionPath[hand],
+    };
+    var grabValue = c.XrActionStateFloat{
+        .type = c.XR_TYPE_ACTION_STATE_FLOAT,
+    };
+    try xr_result.check(c.xrGetActionStateFloat(session, &getInfo, &grabValue));
+    return if (grabValue.isActive == c.XR_TRUE) grabValue.currentState else null;
+}
+
+pub fn isPoseActive(self: @This(), session: c.XrSession, hand: usize) !bool {
+    const getInfo = c.XrActionStateGetInfo{
+        .type = c.XR_TYPE_ACTION_STATE_GET_INFO,
+        .action = self.poseAction,
+        .subactionPath = self.handSubactionPath[hand],
+    };
+    var poseState = c.XrActionStatePose{
+        .type = c.XR_TYPE_ACTION_STATE_POSE,
+    };
+    try xr_result.check(c.xrGetActionStatePose(session, &getInfo, &poseState));
+    return poseState.isActive == c.XR_TRUE;
+}
+
+// Once per frame from the render loop, when no InputSampler owns the action sync.
+pub fn pollActions(self: *@This(), session: c.XrSession) !void {
+    try self.syncActions(session);
+    for (0..Side.COUNT) |hand| {
+        if (try self.getGrab(session, hand)) |grab| {
+            self.setGrab(hand, grab);
+        }
+        self.handActive[hand] = if (try self.isPoseActive(session, hand)) c.XR_TRUE else c.XR_FALSE;
+    }
+}
+
+// Scale the rendered hand by 1.0 (open) to 0.5 (fully squeezed).
+pub fn setGrab(self: *@This(), hand: usize, grab: f32) void {
+    self.handScale[hand] = 1.0 - 0.5 * grab;
+}
+
+fn stringToPath(instance: c.XrInstance, str: [:0]const u8) !c.XrPath {
+    var path: c.XrPath = c.XR_NULL_PATH;
+    try xr_result.check(c.xrStringToPath(instance, str.ptr, &path));
+    return path;
+}
+
+fn copyName(dst: []u8, src: []const u8) void {
+    @memset(dst, 0);
+    @memcpy(dst[0..src.len], src);
+}
@@ -0,0 +1,103 @@
+// Late-latched poses for the GL renderer.
+//
+// Draws are recorded against a small persistently mapped uniform buffer instead of baked
+// matrices. Right before the swapchain image is released, the views and hand spaces are located
+// again for the same predicted display time and the slot is overwritten, so the GPU reads poses
+// that are a full recording time fresher.
+const std = @import("std");
+const c = @import("c");
+const xr_linear = @import("xr_linear.zig");
+const geometry = @import("geometry.zig");
+
+// std140 layout of the LatePoses uniform block.
+pub const Block = extern struct {
+    viewProjection: [16]f32,
+    // Correction on top of the recorded model matrix, indexed by geometry.Attachment.
+    attachment: [ATTACHMENT_COUNT][16]f32,
+
+    pub fn init(vp: xr_linear.Matrix4x4f, hands: [2]xr_linear.Matrix4x4f) @This() {
+        const identity = xr_linear.Matrix4x4f{};
+        return .{
+            .viewProjection = vp.m,
+            .attachment = .{ identity.m, hands[0].m, hands[1].m },
+        };
+    }
+};
+
+pub const ATTACHMENT_COUNT = @typeInfo(geometry.Attachment).@"enum".fields.len;
+
+// Three frames in flight, two views each. A slot is only rewritten once its fence has signaled.
+const SLOT_COUNT = 3 * 2;
+
+buffer: c.GLuint = 0,
+mapped: [*]u8 = undefined,
+stride: usize = 0,
+fences: [SLOT_COUNT]c.GLsync = .{null} ** SLOT_COUNT,
+next: usize = 0,
+
+pub fn init() @This() {
+    var self = @This(){};
+
+    var alignment: c.GLint = 0;
+    c.glGetIntegerv(c.GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    self.stride = std.mem.alignForward(usize, @sizeOf(Block), @intCast(@max(alignment, 1)));
+
+    // Coherent, so writes land without a flush while the recorded draws are still queued.
+    const flags = c.GL_MAP_WRITE_BIT | c.GL_MAP_PERSISTENT_BIT | c.GL_MAP_COHERENT_BIT;
+    const size: c.GLsizeiptr = @intCast(self.stride * SLOT_COUNT);
+    c.glGenBuffers(1, &self.buffer);
+    c.glBindBuffer(c.GL_UNIFORM_BUFFER, self.buffer);
+    c.glBufferStorage(c.GL_UNIFORM_BUFFER, size, null, flags);
+    self.mapped = @ptrCast(c.glMapBufferRange(c.GL_UNIFORM_BUFFER, 0, size, flags));
+    c.glBindBuffer(c.GL_UNIFORM_BUFFER, 0);
+
+    return self;
+}
+
+pub fn deinit(self: *@This()) void {
+    for (&self.fences) |*sync| {
+        if (sync.* != null) {
+            c.glDeleteSync(sync.*);
+            sync.* = null;
+        }
+    }
+    if (self.buffer != 0) {
+        c.glBindBuffer(c.GL_UNIFORM_BUFFER, self.buffer);
+        _ = c.glUnmapBuffer(c.GL_UNIFORM_BUFFER);
+        c.glBindBuffer(c.GL_UNIFORM_BUFFER, 0);
+        c.glDeleteBuffers(1, &self.buffer);
+        self.buffer = 0;
+    }
+}
+
+// Returns the slot the next view records against, once the GPU has finished reading it.
+pub fn acquire(self: *@This()) usize {
+    const slot = self.next;
+    self.next = (self.next + 1) % SLOT_COUNT;
+    if (self.fences[slot]) |sync| {
+        _ = c.glClientWaitSync(sync, c.GL_SYNC_FLUSH_COMMANDS_BIT, std.time.ns_per_s);
+        c.glDeleteSync(sync);
+        self.fences[slot] = null;
+    }
+    return slot;
+}
+
+pub fn write(self: *@This(), slot: usize, block: Block) void {
+    const dst: *align(1) Block = @ptrCast(self.mapped + slot * self.stride);
+    dst.* = block;
+}
+
+pub fn bind(self: @This(), slot: usize, binding: u32) void {
+    c.glBindBufferRange(
+        c.GL_UNIFORM_BUFFER,
+        binding,
+        self.buffer,
+        @intCast(slot * self.stride),
+        @sizeOf(Block),
+    );
+}
+
+// Call after the last draw that reads the slot.
+pub fn fence(self: *@This(), slot: usize) void {
+    self.fences[slot] = c.glFenceSync(c.GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -7,6 +7,9 @@ const geometry = @import("geometry.zig");
 // const c = xr_util.c;
 const InputState = @import("InputState.zig");
 const get_proc = @import("get_proc.zig");
+const QuadLayer = @import("QuadLayer.zig");
+const PerfGovernor = @import("PerfGovernor.zig");
+const SceneModel = @import("SceneModel.zig");
 
 const c = @import("c");
 
@@ -14,6 +17,15 @@ const Swapchain = struct {
     handle: c.XrSwapchain,
     width: u32,
     height: u32,
+    // Differs from width/height when the swapchain is allocated for dynamic resolution.
+    recommendedWidth: u32,
+    recommendedHeight: u32,
+    // Same size as the color swapchain, submitted with XR_KHR_composition_layer_depth.
+    depthHandle: c.XrSwapchain = null,
+    depthInfo: c.XrCompositionLayerDepthInfoKHR = undefined,
+    // Resolved when the swapchains are created, so a view looks its images up by index.
+    images: GraphicsPlugin.SwapchainImages = undefined,
+    depthImages: GraphicsPlugin.SwapchainImages = undefined,
 };
 
 allocator: std.mem.Allocator,
@@ -27,13 +39,31 @@ configViews: std.array_list.Managed(c.XrViewConfigurationView),
 views: std.array_list.Managed(c.XrView),
 swapchains: std.array_list.Managed(Swapchain),
 colorSwapchainFormat: i64 = -1,
+// null unless XR_KHR_composition_layer_depth is enabled and the renderer can use the format.
+depthSwapchainFormat: ?i64 = null,
+quadLayers: std.array_list.Managed(QuadLayer),
 
 // Application's current lifecycle state according to the runtime
 sessionState: c.XrSessionState = c.XR_SESSION_STATE_UNKNOWN,
 sessionRunning: bool = false,
 
 eventDataBuffer: c.XrEventDataBuffer = .{},
+// Latest changeTime of a pending reference space change, until takeReferenceSpaceChange.
+referenceSpaceChangeTime: ?i64 = null,
+// Of the frame between beginFrame and endFrame.
+predictedDisplayPeriod: i64 = 0,
+// Runtime extensions, enumerated once on first use.
+runtimeExtensions: ?[]c.XrExtensionProperties = null,
+// Entries of xr_util.OPTIONAL_EXTENSIONS the instance was created with.
+enabledOptionalExtensions: std.array_list.Managed([]const u8),
 input: InputState = .{},
+// Refresh rate and performance levels, when the runtime has either extension.
+perf: ?PerfGovernor = null,
+// Receives the spatial entity events while set.
+sceneModel: ?*SceneModel = null,
+
+// Quad layers are submitted after the passthrough and projection layers.
+const MAX_QUAD_LAYERS = 4;
 
 const ACCEPTABLE_BLENDMODES = [_]c.XrEnvironmentBlendMode{
     c.XR_ENVIRONMENT_BLEND_MODE_OPAQUE,
@@ -53,14 +83,40 @@ pub fn init(
         .configViews = .init(allocator),
         .views = .init(allocator),
         .swapchains = .init(allocator),
+        .quadLayers = .init(allocator),
+        .enabledOptionalExtensions = .init(allocator),
     };
 }
 
 pub fn deinit(this: *@This()) void {
     std.log.debug("#### OpenXrProgram.deinit ####", .{});
+    for (this.quadLayers.items) |*quadLayer| {
+        quadLayer.deinit(this.graphics);
+    }
+    this.quadLayers.deinit();
+    // The graphics plugin may outlive this program across a restart, so hand back the image arrays.
+    for (this.swapchains.items) |swapchain| {
+        this.graphics.freeSwapchainImageStructs(swapchain.images);
+        _ = c.xrDestroySwapchain(swapchain.handle);
+        if (swapchain.depthHandle != null) {
+            this.graphics.freeSwapchainImageStructs(swapchain.depthImages);
+            _ = c.xrDestroySwapchain(swapchain.depthHandle);
+        }
+    }
     this.swapchains.deinit();
     this.views.deinit();
     this.configViews.deinit();
+    if (this.runtimeExtensions) |extensions| {
+        this.allocator.free(extensions);
+    }
+    this.enabledOptionalExtensions.deinit();
+    this.input.deinit();
+    if (this.session != null) {
+        _ = c.xrDestroySession(this.session);
+    }
+    if (this.instance != null) {
+        _ = c.xrDestroyInstance(this.instance);
+    }
 }
 
 pub fn createInstance(
@@ -68,16 +124,67 @@ pub fn createInstance(
     platform_extensions: []const []const u8,
     instance_create_extension: ?*anyopaque,
 ) !void {
-    try this.logLayersAndExtensions();
+    // Layer enumeration is slow on some runtimes and only informative.
+    if (this.options.Verbose) {
+        try this.logLayersAndExtensions();
+    }
     try this.createInstanceInternal(platform_extensions, instance_create_extension);
     try this.logInstanceInfo();
 }
 
+pub fn isExtensionSupported(this: *@This(), name: []const u8) !bool {
+    for (try this.getRuntimeExtensions()) |extension| {
+        if (std.mem.eql(u8, std.mem.sliceTo(&extension.extensionName, 0), name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+pub fn isExtensionEnabled(this: @This(), name: []const u8) bool {
+    for (this.enabledOptionalExtensions.items) |enabled| {
+        if (std.mem.eql(u8, enabled, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+fn getRuntimeExtensions(this: *@This()) ![]const c.XrExtensionProperties {
+    if (this.runtimeExtensions) |extensions| {
+        return extensions;
+    }
+
+    var count: u32 = undefined;
+    try xr_result.check(c.xrEnumerateInstanceExtensionProperties(null, 0, &count, null));
+    const extensions = try this.allocator.alloc(c.XrExtensionProperties, count);
+    errdefer this.allocator.free(extensions);
+    for (extensions) |*extension| {
+        extension.* = .{
+            .type = c.XR_TYPE_EXTENSION_PROPERTIES,
+        };
+    }
+    if (count > 0) {
+        try xr_result.check(c.xrEnumerateInstanceExtensionProperties(null, count, &count, &extensions[0]));
+    }
+    this.runtimeExtensions = extensions;
+    return extensions;
+}
+
 fn logLayersAndExtensions(this: *@This()) !void {
     // Write out extension properties for a given layer.
 
     // Log non-layer extensions (layerName==nullptr).
-    // try this.logExtensions("", "");
+    {
+        const extensions = try this.getRuntimeExtensions();
+        std.log.debug("Available Extensions: ({})", .{extensions.len});
+        for (extensions) |extension| {
+            std.log.debug("  Name={s} SpecVersion={}", .{
+                extension.extensionName,
+                extension.extensionVersion,
+            });
+        }
+    }
 
     // Log layers and any of their extensions.
     {
@@ -163,8 +270,19 @@ fn createInstanceInternal(
         try extensions.append(copyz);
     }
 
+    for (xr_util.OPTIONAL_EXTENSIONS) |extension| {
+        if (try this.isExtensionSupported(extension)) {
+            try extensions.append(try allocator.dupeZ(u8, extension));
+            try this.enabledOptionalExtensions.append(extension);
+        }
+    }
+
     for (extensions.items) |name| {
-        std.log.info("extension: {s}", .{name});
+        if (!try this.isExtensionSupported(std.mem.span(name))) {
+            std.log.warn("extension: {s} (not supported by the runtime)", .{name});
+        } else {
+            std.log.info("extension: {s}", .{name});
+        }
     }
     var createInfo = c.XrInstanceCreateInfo{
         .type = c.XR_TYPE_INSTANCE_CREATE_INFO,
@@ -258,7 +376,9 @@ pub fn getPreferredBlendMode(this: @This()) !c.XrEnvironmentBlendMode {
 }
 
 pub fn initializeDevice(this: *@This()) !void {
-    try this.logViewConfigurations();
+    if (this.options.Verbose) {
+        try this.logViewConfigurations();
+    }
 
     // The graphics API can initialize the graphics device now that the systemId and instance handle are available.
     try this.graphics.initializeDevice(@ptrCast(this.instance), this.systemId);
@@ -388,8 +508,19 @@ pub fn initializeSession(this: *@This()) !void {
         try xr_result.check(c.xrCreateSession(this.instance, &createInfo, &this.session));
     }
 
-    try this.logReferenceSpaces();
-    // try this.initializeActions();
+    if (this.options.Verbose) {
+        try this.logReferenceSpaces();
+    }
+    try this.input.initializeActions(this.instance, this.session);
+
+    const refreshRate = this.isExtensionEnabled(PerfGovernor.REFRESH_RATE_EXTENSION_NAME);
+    const perfSettings = this.isExtensionEnabled(PerfGovernor.PERF_SETTINGS_EXTENSION_NAME);
+    if (refreshRate or perfSettings) {
+        this.perf = PerfGovernor.init(this.instance, this.session, refreshRate, perfSettings) catch |e| blk: {
+            std.log.warn("PerfGovernor.init: {s}", .{@errorName(e)});
+            break :blk null;
+        };
+    }
 
 }
 
@@ -496,6 +627,10 @@ pub fn createSwapchains(this: *@This()) !void {
         this.colorSwapchainFormat = this.graphics.selectColorSwapchainFormat(swapchainFormats) orelse {
             xr_util.my_panic("selectColorSwapchainFormat", .{});
         };
+        // Lets the runtime reproject positionally instead of rotation only when a frame is late.
+        if (this.isExtensionEnabled(c.XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME)) {
+            this.depthSwapchainFormat = this.graphics.selectDepthSwapchainFormat(swapchainFormats);
+        }
 
         // Print swapchain formats and the selected one.
         {
@@ -517,10 +652,14 @@ pub fn createSwapchains(this: *@This()) !void {
         // Create a swapchain for each view.
         for (0..viewCount) |i| {
             const vp = this.configViews.items[i];
+            // With dynamic resolution the image is allocated at the maximum size and views render
+            // into a sub-rect of it.
+            const width = if (this.options.DynamicResolution) vp.maxImageRectWidth else vp.recommendedImageRectWidth;
+            const height = if (this.options.DynamicResolution) vp.maxImageRectHeight else vp.recommendedImageRectHeight;
             std.log.info("Creating swapchain for view {} with dimensions Width={} Height={} SampleCount={}", .{
                 i,
-                vp.recommendedImageRectWidth,
-                vp.recommendedImageRectHeight,
+                width,
+                height,
                 vp.recommendedSwapchainSampleCount,
             });
 
@@ -529,8 +668,8 @@ pub fn createSwapchains(this: *@This()) !void {
                 .type = c.XR_TYPE_SWAPCHAIN_CREATE_INFO,
                 .arraySize = 1,
                 .format = this.colorSwapchainFormat,
-                .width = vp.recommendedImageRectWidth,
-                .height = vp.recommendedImageRectHeight,
+                .width = width,
+                .height = height,
                 .mipCount = 1,
                 .faceCount = 1,
                 .sampleCount = this.graphics.getSupportedSwapchainSampleCount(vp),
@@ -539,10 +678,30 @@ pub fn createSwapchains(this: *@This()) !void {
             var swapchain = Swapchain{
                 .width = swapchainCreateInfo.width,
                 .height = swapchainCreateInfo.height,
+                .recommendedWidth = vp.recommendedImageRectWidth,
+                .recommendedHeight = vp.recommendedImageRectHeight,
                 .handle = null,
             };
             try xr_result.check(c.xrCreateSwapchain(this.session, &swapchainCreateInfo, &swapchain.handle));
+            if (this.depthSwapchainFormat) |depthFormat| {
+                var depthCreateInfo = swapchainCreateInfo;
+                depthCreateInfo.format = depthFormat;
+                depthCreateInfo.usageFlags = c.XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                try xr_result.check(c.xrCreateSwapchain(this.session, &depthCreateInfo, &swapchain.depthHandle));
+                var depthImageCount: u32 = undefined;
+                try xr_result.check(c.xrEnumerateSwapchainImages(swapchain.depthHandle, 0, &depthImageCount, null));
+                const depthBuffer = this.graphics.allocateSwapchainImageStructs(depthImageCount, &swapchain.depthImages);
+                try xr_result.check(c.xrEnumerateSwapchainImages(
+                    swapchain.depthHandle,
+                    depthImageCount,
+                    &depthImageCount,
+                    depthBuffer,
+                ));
+            }
+            var imageCount: u32 = undefined;
+            try xr_result.check(c.xrEnumerateSwapchainImages(swapchain.handle, 0, &imageCount, null));
             try this.swapchains.append(swapchain);
+            const appended = &this.swapchains.items[this.swapchains.items.len - 1];
 
             // const swapchainBuffer = try this.allocator.alloc(*c.XrSwapchainImageBaseHeader, imageCount);
             // if (!this.graphics.allocateSwapchainImageStructs(swapchainCreateInfo, swapchainBuffer)) {
@@ -550,9 +709,7 @@ pub fn createSwapchains(this: *@This()) !void {
             // }
             // try this.swapchainImageMap.put(swapchain.handle, swapchainBuffer);
 
-            var imageCount: u32 = undefined;
-            try xr_result.check(c.xrEnumerateSwapchainImages(swapchain.handle, 0, &imageCount, null));
-            const swapchainBuffer = this.graphics.allocateSwapchainImageStructs(swapchain.handle, imageCount);
+            const swapchainBuffer = this.graphics.allocateSwapchainImageStructs(imageCount, &appended.images);
             try xr_result.check(c.xrEnumerateSwapchainImages(
                 swapchain.handle,
                 imageCount,
@@ -563,6 +720,74 @@ pub fn createSwapchains(this: *@This()) !void {
     }
 }
 
+// Acquire the depth image paired with the color image of a view, as an index into
+// Swapchain.depthImages. null without depth swapchains, in which case the renderer uses its own
+// depth buffer.
+pub fn acquireDepthImageIndex(this: *@This(), view: usize) !?u32 {
+    const depthHandle = this.swapchains.items[view].depthHandle;
+    if (depthHandle == null) {
+        return null;
+    }
+    var acquireInfo = c.XrSwapchainImageAcquireInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO,
+    };
+    var imageIndex: u32 = undefined;
+    try xr_result.check(c.xrAcquireSwapchainImage(depthHandle, &acquireInfo, &imageIndex));
+    var waitInfo = c.XrSwapchainImageWaitInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO,
+        .timeout = c.XR_INFINITE_DURATION,
+    };
+    try xr_result.check(c.xrWaitSwapchainImage(depthHandle, &waitInfo));
+    return imageIndex;
+}
+
+// Release the depth image of a view and chain its XrCompositionLayerDepthInfoKHR in front of
+// whatever projectionView.next already holds. Depth covers the same rect as the color image.
+pub fn releaseDepthImage(this: *@This(), view: usize, projectionView: *c.XrCompositionLayerProjectionView) !void {
+    const swapchain = &this.swapchains.items[view];
+    if (swapchain.depthHandle == null) {
+        return;
+    }
+    const releaseInfo = c.XrSwapchainImageReleaseInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
+    };
+    try xr_result.check(c.xrReleaseSwapchainImage(swapchain.depthHandle, &releaseInfo));
+    swapchain.depthInfo = .{
+        .type = c.XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR,
+        .next = projectionView.next,
+        .subImage = .{
+            .swapchain = swapchain.depthHandle,
+            .imageRect = projectionView.subImage.imageRect,
+            .imageArrayIndex = 0,
+        },
+        .minDepth = 0,
+        .maxDepth = 1,
+        .nearZ = GraphicsPlugin.NEAR_Z,
+        .farZ = GraphicsPlugin.FAR_Z,
+    };
+    projectionView.next = &swapchain.depthInfo;
+}
+
+// Add static content composited as a quad. The returned index stays valid for markQuadLayerDirty.
+pub fn addQuadLayer(this: *@This(), desc: QuadLayer.Desc) !usize {
+    if (this.quadLayers.items.len >= MAX_QUAD_LAYERS) {
+        return error.too_many_quad_layers;
+    }
+    try this.quadLayers.append(QuadLayer.init(desc));
+    return this.quadLayers.items.len - 1;
+}
+
+pub fn markQuadLayerDirty(this: *@This(), index: usize) void {
+    this.quadLayers.items[index].markDirty();
+}
+
+// Render the quad layers whose content changed. Call between beginFrame and endFrame.
+pub fn updateQuadLayers(this: *@This()) !void {
+    for (this.quadLayers.items) |*quadLayer| {
+        try quadLayer.update(this.session, &this.graphics, this.colorSwapchainFormat);
+    }
+}
+
 pub fn pollEvents(
     this: *@This(),
     exitRenderLoop: *bool,
@@ -593,7 +818,28 @@ pub fn pollEvents(
                 //             LogActionSourceName(m_input.poseAction, "Pose");
                 //             LogActionSourceName(m_input.vibrateAction, "Vibrate");
             },
-            // c.XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING=>:
+            c.XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING => {
+                const spaceChange: *const c.XrEventDataReferenceSpaceChangePending = @ptrCast(event);
+                std.log.info("XrEventDataReferenceSpaceChangePending: type {} at {}", .{
+                    spaceChange.referenceSpaceType,
+                    spaceChange.changeTime,
+                });
+                this.referenceSpaceChangeTime = @max(this.referenceSpaceChangeTime orelse 0, spaceChange.changeTime);
+            },
+            c.XR_TYPE_EVENT_DATA_PERF_SETTINGS_EXT => {
+                const perfSettings: *const c.XrEventDataPerfSettingsEXT = @ptrCast(event);
+                if (this.perf) |*perf| {
+                    perf.onPerfSettings(perfSettings);
+                }
+            },
+            c.XR_TYPE_EVENT_DATA_SPACE_QUERY_RESULTS_AVAILABLE_FB,
+            c.XR_TYPE_EVENT_DATA_SPACE_QUERY_COMPLETE_FB,
+            c.XR_TYPE_EVENT_DATA_SPACE_SET_STATUS_COMPLETE_FB,
+            => {
+                if (this.sceneModel) |model| {
+                    model.onEvent(event);
+                }
+            },
             else => {
                 std.log.debug("Ignoring event type {}", .{event.type});
             },
@@ -650,6 +896,12 @@ fn handleSessionStateChangedEvent(
     }
 }
 
+// Returns the changeTime of reference space changes seen by pollEvents since the last call.
+pub fn takeReferenceSpaceChange(this: *@This()) ?i64 {
+    defer this.referenceSpaceChangeTime = null;
+    return this.referenceSpaceChangeTime;
+}
+
 // Return event if one is available, otherwise return null.
 fn tryReadNextEvent(this: *@This()) !?*const c.XrEventDataBaseHeader {
     // It is sufficient to clear the just the XrEventDataBuffer header to XR_TYPE_EVENT_DATA_BUFFER
@@ -674,7 +926,9 @@ fn tryReadNextEvent(this: *@This()) !?*const c.XrEventDataBaseHeader {
     xr_util.my_panic("xrPollEvent", .{});
 }
 
-pub fn beginFrame(this: *@This()) !c.XrFrameState {
+// Throttle to the runtime and get the frame's predicted display time. Work that only needs the
+// time, like HandTrackingService.request, goes between this and beginFrame.
+pub fn waitFrame(this: *@This()) !c.XrFrameState {
     try xr_util.assert(this.session != null);
 
     var frameWaitInfo = c.XrFrameWaitInfo{
@@ -684,14 +938,18 @@ pub fn beginFrame(this: *@This()) !c.XrFrameState {
         .type = c.XR_TYPE_FRAME_STATE,
     };
     try xr_result.check(c.xrWaitFrame(this.session, &frameWaitInfo, &frameState));
+    this.predictedDisplayPeriod = frameState.predictedDisplayPeriod;
+    return frameState;
+}
 
+pub fn beginFrame(this: *@This()) !void {
     var frameBeginInfo = c.XrFrameBeginInfo{
         .type = c.XR_TYPE_FRAME_BEGIN_INFO,
     };
     try xr_result.check(c.xrBeginFrame(this.session, &frameBeginInfo));
-    // return frameState;
-
-    return frameState;
+    if (this.perf) |*perf| {
+        perf.beginFrame();
+    }
 }
 
 pub fn locateView(this: *@This(), space: c.XrSpace, predictedDisplayTime: i64) !c.XrViewState {
@@ -717,7 +975,7 @@ pub fn locateView(this: *@This(), space: c.XrSpace, predictedDisplayTime: i64) !
 }
 
 pub fn endFrame(
-    this: @This(),
+    this: *@This(),
     space: c.XrSpace,
     predictedDisplayTime: i64,
     views: []c.XrCompositionLayerProjectionView,
@@ -732,7 +990,7 @@ pub fn endFrame(
         .layers = null,
     };
 
-    var composition_layers: [2]*c.XrCompositionLayerBaseHeader = undefined;
+    var composition_layers: [2 + MAX_QUAD_LAYERS]*c.XrCompositionLayerBaseHeader = undefined;
 
     var composition_layer_passthrough: c.XrCompositionLayerPassthroughFB = undefined;
     if (maybe_passthrough) |passthrough| {
@@ -765,5 +1023,18 @@ pub fn endFrame(
         frameEndInfo.layers = &composition_layers[0];
     }
 
+    var composition_layer_quads: [MAX_QUAD_LAYERS]c.XrCompositionLayerQuad = undefined;
+    for (this.quadLayers.items, 0..) |quadLayer, i| {
+        if (quadLayer.compositionLayer()) |layer| {
+            composition_layer_quads[i] = layer;
+            composition_layers[frameEndInfo.layerCount] = @ptrCast(&composition_layer_quads[i]);
+            frameEndInfo.layerCount += 1;
+            frameEndInfo.layers = &composition_layers[0];
+        }
+    }
+
+    if (this.perf) |*perf| {
+        perf.endFrame(predictedDisplayTime, this.predictedDisplayPeriod);
+    }
     try xr_result.check(c.xrEndFrame(this.session, &frameEndInfo));
 }
@@ -32,6 +32,17 @@ FormFactor: []const u8 = "Hmd",
 ViewConfiguration: []const u8 = "Stereo",
 EnvironmentBlendMode: []const u8 = "Opaque",
 AppSpace: []const u8 = "Local",
+// Re-locate views and hands right before each swapchain image is released.
+LateLatch: bool = false,
+// Allocate swapchains at the maximum size and scale the rendered rect with GPU load.
+DynamicResolution: bool = false,
+// Render at half rate with XR_FB_space_warp when the runtime supports it. Android only.
+SpaceWarp: bool = false,
+// Sample actions and hand poses on a thread of their own at this rate in Hz. 0 polls them once
+// per frame on the render thread.
+InputRate: u32 = 0,
+// Enumerate and log layers, extensions, view configurations and reference spaces at startup.
+Verbose: bool = false,
 
 Parsed: struct {
     FormFactor: xr.XrFormFactor = xr.XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY,
@@ -74,8 +85,14 @@ pub fn init(argc: usize, argv: [*][*:0]u8) !@This() {
             options.EnvironmentBlendMode = try nextArg.get();
         } else if (std.mem.eql(u8, arg, "--space") or std.mem.eql(u8, arg, "-s")) {
             options.AppSpace = try nextArg.get();
+        } else if (std.mem.eql(u8, arg, "--latelatch") or std.mem.eql(u8, arg, "-ll")) {
+            options.LateLatch = true;
+        } else if (std.mem.eql(u8, arg, "--dynamicresolution") or std.mem.eql(u8, arg, "-dr")) {
+            options.DynamicResolution = true;
+        } else if (std.mem.eql(u8, arg, "--inputrate") or std.mem.eql(u8, arg, "-ir")) {
+            options.InputRate = try std.fmt.parseInt(u32, try nextArg.get(), 10);
         } else if (std.mem.eql(u8, arg, "--verbose") or std.mem.eql(u8, arg, "-v")) {
-            // Log::SetLevel(Log::Level::Verbose);
+            options.Verbose = true;
         } else if (std.mem.eql(u8, arg, "--help") or std.mem.eql(u8, arg, "-h")) {
             // showHelp();
             return error.help;
@@ -130,7 +147,7 @@ fn getXrFormFactor(formFactorStr: []const u8) !xr.XrFormFactor {
 
 fn showHelp() void {
     // TODO: Improve/update when things are more settled.
-    std.log.info("HelloXr --graphics|-g <Graphics API> [--formfactor|-ff <Form factor>] [--viewconfig|-vc <View config>] [--blendmode|-bm <Blend mode>] [--space|-s <Space>] [--verbose|-v]", .{});
+    std.log.info("HelloXr --graphics|-g <Graphics API> [--formfactor|-ff <Form factor>] [--viewconfig|-vc <View config>] [--blendmode|-bm <Blend mode>] [--space|-s <Space>] [--latelatch|-ll] [--dynamicresolution|-dr] [--inputrate|-ir <Hz>] [--verbose|-v]", .{});
     std.log.info("Graphics APIs:            D3D11, D3D12, OpenGLES, OpenGL, Vulkan2, Vulkan, Metal", .{});
     std.log.info("Form factors:             Hmd, Handheld", .{});
     std.log.info("View configurations:      Mono, Stereo", .{});
@@ -0,0 +1,269 @@
+// Picks the display refresh rate and the CPU/GPU performance levels from measured frame headroom.
+//
+// A run of frames over budget raises the levels from SUSTAINED_LOW to SUSTAINED_HIGH first and
+// drops to the next lower refresh rate only once the levels are exhausted. A longer run of cheap
+// frames moves to the next higher refresh rate, and at the highest rate lowers the levels again
+// to save heat. BOOST is never requested because it cannot be held. Thermal warnings from
+// XR_EXT_performance_settings drop one refresh rate and cap the rate there until both domains
+// report normal again.
+//
+// Headroom is the CPU time from xrBeginFrame to xrEndFrame against the display period, plus
+// frames the runtime reports as missed through a jump in predictedDisplayTime, which is how a
+// GPU bound frame shows up. Both are measured against the app frame interval, which is a multiple
+// of the display period while XR_FB_space_warp renders at half rate.
+const std = @import("std");
+const c = @import("c");
+const xr_gen = @import("openxr");
+const xr_util = @import("xr_util.zig");
+const xr_result = @import("xr_result.zig");
+const get_proc = @import("get_proc.zig");
+
+pub const REFRESH_RATE_EXTENSION_NAME = c.XR_FB_DISPLAY_REFRESH_RATE_EXTENSION_NAME;
+pub const PERF_SETTINGS_EXTENSION_NAME = c.XR_EXT_PERFORMANCE_SETTINGS_EXTENSION_NAME;
+
+// Fraction of the display period the CPU may spend on a frame.
+const BUDGET = 0.85;
+// Step up only after this many frames below this fraction of the budget, at least a second.
+const CHEAP_THRESHOLD = 0.6;
+const CHEAP_FRAMES = 120;
+// Step down after this many frames over budget or missed out of the last WINDOW frames.
+const WINDOW = 30;
+const SLOW_FRAMES = 6;
+// Frames to ignore after a change, while the runtime settles on the new rate and clocks.
+const SETTLE_FRAMES = 30;
+// After a refresh rate had to be given up, wait this many frames before trying it again.
+const RATE_RETRY_FRAMES = 3600;
+const MAX_RATES = 16;
+
+const LEVELS = [_]c.XrPerfSettingsLevelEXT{
+    c.XR_PERF_SETTINGS_LEVEL_SUSTAINED_LOW_EXT,
+    c.XR_PERF_SETTINGS_LEVEL_SUSTAINED_HIGH_EXT,
+};
+
+ext_refreshRate: ?xr_gen.extensions.XR_FB_display_refresh_rate = null,
+ext_perfSettings: ?xr_gen.extensions.XR_EXT_performance_settings = null,
+session: c.XrSession,
+
+// Ascending.
+rates: [MAX_RATES]f32 = undefined,
+rateCount: usize = 0,
+rate: usize = 0,
+level: usize = 0,
+// Highest rate index allowed while a thermal warning is active.
+thermalCap: ?usize = null,
+thermal: [2]c.XrPerfSettingsNotificationLevelEXT = .{
+    c.XR_PERF_SETTINGS_NOTIF_LEVEL_NORMAL_EXT,
+    c.XR_PERF_SETTINGS_NOTIF_LEVEL_NORMAL_EXT,
+},
+
+// Display periods per app frame, 2 while space warp synthesizes every other frame.
+frameInterval: u32 = 1,
+frameBegin: ?std.time.Instant = null,
+lastDisplayTime: i64 = 0,
+windowFrames: u32 = 0,
+slowFrames: u32 = 0,
+cheapFrames: u32 = 0,
+settleFrames: u32 = SETTLE_FRAMES,
+rateRetryFrames: u32 = 0,
+
+pub fn init(
+    instance: c.XrInstance,
+    session: c.XrSession,
+    refreshRate: bool,
+    perfSettings: bool,
+) !@This() {
+    var self = @This(){
+        .session = session,
+    };
+
+    if (refreshRate) {
+        var ext: xr_gen.extensions.XR_FB_display_refresh_rate = .{};
+        get_proc.getProcs(@ptrCast(instance), &ext);
+        self.ext_refreshRate = ext;
+
+        var count: u32 = 0;
+        try xr_result.check(ext.xrEnumerateDisplayRefreshRatesFB.?(session, 0, &count, null));
+        try xr_util.assert(count > 0 and count <= MAX_RATES);
+        try xr_result.check(ext.xrEnumerateDisplayRefreshRatesFB.?(session, count, &count, &self.rates[0]));
+        self.rateCount = count;
+        std.mem.sort(f32, self.rates[0..self.rateCount], {}, std.sort.asc(f32));
+
+        var current: f32 = 0;
+        try xr_result.check(ext.xrGetDisplayRefreshRateFB.?(session, &current));
+        for (self.rates[0..self.rateCount], 0..) |rate, i| {
+            if (rate <= current) {
+                self.rate = i;
+            }
+        }
+        std.log.info("perf: refresh rates {any}, current {d}Hz", .{ self.rates[0..self.rateCount], current });
+    }
+
+    if (perfSettings) {
+        var ext: xr_gen.extensions.XR_EXT_performance_settings = .{};
+        get_proc.getProcs(@ptrCast(instance), &ext);
+        self.ext_perfSettings = ext;
+        try self.applyLevel();
+    }
+
+    return self;
+}
+
+// Call whenever the app switches between full-rate and half-rate rendering. The frames around
+// the switch are ignored like after a refresh rate change.
+pub fn setFrameInterval(self: *@This(), periods: u32) void {
+    std.debug.assert(periods > 0);
+    if (periods == self.frameInterval) {
+        return;
+    }
+    self.frameInterval = periods;
+    self.resetCounters();
+    self.settleFrames = SETTLE_FRAMES;
+}
+
+// Call right after xrBeginFrame.
+pub fn beginFrame(self: *@This()) void {
+    self.frameBegin = std.time.Instant.now() catch null;
+}
+
+// Call right before xrEndFrame with the frame state of the same frame.
+pub fn endFrame(self: *@This(), predictedDisplayTime: i64, predictedDisplayPeriod: i64) void {
+    const begin = self.frameBegin orelse return;
+    self.frameBegin = null;
+    const now = std.time.Instant.now() catch return;
+    if (predictedDisplayPeriod <= 0) {
+        return;
+    }
+
+    const interval = predictedDisplayPeriod * self.frameInterval;
+    const missed = self.lastDisplayTime != 0 and
+        predictedDisplayTime - self.lastDisplayTime > interval + @divTrunc(predictedDisplayPeriod, 2);
+    self.lastDisplayTime = predictedDisplayTime;
+
+    if (self.rateRetryFrames > 0) {
+        self.rateRetryFrames -= 1;
+    }
+    if (self.settleFrames > 0) {
+        self.settleFrames -= 1;
+        return;
+    }
+
+    const load = @as(f32, @floatFromInt(now.since(begin))) /
+        (BUDGET * @as(f32, @floatFromInt(interval)));
+
+    if (missed or load > 1.0) {
+        self.slowFrames += 1;
+        self.cheapFrames = 0;
+    } else if (load < CHEAP_THRESHOLD) {
+        self.cheapFrames += 1;
+    } else {
+        self.cheapFrames = 0;
+    }
+
+    self.windowFrames += 1;
+    if (self.slowFrames >= SLOW_FRAMES) {
+        self.stepDown() catch |e| {
+            std.log.warn("perf: step down: {s}", .{@errorName(e)});
+        };
+    } else if (self.cheapFrames >= CHEAP_FRAMES) {
+        self.stepUp() catch |e| {
+            std.log.warn("perf: step up: {s}", .{@errorName(e)});
+        };
+    } else if (self.windowFrames >= WINDOW) {
+        self.windowFrames = 0;
+        self.slowFrames = 0;
+    }
+}
+
+// Called for XR_TYPE_EVENT_DATA_PERF_SETTINGS_EXT.
+pub fn onPerfSettings(self: *@This(), event: *const c.XrEventDataPerfSettingsEXT) void {
+    std.log.info("perf: domain {} sub domain {} {}->{}", .{
+        event.domain,
+        event.subDomain,
+        event.fromLevel,
+        event.toLevel,
+    });
+    switch (event.subDomain) {
+        c.XR_PERF_SETTINGS_SUB_DOMAIN_THERMAL_EXT => {
+            const domain: usize = if (event.domain == c.XR_PERF_SETTINGS_DOMAIN_GPU_EXT) 1 else 0;
+            self.thermal[domain] = event.toLevel;
+            if (event.toLevel != c.XR_PERF_SETTINGS_NOTIF_LEVEL_NORMAL_EXT) {
+                if (self.thermalCap == null) {
+                    self.thermalCap = if (self.rate > 0) self.rate - 1 else 0;
+                    self.setRate(self.thermalCap.?, 0) catch |e| {
+                        std.log.warn("perf: thermal: {s}", .{@errorName(e)});
+                    };
+                }
+            } else if (self.thermal[0] == c.XR_PERF_SETTINGS_NOTIF_LEVEL_NORMAL_EXT and
+                self.thermal[1] == c.XR_PERF_SETTINGS_NOTIF_LEVEL_NORMAL_EXT)
+            {
+                self.thermalCap = null;
+            }
+        },
+        else => {
+            // Compositing or rendering falling behind counts the same as missed frames.
+            if (event.toLevel != c.XR_PERF_SETTINGS_NOTIF_LEVEL_NORMAL_EXT) {
+                self.slowFrames = SLOW_FRAMES;
+            }
+        },
+    }
+}
+
+fn maxRate(self: @This()) usize {
+    const top = if (self.rateCount > 0) self.rateCount - 1 else 0;
+    return @min(top, self.thermalCap orelse top);
+}
+
+fn maxLevel(self: @This()) usize {
+    return if (self.ext_perfSettings != null) LEVELS.len - 1 else 0;
+}
+
+fn stepUp(self: *@This()) !void {
+    if (self.rate < self.maxRate() and self.rateRetryFrames == 0) {
+        try self.setRate(self.rate + 1, self.level);
+    } else if (self.level > 0) {
+        try self.setRate(self.rate, self.level - 1);
+    } else {
+        self.resetCounters();
+    }
+}
+
+fn stepDown(self: *@This()) !void {
+    // More clocks first, a lower rate only once the levels are exhausted.
+    if (self.level < self.maxLevel()) {
+        try self.setRate(self.rate, self.maxLevel());
+    } else if (self.rate > 0 and self.rateCount > 0) {
+        self.rateRetryFrames = RATE_RETRY_FRAMES;
+        try self.setRate(self.rate - 1, self.maxLevel());
+    } else {
+        self.resetCounters();
+    }
+}
+
+fn setRate(self: *@This(), rate: usize, level: usize) !void {
+    self.resetCounters();
+    self.settleFrames = SETTLE_FRAMES;
+    if (rate != self.rate) {
+        if (self.ext_refreshRate) |ext| {
+            std.log.info("perf: refresh rate {d}Hz -> {d}Hz", .{ self.rates[self.rate], self.rates[rate] });
+            try xr_result.check(ext.xrRequestDisplayRefreshRateFB.?(self.session, self.rates[rate]));
+            self.rate = rate;
+        }
+    }
+    if (level != self.level) {
+        self.level = level;
+        try self.applyLevel();
+    }
+}
+
+fn applyLevel(self: *@This()) !void {
+    const ext = self.ext_perfSettings orelse return;
+    std.log.info("perf: level {}", .{LEVELS[self.level]});
+    try xr_result.check(ext.xrPerfSettingsSetPerformanceLevelEXT.?(self.session, c.XR_PERF_SETTINGS_DOMAIN_CPU_EXT, LEVELS[self.level]));
+    try xr_result.check(ext.xrPerfSettingsSetPerformanceLevelEXT.?(self.session, c.XR_PERF_SETTINGS_DOMAIN_GPU_EXT, LEVELS[self.level]));
+}
+
+fn resetCounters(self: *@This()) void {
+    self.windowFrames = 0;
+    self.slowFrames = 0;
+    self.cheapFrames = 0;
+}
@@ -0,0 +1,139 @@
+// A content item rendered once into a static swapchain and composited as an XrCompositionLayerQuad.
+//
+// An XR_SWAPCHAIN_CREATE_STATIC_IMAGE_BIT swapchain can only be acquired once, so marking the
+// content dirty recreates the swapchain and renders it again on the next update. In between, the
+// compositor samples the image at display resolution without any per-frame work from the app.
+const std = @import("std");
+const c = @import("c");
+const xr_result = @import("xr_result.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+
+// images and image_index are the quad's own swapchain, for renderers that keep per image state.
+pub const RenderFn = *const fn (
+    ctx: ?*anyopaque,
+    images: GraphicsPlugin.SwapchainImages,
+    image_index: u32,
+    image: GraphicsPlugin.SwapchainImage,
+    width: u32,
+    height: u32,
+) void;
+
+pub const Desc = struct {
+    // Swapchain size in pixels.
+    width: u32,
+    height: u32,
+    space: c.XrSpace,
+    pose: c.XrPosef,
+    // Quad size in meters.
+    size: c.XrExtent2Df,
+    ctx: ?*anyopaque = null,
+    render: RenderFn,
+};
+
+desc: Desc,
+swapchain: c.XrSwapchain = null,
+images: GraphicsPlugin.SwapchainImages = undefined,
+dirty: bool = true,
+
+pub fn init(desc: Desc) @This() {
+    return .{
+        .desc = desc,
+    };
+}
+
+pub fn deinit(self: *@This(), graphics: GraphicsPlugin) void {
+    self.destroySwapchain(graphics);
+}
+
+pub fn markDirty(self: *@This()) void {
+    self.dirty = true;
+}
+
+// Re-render into a fresh static swapchain if the content is dirty. Cheap otherwise.
+pub fn update(self: *@This(), session: c.XrSession, graphics: *GraphicsPlugin, format: i64) !void {
+    if (!self.dirty) {
+        return;
+    }
+    self.destroySwapchain(graphics.*);
+
+    const swapchainCreateInfo = c.XrSwapchainCreateInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_CREATE_INFO,
+        .createFlags = c.XR_SWAPCHAIN_CREATE_STATIC_IMAGE_BIT,
+        .usageFlags = c.XR_SWAPCHAIN_USAGE_SAMPLED_BIT | c.XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT,
+        .format = format,
+        .sampleCount = 1,
+        .width = self.desc.width,
+        .height = self.desc.height,
+        .faceCount = 1,
+        .arraySize = 1,
+        .mipCount = 1,
+    };
+    try xr_result.check(c.xrCreateSwapchain(session, &swapchainCreateInfo, &self.swapchain));
+
+    var imageCount: u32 = undefined;
+    try xr_result.check(c.xrEnumerateSwapchainImages(self.swapchain, 0, &imageCount, null));
+    const swapchainBuffer = graphics.allocateSwapchainImageStructs(imageCount, &self.images);
+    try xr_result.check(c.xrEnumerateSwapchainImages(self.swapchain, imageCount, &imageCount, swapchainBuffer));
+
+    var acquireInfo = c.XrSwapchainImageAcquireInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO,
+    };
+    var imageIndex: u32 = undefined;
+    try xr_result.check(c.xrAcquireSwapchainImage(self.swapchain, &acquireInfo, &imageIndex));
+    var waitInfo = c.XrSwapchainImageWaitInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO,
+        .timeout = c.XR_INFINITE_DURATION,
+    };
+    try xr_result.check(c.xrWaitSwapchainImage(self.swapchain, &waitInfo));
+
+    self.desc.render(
+        self.desc.ctx,
+        self.images,
+        imageIndex,
+        graphics.getSwapchainImage(self.images, imageIndex),
+        self.desc.width,
+        self.desc.height,
+    );
+
+    const releaseInfo = c.XrSwapchainImageReleaseInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
+    };
+    try xr_result.check(c.xrReleaseSwapchainImage(self.swapchain, &releaseInfo));
+
+    std.log.debug("quad layer rendered {}x{}", .{ self.desc.width, self.desc.height });
+    self.dirty = false;
+}
+
+pub fn compositionLayer(self: @This()) ?c.XrCompositionLayerQuad {
+    if (self.swapchain == null or self.dirty) {
+        return null;
+    }
+    return .{
+        .type = c.XR_TYPE_COMPOSITION_LAYER_QUAD,
+        .layerFlags = c.XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT,
+        .space = self.desc.space,
+        .eyeVisibility = c.XR_EYE_VISIBILITY_BOTH,
+        .subImage = .{
+            .swapchain = self.swapchain,
+            .imageRect = .{
+                .offset = .{ .x = 0, .y = 0 },
+                .extent = .{
+                    .width = @intCast(self.desc.width),
+                    .height = @intCast(self.desc.height),
+                },
+            },
+            .imageArrayIndex = 0,
+        },
+        .pose = self.desc.pose,
+        .size = self.desc.size,
+    };
+}
+
+fn destroySwapchain(self: *@This(), graphics: GraphicsPlugin) void {
+    if (self.swapchain == null) {
+        return;
+    }
+    graphics.freeSwapchainImageStructs(self.images);
+    _ = c.xrDestroySwapchain(self.swapchain);
+    self.swapchain = null;
+}
@@ -0,0 +1,60 @@
+// What the desktop frame loop does per view, fixed at comptime.
+//
+// The loop is instantiated once per variant and the variant is selected once per session, so a
+// view resolves its swapchain image and view projection with direct calls into the OpenGL plugin
+// and picks the plain or late latched draw without a runtime branch or a trip through the
+// GraphicsPlugin vtable. The renderer always draws instanced, that is not a variant.
+const Options = @import("Options.zig");
+const xr = @import("openxr").c;
+
+// What the projection layer is composited over, which decides the clear color.
+pub const Blend = enum {
+    // Under the passthrough layer, the unrendered background stays see-through.
+    passthrough,
+    @"opaque",
+    additive,
+    alpha_blend,
+
+    fn fromEnvironmentBlendMode(mode: xr.XrEnvironmentBlendMode) @This() {
+        return switch (mode) {
+            xr.XR_ENVIRONMENT_BLEND_MODE_ADDITIVE => .additive,
+            xr.XR_ENVIRONMENT_BLEND_MODE_ALPHA_BLEND => .alpha_blend,
+            else => .@"opaque",
+        };
+    }
+};
+
+lateLatch: bool,
+blend: Blend,
+
+// GraphicsRendererGlad only draws into OpenGL swapchains.
+pub fn select(options: Options, lateLatch: bool, passthrough: bool) !@This() {
+    if (options.GraphicsPlugin != .OpenGL) {
+        return error.unsupported_graphics;
+    }
+    return .{
+        .lateLatch = lateLatch,
+        .blend = if (passthrough) .passthrough else Blend.fromEnvironmentBlendMode(options.Parsed.EnvironmentBlendMode),
+    };
+}
+
+// Same colors as Options.getBackgroundClearColor.
+pub fn clearColor(comptime self: @This()) [4]f32 {
+    return switch (self.blend) {
+        .passthrough, .alpha_blend => .{ 0.0, 0.0, 0.0, 0.0 },
+        .@"opaque" => .{ 0.184313729, 0.309803933, 0.309803933, 1.0 },
+        .additive => .{ 0.0, 0.0, 0.0, 1.0 },
+    };
+}
+
+// Calls func with the variant as its first, comptime argument. One instance of func per variant.
+pub fn dispatch(self: @This(), comptime func: anytype, args: anytype) anyerror!void {
+    return switch (self.lateLatch) {
+        inline else => |lateLatch| switch (self.blend) {
+            inline else => |blend| @call(.auto, func, .{@This(){
+                .lateLatch = lateLatch,
+                .blend = blend,
+            }} ++ args),
+        },
+    };
+}
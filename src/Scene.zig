@@ -6,33 +6,80 @@ const InputState = @import("InputState.zig");
 const get_proc = @import("get_proc.zig");
 const HandTracking = @import("HandTracking.zig");
 const xr = @import("openxr");
+const xr_linear = @import("xr_linear.zig");
+const SpaceCache = @import("SpaceCache.zig");
+const InputSampler = @import("InputSampler.zig");
+const SceneStore = @import("SceneStore.zig");
+const HandMesh = @import("HandMesh.zig");
+const HandTrackingService = @import("HandTrackingService.zig");
+const SceneModel = @import("SceneModel.zig");
+
+const JOINT_SCALE = c.XrVector3f{ .x = 0.02, .y = 0.02, .z = 0.02 };
+const SPACE_SCALE = c.XrVector3f{ .x = 0.25, .y = 0.25, .z = 0.25 };
+const HIT_SCALE = c.XrVector3f{ .x = 0.03, .y = 0.03, .z = 0.03 };
+// How far a hand ray reaches into the scene model.
+const MAX_RAY_DISTANCE = 10.0;
 
 allocator: std.mem.Allocator,
+// Every cube keeps its object across frames, hidden while untracked, so only moved cubes are dirty.
+store: SceneStore,
+jointCubes: [2][c.XR_HAND_JOINT_COUNT_EXT]SceneStore.Handle = undefined,
+// Index aligned with visualizedSpaces.entries.
+spaceCubes: std.array_list.Managed(SceneStore.Handle),
+handCubes: [2]SceneStore.Handle = undefined,
+// Where each hand's ray meets the scene model.
+hitCubes: [2]SceneStore.Handle = undefined,
+// The shown cubes of the last buildCubes, for the renderers that take a cube list.
 cubes: std.array_list.Managed(geometry.Cube),
-visualizedSpaces: std.array_list.Managed(c.XrSpace),
+visualizedSpaces: SpaceCache,
 
 ext_handTracking: xr.extensions.XR_EXT_hand_tracking = .{},
 handLeft: HandTracking = .{},
 handRight: HandTracking = .{},
+// Locates the hands off the render thread when set, see HandTrackingService.
+handService: ?*HandTrackingService = null,
+// With XR_FB_hand_tracking_mesh a located hand is drawn as its skinned mesh instead of joint cubes.
+handMeshes: [2]?HandMesh = .{ null, null },
+// Joint matrices of the last update, null while the hand has no mesh or is not tracked.
+handSkins: [2]?HandMesh.Skin = .{ null, null },
+// Hand action poses the cubes were built from, for latchHands.
+handPoses: [2]?c.XrPosef = .{ null, null },
+// The room meshes hand rays are cast against, when the runtime has XR_FB_scene.
+sceneModel: ?*SceneModel = null,
 
 pub fn init(
     allocator: std.mem.Allocator,
     instance: c.XrInstance,
     session: c.XrSession,
+    appSpaceType: c.XrReferenceSpaceType,
+    handMesh: bool,
 ) !@This() {
 
     // fn createVisualizedSpaces(this: *@This()) !void {
     // try xr_util.assert(this.session != null);
     var this = @This(){
         .allocator = allocator,
+        .store = .init(allocator),
+        .spaceCubes = .init(allocator),
         .cubes = .init(allocator),
-        .visualizedSpaces = .init(allocator),
+        .visualizedSpaces = .init(allocator, appSpaceType),
     };
 
     get_proc.getProcs(@ptrCast(instance), &this.ext_handTracking);
     try this.handLeft.init(this.ext_handTracking, session, .left);
     try this.handRight.init(this.ext_handTracking, session, .right);
 
+    if (handMesh) {
+        var ext_handMesh: xr.extensions.XR_FB_hand_tracking_mesh = .{};
+        get_proc.getProcs(@ptrCast(instance), &ext_handMesh);
+        for (&this.handMeshes, [2]c.XrHandTrackerEXT{ this.handLeft.tracker, this.handRight.tracker }) |*mesh, tracker| {
+            mesh.* = HandMesh.load(allocator, ext_handMesh, tracker) catch |e| blk: {
+                std.log.warn("hand mesh: {s}", .{@errorName(e)});
+                break :blk null;
+            };
+        }
+    }
+
     const visualizedSpaces = [_][]const u8{
         "ViewFront",
         "Local",
@@ -48,7 +95,7 @@ pub fn init(
         var space: c.XrSpace = undefined;
         const res = c.xrCreateReferenceSpace(session, &referenceSpaceCreateInfo, &space);
         if (res == 0) {
-            try this.visualizedSpaces.append(space);
+            try this.visualizedSpaces.add(space, referenceSpaceCreateInfo.referenceSpaceType);
         } else {
             std.log.warn("Failed to create reference space {s} with error {}", .{
                 visualizedSpace,
@@ -57,10 +104,44 @@ pub fn init(
         }
     }
 
+    // Added in the order update used to append the cubes: joints, spaces, hands, hits.
+    for (&this.jointCubes) |*joints| {
+        for (joints) |*handle| {
+            handle.* = try this.store.add(hiddenCube(JOINT_SCALE, .world));
+        }
+    }
+    for (this.visualizedSpaces.entries.items) |_| {
+        try this.spaceCubes.append(try this.store.add(hiddenCube(SPACE_SCALE, .world)));
+    }
+    const attachments = [2]geometry.Attachment{ .left_hand, .right_hand };
+    for (&this.handCubes, attachments) |*handle, attachment| {
+        handle.* = try this.store.add(hiddenCube(.{ .x = 0.1, .y = 0.1, .z = 0.1 }, attachment));
+    }
+    for (&this.hitCubes) |*handle| {
+        handle.* = try this.store.add(hiddenCube(HIT_SCALE, .world));
+    }
+
     return this;
 }
 
+fn hiddenCube(scale: c.XrVector3f, attachment: geometry.Attachment) SceneStore.Object {
+    const identity = geometry.XrPosef_Identity();
+    return .{
+        .position = identity.position,
+        .orientation = identity.orientation,
+        .scale = scale,
+        .flags = .{ .visible = false, .attachment = attachment },
+    };
+}
+
 pub fn deinit(this: *@This()) void {
+    for (&this.handMeshes) |*mesh| {
+        if (mesh.*) |*m| {
+            m.deinit();
+        }
+    }
+    this.store.deinit();
+    this.spaceCubes.deinit();
     this.cubes.deinit();
     this.visualizedSpaces.deinit();
 }
@@ -70,60 +151,39 @@ pub fn update(
     space: c.XrSpace,
     input: *InputState,
     predictedDisplayTime: i64,
-) ![]geometry.Cube {
-    // For each locatable space that we want to visualize, render a 25cm cube.
-    try this.cubes.resize(0);
-
-    // left
-    if (try this.handLeft.locate(
-        this.ext_handTracking,
-        space,
-        predictedDisplayTime,
-    )) |joints| {
-        for (joints) |joint| {
-            try this.cubes.append(.{
-                .Pose = joint.pose,
-                .Scale = .{ .x = 0.02, .y = 0.02, .z = 0.02 },
-            });
+) !void {
+    // The skinned mesh of each tracked hand, or a 2cm cube per joint without one.
+    const trackers = [2]*HandTracking{ &this.handLeft, &this.handRight };
+    for (trackers, this.jointCubes, this.handMeshes, &this.handSkins, 0..) |tracker, handles, maybe_mesh, *handSkin, hand| {
+        const located = if (this.handService) |service|
+            service.locate(hand, predictedDisplayTime, &tracker.joints)
+        else
+            try tracker.locate(this.ext_handTracking, space, predictedDisplayTime);
+        var joints = located orelse &.{};
+        handSkin.* = null;
+        if (maybe_mesh) |mesh| {
+            if (joints.len > 0) {
+                handSkin.* = .{xr_linear.Matrix4x4f{}} ** HandMesh.MAX_JOINTS;
+                mesh.skin(joints, &handSkin.*.?);
+            }
+            joints = &.{};
         }
-    }
-    // right
-    if (try this.handRight.locate(
-        this.ext_handTracking,
-        space,
-        predictedDisplayTime,
-    )) |joints| {
-        for (joints) |joint| {
-            try this.cubes.append(.{
-                .Pose = joint.pose,
-                .Scale = .{ .x = 0.02, .y = 0.02, .z = 0.02 },
-            });
+        for (handles, 0..) |handle, i| {
+            if (i < joints.len) {
+                this.store.setPose(handle, joints[i].pose);
+            }
+            this.store.setVisible(handle, i < joints.len);
         }
     }
 
-    for (this.visualizedSpaces.items) |visualizedSpace| {
-        var spaceLocation = c.XrSpaceLocation{
-            .type = c.XR_TYPE_SPACE_LOCATION,
-        };
-        const res = c.xrLocateSpace(
-            visualizedSpace,
-            space,
-            predictedDisplayTime,
-            &spaceLocation,
-        );
-        try xr_util.assert(res == 0); //, "xrLocateSpace");
-        if (c.XR_UNQUALIFIED_SUCCESS(res)) {
-            if ((spaceLocation.locationFlags & c.XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 and
-                (spaceLocation.locationFlags & c.XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0)
-            {
-                try this.cubes.append(.{
-                    .Pose = spaceLocation.pose,
-                    .Scale = .{ .x = 0.25, .y = 0.25, .z = 0.25 },
-                });
-            }
-        } else {
-            std.log.debug("Unable to locate a visualized reference space in app space: {}", .{res});
+    // For each locatable space that we want to visualize, render a 25cm cube.
+    // Static relations come from the cache, only VIEW based spaces are located per frame.
+    for (this.visualizedSpaces.entries.items, this.spaceCubes.items) |*visualizedSpace, handle| {
+        const pose = try this.visualizedSpaces.locate(visualizedSpace, space, predictedDisplayTime);
+        if (pose) |p| {
+            this.store.setPose(handle, p);
         }
+        this.store.setVisible(handle, pose != null);
     }
 
     // Render a 10cm cube scaled by grabAction for each hand. Note renderHand will only be
@@ -135,6 +195,7 @@ pub fn update(
     };
     const hands = [2]u32{ Side.LEFT, Side.RIGHT };
     for (hands) |hand| {
+        this.handPoses[hand] = null;
         var spaceLocation = c.XrSpaceLocation{
             .type = c.XR_TYPE_SPACE_LOCATION,
         };
@@ -150,10 +211,9 @@ pub fn update(
                 (spaceLocation.locationFlags & c.XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0)
             {
                 const scale = 0.1 * input.handScale[hand];
-                try this.cubes.append(.{
-                    .Pose = spaceLocation.pose,
-                    .Scale = .{ .x = scale, .y = scale, .z = scale },
-                });
+                this.store.setPose(this.handCubes[hand], spaceLocation.pose);
+                this.store.setScale(this.handCubes[hand], .{ .x = scale, .y = scale, .z = scale });
+                this.handPoses[hand] = spaceLocation.pose;
             }
         } else {
             // Tracking loss is expected when the hand is not active so only log a message
@@ -166,11 +226,81 @@ pub fn update(
                 });
             }
         }
+        this.store.setVisible(this.handCubes[hand], this.handPoses[hand] != null);
     }
 
+    // A 3cm cube where the ray along each hand's -Z meets the scene model.
+    if (this.sceneModel) |model| {
+        try model.update(space, predictedDisplayTime);
+    }
+    for (this.hitCubes, this.handPoses) |handle, maybe_pose| {
+        var hit: ?SceneModel.Hit = null;
+        if (this.sceneModel) |model| {
+            if (maybe_pose) |pose| {
+                const rotation = xr_linear.Matrix4x4f.createFromQuaternion(pose.orientation);
+                const forward = c.XrVector3f{ .x = -rotation.m[8], .y = -rotation.m[9], .z = -rotation.m[10] };
+                hit = model.raycast(pose.position, forward, MAX_RAY_DISTANCE);
+            }
+        }
+        if (hit) |h| {
+            this.store.setPose(handle, .{ .orientation = geometry.XrPosef_Identity().orientation, .position = h.position });
+        }
+        this.store.setVisible(handle, hit != null);
+    }
+}
+
+// The shown objects of the store as a flat cube list, for the renderers that take one. Renderers
+// that consume the store's dirty ranges, see GraphicsRendererGlad.uploadStore, never call this.
+pub fn buildCubes(this: *@This()) ![]geometry.Cube {
+    try this.cubes.resize(0);
+    try this.store.appendCubes(&this.cubes);
     return this.cubes.items;
 }
 
+// Locate the hands again for the same display time and return, per hand, the transform that
+// moves the pose used by update to the fresh one. Identity when either location is missing.
+pub fn latchHands(
+    this: @This(),
+    space: c.XrSpace,
+    input: *const InputState,
+    predictedDisplayTime: i64,
+) [2]xr_linear.Matrix4x4f {
+    var deltas = [2]xr_linear.Matrix4x4f{ .{}, .{} };
+    for (this.handPoses, 0..) |maybe_pose, hand| {
+        const pose = maybe_pose orelse continue;
+        var spaceLocation = c.XrSpaceLocation{
+            .type = c.XR_TYPE_SPACE_LOCATION,
+        };
+        const res = c.xrLocateSpace(input.handSpace[hand], space, predictedDisplayTime, &spaceLocation);
+        if (!c.XR_UNQUALIFIED_SUCCESS(res) or
+            (spaceLocation.locationFlags & c.XR_SPACE_LOCATION_POSITION_VALID_BIT) == 0 or
+            (spaceLocation.locationFlags & c.XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) == 0)
+        {
+            continue;
+        }
+        const early = xr_linear.Matrix4x4f.createFromRigidTransform(pose);
+        const late = xr_linear.Matrix4x4f.createFromRigidTransform(spaceLocation.pose);
+        deltas[hand] = late.multiply(early.invertRigidBody());
+    }
+    return deltas;
+}
+
+// The hand trackers, for an InputSampler that locates the palms off the render thread.
+pub fn handTrackers(this: @This()) InputSampler.HandTrackers {
+    return .{
+        .ext = this.ext_handTracking,
+        .trackers = .{ this.handLeft.tracker, this.handRight.tracker },
+    };
+}
+
+// The relation between reference spaces changes at changeTime, e.g. after a recenter.
+pub fn onReferenceSpaceChange(this: *@This(), changeTime: i64) void {
+    this.visualizedSpaces.invalidate(changeTime);
+    if (this.sceneModel) |model| {
+        model.onReferenceSpaceChange(changeTime);
+    }
+}
+
 pub fn getXrReferenceSpaceCreateInfo(referenceSpaceTypeStr: []const u8) !c.XrReferenceSpaceCreateInfo {
     var referenceSpaceCreateInfo = c.XrReferenceSpaceCreateInfo{
         .type = c.XR_TYPE_REFERENCE_SPACE_CREATE_INFO,
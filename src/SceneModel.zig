@@ -0,0 +1,638 @@
+// XR_FB_scene: the triangle meshes of the room the user has set up, for drawing and ray queries.
+//
+// Discovery is asynchronous and runs on the events OpenXrProgram.pollEvents forwards: a query for
+// the room layout anchors, then one for the anchors each room contains. An anchor with a triangle
+// mesh component gets its locatable and mesh components enabled and is handed to a loader thread,
+// which reads the mesh with xrGetSpaceTriangleMeshMETA, builds a Bvh over it and queues the
+// vertex and index buffers on the GlUploader. The render thread only takes finished meshes over
+// and polls their uploads in update, so a room mesh of hundreds of thousands of triangles never
+// stalls a frame. Meshes stay in their anchor's space, which is located every frame since the
+// runtime refines anchor poses and relocalization moves them. A mesh that fails to load or upload
+// is retried on the next query complete event, and the rooms are queried again to get one.
+const std = @import("std");
+const c = @import("c");
+const xr = @import("openxr");
+const xr_result = @import("xr_result.zig");
+const xr_linear = @import("xr_linear.zig");
+const get_proc = @import("get_proc.zig");
+const Bvh = @import("Bvh.zig");
+const GlUploader = @import("GlUploader.zig");
+const SpaceCache = @import("SpaceCache.zig");
+
+pub const EXTENSION_NAMES = [_][]const u8{
+    c.XR_FB_SPATIAL_ENTITY_EXTENSION_NAME,
+    c.XR_FB_SPATIAL_ENTITY_QUERY_EXTENSION_NAME,
+    c.XR_FB_SPATIAL_ENTITY_CONTAINER_EXTENSION_NAME,
+    c.XR_FB_SCENE_EXTENSION_NAME,
+    c.XR_META_SPATIAL_ENTITY_MESH_EXTENSION_NAME,
+};
+
+const MAX_QUERY_RESULTS = 256;
+// A Bvh node this small is drawn whole instead of culled further, which keeps a view at a few
+// dozen draws.
+const CULL_GRANULARITY = 4096;
+// Loads and uploads of one mesh before it is given up.
+const MAX_ATTEMPTS = 3;
+
+pub const Mesh = struct {
+    space: c.XrSpace,
+    positions: []c.XrVector3f,
+    // Triangles in Bvh order.
+    indices: []u32,
+    bvh: Bvh,
+    // GlUploader ids of the vertex and index buffer while they are in flight.
+    uploads: ?[2]u32 = null,
+    // Buffer names once both uploads have finished, 0 before.
+    vertexBuffer: u32 = 0,
+    indexBuffer: u32 = 0,
+    uploadAttempts: u8 = 0,
+    // Anchor pose in the app space, null while it is not locatable.
+    pose: ?c.XrPosef = null,
+    model: xr_linear.Matrix4x4f = .{},
+
+    // The triangle ranges inside the view frustum of viewProjection, a GL clip space.
+    pub fn cull(self: @This(), viewProjection: xr_linear.Matrix4x4f, out: *std.array_list.Managed(Bvh.Range)) !void {
+        try out.resize(0);
+        const planes = frustumPlanes(viewProjection.multiply(self.model));
+        try self.bvh.cull(&planes, CULL_GRANULARITY, out);
+    }
+
+    fn deinit(self: *@This(), allocator: std.mem.Allocator) void {
+        self.bvh.deinit();
+        allocator.free(self.positions);
+        allocator.free(self.indices);
+    }
+};
+
+pub const Hit = struct {
+    position: c.XrVector3f,
+    distance: f32,
+};
+
+const Query = enum {
+    rooms,
+    contents,
+};
+
+// A mesh anchor found by a query, by uuid since every query returns a new space handle.
+const Anchor = struct {
+    space: c.XrSpace,
+    queued: bool = false,
+    loadAttempts: u8 = 0,
+};
+
+const Job = struct {
+    uuid: c.XrUuidEXT,
+    space: c.XrSpace,
+};
+
+allocator: std.mem.Allocator,
+session: c.XrSession,
+uploader: ?*GlUploader,
+ext_entity: xr.extensions.XR_FB_spatial_entity = .{},
+ext_query: xr.extensions.XR_FB_spatial_entity_query = .{},
+ext_container: xr.extensions.XR_FB_spatial_entity_container = .{},
+ext_scene: xr.extensions.XR_FB_scene = .{},
+ext_mesh: xr.extensions.XR_META_spatial_entity_mesh = .{},
+
+// Owned by the render thread.
+queries: std.AutoHashMap(c.XrAsyncRequestIdFB, Query),
+anchors: std.AutoHashMap(c.XrUuidEXT, Anchor),
+meshes: std.array_list.Managed(Mesh),
+// Index aligned with meshes.
+spaces: SpaceCache,
+// A load or upload failed, so the rooms are queried again once no query is in flight.
+retryPending: bool = false,
+retrying: std.array_list.Managed(c.XrUuidEXT),
+
+// Shared with the loader thread.
+thread: ?std.Thread = null,
+mutex: std.Thread.Mutex = .{},
+cond: std.Thread.Condition = .{},
+quit: bool = false,
+jobs: std.array_list.Managed(Job),
+loaded: std.array_list.Managed(Mesh),
+// Anchors whose mesh the loader could not read.
+failed: std.array_list.Managed(c.XrUuidEXT),
+
+// Heap allocated and started, since the loader thread holds a pointer to it. Without an uploader
+// the meshes are only used for ray queries.
+pub fn create(
+    allocator: std.mem.Allocator,
+    instance: c.XrInstance,
+    session: c.XrSession,
+    appSpaceType: c.XrReferenceSpaceType,
+    uploader: ?*GlUploader,
+) !*@This() {
+    const self = try allocator.create(@This());
+    self.* = .{
+        .allocator = allocator,
+        .session = session,
+        .uploader = uploader,
+        .queries = .init(allocator),
+        .anchors = .init(allocator),
+        .meshes = .init(allocator),
+        .spaces = .init(allocator, appSpaceType),
+        .retrying = .init(allocator),
+        .jobs = .init(allocator),
+        .loaded = .init(allocator),
+        .failed = .init(allocator),
+    };
+    get_proc.getProcs(@ptrCast(instance), &self.ext_entity);
+    get_proc.getProcs(@ptrCast(instance), &self.ext_query);
+    get_proc.getProcs(@ptrCast(instance), &self.ext_container);
+    get_proc.getProcs(@ptrCast(instance), &self.ext_scene);
+    get_proc.getProcs(@ptrCast(instance), &self.ext_mesh);
+
+    self.thread = std.Thread.spawn(.{}, run, .{self}) catch |e| {
+        allocator.destroy(self);
+        return e;
+    };
+    errdefer self.destroy();
+
+    try self.queryRooms();
+    return self;
+}
+
+// Call with the render context current, the mesh buffers are deleted.
+pub fn destroy(self: *@This()) void {
+    {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.quit = true;
+    }
+    self.cond.signal();
+    if (self.thread) |thread| {
+        thread.join();
+    }
+
+    for (self.loaded.items) |*mesh| {
+        self.releaseUploads(mesh);
+        mesh.deinit(self.allocator);
+    }
+    self.loaded.deinit();
+    self.jobs.deinit();
+    self.failed.deinit();
+    self.retrying.deinit();
+    for (self.meshes.items) |*mesh| {
+        self.releaseUploads(mesh);
+        if (mesh.vertexBuffer != 0) {
+            c.glDeleteBuffers(1, &mesh.vertexBuffer);
+            c.glDeleteBuffers(1, &mesh.indexBuffer);
+        }
+        mesh.deinit(self.allocator);
+    }
+    self.meshes.deinit();
+    self.spaces.deinit();
+    var it = self.anchors.valueIterator();
+    while (it.next()) |anchor| {
+        _ = c.xrDestroySpace(anchor.space);
+    }
+    self.anchors.deinit();
+    self.queries.deinit();
+    self.allocator.destroy(self);
+}
+
+// Called by OpenXrProgram.pollEvents for the spatial entity events.
+pub fn onEvent(self: *@This(), event: *const c.XrEventDataBaseHeader) void {
+    switch (event.type) {
+        c.XR_TYPE_EVENT_DATA_SPACE_QUERY_RESULTS_AVAILABLE_FB => {
+            const available: *const c.XrEventDataSpaceQueryResultsAvailableFB = @ptrCast(event);
+            const kind = self.queries.get(available.requestId) orelse return;
+            self.retrieve(available.requestId, kind) catch |e| {
+                std.log.warn("scene model: {s} query: {s}", .{ @tagName(kind), @errorName(e) });
+            };
+        },
+        c.XR_TYPE_EVENT_DATA_SPACE_QUERY_COMPLETE_FB => {
+            const complete: *const c.XrEventDataSpaceQueryCompleteFB = @ptrCast(event);
+            const entry = self.queries.fetchRemove(complete.requestId) orelse return;
+            if (complete.result != c.XR_SUCCESS) {
+                std.log.warn("scene model: {s} query failed: {}", .{ @tagName(entry.value), complete.result });
+            }
+            self.retry() catch |e| {
+                std.log.warn("scene model: retry: {s}", .{@errorName(e)});
+            };
+        },
+        c.XR_TYPE_EVENT_DATA_SPACE_SET_STATUS_COMPLETE_FB => {
+            const status: *const c.XrEventDataSpaceSetStatusCompleteFB = @ptrCast(event);
+            const anchor = self.anchors.getPtr(status.uuid) orelse return;
+            if (status.result != c.XR_SUCCESS) {
+                std.log.warn("scene model: enabling component {} failed: {}", .{ status.componentType, status.result });
+                return;
+            }
+            self.prepare(status.uuid, anchor) catch |e| {
+                std.log.warn("scene model: {s}", .{@errorName(e)});
+            };
+        },
+        else => {},
+    }
+}
+
+fn queryRooms(self: *@This()) !void {
+    const filter = c.XrSpaceComponentFilterInfoFB{
+        .type = c.XR_TYPE_SPACE_COMPONENT_FILTER_INFO_FB,
+        .componentType = c.XR_SPACE_COMPONENT_TYPE_ROOM_LAYOUT_FB,
+    };
+    try self.query(.rooms, @ptrCast(&filter));
+}
+
+fn query(self: *@This(), kind: Query, filter: *const c.XrSpaceFilterInfoBaseHeaderFB) !void {
+    const info = c.XrSpaceQueryInfoFB{
+        .type = c.XR_TYPE_SPACE_QUERY_INFO_FB,
+        .queryAction = c.XR_SPACE_QUERY_ACTION_LOAD_FB,
+        .maxResultCount = MAX_QUERY_RESULTS,
+        .timeout = 0,
+        .filter = filter,
+        .excludeFilter = null,
+    };
+    var requestId: c.XrAsyncRequestIdFB = 0;
+    try xr_result.check(self.ext_query.xrQuerySpacesFB.?(self.session, @ptrCast(&info), &requestId));
+    try self.queries.put(requestId, kind);
+}
+
+fn retrieve(self: *@This(), requestId: c.XrAsyncRequestIdFB, kind: Query) !void {
+    var results = c.XrSpaceQueryResultsFB{
+        .type = c.XR_TYPE_SPACE_QUERY_RESULTS_FB,
+    };
+    try xr_result.check(self.ext_query.xrRetrieveSpaceQueryResultsFB.?(self.session, requestId, &results));
+    const items = try self.allocator.alloc(c.XrSpaceQueryResultFB, results.resultCountOutput);
+    defer self.allocator.free(items);
+    results.resultCapacityInput = @intCast(items.len);
+    results.results = items.ptr;
+    try xr_result.check(self.ext_query.xrRetrieveSpaceQueryResultsFB.?(self.session, requestId, &results));
+
+    for (items[0..results.resultCountOutput]) |result| {
+        switch (kind) {
+            .rooms => self.addRoom(result.space) catch |e| {
+                std.log.warn("scene model: room: {s}", .{@errorName(e)});
+            },
+            .contents => self.addAnchor(result) catch |e| {
+                std.log.warn("scene model: anchor: {s}", .{@errorName(e)});
+            },
+        }
+    }
+}
+
+// Query the anchors the room contains. Only their uuids are needed, so the room space goes.
+fn addRoom(self: *@This(), space: c.XrSpace) !void {
+    defer _ = c.xrDestroySpace(space);
+
+    var layout = c.XrRoomLayoutFB{
+        .type = c.XR_TYPE_ROOM_LAYOUT_FB,
+    };
+    if (self.ext_scene.xrGetSpaceRoomLayoutFB.?(self.session, space, &layout) == c.XR_SUCCESS) {
+        std.log.info("scene model: room with {} walls", .{layout.wallUuidCountOutput});
+    }
+
+    var container = c.XrSpaceContainerFB{
+        .type = c.XR_TYPE_SPACE_CONTAINER_FB,
+    };
+    try xr_result.check(self.ext_container.xrGetSpaceContainerFB.?(self.session, space, &container));
+    const uuids = try self.allocator.alloc(c.XrUuidEXT, container.uuidCountOutput);
+    defer self.allocator.free(uuids);
+    container.uuidCapacityInput = @intCast(uuids.len);
+    container.uuids = uuids.ptr;
+    try xr_result.check(self.ext_container.xrGetSpaceContainerFB.?(self.session, space, &container));
+    if (container.uuidCountOutput == 0) {
+        return;
+    }
+
+    const filter = c.XrSpaceUuidFilterInfoFB{
+        .type = c.XR_TYPE_SPACE_UUID_FILTER_INFO_FB,
+        .uuidCount = container.uuidCountOutput,
+        .uuids = uuids.ptr,
+    };
+    try self.query(.contents, @ptrCast(&filter));
+}
+
+// Keep the anchors with a triangle mesh, the walls and furniture without one are dropped.
+fn addAnchor(self: *@This(), result: c.XrSpaceQueryResultFB) !void {
+    // The space is owned by anchors once it is put there, until then every exit destroys it.
+    var owned = false;
+    defer if (!owned) {
+        _ = c.xrDestroySpace(result.space);
+    };
+    if (self.anchors.contains(result.uuid) or !try self.supports(result.space, c.XR_SPACE_COMPONENT_TYPE_TRIANGLE_MESH_META)) {
+        return;
+    }
+    try self.anchors.put(result.uuid, .{ .space = result.space });
+    owned = true;
+    try self.prepare(result.uuid, self.anchors.getPtr(result.uuid).?);
+}
+
+fn supports(self: *@This(), space: c.XrSpace, component: c.XrSpaceComponentTypeFB) !bool {
+    const enumerate = self.ext_entity.xrEnumerateSpaceSupportedComponentsFB.?;
+    var count: u32 = 0;
+    try xr_result.check(enumerate(space, 0, &count, null));
+    const components = try self.allocator.alloc(c.XrSpaceComponentTypeFB, count);
+    defer self.allocator.free(components);
+    try xr_result.check(enumerate(space, @intCast(components.len), &count, components.ptr));
+    return std.mem.indexOfScalar(c.XrSpaceComponentTypeFB, components[0..count], component) != null;
+}
+
+// Queue the mesh for the loader once the components it needs are enabled. Otherwise enable them,
+// and come back with XR_TYPE_EVENT_DATA_SPACE_SET_STATUS_COMPLETE_FB.
+fn prepare(self: *@This(), uuid: c.XrUuidEXT, anchor: *Anchor) !void {
+    if (anchor.queued) {
+        return;
+    }
+    var ready = true;
+    for ([_]c.XrSpaceComponentTypeFB{
+        c.XR_SPACE_COMPONENT_TYPE_LOCATABLE_FB,
+        c.XR_SPACE_COMPONENT_TYPE_TRIANGLE_MESH_META,
+    }) |component| {
+        var status = c.XrSpaceComponentStatusFB{
+            .type = c.XR_TYPE_SPACE_COMPONENT_STATUS_FB,
+        };
+        try xr_result.check(self.ext_entity.xrGetSpaceComponentStatusFB.?(anchor.space, component, &status));
+        if (status.enabled == c.XR_TRUE) {
+            continue;
+        }
+        ready = false;
+        if (status.changePending == c.XR_FALSE) {
+            const setInfo = c.XrSpaceComponentStatusSetInfoFB{
+                .type = c.XR_TYPE_SPACE_COMPONENT_STATUS_SET_INFO_FB,
+                .componentType = component,
+                .enabled = c.XR_TRUE,
+                .timeout = 0,
+            };
+            var requestId: c.XrAsyncRequestIdFB = 0;
+            try xr_result.check(self.ext_entity.xrSetSpaceComponentStatusFB.?(anchor.space, &setInfo, &requestId));
+        }
+    }
+    if (!ready) {
+        return;
+    }
+
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    try self.jobs.append(.{ .uuid = uuid, .space = anchor.space });
+    anchor.queued = true;
+    anchor.loadAttempts += 1;
+    self.cond.signal();
+}
+
+// Queue the failed loads and uploads again, up to MAX_ATTEMPTS each.
+fn retry(self: *@This()) !void {
+    if (self.uploader) |uploader| {
+        for (self.meshes.items) |*mesh| {
+            if (mesh.uploads != null or mesh.vertexBuffer != 0) {
+                continue;
+            }
+            if (mesh.uploadAttempts >= MAX_ATTEMPTS) {
+                continue;
+            }
+            try submitUploads(uploader, mesh);
+        }
+    }
+
+    {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.retrying.appendSlice(self.failed.items);
+        self.failed.clearRetainingCapacity();
+    }
+    defer self.retrying.clearRetainingCapacity();
+    for (self.retrying.items) |uuid| {
+        const anchor = self.anchors.getPtr(uuid) orelse continue;
+        if (anchor.loadAttempts >= MAX_ATTEMPTS) {
+            std.log.warn("scene model: mesh failed to load {} times, giving up", .{anchor.loadAttempts});
+            continue;
+        }
+        anchor.queued = false;
+        try self.prepare(uuid, anchor);
+    }
+}
+
+// Take over the meshes the loader has finished, pick up finished uploads and locate the anchors.
+// Call once per frame on the render thread.
+pub fn update(self: *@This(), appSpace: c.XrSpace, predictedDisplayTime: i64) !void {
+    {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        try self.meshes.ensureUnusedCapacity(self.loaded.items.len);
+        try self.spaces.entries.ensureUnusedCapacity(self.loaded.items.len);
+        for (self.loaded.items) |mesh| {
+            self.meshes.appendAssumeCapacity(mesh);
+            try self.spaces.addAnchor(mesh.space);
+        }
+        try self.loaded.resize(0);
+        if (self.failed.items.len > 0) {
+            self.retryPending = true;
+        }
+    }
+
+    const uploaderFailed = if (self.uploader) |uploader| uploader.isFailed() else false;
+    for (self.meshes.items, self.spaces.entries.items) |*mesh, *entry| {
+        if (mesh.uploads) |uploads| {
+            const uploader = self.uploader.?;
+            const vertexBuffer = uploader.poll(uploads[0]);
+            const indexBuffer = uploader.poll(uploads[1]);
+            if (vertexBuffer == .failed or indexBuffer == .failed) {
+                // Rays and culling still work on the cpu copy, the mesh is not drawn until a retry.
+                std.log.warn("scene model: mesh upload failed, attempt {} of {}", .{ mesh.uploadAttempts, MAX_ATTEMPTS });
+                self.releaseUploads(mesh);
+                if (!uploaderFailed and mesh.uploadAttempts < MAX_ATTEMPTS) {
+                    self.retryPending = true;
+                }
+            } else if (vertexBuffer == .ready and indexBuffer == .ready) {
+                mesh.vertexBuffer = vertexBuffer.ready;
+                mesh.indexBuffer = indexBuffer.ready;
+                uploader.release(uploads[0]);
+                uploader.release(uploads[1]);
+                mesh.uploads = null;
+            }
+        }
+        if (uploaderFailed and mesh.uploads == null and mesh.vertexBuffer == 0 and mesh.uploadAttempts < MAX_ATTEMPTS) {
+            uploadNow(mesh);
+        }
+        mesh.pose = try self.spaces.locate(entry, appSpace, predictedDisplayTime);
+        if (mesh.pose) |pose| {
+            mesh.model = xr_linear.Matrix4x4f.createFromRigidTransform(pose);
+        }
+    }
+
+    // Failures are retried on a query complete event, so make sure one comes.
+    if (self.retryPending and self.queries.count() == 0) {
+        self.retryPending = false;
+        try self.queryRooms();
+    }
+}
+
+// Queue the vertex and index buffer of mesh. The loader and the render thread both call it. A
+// failed uploader leaves the mesh to uploadNow in update.
+fn submitUploads(uploader: *GlUploader, mesh: *Mesh) !void {
+    mesh.uploads = uploader.submitAll(2, .{
+        .{ .buffer = .{ .data = std.mem.sliceAsBytes(mesh.positions) } },
+        .{ .buffer = .{ .data = std.mem.sliceAsBytes(mesh.indices) } },
+    }) catch |e| switch (e) {
+        error.UploaderFailed => return,
+        else => |err| return err,
+    };
+    mesh.uploadAttempts += 1;
+}
+
+// Upload the vertex and index buffer on the render thread, once the uploader has failed.
+fn uploadNow(mesh: *Mesh) void {
+    mesh.uploadAttempts += 1;
+    const vertexBuffer = GlUploader.upload(.{ .buffer = .{ .data = std.mem.sliceAsBytes(mesh.positions) } }) orelse {
+        std.log.warn("scene model: mesh upload failed, attempt {} of {}", .{ mesh.uploadAttempts, MAX_ATTEMPTS });
+        return;
+    };
+    const indexBuffer = GlUploader.upload(.{ .buffer = .{ .data = std.mem.sliceAsBytes(mesh.indices) } }) orelse {
+        std.log.warn("scene model: mesh upload failed, attempt {} of {}", .{ mesh.uploadAttempts, MAX_ATTEMPTS });
+        c.glDeleteBuffers(1, &vertexBuffer);
+        return;
+    };
+    mesh.vertexBuffer = vertexBuffer;
+    mesh.indexBuffer = indexBuffer;
+}
+
+// Drop uploads that were not taken over, a buffer already finished is deleted.
+fn releaseUploads(self: *@This(), mesh: *Mesh) void {
+    const uploads = mesh.uploads orelse return;
+    const uploader = self.uploader.?;
+    for (uploads) |id| {
+        switch (uploader.poll(id)) {
+            .ready => |buffer| c.glDeleteBuffers(1, &buffer),
+            .pending, .failed => {},
+        }
+        uploader.release(id);
+    }
+    mesh.uploads = null;
+}
+
+// The relation between reference spaces changes at changeTime, e.g. after a recenter.
+pub fn onReferenceSpaceChange(self: *@This(), changeTime: i64) void {
+    self.spaces.invalidate(changeTime);
+}
+
+// The nearest point of any located mesh on the ray from origin along direction, a unit vector in
+// the app space, within maxDistance meters.
+pub fn raycast(self: @This(), origin: c.XrVector3f, direction: c.XrVector3f, maxDistance: f32) ?Hit {
+    var nearest: ?Hit = null;
+    var limit = maxDistance;
+    for (self.meshes.items) |mesh| {
+        if (mesh.pose == null) {
+            continue;
+        }
+        // Into the anchor space. A rigid transform keeps distances, so limit carries over.
+        const inverse = mesh.model.invertRigidBody();
+        const hit = mesh.bvh.raycast(
+            mesh.positions,
+            mesh.indices,
+            transform(inverse, Bvh.vec3(origin), 1),
+            transform(inverse, Bvh.vec3(direction), 0),
+            limit,
+        ) orelse continue;
+        limit = hit.distance;
+        nearest = .{
+            .distance = hit.distance,
+            .position = .{
+                .x = origin.x + direction.x * hit.distance,
+                .y = origin.y + direction.y * hit.distance,
+                .z = origin.z + direction.z * hit.distance,
+            },
+        };
+    }
+    return nearest;
+}
+
+fn transform(m: xr_linear.Matrix4x4f, v: Bvh.Vec3, w: f32) Bvh.Vec3 {
+    return .{
+        m.m[0] * v[0] + m.m[4] * v[1] + m.m[8] * v[2] + m.m[12] * w,
+        m.m[1] * v[0] + m.m[5] * v[1] + m.m[9] * v[2] + m.m[13] * w,
+        m.m[2] * v[0] + m.m[6] * v[1] + m.m[10] * v[2] + m.m[14] * w,
+    };
+}
+
+// The six planes of a GL clip space, -w <= x, y, z <= w, in the space m projects from. With an
+// infinite far plane the far plane degenerates to one that everything is inside of.
+fn frustumPlanes(m: xr_linear.Matrix4x4f) [6]Bvh.Plane {
+    var rows: [4]Bvh.Plane = undefined;
+    for (&rows, 0..) |*row, i| {
+        row.* = .{ m.m[i], m.m[4 + i], m.m[8 + i], m.m[12 + i] };
+    }
+    return .{
+        rows[3] + rows[0],
+        rows[3] - rows[0],
+        rows[3] + rows[1],
+        rows[3] - rows[1],
+        rows[3] + rows[2],
+        rows[3] - rows[2],
+    };
+}
+
+fn run(self: *@This()) void {
+    while (true) {
+        const job = blk: {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            while (self.jobs.items.len == 0 and !self.quit) {
+                self.cond.wait(&self.mutex);
+            }
+            if (self.quit) {
+                return;
+            }
+            break :blk self.jobs.orderedRemove(0);
+        };
+
+        var mesh = self.load(job.space) catch |e| {
+            std.log.warn("scene model: mesh: {s}, retried on the next query", .{@errorName(e)});
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.failed.append(job.uuid) catch {};
+            continue;
+        };
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.loaded.append(mesh) catch {
+            mesh.deinit(self.allocator);
+        };
+    }
+}
+
+// On the loader thread: read the mesh, build its Bvh and queue its buffers.
+fn load(self: *@This(), space: c.XrSpace) !Mesh {
+    var timer = try std.time.Timer.start();
+    const getInfo = c.XrSpaceTriangleMeshGetInfoMETA{
+        .type = c.XR_TYPE_SPACE_TRIANGLE_MESH_GET_INFO_META,
+    };
+    var triangleMesh = c.XrSpaceTriangleMeshMETA{
+        .type = c.XR_TYPE_SPACE_TRIANGLE_MESH_META,
+    };
+    try xr_result.check(self.ext_mesh.xrGetSpaceTriangleMeshMETA.?(space, &getInfo, &triangleMesh));
+    const positions = try self.allocator.alloc(c.XrVector3f, triangleMesh.vertexCountOutput);
+    errdefer self.allocator.free(positions);
+    const indices = try self.allocator.alloc(u32, triangleMesh.indexCountOutput);
+    errdefer self.allocator.free(indices);
+    triangleMesh.vertexCapacityInput = @intCast(positions.len);
+    triangleMesh.vertices = positions.ptr;
+    triangleMesh.indexCapacityInput = @intCast(indices.len);
+    triangleMesh.indices = indices.ptr;
+    try xr_result.check(self.ext_mesh.xrGetSpaceTriangleMeshMETA.?(space, &getInfo, &triangleMesh));
+    const readTime = timer.lap();
+
+    var bvh = try Bvh.build(self.allocator, positions, indices);
+    errdefer bvh.deinit();
+    const buildTime = timer.lap();
+
+    var mesh = Mesh{
+        .space = space,
+        .positions = positions,
+        .indices = indices,
+        .bvh = bvh,
+    };
+    if (self.uploader) |uploader| {
+        try submitUploads(uploader, &mesh);
+    }
+    std.log.info("scene model: mesh with {} vertices, {} triangles, read in {d:.1} ms, bvh of {} nodes and depth {} in {d:.1} ms", .{
+        positions.len,
+        indices.len / 3,
+        @as(f64, @floatFromInt(readTime)) / std.time.ns_per_ms,
+        bvh.nodes.len,
+        bvh.depth,
+        @as(f64, @floatFromInt(buildTime)) / std.time.ns_per_ms,
+    });
+    return mesh;
+}
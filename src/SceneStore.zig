@@ -0,0 +1,197 @@
+// Scene objects in structure-of-arrays form with stable handles and per-object dirty bits.
+//
+// A handle is the object's index, which never changes while the object lives; removed indices go
+// to a free list and are reused by add. Setters mark an object dirty only when a value actually
+// changes, so a mostly static scene produces a few short dirty ranges per frame and the renderer
+// uploads just those, see GraphicsRendererGlad.uploadStore. Removed and hidden objects keep their
+// instance slot and are written as zero-scale instances.
+const std = @import("std");
+const xr = @import("openxr").c;
+const geometry = @import("geometry.zig");
+
+pub const Handle = enum(u32) { _ };
+
+pub const Flags = packed struct(u8) {
+    alive: bool = true,
+    visible: bool = true,
+    attachment: geometry.Attachment = .world,
+    _: u4 = 0,
+};
+
+pub const Object = struct {
+    position: xr.XrVector3f,
+    orientation: xr.XrQuaternionf,
+    scale: xr.XrVector3f,
+    // See geometry.Instance.Color.
+    color: u32 = 0xffffffff,
+    flags: Flags = .{},
+};
+
+// Half-open range of object indices.
+pub const Range = struct {
+    begin: u32,
+    end: u32,
+};
+
+// Clean runs shorter than this between two dirty runs are uploaded with them, which is cheaper
+// than another upload call.
+const MERGE_GAP = 16;
+
+allocator: std.mem.Allocator,
+objects: std.MultiArrayList(Object) = .{},
+dirty: std.DynamicBitSetUnmanaged = .{},
+free: std.array_list.Managed(u32),
+
+pub fn init(allocator: std.mem.Allocator) @This() {
+    return .{
+        .allocator = allocator,
+        .free = .init(allocator),
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    self.objects.deinit(self.allocator);
+    self.dirty.deinit(self.allocator);
+    self.free.deinit();
+}
+
+// Number of instance slots, including removed objects.
+pub fn len(self: @This()) usize {
+    return self.objects.len;
+}
+
+pub fn add(self: *@This(), object: Object) !Handle {
+    const index: u32 = if (self.free.pop()) |index| blk: {
+        self.objects.set(index, object);
+        break :blk index;
+    } else blk: {
+        try self.objects.append(self.allocator, object);
+        try self.dirty.resize(self.allocator, self.objects.len, false);
+        break :blk @intCast(self.objects.len - 1);
+    };
+    self.dirty.set(index);
+    return @enumFromInt(index);
+}
+
+pub fn remove(self: *@This(), handle: Handle) !void {
+    const index = @intFromEnum(handle);
+    const flags = &self.objects.items(.flags)[index];
+    std.debug.assert(flags.alive);
+    flags.alive = false;
+    self.dirty.set(index);
+    try self.free.append(index);
+}
+
+pub fn get(self: @This(), handle: Handle) Object {
+    return self.objects.get(@intFromEnum(handle));
+}
+
+pub fn setPose(self: *@This(), handle: Handle, pose: xr.XrPosef) void {
+    const index = @intFromEnum(handle);
+    const slice = self.objects.slice();
+    const position = &slice.items(.position)[index];
+    const orientation = &slice.items(.orientation)[index];
+    if (!std.meta.eql(position.*, pose.position) or !std.meta.eql(orientation.*, pose.orientation)) {
+        position.* = pose.position;
+        orientation.* = pose.orientation;
+        self.dirty.set(index);
+    }
+}
+
+pub fn setScale(self: *@This(), handle: Handle, scale: xr.XrVector3f) void {
+    self.setField(.scale, handle, scale);
+}
+
+pub fn setColor(self: *@This(), handle: Handle, color: u32) void {
+    self.setField(.color, handle, color);
+}
+
+pub fn setVisible(self: *@This(), handle: Handle, visible: bool) void {
+    const index = @intFromEnum(handle);
+    const flags = &self.objects.items(.flags)[index];
+    if (flags.visible != visible) {
+        flags.visible = visible;
+        self.dirty.set(index);
+    }
+}
+
+fn setField(
+    self: *@This(),
+    comptime field: std.MultiArrayList(Object).Field,
+    handle: Handle,
+    value: @FieldType(Object, @tagName(field)),
+) void {
+    const index = @intFromEnum(handle);
+    const item = &self.objects.items(field)[index];
+    if (!std.meta.eql(item.*, value)) {
+        item.* = value;
+        self.dirty.set(index);
+    }
+}
+
+pub fn isDirty(self: @This()) bool {
+    return self.dirty.findFirstSet() != null;
+}
+
+// Everything is uploaded again, e.g. after the instance buffer was reallocated.
+pub fn markAllDirty(self: *@This()) void {
+    self.dirty.setRangeValue(.{ .start = 0, .end = self.objects.len }, true);
+}
+
+// Append the dirty runs in index order, with short clean gaps merged in.
+pub fn dirtyRanges(self: @This(), out: *std.array_list.Managed(Range)) !void {
+    var it = self.dirty.iterator(.{});
+    var current: ?Range = null;
+    while (it.next()) |i| {
+        const index: u32 = @intCast(i);
+        if (current) |*range| {
+            if (index <= range.end + MERGE_GAP) {
+                range.end = index + 1;
+                continue;
+            }
+            try out.append(range.*);
+        }
+        current = .{ .begin = index, .end = index + 1 };
+    }
+    if (current) |range| {
+        try out.append(range);
+    }
+}
+
+pub fn clearDirty(self: *@This()) void {
+    self.dirty.unsetAll();
+}
+
+// Instances for the objects in range, index aligned. Removed and hidden objects get zero scale.
+pub fn writeInstances(self: @This(), range: Range, out: []geometry.Instance) void {
+    const slice = self.objects.slice();
+    const positions = slice.items(.position)[range.begin..range.end];
+    const orientations = slice.items(.orientation)[range.begin..range.end];
+    const scales = slice.items(.scale)[range.begin..range.end];
+    const colors = slice.items(.color)[range.begin..range.end];
+    const flags = slice.items(.flags)[range.begin..range.end];
+    for (out[0 .. range.end - range.begin], positions, orientations, scales, colors, flags) |*instance, position, orientation, scale, color, flag| {
+        const shown = flag.alive and flag.visible;
+        instance.* = .{
+            .Orientation = orientation,
+            .Position = position,
+            .Scale = if (shown) scale else .{ .x = 0, .y = 0, .z = 0 },
+            .Attachment = @intFromEnum(flag.attachment),
+            .Color = color,
+        };
+    }
+}
+
+// The shown objects as cubes, for the renderers that take a cube list.
+pub fn appendCubes(self: @This(), out: *std.array_list.Managed(geometry.Cube)) !void {
+    const slice = self.objects.slice();
+    for (slice.items(.position), slice.items(.orientation), slice.items(.scale), slice.items(.flags)) |position, orientation, scale, flag| {
+        if (flag.alive and flag.visible) {
+            try out.append(.{
+                .Pose = .{ .orientation = orientation, .position = position },
+                .Scale = scale,
+                .Attachment = flag.attachment,
+            });
+        }
+    }
+}
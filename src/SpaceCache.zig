@@ -0,0 +1,92 @@
+// Locations of visualized reference spaces in the app space.
+//
+// Two reference spaces that are both not VIEW keep their relation until the runtime announces a
+// reference space change, so such a pair is located once and reused. Spaces on the VIEW side
+// follow the head and are located every frame.
+const std = @import("std");
+const c = @import("c");
+
+pub const Entry = struct {
+    space: c.XrSpace,
+    // Fixed relative to the app space while no reference space change is pending.
+    static: bool,
+    pose: ?c.XrPosef = null,
+};
+
+appSpaceType: c.XrReferenceSpaceType,
+entries: std.array_list.Managed(Entry),
+// A pending reference space change takes effect at this display time. Static relations are
+// located every frame until then, so the old relation is not cached again.
+changeTime: i64 = 0,
+
+pub fn init(allocator: std.mem.Allocator, appSpaceType: c.XrReferenceSpaceType) @This() {
+    return .{
+        .appSpaceType = appSpaceType,
+        .entries = .init(allocator),
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    self.entries.deinit();
+}
+
+pub fn add(self: *@This(), space: c.XrSpace, spaceType: c.XrReferenceSpaceType) !void {
+    try self.entries.append(.{
+        .space = space,
+        .static = spaceType != c.XR_REFERENCE_SPACE_TYPE_VIEW and
+            self.appSpaceType != c.XR_REFERENCE_SPACE_TYPE_VIEW,
+    });
+}
+
+// A spatial anchor. The runtime refines anchor poses and moves them on relocalization, so an
+// anchor is located every frame.
+pub fn addAnchor(self: *@This(), space: c.XrSpace) !void {
+    try self.entries.append(.{
+        .space = space,
+        .static = false,
+    });
+}
+
+// Called for XR_TYPE_EVENT_DATA_REFERENCE_SPACE_CHANGE_PENDING.
+pub fn invalidate(self: *@This(), changeTime: i64) void {
+    for (self.entries.items) |*entry| {
+        entry.pose = null;
+    }
+    self.changeTime = @max(self.changeTime, changeTime);
+}
+
+// Pose of entry in appSpace, or null while it is not locatable.
+pub fn locate(
+    self: *@This(),
+    entry: *Entry,
+    appSpace: c.XrSpace,
+    predictedDisplayTime: i64,
+) !?c.XrPosef {
+    if (entry.pose) |pose| {
+        return pose;
+    }
+
+    var spaceLocation = c.XrSpaceLocation{
+        .type = c.XR_TYPE_SPACE_LOCATION,
+    };
+    const res = c.xrLocateSpace(entry.space, appSpace, predictedDisplayTime, &spaceLocation);
+    if (!c.XR_UNQUALIFIED_SUCCESS(res)) {
+        std.log.debug("Unable to locate a visualized reference space in app space: {}", .{res});
+        return null;
+    }
+    if ((spaceLocation.locationFlags & c.XR_SPACE_LOCATION_POSITION_VALID_BIT) == 0 or
+        (spaceLocation.locationFlags & c.XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) == 0)
+    {
+        return null;
+    }
+
+    // A pose that is valid but not tracked is an estimate, e.g. during tracking loss, and would
+    // stay frozen if it were cached.
+    const tracked = c.XR_SPACE_LOCATION_POSITION_TRACKED_BIT | c.XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT;
+    if (entry.static and predictedDisplayTime > self.changeTime and
+        (spaceLocation.locationFlags & tracked) == tracked)
+    {
+        entry.pose = spaceLocation.pose;
+    }
+    return spaceLocation.pose;
+}
@@ -0,0 +1,213 @@
+// XR_FB_space_warp: the app renders at half the display rate and the runtime synthesizes the
+// frames in between from a motion vector image and a depth image per view.
+//
+// Motion vectors hold the NDC delta of every surface point between the previous and the current
+// frame, from object motion only: both positions use the current view-projection, head motion is
+// reprojected by the runtime from depth. Submitting XrCompositionLayerSpaceWarpInfoFB on the
+// projection views makes the runtime pace xrWaitFrame at half rate; stop submitting it to return
+// to full rate.
+const std = @import("std");
+const c = @import("c");
+const xr_result = @import("xr_result.zig");
+const xr_linear = @import("xr_linear.zig");
+const geometry = @import("geometry.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+
+pub const EXTENSION_NAME = c.XR_FB_SPACE_WARP_EXTENSION_NAME;
+
+const MAX_VIEWS = 2;
+
+// Indices of the acquired images into motionVectorImages and depthImages of the view.
+pub const Images = struct {
+    motionVector: u32,
+    depth: u32,
+};
+
+allocator: std.mem.Allocator,
+enabled: bool,
+width: u32 = 0,
+height: u32 = 0,
+viewCount: usize = 0,
+motionVectorSwapchains: [MAX_VIEWS]c.XrSwapchain = .{ null, null },
+depthSwapchains: [MAX_VIEWS]c.XrSwapchain = .{ null, null },
+motionVectorImages: [MAX_VIEWS]GraphicsPlugin.SwapchainImages = undefined,
+depthImages: [MAX_VIEWS]GraphicsPlugin.SwapchainImages = undefined,
+infos: [MAX_VIEWS]c.XrCompositionLayerSpaceWarpInfoFB = undefined,
+// Model matrices of the cubes this frame and the previous one, index aligned.
+models: std.array_list.Managed(xr_linear.Matrix4x4f),
+prevModels: std.array_list.Managed(xr_linear.Matrix4x4f),
+
+pub fn init(
+    allocator: std.mem.Allocator,
+    instance: c.XrInstance,
+    systemId: c.XrSystemId,
+    session: c.XrSession,
+    graphics: *GraphicsPlugin,
+    viewCount: usize,
+    enabled: bool,
+) !@This() {
+    var spaceWarpProperties = c.XrSystemSpaceWarpPropertiesFB{
+        .type = c.XR_TYPE_SYSTEM_SPACE_WARP_PROPERTIES_FB,
+    };
+    var systemProperties = c.XrSystemProperties{
+        .type = c.XR_TYPE_SYSTEM_PROPERTIES,
+        .next = &spaceWarpProperties,
+    };
+    try xr_result.check(c.xrGetSystemProperties(instance, systemId, &systemProperties));
+
+    var self = @This(){
+        .allocator = allocator,
+        .enabled = enabled,
+        .width = spaceWarpProperties.recommendedMotionVectorImageRectWidth,
+        .height = spaceWarpProperties.recommendedMotionVectorImageRectHeight,
+        .viewCount = @min(viewCount, MAX_VIEWS),
+        .models = .init(allocator),
+        .prevModels = .init(allocator),
+    };
+    std.log.info("space warp: motion vector images {}x{}", .{ self.width, self.height });
+
+    for (0..self.viewCount) |i| {
+        self.motionVectorSwapchains[i] = try createSwapchain(
+            session,
+            graphics,
+            c.GL_RGBA16F,
+            c.XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT,
+            self.width,
+            self.height,
+            &self.motionVectorImages[i],
+        );
+        self.depthSwapchains[i] = try createSwapchain(
+            session,
+            graphics,
+            c.GL_DEPTH_COMPONENT24,
+            c.XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            self.width,
+            self.height,
+            &self.depthImages[i],
+        );
+    }
+    return self;
+}
+
+pub fn deinit(self: *@This(), graphics: GraphicsPlugin) void {
+    for (0..self.viewCount) |i| {
+        graphics.freeSwapchainImageStructs(self.motionVectorImages[i]);
+        _ = c.xrDestroySwapchain(self.motionVectorSwapchains[i]);
+        graphics.freeSwapchainImageStructs(self.depthImages[i]);
+        _ = c.xrDestroySwapchain(self.depthSwapchains[i]);
+    }
+    self.models.deinit();
+    self.prevModels.deinit();
+}
+
+// Toggle between half-rate rendering with synthesized frames and full-rate rendering.
+pub fn setEnabled(self: *@This(), enabled: bool) void {
+    if (self.enabled != enabled) {
+        std.log.info("space warp: {s}", .{if (enabled) "half rate" else "full rate"});
+    }
+    self.enabled = enabled;
+}
+
+// Call once per frame, before the views are rendered. A cube whose index did not exist last frame
+// gets no motion.
+pub fn beginFrame(self: *@This(), cubes: []const geometry.Cube) !void {
+    std.mem.swap(std.array_list.Managed(xr_linear.Matrix4x4f), &self.models, &self.prevModels);
+    try self.models.resize(cubes.len);
+    geometry.Cube.modelMatrices(cubes, self.models.items);
+    // Cubes come and go with hand tracking, so a count change breaks the index pairing.
+    if (self.prevModels.items.len != self.models.items.len) {
+        try self.prevModels.resize(0);
+        try self.prevModels.appendSlice(self.models.items);
+    }
+}
+
+pub fn acquire(self: *@This(), view: usize) !Images {
+    return .{
+        .motionVector = try acquireImage(self.motionVectorSwapchains[view]),
+        .depth = try acquireImage(self.depthSwapchains[view]),
+    };
+}
+
+pub fn release(self: *@This(), view: usize) !void {
+    const releaseInfo = c.XrSwapchainImageReleaseInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
+    };
+    try xr_result.check(c.xrReleaseSwapchainImage(self.motionVectorSwapchains[view], &releaseInfo));
+    try xr_result.check(c.xrReleaseSwapchainImage(self.depthSwapchains[view], &releaseInfo));
+}
+
+// Chain the result onto the projection view of the same index.
+pub fn layerInfo(self: *@This(), view: usize) *const c.XrCompositionLayerSpaceWarpInfoFB {
+    const rect = c.XrRect2Di{
+        .offset = .{ .x = 0, .y = 0 },
+        .extent = .{ .width = @intCast(self.width), .height = @intCast(self.height) },
+    };
+    self.infos[view] = .{
+        .type = c.XR_TYPE_COMPOSITION_LAYER_SPACE_WARP_INFO_FB,
+        .layerFlags = 0,
+        .motionVectorSubImage = .{
+            .swapchain = self.motionVectorSwapchains[view],
+            .imageRect = rect,
+            .imageArrayIndex = 0,
+        },
+        // The app space is a reference space and does not move on its own.
+        .appSpaceDeltaPose = .{
+            .orientation = .{ .x = 0, .y = 0, .z = 0, .w = 1 },
+            .position = .{ .x = 0, .y = 0, .z = 0 },
+        },
+        .depthSubImage = .{
+            .swapchain = self.depthSwapchains[view],
+            .imageRect = rect,
+            .imageArrayIndex = 0,
+        },
+        .minDepth = 0,
+        .maxDepth = 1,
+        .nearZ = GraphicsPlugin.NEAR_Z,
+        .farZ = GraphicsPlugin.FAR_Z,
+    };
+    return &self.infos[view];
+}
+
+fn createSwapchain(
+    session: c.XrSession,
+    graphics: *GraphicsPlugin,
+    format: i64,
+    usage: c.XrSwapchainUsageFlags,
+    width: u32,
+    height: u32,
+    images: *GraphicsPlugin.SwapchainImages,
+) !c.XrSwapchain {
+    const swapchainCreateInfo = c.XrSwapchainCreateInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_CREATE_INFO,
+        .usageFlags = usage,
+        .format = format,
+        .sampleCount = 1,
+        .width = width,
+        .height = height,
+        .faceCount = 1,
+        .arraySize = 1,
+        .mipCount = 1,
+    };
+    var swapchain: c.XrSwapchain = null;
+    try xr_result.check(c.xrCreateSwapchain(session, &swapchainCreateInfo, &swapchain));
+
+    var imageCount: u32 = undefined;
+    try xr_result.check(c.xrEnumerateSwapchainImages(swapchain, 0, &imageCount, null));
+    const swapchainBuffer = graphics.allocateSwapchainImageStructs(imageCount, images);
+    try xr_result.check(c.xrEnumerateSwapchainImages(swapchain, imageCount, &imageCount, swapchainBuffer));
+    return swapchain;
+}
+
+fn acquireImage(swapchain: c.XrSwapchain) !u32 {
+    var acquireInfo = c.XrSwapchainImageAcquireInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO,
+    };
+    var imageIndex: u32 = undefined;
+    try xr_result.check(c.xrAcquireSwapchainImage(swapchain, &acquireInfo, &imageIndex));
+    var waitInfo = c.XrSwapchainImageWaitInfo{
+        .type = c.XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO,
+        .timeout = c.XR_INFINITE_DURATION,
+    };
+    try xr_result.check(c.xrWaitSwapchainImage(swapchain, &waitInfo));
+    return imageIndex;
+}
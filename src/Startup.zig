@@ -0,0 +1,122 @@
+// Startup scheduler and timeline.
+//
+// Steps run either inline on the calling thread or on a worker thread, and every step records
+// when it started and ended relative to init. report logs the timeline once the first frame is
+// out, so overlapping steps and the time to first frame can be read off the log.
+const std = @import("std");
+
+const MAX_STEPS = 32;
+
+const Step = struct {
+    name: []const u8,
+    begin: u64,
+    end: u64,
+    worker: bool,
+};
+
+started: std.time.Instant,
+mutex: std.Thread.Mutex = .{},
+steps: [MAX_STEPS]Step = undefined,
+count: usize = 0,
+reported: bool = false,
+
+pub fn init() @This() {
+    return .{
+        .started = std.time.Instant.now() catch @panic("no monotonic clock"),
+    };
+}
+
+// Run func on the calling thread and return its result.
+pub fn run(
+    self: *@This(),
+    name: []const u8,
+    comptime func: anytype,
+    args: anytype,
+) @typeInfo(@TypeOf(func)).@"fn".return_type.? {
+    const begin = self.now();
+    defer self.push(name, begin, self.now(), false);
+    return @call(.auto, func, args);
+}
+
+// Run func on a new thread. func returns void and reports failure through its arguments. The
+// caller joins the returned thread before using anything the step produces.
+pub fn spawn(
+    self: *@This(),
+    name: []const u8,
+    comptime func: anytype,
+    args: anytype,
+) !std.Thread {
+    const Worker = struct {
+        fn main(startup: *Startup, step_name: []const u8, step_args: @TypeOf(args)) void {
+            const begin = startup.now();
+            @call(.auto, func, step_args);
+            startup.push(step_name, begin, startup.now(), true);
+        }
+    };
+    return std.Thread.spawn(.{}, Worker.main, .{ self, name, args });
+}
+
+// Record an instant, e.g. the first submitted frame.
+pub fn mark(self: *@This(), name: []const u8) void {
+    const t = self.now();
+    self.push(name, t, t, false);
+}
+
+// Log the timeline once. Later calls do nothing, so it can sit in the frame loop.
+pub fn report(self: *@This()) void {
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    if (self.reported) {
+        return;
+    }
+    self.reported = true;
+
+    const steps = self.steps[0..self.count];
+    std.mem.sort(Step, steps, {}, struct {
+        fn lessThan(_: void, a: Step, b: Step) bool {
+            return a.begin < b.begin;
+        }
+    }.lessThan);
+
+    var last: u64 = 0;
+    std.log.info("startup timeline:", .{});
+    for (steps) |step| {
+        std.log.info("  {d:>8.1}ms {d:>8.1}ms {s:<6} {s}", .{
+            toMs(step.begin),
+            toMs(step.end - step.begin),
+            if (step.worker) "worker" else "main",
+            step.name,
+        });
+        last = @max(last, step.end);
+    }
+    std.log.info("startup: {d:.1}ms to {s}", .{
+        toMs(last),
+        if (steps.len > 0) steps[steps.len - 1].name else "",
+    });
+}
+
+const Startup = @This();
+
+fn now(self: *const @This()) u64 {
+    const t = std.time.Instant.now() catch return 0;
+    return t.since(self.started);
+}
+
+fn push(self: *@This(), name: []const u8, begin: u64, end: u64, worker: bool) void {
+    self.mutex.lock();
+    defer self.mutex.unlock();
+    if (self.count >= MAX_STEPS) {
+        return;
+    }
+    self.steps[self.count] = .{
+        .name = name,
+        .begin = begin,
+        .end = end,
+        .worker = worker,
+    };
+    self.count += 1;
+}
+
+fn toMs(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+}
@@ -2,16 +2,33 @@ const std = @import("std");
 // const c = @import("xr_util.zig").c;
 const Options = @import("Options.zig");
 const GraphicsPlugin = @import("GraphicsPluginOpenglES.zig");
+const SwapchainTexture = @import("GraphicsPlugin.zig").SwapchainTexture;
 const OpenXrProgram = @import("OpenXrProgram.zig");
 const xr = @import("openxr").c;
 const xr_util = @import("xr_util.zig");
 const xr_result = @import("xr_result.zig");
 const Egl = @import("Egl.zig");
+const GlUploader = @import("GlUploader.zig");
 const Scene = @import("Scene.zig");
+const SceneModel = @import("SceneModel.zig");
 const RendererGLES = @import("GraphicsRendererAndroidGLES.zig");
 const RendererSokol = @import("GraphicsRendererSokol.zig");
+const Startup = @import("Startup.zig");
+const SpaceWarp = @import("SpaceWarp.zig");
+const xr_linear = @import("xr_linear.zig");
+const InputSampler = @import("InputSampler.zig");
+const HandMesh = @import("HandMesh.zig");
+const HandTrackingService = @import("HandTrackingService.zig");
 const c = @import("c");
 
+// RendererGLES is the fallback renderer and nothing calls it, so Zig would not analyze it.
+// Reference every public declaration so it keeps type-checking against the shared modules.
+comptime {
+    for (@typeInfo(RendererGLES).@"struct".decls) |decl| {
+        _ = &@field(RendererGLES, decl.name);
+    }
+}
+
 // https://ziggit.dev/t/set-debug-level-at-runtime/6196/3
 pub const std_options: std.Options = .{
     .logFn = logFn,
@@ -74,6 +91,18 @@ fn updateOptionsFromSystemProperties(allocator: std.mem.Allocator) !Options {
         options.EnvironmentBlendMode = try allocator.dupe(u8, std.mem.sliceTo(&value, 0));
     }
 
+    if (c.__system_property_get("debug.xr.spaceWarp", &value[0]) != 0) {
+        options.SpaceWarp = std.mem.eql(u8, std.mem.sliceTo(&value, 0), "true");
+    }
+
+    if (c.__system_property_get("debug.xr.inputRate", &value[0]) != 0) {
+        options.InputRate = std.fmt.parseInt(u32, std.mem.sliceTo(&value, 0), 10) catch 0;
+    }
+
+    if (c.__system_property_get("debug.xr.verbose", &value[0]) != 0) {
+        options.Verbose = std.mem.eql(u8, std.mem.sliceTo(&value, 0), "true");
+    }
+
     try options.parseStrings();
 
     return options;
@@ -128,12 +157,42 @@ export fn app_handle_cmd(app: [*c]c.android_app, cmd: i32) void {
     }
 }
 
+// Render one view's motion vectors and depth and chain them onto its projection view. On failure
+// the view is submitted without space warp info.
+fn renderSpaceWarp(
+    spaceWarp: *SpaceWarp,
+    renderer: *RendererSokol,
+    gles: *GraphicsPlugin,
+    view: usize,
+    vp: xr_linear.Matrix4x4f,
+    projectionLayerView: *xr.XrCompositionLayerProjectionView,
+) void {
+    const images = spaceWarp.acquire(view) catch |e| {
+        std.log.err("SpaceWarp.acquire: {s}", .{@errorName(e)});
+        return;
+    };
+    renderer.renderVelocity(
+        gles.swapchainTexture(spaceWarp.motionVectorImages[view], images.motionVector),
+        gles.swapchainTexture(spaceWarp.depthImages[view], images.depth),
+        @intCast(spaceWarp.width),
+        @intCast(spaceWarp.height),
+        vp,
+    );
+    spaceWarp.release(view) catch |e| {
+        std.log.err("SpaceWarp.release: {s}", .{@errorName(e)});
+        return;
+    };
+    projectionLayerView.next = spaceWarp.layerInfo(view);
+}
+
 // This is the main entry point of a native application that is using
 // android_native_app_glue.  It runs in its own thread, with its own
 // event loop for receiving input events and doing other things.
 export fn android_main(app: *c.android_app) void {
     std.log.info("#### android_main ####", .{});
 
+    var startup = Startup.init();
+
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.detectLeaks();
     const allocator = gpa.allocator();
@@ -151,15 +210,25 @@ export fn android_main(app: *c.android_app) void {
             xr_util.my_panic("{s}", .{@errorName(e)});
         };
 
-    const egl = Egl.init(
+    const egl = startup.run("egl", Egl.init, .{
         .KS_GPU_SURFACE_COLOR_FORMAT_B8G8R8A8,
         .KS_GPU_SURFACE_DEPTH_FORMAT_D24,
         .KS_GPU_SAMPLE_COUNT_1,
-    ) orelse {
+    }) orelse {
         xr_util.my_panic("Egl.init", .{});
     };
     std.log.debug("Egl.init", .{});
 
+    // Textures and buffers are uploaded on a loader thread with a context shared with the render context.
+    var shared_context = egl.createShared() orelse {
+        xr_util.my_panic("Egl.createShared", .{});
+    };
+    defer shared_context.deinit();
+    const uploader = GlUploader.create(allocator, shared_context.uploaderContext()) catch {
+        xr_util.my_panic("GlUploader.create", .{});
+    };
+    defer uploader.destroy();
+
     // Create graphics API implementation.
     const graphics_plugin = GraphicsPlugin.init(.{
         .allocator = allocator,
@@ -170,81 +239,173 @@ export fn android_main(app: *c.android_app) void {
         xr_util.my_panic("GraphicsPlugin", .{});
     };
 
+    // The renderer resolves swapchain images without the vtable.
+    const gles: *GraphicsPlugin = @ptrCast(@alignCast(graphics_plugin.ptr));
+
     // Initialize the OpenXR program.
     var program = OpenXrProgram.init(allocator, options, graphics_plugin);
     defer program.deinit();
 
-    // Initialize the loader for this platform
-    var initializeLoader: c.PFN_xrInitializeLoaderKHR = null;
-    const res = c.xrGetInstanceProcAddr(null, "xrInitializeLoaderKHR", &initializeLoader);
-    if (res == c.XR_SUCCESS) {
-        var loaderInitInfoAndroid = c.XrLoaderInitInfoAndroidKHR{
-            .type = c.XR_TYPE_LOADER_INIT_INFO_ANDROID_KHR,
-            .applicationVM = @ptrCast(app.*.activity.*.vm),
-            .applicationContext = @ptrCast(app.*.activity.*.clazz),
-        };
-        _ = (initializeLoader.?)(@ptrCast(&loaderInitInfoAndroid));
-    } else {
-        xr_util.my_panic("xrInitializeLoaderKHR: {}", .{res});
-    }
-    std.log.debug("xrInitializeLoaderKHR", .{});
+    // The OpenXR instance and system do not touch GL, so they come up on a worker while this
+    // thread, which has the EGL context current, compiles shaders and uploads geometry.
+    const XrBringUp = struct {
+        app: *c.android_app,
+        program: *OpenXrProgram,
+        options: *Options,
+        failed: ?[]const u8 = null,
+
+        fn run(self: *@This()) void {
+            self.bringUp() catch |e| {
+                self.failed = @errorName(e);
+            };
+        }
 
-    const INSTANCE_EXTENSIONS = [_][]const u8{
-        c.XR_KHR_ANDROID_CREATE_INSTANCE_EXTENSION_NAME,
+        fn bringUp(self: *@This()) !void {
+            // Initialize the loader for this platform
+            var initializeLoader: c.PFN_xrInitializeLoaderKHR = null;
+            try xr_result.check(c.xrGetInstanceProcAddr(null, "xrInitializeLoaderKHR", &initializeLoader));
+            var loaderInitInfoAndroid = c.XrLoaderInitInfoAndroidKHR{
+                .type = c.XR_TYPE_LOADER_INIT_INFO_ANDROID_KHR,
+                .applicationVM = @ptrCast(self.app.activity.*.vm),
+                .applicationContext = @ptrCast(self.app.activity.*.clazz),
+            };
+            _ = (initializeLoader.?)(@ptrCast(&loaderInitInfoAndroid));
+            std.log.debug("xrInitializeLoaderKHR", .{});
+
+            const INSTANCE_EXTENSIONS = [_][]const u8{
+                c.XR_KHR_ANDROID_CREATE_INSTANCE_EXTENSION_NAME,
+            };
+            var create_info: c.XrInstanceCreateInfoAndroidKHR = .{
+                .type = c.XR_TYPE_INSTANCE_CREATE_INFO_ANDROID_KHR,
+                .next = null,
+                .applicationVM = @ptrCast(self.app.activity.*.vm),
+                .applicationActivity = @ptrCast(self.app.activity.*.clazz),
+            };
+            try self.program.createInstance(
+                &(INSTANCE_EXTENSIONS ++ xr_util.REQUIRED_EXTENSIONS),
+                @ptrCast(&create_info),
+            );
+            try self.program.initializeSystem();
+            std.log.debug("program.initializeSystem", .{});
+
+            try self.options.setEnvironmentBlendMode(try self.program.getPreferredBlendMode());
+            std.log.debug("getPreferredBlendMode", .{});
+        }
     };
-    var create_info: c.XrInstanceCreateInfoAndroidKHR = .{
-        .type = c.XR_TYPE_INSTANCE_CREATE_INFO_ANDROID_KHR,
-        .next = null,
-        .applicationVM = @ptrCast(app.activity.*.vm),
-        .applicationActivity = @ptrCast(app.activity.*.clazz),
+    var xrBringUp = XrBringUp{
+        .app = app,
+        .program = &program,
+        .options = &options,
     };
-    program.createInstance(
-        &(INSTANCE_EXTENSIONS ++ xr_util.REQUIRED_EXTENSIONS),
-        @ptrCast(&create_info),
-    ) catch {
-        xr_util.my_panic("program.createInstance", .{});
+    const xrThread = startup.spawn("xr instance", XrBringUp.run, .{&xrBringUp}) catch {
+        xr_util.my_panic("spawn xr instance", .{});
     };
-    program.initializeSystem() catch {
-        xr_util.my_panic("initializeSystem", .{});
+
+    var renderer = startup.run("renderer", RendererSokol.init, .{allocator}) catch {
+        xr_util.my_panic("Renderer.init", .{});
     };
-    std.log.debug("program.initializeSystem", .{});
+    defer renderer.deinit();
 
-    if (program.getPreferredBlendMode()) |mode| {
-        options.setEnvironmentBlendMode(mode) catch {
-            xr_util.my_panic("setEnvironmentBlendMode", .{});
-        };
-    } else |_| {
-        xr_util.my_panic("getPreferredBlendMode", .{});
+    xrThread.join();
+    if (xrBringUp.failed) |name| {
+        xr_util.my_panic("xr instance: {s}", .{name});
     }
-    std.log.debug("getPreferredBlendMode", .{});
 
-    program.initializeDevice() catch {
+    startup.run("device", OpenXrProgram.initializeDevice, .{&program}) catch {
         xr_util.my_panic("initializeDevice", .{});
     };
-    program.initializeSession() catch {
+    startup.run("session", OpenXrProgram.initializeSession, .{&program}) catch {
         xr_util.my_panic("initializeSession", .{});
     };
-    program.createSwapchains() catch {
+    startup.run("swapchains", OpenXrProgram.createSwapchains, .{&program}) catch {
         xr_util.my_panic("createSwapchains", .{});
     };
 
-    var scene = Scene.init(allocator, program.instance, program.session) catch {
-        xr_util.my_panic("Scene.init", .{});
-    };
-    defer scene.deinit();
+    // The swapchains exist whenever the runtime supports space warp, so it can be switched on
+    // and off at runtime with setEnabled.
+    var spaceWarp: ?SpaceWarp = if (program.isExtensionEnabled(SpaceWarp.EXTENSION_NAME)) SpaceWarp.init(
+        allocator,
+        program.instance,
+        program.systemId,
+        program.session,
+        &program.graphics,
+        program.views.items.len,
+        options.SpaceWarp,
+    ) catch {
+        xr_util.my_panic("SpaceWarp.init", .{});
+    } else null;
+    defer if (spaceWarp) |*sw| sw.deinit(program.graphics);
+    // The sokol images wrapping swapchain textures go before the swapchains do.
+    defer renderer.releaseAttachments();
 
     const referenceSpaceCreateInfo = Scene.getXrReferenceSpaceCreateInfo(options.AppSpace) catch {
         xr_util.my_panic("Scene.getXrReferenceSpaceCreateInfo", .{});
     };
+
+    var scene = startup.run("scene", Scene.init, .{
+        allocator,
+        program.instance,
+        program.session,
+        referenceSpaceCreateInfo.referenceSpaceType,
+        program.isExtensionEnabled(HandMesh.EXTENSION_NAME),
+    }) catch {
+        xr_util.my_panic("Scene.init", .{});
+    };
+    defer scene.deinit();
+    renderer.loadHandMeshes(scene.handMeshes);
     var space: xr.XrSpace = null;
     xr_result.check(xr.xrCreateReferenceSpace(program.session, &referenceSpaceCreateInfo, &space)) catch {
         xr_util.my_panic("xrCreateReferenceSpace", .{});
     };
 
-    var renderer = RendererSokol.init(allocator) catch {
-        xr_util.my_panic("Renderer.init", .{});
+    // With debug.xr.inputRate the actions are synced on the sampler thread instead of per frame.
+    const inputSampler: ?*InputSampler = if (options.InputRate == 0)
+        null
+    else if (!program.isExtensionEnabled(InputSampler.CLOCK_EXTENSION_NAME)) blk: {
+        std.log.warn("input sampler: {s} not supported", .{InputSampler.CLOCK_EXTENSION_NAME});
+        break :blk null;
+    } else InputSampler.create(
+        allocator,
+        program.instance,
+        program.session,
+        &program.input,
+        space,
+        scene.handTrackers(),
+        options.InputRate,
+    ) catch {
+        xr_util.my_panic("InputSampler.create", .{});
     };
-    defer renderer.deinit();
+    defer if (inputSampler) |sampler| sampler.destroy(allocator);
+
+    // Both hands are located on a worker, the frame takes the newest result.
+    const handService = HandTrackingService.create(allocator, scene.handTrackers(), space) catch {
+        xr_util.my_panic("HandTrackingService.create", .{});
+    };
+    defer handService.destroy(allocator);
+    scene.handService = handService;
+
+    // The room meshes are loaded in the background, for the hand rays and drawn over the scene.
+    const sceneModel: ?*SceneModel = for (SceneModel.EXTENSION_NAMES) |name| {
+        if (!program.isExtensionEnabled(name)) {
+            break null;
+        }
+    } else SceneModel.create(
+        allocator,
+        program.instance,
+        program.session,
+        referenceSpaceCreateInfo.referenceSpaceType,
+        uploader,
+    ) catch |e| blk: {
+        std.log.warn("scene model: {s}", .{@errorName(e)});
+        break :blk null;
+    };
+    defer if (sceneModel) |model| {
+        program.sceneModel = null;
+        model.destroy();
+    };
+    program.sceneModel = sceneModel;
+    scene.sceneModel = sceneModel;
+    defer renderer.releaseSceneMeshes();
 
     var projectionLayerViews = std.array_list.Managed(xr.XrCompositionLayerProjectionView).init(allocator);
     defer projectionLayerViews.deinit();
@@ -275,6 +436,9 @@ export fn android_main(app: *c.android_app) void {
         program.pollEvents(&exitRenderLoop, &requestRestart) catch {
             xr_util.my_panic("pollEvents", .{});
         };
+        if (program.takeReferenceSpaceChange()) |changeTime| {
+            scene.onReferenceSpaceChange(changeTime);
+        }
         if (exitRenderLoop) {
             c.ANativeActivity_finish(app.activity);
             continue;
@@ -286,11 +450,22 @@ export fn android_main(app: *c.android_app) void {
             continue;
         }
 
-        // program.pollActions();
         // program.renderFrame() catch {
         //     xr_util.my_panic("renderFrame", .{});
         // };
-        const frame_state = program.beginFrame() catch {
+        const frame_state = program.waitFrame() catch {
+            xr_util.my_panic("program.waitFrame", .{});
+        };
+        // Before input polling, so the worker locates the hands while this thread polls.
+        handService.request(frame_state.predictedDisplayTime);
+        if (inputSampler) |sampler| {
+            sampler.updateInput(&program.input);
+        } else {
+            program.input.pollActions(program.session) catch |e| {
+                std.log.err("pollActions: {s}", .{@errorName(e)});
+            };
+        }
+        program.beginFrame() catch {
             xr_util.my_panic("program.beginFrame", .{});
         };
         projectionLayerViews.resize(0) catch @panic("OOM");
@@ -306,14 +481,31 @@ export fn android_main(app: *c.android_app) void {
                 // try xr_util.assert(viewCountOutput == self.views.items.len);
                 // try xr_util.assert(viewCountOutput == self.configViews.items.len);
                 // try xr_util.assert(viewCountOutput == self.swapchains.items.len);
-                const cubes = scene.update(
+                scene.update(
                     space,
                     &program.input,
                     frame_state.predictedDisplayTime,
                 ) catch @panic("OOM");
+                // The sokol renderer uploads a cube list rather than the store's dirty ranges.
+                const cubes = scene.buildCubes() catch @panic("OOM");
 
                 projectionLayerViews.resize(2) catch @panic("OOM");
 
+                var prevModels: ?[]const xr_linear.Matrix4x4f = null;
+                if (spaceWarp) |*sw| {
+                    if (program.perf) |*perf| {
+                        perf.setFrameInterval(if (sw.enabled) 2 else 1);
+                    }
+                    if (sw.enabled) {
+                        sw.beginFrame(cubes) catch @panic("OOM");
+                        prevModels = sw.prevModels.items;
+                    }
+                }
+                // Both views draw the same instances.
+                renderer.beginFrame(cubes, prevModels);
+                renderer.setHandSkins(scene.handSkins);
+                renderer.setSceneMeshes(if (sceneModel) |model| model.meshes.items else &.{});
+
                 // Render view to the appropriate part of the swapchain image.
                 for (program.views.items, program.swapchains.items, 0..) |view, viewSwapchain, i| {
                     // Each view has a separate swapchain which is acquired, rendered to, and released.
@@ -331,6 +523,12 @@ export fn android_main(app: *c.android_app) void {
                             .timeout = xr.XR_INFINITE_DURATION,
                         };
                         if (xr_result.check(xr.xrWaitSwapchainImage(viewSwapchain.handle, &waitInfo))) {
+                            const depthTexture: ?SwapchainTexture = if (program.acquireDepthImageIndex(i)) |depthImageIndex|
+                                if (depthImageIndex) |index| gles.swapchainTexture(viewSwapchain.depthImages, index) else null
+                            else |e| blk: {
+                                std.log.err("acquireDepthImageIndex: {s}", .{@errorName(e)});
+                                break :blk null;
+                            };
                             // composition
                             projectionLayerViews.items[i] = .{
                                 .type = xr.XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW,
@@ -349,18 +547,27 @@ export fn android_main(app: *c.android_app) void {
                             };
 
                             // render
-                            switch (program.graphics.getSwapchainImage(
-                                viewSwapchain.handle,
-                                swapchainImageIndex,
-                            )) {
-                                .OpenGLES => |image| renderer.render(
-                                    image.image,
-                                    @intCast(viewSwapchain.width),
-                                    @intCast(viewSwapchain.height),
-                                    .{ 0, 0, 0, 0 },
-                                    program.graphics.calcViewProjectionMatrix(view.fov, view.pose),
-                                    cubes,
-                                ),
+                            renderer.render(
+                                gles.swapchainTexture(viewSwapchain.images, swapchainImageIndex),
+                                depthTexture,
+                                @intCast(viewSwapchain.width),
+                                @intCast(viewSwapchain.height),
+                                .{ 0, 0, 0, 0 },
+                                program.graphics.calcViewProjectionMatrix(view.fov, view.pose),
+                            );
+
+                            // motion vectors and depth for the frames the runtime synthesizes
+                            if (spaceWarp) |*sw| {
+                                if (sw.enabled) {
+                                    renderSpaceWarp(
+                                        sw,
+                                        &renderer,
+                                        gles,
+                                        i,
+                                        program.graphics.calcViewProjectionMatrix(view.fov, view.pose),
+                                        &projectionLayerViews.items[i],
+                                    );
+                                }
                             }
 
                             // commit
@@ -373,14 +580,24 @@ export fn android_main(app: *c.android_app) void {
                             )) catch |e| {
                                 std.log.err("xr.xrReleaseSwapchainImage: {s}", .{@errorName(e)});
                             };
+                            if (depthTexture != null) {
+                                program.releaseDepthImage(i, &projectionLayerViews.items[i]) catch |e| {
+                                    std.log.err("releaseDepthImage: {s}", .{@errorName(e)});
+                                };
+                            }
                         } else |_| {}
                     } else |_| {}
                 }
             }
         }
+        renderer.endFrame();
         program.endFrame(space, frame_state.predictedDisplayTime, projectionLayerViews.items, null) catch |e| {
             std.log.err("program.endFrame: {s}", .{@errorName(e)});
         };
+        if (!startup.reported and frame_state.shouldRender == xr.XR_TRUE) {
+            startup.mark("first frame");
+            startup.report();
+        }
     }
 
     // app.activity.vm.DetachCurrentThread();
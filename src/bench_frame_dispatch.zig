@@ -0,0 +1,184 @@
+// zig build bench: the per view resolve and draw dispatch of main.frameLoop, against a stub plugin.
+//
+// "vtable" is the loop before RenderVariant: the swapchain image and the view projection come
+// through GraphicsPlugin function pointers, the image union is switched on, and late latching and
+// the clear color are decided per view. "comptime" is frameLoop: RenderVariant.dispatch picks the
+// instance once and every view calls the plugin directly. The draws only consume their arguments,
+// so the times are the dispatch alone, without GL or OpenXR.
+const std = @import("std");
+const c = @import("c");
+const xr_linear = @import("xr_linear.zig");
+const slot_map = @import("slot_map.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
+const RenderVariant = @import("RenderVariant.zig");
+
+const VIEWS = 2;
+const IMAGES = 3;
+const FRAMES = 1_000_000;
+
+// The parts of GraphicsPluginOpengl that the frame loop uses per view.
+const StubPlugin = struct {
+    swapchainImages: slot_map.SlotMap([]c.XrSwapchainImageOpenGLKHR),
+
+    fn swapchainImage(self: *@This(), handle: GraphicsPlugin.SwapchainImages, image_index: u32) c.XrSwapchainImageOpenGLKHR {
+        return self.swapchainImages.get(handle).?.*[image_index];
+    }
+
+    fn swapchainTexture(self: *@This(), handle: GraphicsPlugin.SwapchainImages, image_index: u32) GraphicsPlugin.SwapchainTexture {
+        return .{
+            .images = handle,
+            .index = image_index,
+            .texture = self.swapchainImage(handle, image_index).image,
+        };
+    }
+
+    fn calcViewProjectionMatrix(fov: c.XrFovf, view_pose: c.XrPosef) xr_linear.Matrix4x4f {
+        const proj = xr_linear.Matrix4x4f.createProjectionFov(.OPENGL, fov, GraphicsPlugin.NEAR_Z, GraphicsPlugin.FAR_Z);
+        return proj.multiplySimd(xr_linear.Matrix4x4f.createFromRigidTransform(view_pose).invertRigidBody());
+    }
+
+    fn getSwapchainImage(ptr: *anyopaque, handle: GraphicsPlugin.SwapchainImages, image_index: u32) GraphicsPlugin.SwapchainImage {
+        const self: *@This() = @ptrCast(@alignCast(ptr));
+        return .{ .OpenGL = self.swapchainImage(handle, image_index) };
+    }
+
+    const vtable = VTable{
+        .getSwapchainImage = &getSwapchainImage,
+        .calcViewProjectionMatrix = &calcViewProjectionMatrix,
+    };
+};
+
+// The GraphicsPlugin.VTable entries of the old loop.
+const VTable = struct {
+    getSwapchainImage: *const fn (ptr: *anyopaque, handle: GraphicsPlugin.SwapchainImages, image_index: u32) GraphicsPlugin.SwapchainImage,
+    calcViewProjectionMatrix: *const fn (fov: c.XrFovf, view_pose: c.XrPosef) xr_linear.Matrix4x4f,
+};
+
+const View = struct {
+    fov: c.XrFovf,
+    pose: c.XrPosef,
+    images: GraphicsPlugin.SwapchainImages,
+    depthImages: GraphicsPlugin.SwapchainImages,
+};
+
+noinline fn render(color: GraphicsPlugin.SwapchainTexture, depth: ?GraphicsPlugin.SwapchainTexture, clear_color: [4]f32, vp: xr_linear.Matrix4x4f) void {
+    std.mem.doNotOptimizeAway(color);
+    std.mem.doNotOptimizeAway(depth);
+    std.mem.doNotOptimizeAway(clear_color);
+    std.mem.doNotOptimizeAway(vp);
+}
+
+noinline fn renderLateLatched(color: GraphicsPlugin.SwapchainTexture, depth: ?GraphicsPlugin.SwapchainTexture, clear_color: [4]f32, vp: xr_linear.Matrix4x4f) void {
+    std.mem.doNotOptimizeAway(color);
+    std.mem.doNotOptimizeAway(depth);
+    std.mem.doNotOptimizeAway(clear_color);
+    std.mem.doNotOptimizeAway(vp);
+}
+
+// Options.getBackgroundClearColor, looked up per view.
+fn runtimeClearColor(blend: RenderVariant.Blend) [4]f32 {
+    return switch (blend) {
+        .passthrough, .alpha_blend => .{ 0.0, 0.0, 0.0, 0.0 },
+        .@"opaque" => .{ 0.184313729, 0.309803933, 0.309803933, 1.0 },
+        .additive => .{ 0.0, 0.0, 0.0, 1.0 },
+    };
+}
+
+fn vtableLoop(variant: RenderVariant, plugin: *StubPlugin, views: []const View) void {
+    // Loaded at runtime like GraphicsPlugin.vtable, so the calls cannot be devirtualized.
+    var vtablePtr: *const VTable = &StubPlugin.vtable;
+    std.mem.doNotOptimizeAway(&vtablePtr);
+    const vtable = vtablePtr;
+    for (0..FRAMES) |frame| {
+        const image_index: u32 = @intCast(frame % IMAGES);
+        for (views) |view| {
+            const depth = GraphicsPlugin.SwapchainTexture{
+                .images = view.depthImages,
+                .index = image_index,
+                .texture = switch (vtable.getSwapchainImage(plugin, view.depthImages, image_index)) {
+                    .OpenGL => |image| image.image,
+                    else => unreachable,
+                },
+            };
+            const vp = vtable.calcViewProjectionMatrix(view.fov, view.pose);
+            std.mem.doNotOptimizeAway(depth);
+            std.mem.doNotOptimizeAway(vp);
+            switch (vtable.getSwapchainImage(plugin, view.images, image_index)) {
+                .OpenGL => |image| {
+                    const color = GraphicsPlugin.SwapchainTexture{ .images = view.images, .index = image_index, .texture = image.image };
+                    std.mem.doNotOptimizeAway(color);
+                    if (variant.lateLatch) {
+                        renderLateLatched(color, depth, runtimeClearColor(variant.blend), vp);
+                    } else {
+                        render(color, depth, runtimeClearColor(variant.blend), vp);
+                    }
+                },
+                else => unreachable,
+            }
+        }
+    }
+}
+
+fn comptimeLoop(comptime variant: RenderVariant, plugin: *StubPlugin, views: []const View) !void {
+    for (0..FRAMES) |frame| {
+        const image_index: u32 = @intCast(frame % IMAGES);
+        for (views) |view| {
+            const depth = plugin.swapchainTexture(view.depthImages, image_index);
+            const vp = StubPlugin.calcViewProjectionMatrix(view.fov, view.pose);
+            const color = plugin.swapchainTexture(view.images, image_index);
+            std.mem.doNotOptimizeAway(depth);
+            std.mem.doNotOptimizeAway(vp);
+            std.mem.doNotOptimizeAway(color);
+            if (variant.lateLatch) {
+                renderLateLatched(color, depth, comptime variant.clearColor(), vp);
+            } else {
+                render(color, depth, comptime variant.clearColor(), vp);
+            }
+        }
+    }
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    var plugin = StubPlugin{ .swapchainImages = .init(allocator) };
+    defer plugin.swapchainImages.deinit();
+    var textures: [VIEWS * 2][IMAGES]c.XrSwapchainImageOpenGLKHR = undefined;
+    var views: [VIEWS]View = undefined;
+    for (&views, 0..) |*view, i| {
+        for (0..2) |kind| {
+            for (&textures[i * 2 + kind], 0..) |*texture, j| {
+                texture.* = .{
+                    .type = c.XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR,
+                    .image = @intCast(1 + (i * 2 + kind) * IMAGES + j),
+                };
+            }
+        }
+        view.* = .{
+            .fov = .{ .angleLeft = -0.8, .angleRight = 0.7, .angleUp = 0.8, .angleDown = -0.8 },
+            .pose = .{
+                .orientation = .{ .x = 0, .y = 0, .z = 0, .w = 1 },
+                .position = .{ .x = if (i == 0) -0.032 else 0.032, .y = 1.6, .z = 0 },
+            },
+            .images = try plugin.swapchainImages.insert(&textures[i * 2]),
+            .depthImages = try plugin.swapchainImages.insert(&textures[i * 2 + 1]),
+        };
+    }
+
+    // Known at runtime only, like the variant main selects from the options.
+    var variant = RenderVariant{ .lateLatch = false, .blend = .@"opaque" };
+    std.mem.doNotOptimizeAway(&variant);
+
+    var timer = try std.time.Timer.start();
+    vtableLoop(variant, &plugin, &views);
+    const vtableTime = timer.lap();
+    try variant.dispatch(comptimeLoop, .{ &plugin, @as([]const View, &views) });
+    const comptimeTime = timer.lap();
+
+    const count: f64 = @floatFromInt(FRAMES * VIEWS);
+    std.debug.print("{} frames of {} views\n", .{ FRAMES, VIEWS });
+    std.debug.print("vtable:   {d:.2} ns per view\n", .{@as(f64, @floatFromInt(vtableTime)) / count});
+    std.debug.print("comptime: {d:.2} ns per view\n", .{@as(f64, @floatFromInt(comptimeTime)) / count});
+}
@@ -1,15 +1,20 @@
+// One instance per cube, the model matrix columns come from a per-instance vertex buffer.
 @vs vs
 layout(binding = 0) uniform vs_params {
-    mat4 mvp;
+    mat4 vp;
 };
 
 in vec4 position;
 in vec4 color0;
+in vec4 model0;
+in vec4 model1;
+in vec4 model2;
+in vec4 model3;
 
 out vec4 color;
 
 void main() {
-    gl_Position = mvp * position;
+    gl_Position = vp * mat4(model0, model1, model2, model3) * position;
     color = color0;
 }
 @end
@@ -24,3 +29,126 @@ void main() {
 @end
 
 @program cube vs fs
+
+// Motion vectors for XR_FB_space_warp. The previous model goes through the current
+// view-projection, so only object motion ends up in the image.
+@vs vs_velocity
+layout(binding = 0) uniform velocity_params {
+    mat4 vp;
+};
+
+in vec4 position;
+in vec4 model0;
+in vec4 model1;
+in vec4 model2;
+in vec4 model3;
+in vec4 prev_model0;
+in vec4 prev_model1;
+in vec4 prev_model2;
+in vec4 prev_model3;
+
+out vec4 cur_pos;
+out vec4 prev_pos;
+
+void main() {
+    cur_pos = vp * mat4(model0, model1, model2, model3) * position;
+    prev_pos = vp * mat4(prev_model0, prev_model1, prev_model2, prev_model3) * position;
+    gl_Position = cur_pos;
+}
+@end
+
+@fs fs_velocity
+in vec4 cur_pos;
+in vec4 prev_pos;
+out vec4 frag_velocity;
+
+void main() {
+    frag_velocity = vec4(cur_pos.xyz / cur_pos.w - prev_pos.xyz / prev_pos.w, 0.0);
+}
+@end
+
+@program velocity vs_velocity fs_velocity
+
+// Skinned hand mesh from XR_FB_hand_tracking_mesh, up to four joints per vertex. The joint count
+// is HandMesh.MAX_JOINTS.
+@vs vs_hand
+layout(binding = 0) uniform hand_params {
+    mat4 vp;
+    mat4 joints[26];
+};
+
+in vec4 position;
+in vec3 normal;
+in vec4 joint_indices;
+in vec4 joint_weights;
+
+out vec4 color;
+
+void main() {
+    mat4 skin = joints[int(joint_indices.x)] * joint_weights.x +
+                joints[int(joint_indices.y)] * joint_weights.y +
+                joints[int(joint_indices.z)] * joint_weights.z +
+                joints[int(joint_indices.w)] * joint_weights.w;
+    gl_Position = vp * skin * position;
+    // Lit from above, so the fingers stand out against each other.
+    vec3 n = normalize(mat3(skin) * normal);
+    color = vec4(vec3(0.8, 0.6, 0.5) * (0.4 + 0.6 * max(n.y, 0.0)), 1.0);
+}
+@end
+
+@program hand vs_hand fs
+
+// The hands go into the XR_FB_space_warp pass with zero motion, only for their depth.
+@fs fs_hand_velocity
+in vec4 color;
+out vec4 frag_velocity;
+
+void main() {
+    frag_velocity = vec4(0.0);
+}
+@end
+
+@program hand_velocity vs_hand fs_hand_velocity
+
+// Scene model mesh from XR_FB_scene, in its anchor space. It has no normals, so it is flat shaded
+// from the derivatives of the world position, and blended over passthrough.
+@vs vs_scene
+layout(binding = 0) uniform scene_params {
+    mat4 vp;
+    mat4 model;
+};
+
+in vec4 position;
+
+out vec3 world;
+
+void main() {
+    vec4 p = model * position;
+    gl_Position = vp * p;
+    world = p.xyz;
+}
+@end
+
+@fs fs_scene
+in vec3 world;
+out vec4 frag_color;
+
+void main() {
+    vec3 n = normalize(cross(dFdx(world), dFdy(world)));
+    frag_color = vec4(vec3(0.3, 0.7, 1.0) * (0.5 + 0.5 * abs(n.y)), 0.3);
+}
+@end
+
+@program scene vs_scene fs_scene
+
+// The scene meshes do not move, see hand_velocity.
+@fs fs_scene_velocity
+in vec3 world;
+out vec4 frag_velocity;
+
+void main() {
+    frag_velocity = vec4(0.0);
+}
+@end
+
+@program scene_velocity vs_scene fs_scene_velocity
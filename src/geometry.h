@@ -49,4 +49,23 @@ constexpr unsigned short c_cubeIndices[] = {
     30, 31, 32, 33, 34, 35,  // +Z
 };
 
+// A pyramid pointing down -Z, for the hands. Same winding as the cube, the base is blue.
+constexpr XrVector3f PyramidApex{0, 0, -0.5f};
+
+constexpr Vertex c_pyramidVertices[] = {
+    {PyramidApex, DarkRed}, {LTF, DarkRed}, {LBF, DarkRed},          // -X
+    {PyramidApex, Red}, {RBF, Red}, {RTF, Red},                      // +X
+    {PyramidApex, DarkGreen}, {LBF, DarkGreen}, {RBF, DarkGreen},    // -Y
+    {PyramidApex, Green}, {RTF, Green}, {LTF, Green},                // +Y
+    {LBF, Blue}, {LTF, Blue}, {RTF, Blue}, {LBF, Blue}, {RTF, Blue}, {RBF, Blue},  // +Z
+};
+
+constexpr unsigned short c_pyramidIndices[] = {
+    0,  1,  2,                    // -X
+    3,  4,  5,                    // +X
+    6,  7,  8,                    // -Y
+    9,  10, 11,                   // +Y
+    12, 13, 14, 15, 16, 17,       // +Z
+};
+
 }  // namespace Geometry
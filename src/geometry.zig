@@ -1,4 +1,5 @@
 const xr = @import("openxr").c;
+const xr_linear = @import("xr_linear.zig");
 
 pub fn XrPosef_Identity() xr.XrPosef {
     return .{
@@ -31,9 +32,46 @@ pub const Vertex = struct {
     Color: xr.XrVector3f,
 };
 
+// What a cube moves with, so a late latch can correct it with a fresher pose.
+pub const Attachment = enum(u2) {
+    world,
+    left_hand,
+    right_hand,
+};
+
 pub const Cube = struct {
     Pose: xr.XrPosef,
     Scale: xr.XrVector3f,
+    Attachment: Attachment = .world,
+
+    // Model matrices of index aligned cubes, see xr_linear.createTranslationRotationScaleBatch.
+    pub fn modelMatrices(cubes: []const Cube, out: []xr_linear.Matrix4x4f) void {
+        xr_linear.createTranslationRotationScaleBatch(Cube, cubes, transform, out);
+    }
+
+    fn transform(cube: Cube) xr_linear.Transform {
+        return .{ .pose = cube.Pose, .scale = cube.Scale };
+    }
+};
+
+// Per-instance vertex attributes of the instanced GL programs, which build the model matrix from
+// pose and scale in the vertex shader.
+pub const Instance = extern struct {
+    Orientation: xr.XrQuaternionf,
+    Position: xr.XrVector3f,
+    Scale: xr.XrVector3f,
+    Attachment: u32,
+    // RGBA8 in byte order, so 0xAABBGGRR read as a little endian u32. Multiplies the vertex color.
+    Color: u32 = 0xffffffff,
+
+    pub fn fromCube(cube: Cube) @This() {
+        return .{
+            .Orientation = cube.Pose.orientation,
+            .Position = cube.Pose.position,
+            .Scale = cube.Scale,
+            .Attachment = @intFromEnum(cube.Attachment),
+        };
+    }
 };
 
 const Red = xr.XrVector3f{ .x = 1, .y = 0, .z = 0 };
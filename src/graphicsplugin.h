@@ -6,9 +6,15 @@
 #include <vector>
 #include <string>
 
+namespace Geometry {
+struct Vertex;
+}
+
 struct Cube {
     XrPosef Pose;
     XrVector3f Scale;
+    // Mesh registered with the graphics plugin; 0 is the unit cube. Plugins without a mesh registry ignore it.
+    uint32_t Mesh{0};
 };
 
 // Wraps a graphics API so the main openxr program can be graphics API-independent.
@@ -28,12 +34,21 @@ struct IGraphicsPlugin {
     virtual const XrBaseInStructure* GetGraphicsBinding() const = 0;
 
     // Allocate space for the swapchain image structures. These are different for each graphics API. The returned
-    // pointers are valid for the lifetime of the graphics plugin.
+    // pointers are valid for the lifetime of the graphics plugin. swapchainIndex receives the index RenderView takes for
+    // these images.
     virtual std::vector<XrSwapchainImageBaseHeader*> AllocateSwapchainImageStructs(
-        uint32_t capacity, const XrSwapchainCreateInfo& swapchainCreateInfo) = 0;
+        uint32_t capacity, const XrSwapchainCreateInfo& swapchainCreateInfo, uint32_t* swapchainIndex) = 0;
+
+    // Register a mesh for Cube::Mesh and return its id. Call after InitializeDevice. Plugins without a mesh registry
+    // return 0 and draw every cube with the unit cube mesh.
+    virtual uint32_t AddMesh(const Geometry::Vertex* /*vertices*/, size_t /*vertexCount*/, const unsigned short* /*indices*/,
+                             size_t /*indexCount*/) {
+        return 0;
+    }
 
-    // Render to a swapchain image for a projection view.
-    virtual void RenderView(const XrCompositionLayerProjectionView& layerView, const XrSwapchainImageBaseHeader* swapchainImage,
+    // Render to a swapchain image for a projection view. The image is imageIndex of the structs allocated with
+    // swapchainIndex, so per image state is an array index instead of a lookup by image.
+    virtual void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t swapchainIndex, uint32_t imageIndex,
                             int64_t swapchainFormat, const std::vector<Cube>& cubes) = 0;
 
     // Get recommended number of sub-data element samples in view (recommendedSwapchainSampleCount)
@@ -69,6 +69,16 @@ struct D3D11GraphicsPlugin {
         // Create the D3D11 device for the adapter associated with the system.
         XrGraphicsRequirementsD3D11KHR graphicsRequirements{XR_TYPE_GRAPHICS_REQUIREMENTS_D3D11_KHR};
         RETURN_IF_FAIL(pfnGetD3D11GraphicsRequirementsKHR(instance, systemId, &graphicsRequirements));
+
+        // A restarted instance on the same adapter keeps the device and everything created on it.
+        // Only the swapchain-bound depth buffers are dropped.
+        if (m_device && memcmp(&m_adapterLuid, &graphicsRequirements.adapterLuid, sizeof(LUID)) == 0) {
+            m_colorToDepthMap.clear();
+            return XR_SUCCESS;
+        }
+        m_colorToDepthMap.clear();
+        m_adapterLuid = graphicsRequirements.adapterLuid;
+
         const ComPtr<IDXGIAdapter1> adapter = GetAdapter(graphicsRequirements.adapterLuid);
 
         // Create a list of feature levels which are both supported by the OpenXR runtime and this application.
@@ -245,6 +255,7 @@ struct D3D11GraphicsPlugin {
 
     // Map color buffer to associated depth buffer. This map is populated on demand.
     std::map<ID3D11Texture2D*, ComPtr<ID3D11DepthStencilView>> m_colorToDepthMap;
+    LUID m_adapterLuid{};
     // std::array<float, 4> m_clearColor;
 };
 }  // namespace
@@ -13,6 +13,7 @@
 #include <common/xr_linear.h>
 #include <DirectXColors.h>
 #include <D3Dcompiler.h>
+#include <deque>
 
 #include "d3d_common.h"
 
@@ -91,10 +92,7 @@ class SwapchainImageContext {
         return bases;
     }
 
-    uint32_t ImageIndex(const XrSwapchainImageBaseHeader* swapchainImageHeader) {
-        auto p = reinterpret_cast<const XrSwapchainImageD3D12KHR*>(swapchainImageHeader);
-        return (uint32_t)(p - &m_swapchainImages[0]);
-    }
+    ID3D12Resource* GetColorTexture(uint32_t imageIndex) const { return m_swapchainImages[imageIndex].texture; }
 
     ID3D12Resource* GetDepthStencilTexture(ID3D12Resource* colorTexture) {
         if (!m_depthStencilTexture) {
@@ -308,21 +306,15 @@ struct D3D12GraphicsPlugin : public IGraphicsPlugin {
     }
 
     std::vector<XrSwapchainImageBaseHeader*> AllocateSwapchainImageStructs(
-        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/) override {
+        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/, uint32_t* swapchainIndex) override {
         // Allocate and initialize the buffer of image structs (must be sequential in memory for xrEnumerateSwapchainImages).
         // Return back an array of pointers to each swapchain image struct so the consumer doesn't need to know the type/size.
 
+        *swapchainIndex = static_cast<uint32_t>(m_swapchainImageContexts.size());
         m_swapchainImageContexts.emplace_back();
         SwapchainImageContext& swapchainImageContext = m_swapchainImageContexts.back();
 
-        std::vector<XrSwapchainImageBaseHeader*> bases = swapchainImageContext.Create(m_device.Get(), capacity);
-
-        // Map every swapchainImage base pointer to this context
-        for (auto& base : bases) {
-            m_swapchainImageContextMap[base] = &swapchainImageContext;
-        }
-
-        return bases;
+        return swapchainImageContext.Create(m_device.Get(), capacity);
     }
 
     ID3D12PipelineState* GetOrCreatePipelineState(DXGI_FORMAT swapchainFormat) {
@@ -409,11 +401,11 @@ struct D3D12GraphicsPlugin : public IGraphicsPlugin {
         return pipelineStateRaw;
     }
 
-    void RenderView(const XrCompositionLayerProjectionView& layerView, const XrSwapchainImageBaseHeader* swapchainImage,
+    void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t swapchainIndex, uint32_t imageIndex,
                     int64_t swapchainFormat, const std::vector<Cube>& cubes) override {
         CHECK(layerView.subImage.imageArrayIndex == 0);  // Texture arrays not supported.
 
-        auto& swapchainContext = *m_swapchainImageContextMap[swapchainImage];
+        auto& swapchainContext = m_swapchainImageContexts[swapchainIndex];
         CpuWaitForFence(swapchainContext.GetFrameFenceValue());
         swapchainContext.ResetCommandAllocator();
 
@@ -426,7 +418,7 @@ struct D3D12GraphicsPlugin : public IGraphicsPlugin {
         cmdList->SetPipelineState(pipelineState);
         cmdList->SetGraphicsRootSignature(m_rootSignature.Get());
 
-        ID3D12Resource* const colorTexture = reinterpret_cast<const XrSwapchainImageD3D12KHR*>(swapchainImage)->texture;
+        ID3D12Resource* const colorTexture = swapchainContext.GetColorTexture(imageIndex);
         const D3D12_RESOURCE_DESC colorTextureDesc = colorTexture->GetDesc();
 
         const D3D12_VIEWPORT viewport = {(float)layerView.subImage.imageRect.offset.x,
@@ -587,8 +579,8 @@ struct D3D12GraphicsPlugin : public IGraphicsPlugin {
     ComPtr<ID3D12Fence> m_fence;
     uint64_t m_fenceValue = 0;
     HANDLE m_fenceEvent = INVALID_HANDLE_VALUE;
-    std::list<SwapchainImageContext> m_swapchainImageContexts;
-    std::map<const XrSwapchainImageBaseHeader*, SwapchainImageContext*> m_swapchainImageContextMap;
+    // Indexed by swapchainIndex. A deque, so the image structs of earlier swapchains do not move.
+    std::deque<SwapchainImageContext> m_swapchainImageContexts;
     XrGraphicsBindingD3D12KHR m_graphicsBinding{XR_TYPE_GRAPHICS_BINDING_D3D12_KHR};
     ComPtr<ID3D12RootSignature> m_rootSignature;
     std::map<DXGI_FORMAT, ComPtr<ID3D12PipelineState>> m_pipelineStates;
@@ -138,7 +138,11 @@ struct MetalGraphicsPlugin : public IGraphicsPlugin {
     }
 
     void DestroyBuffers() {
-        m_swapchainContextMap.clear();
+        for (SwapchainImages& swapchain : m_swapchainImages) {
+            for (SwapchainContext& context : swapchain.contexts) {
+                context.m_cubeMatricesBuffer.reset();
+            }
+        }
         m_cubeVerticesBuffer.reset();
         m_cubeIndicesBuffer.reset();
     }
@@ -162,7 +166,7 @@ struct MetalGraphicsPlugin : public IGraphicsPlugin {
     }
 
     std::vector<XrSwapchainImageBaseHeader*> AllocateSwapchainImageStructs(
-        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/) override {
+        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/, uint32_t* swapchainIndex) override {
         // Allocate and initialize the buffer of image structs (must be sequential in memory for xrEnumerateSwapchainImages).
         // Return back an array of pointers to each swapchain image struct so the consumer doesn't need to know the type/size.
         std::vector<XrSwapchainImageMetalKHR> swapchainImageBuffer(capacity);
@@ -172,21 +176,20 @@ struct MetalGraphicsPlugin : public IGraphicsPlugin {
             swapchainImageBase.push_back(reinterpret_cast<XrSwapchainImageBaseHeader*>(&image));
         }
 
-        // Keep the buffer alive by moving it into the list of buffers.
-        m_swapchainImageBuffers.push_back(std::move(swapchainImageBuffer));
-
-        for (auto imageBaseHeader : swapchainImageBase) {
-            m_swapchainContextMap.insert({imageBaseHeader, SwapchainContext()});
-        }
+        // Keep the buffer alive by moving it into the list of buffers. A moved vector keeps its storage, so the pointers
+        // stay valid when m_swapchainImages grows.
+        *swapchainIndex = static_cast<uint32_t>(m_swapchainImages.size());
+        m_swapchainImages.push_back({std::move(swapchainImageBuffer), std::vector<SwapchainContext>(capacity)});
 
         return swapchainImageBase;
     }
 
-    void RenderView(const XrCompositionLayerProjectionView& layerView, const XrSwapchainImageBaseHeader* swapchainImage,
+    void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t swapchainIndex, uint32_t imageIndex,
                     int64_t swapchainFormat, const std::vector<Cube>& cubes) override {
         auto pAutoReleasePool = NS::TransferPtr(NS::AutoreleasePool::alloc()->init());
 
-        SwapchainContext& swapchainContext = m_swapchainContextMap[swapchainImage];
+        SwapchainImages& swapchain = m_swapchainImages[swapchainIndex];
+        SwapchainContext& swapchainContext = swapchain.contexts[imageIndex];
 
         auto mtlSwapchainFormat = (MTL::PixelFormat)swapchainFormat;
         if (mtlSwapchainFormat != m_colorAttachmentFormat) {
@@ -207,7 +210,7 @@ struct MetalGraphicsPlugin : public IGraphicsPlugin {
         }
 
         CHECK(layerView.subImage.imageArrayIndex == 0);  // Texture arrays not supported.
-        void* rawTexture = reinterpret_cast<const XrSwapchainImageMetalKHR*>(swapchainImage)->texture;
+        void* rawTexture = swapchain.images[imageIndex].texture;
         NS::SharedPtr<MTL::Texture> colorTexture = NS::RetainPtr(reinterpret_cast<MTL::Texture*>(rawTexture));
 
         if (!m_depthStencilTexture) {
@@ -306,12 +309,16 @@ struct MetalGraphicsPlugin : public IGraphicsPlugin {
     NS::SharedPtr<MTL::Buffer> m_cubeIndicesBuffer;
 
     XrGraphicsBindingMetalKHR m_graphicsBinding{XR_TYPE_GRAPHICS_BINDING_METAL_KHR};
-    std::list<std::vector<XrSwapchainImageMetalKHR>> m_swapchainImageBuffers;
 
     struct SwapchainContext {
         NS::SharedPtr<MTL::Buffer> m_cubeMatricesBuffer;
     };
-    std::map<const XrSwapchainImageBaseHeader*, SwapchainContext> m_swapchainContextMap;
+    // The image structs of one AllocateSwapchainImageStructs call and a context per image. Indexed by swapchainIndex.
+    struct SwapchainImages {
+        std::vector<XrSwapchainImageMetalKHR> images;
+        std::vector<SwapchainContext> contexts;
+    };
+    std::vector<SwapchainImages> m_swapchainImages;
 
     NS::SharedPtr<MTL::Texture> m_depthStencilTexture;
 
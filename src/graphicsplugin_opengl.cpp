@@ -8,8 +8,8 @@
 #include "geometry.h"
 #include "graphicsplugin.h"
 #include "options.h"
-#include <list>
 #include <map>
+#include <tuple>
 
 #ifdef XR_USE_GRAPHICS_API_OPENGL
 
@@ -45,6 +45,59 @@ static const char* FragmentShaderGlsl = R"_(
     }
     )_";
 
+// Multi-draw-indirect variant: every draw of a glMultiDrawElementsIndirect call fetches its transform from the DrawData
+// storage buffer. gl_DrawID is only core in GL 4.6, so the draw index is carried through baseInstance into an instanced
+// attribute instead, which works on any GL 4.3 context.
+static const char* MultiDrawVertexShaderGlsl = R"_(
+    #version 430
+
+    in vec3 VertexPos;
+    in vec3 VertexColor;
+    in uint DrawIndex;
+
+    out vec3 PSVertexColor;
+
+    layout(std430, binding = 0) readonly buffer DrawData {
+        mat4 ModelViewProjection[];
+    };
+
+    void main() {
+       gl_Position = ModelViewProjection[DrawIndex] * vec4(VertexPos, 1.0);
+       PSVertexColor = VertexColor;
+    }
+    )_";
+
+static const char* MultiDrawFragmentShaderGlsl = R"_(
+    #version 430
+
+    in vec3 PSVertexColor;
+    out vec4 FragColor;
+
+    void main() {
+       FragColor = vec4(PSVertexColor, 1);
+    }
+    )_";
+
+// Layout mandated by GL_DRAW_INDIRECT_BUFFER for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Location of a mesh inside the shared vertex/index buffers.
+struct MeshRange {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+};
+
+// Capacity of the shared vertex/index buffers that every mesh is packed into.
+constexpr GLsizeiptr MeshVertexCapacity = 65536;
+constexpr GLsizeiptr MeshIndexCapacity = 3 * MeshVertexCapacity;
+
 struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
     OpenGLGraphicsPlugin(const Options* options, IPlatformPlugin* /*unused*/&)
         : m_clearColor(GetBackgroundClearColor(options)) {}
@@ -61,19 +114,31 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
         if (m_program != 0) {
             glDeleteProgram(m_program);
         }
+        if (m_multiDrawProgram != 0) {
+            glDeleteProgram(m_multiDrawProgram);
+        }
         if (m_vao != 0) {
             glDeleteVertexArrays(1, &m_vao);
         }
-        if (m_cubeVertexBuffer != 0) {
-            glDeleteBuffers(1, &m_cubeVertexBuffer);
+        if (m_meshVertexBuffer != 0) {
+            glDeleteBuffers(1, &m_meshVertexBuffer);
+        }
+        if (m_meshIndexBuffer != 0) {
+            glDeleteBuffers(1, &m_meshIndexBuffer);
+        }
+        if (m_drawIndexBuffer != 0) {
+            glDeleteBuffers(1, &m_drawIndexBuffer);
+        }
+        if (m_drawCommandBuffer != 0) {
+            glDeleteBuffers(1, &m_drawCommandBuffer);
         }
-        if (m_cubeIndexBuffer != 0) {
-            glDeleteBuffers(1, &m_cubeIndexBuffer);
+        if (m_drawDataBuffer != 0) {
+            glDeleteBuffers(1, &m_drawDataBuffer);
         }
 
-        for (auto& colorToDepth : m_colorToDepthMap) {
-            if (colorToDepth.second != 0) {
-                glDeleteTextures(1, &colorToDepth.second);
+        for (auto& pooledDepth : m_depthPool) {
+            if (pooledDepth.second != 0) {
+                glDeleteRenderbuffers(1, &pooledDepth.second);
             }
         }
 
@@ -190,23 +255,121 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
         m_vertexAttribCoords = glGetAttribLocation(m_program, "VertexPos");
         m_vertexAttribColor = glGetAttribLocation(m_program, "VertexColor");
 
-        glGenBuffers(1, &m_cubeVertexBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, m_cubeVertexBuffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Geometry::c_cubeVertices), Geometry::c_cubeVertices, GL_STATIC_DRAW);
+        // All meshes share one vertex buffer and one index buffer, so a single VAO serves both render paths.
+        glGenBuffers(1, &m_meshVertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_meshVertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, MeshVertexCapacity * sizeof(Geometry::Vertex), nullptr, GL_STATIC_DRAW);
 
-        glGenBuffers(1, &m_cubeIndexBuffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_cubeIndexBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Geometry::c_cubeIndices), Geometry::c_cubeIndices, GL_STATIC_DRAW);
+        glGenBuffers(1, &m_meshIndexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_meshIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, MeshIndexCapacity * sizeof(unsigned short), nullptr, GL_STATIC_DRAW);
+
+        // Mesh 0 is the unit cube, starting at offset zero so the per-cube path can draw it directly.
+        AddMesh(Geometry::c_cubeVertices, ArraySize(Geometry::c_cubeVertices), Geometry::c_cubeIndices,
+                ArraySize(Geometry::c_cubeIndices));
 
         glGenVertexArrays(1, &m_vao);
         glBindVertexArray(m_vao);
         glEnableVertexAttribArray(m_vertexAttribCoords);
         glEnableVertexAttribArray(m_vertexAttribColor);
-        glBindBuffer(GL_ARRAY_BUFFER, m_cubeVertexBuffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_cubeIndexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_meshVertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_meshIndexBuffer);
         glVertexAttribPointer(m_vertexAttribCoords, 3, GL_FLOAT, GL_FALSE, sizeof(Geometry::Vertex), nullptr);
         glVertexAttribPointer(m_vertexAttribColor, 3, GL_FLOAT, GL_FALSE, sizeof(Geometry::Vertex),
                               reinterpret_cast<const void*>(sizeof(XrVector3f)));
+
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 3)) {
+            InitializeMultiDrawResources();
+        } else {
+            Log::Write(Log::Level::Info, Fmt("GL %d.%d has no glMultiDrawElementsIndirect, drawing cubes one by one", major, minor));
+        }
+
+        glBindVertexArray(0);
+    }
+
+    void InitializeMultiDrawResources() {
+        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertexShader, 1, &MultiDrawVertexShaderGlsl, nullptr);
+        glCompileShader(vertexShader);
+        CheckShader(vertexShader);
+
+        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &MultiDrawFragmentShaderGlsl, nullptr);
+        glCompileShader(fragmentShader);
+        CheckShader(fragmentShader);
+
+        // Pin the shared attributes to the locations already enabled in m_vao, and put the draw index after them.
+        m_vertexAttribDrawIndex = std::max(m_vertexAttribCoords, m_vertexAttribColor) + 1;
+
+        m_multiDrawProgram = glCreateProgram();
+        glAttachShader(m_multiDrawProgram, vertexShader);
+        glAttachShader(m_multiDrawProgram, fragmentShader);
+        glBindAttribLocation(m_multiDrawProgram, m_vertexAttribCoords, "VertexPos");
+        glBindAttribLocation(m_multiDrawProgram, m_vertexAttribColor, "VertexColor");
+        glBindAttribLocation(m_multiDrawProgram, m_vertexAttribDrawIndex, "DrawIndex");
+        glLinkProgram(m_multiDrawProgram);
+        CheckProgram(m_multiDrawProgram);
+
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        glGenBuffers(1, &m_drawCommandBuffer);
+        glGenBuffers(1, &m_drawDataBuffer);
+        glGenBuffers(1, &m_drawIndexBuffer);
+
+        // The draw index attribute advances once per instance; baseInstance of each command selects its element.
+        glBindVertexArray(m_vao);
+        glEnableVertexAttribArray(m_vertexAttribDrawIndex);
+        glVertexAttribDivisor(m_vertexAttribDrawIndex, 1);
+        ReserveDrawCapacity(256);
+    }
+
+    // Grow the draw index attribute buffer so it covers at least drawCount draws.
+    void ReserveDrawCapacity(size_t drawCount) {
+        if (drawCount <= m_drawCapacity) {
+            return;
+        }
+        size_t capacity = std::max<size_t>(m_drawCapacity, 1);
+        while (capacity < drawCount) {
+            capacity *= 2;
+        }
+
+        std::vector<GLuint> drawIndices(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            drawIndices[i] = static_cast<GLuint>(i);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+        glVertexAttribIPointer(m_vertexAttribDrawIndex, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_drawCapacity = capacity;
+    }
+
+    // Append a mesh to the shared vertex/index buffers and return its id for Cube::Mesh.
+    uint32_t AddMesh(const Geometry::Vertex* vertices, size_t vertexCount, const unsigned short* indices,
+                     size_t indexCount) override {
+        if (m_meshVertexCount + vertexCount > static_cast<size_t>(MeshVertexCapacity) ||
+            m_meshIndexCount + indexCount > static_cast<size_t>(MeshIndexCapacity)) {
+            THROW("Shared mesh buffers are full");
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_meshVertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, m_meshVertexCount * sizeof(Geometry::Vertex), vertexCount * sizeof(Geometry::Vertex),
+                        vertices);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_meshIndexBuffer);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, m_meshIndexCount * sizeof(unsigned short), indexCount * sizeof(unsigned short),
+                        indices);
+
+        m_meshes.push_back(MeshRange{static_cast<GLuint>(m_meshIndexCount), static_cast<GLuint>(indexCount),
+                                     static_cast<GLint>(m_meshVertexCount)});
+        m_meshVertexCount += vertexCount;
+        m_meshIndexCount += indexCount;
+        return static_cast<uint32_t>(m_meshes.size() - 1);
     }
 
     void CheckShader(GLuint shader) {
@@ -257,7 +420,7 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
     }
 
     std::vector<XrSwapchainImageBaseHeader*> AllocateSwapchainImageStructs(
-        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/) override {
+        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/, uint32_t* swapchainIndex) override {
         // Allocate and initialize the buffer of image structs (must be sequential in memory for xrEnumerateSwapchainImages).
         // Return back an array of pointers to each swapchain image struct so the consumer doesn't need to know the type/size.
         std::vector<XrSwapchainImageOpenGLKHR> swapchainImageBuffer(capacity, {XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR});
@@ -266,49 +429,66 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
             swapchainImageBase.push_back(reinterpret_cast<XrSwapchainImageBaseHeader*>(&image));
         }
 
-        // Keep the buffer alive by moving it into the list of buffers.
-        m_swapchainImageBuffers.push_back(std::move(swapchainImageBuffer));
+        // Keep the buffer alive by moving it into the list of buffers. A moved vector keeps its storage, so the pointers
+        // stay valid when m_swapchainImages grows.
+        *swapchainIndex = static_cast<uint32_t>(m_swapchainImages.size());
+        m_swapchainImages.push_back({std::move(swapchainImageBuffer), std::vector<uint32_t>(capacity, 0)});
 
         return swapchainImageBase;
     }
 
-    uint32_t GetDepthTexture(uint32_t colorTexture) {
-        // If a depth-stencil view has already been created for this back-buffer, use it.
-        auto depthBufferIt = m_colorToDepthMap.find(colorTexture);
-        if (depthBufferIt != m_colorToDepthMap.end()) {
-            return depthBufferIt->second;
+    uint32_t GetDepthBuffer(uint32_t swapchainIndex, uint32_t imageIndex) {
+        // If this back-buffer has already been matched with a pooled depth buffer, use it.
+        SwapchainImages& swapchain = m_swapchainImages[swapchainIndex];
+        uint32_t& depthBuffer = swapchain.depthBuffers[imageIndex];
+        if (depthBuffer != 0) {
+            return depthBuffer;
         }
+        const uint32_t colorTexture = swapchain.images[imageIndex].image;
 
-        // This back-buffer has no corresponding depth-stencil texture, so create one with matching dimensions.
-
+        // Depth is cleared at the start of every view and never read back, so all back-buffers with matching dimensions can
+        // share one renderbuffer instead of each owning a full-resolution depth texture.
         GLint width;
         GLint height;
         glBindTexture(GL_TEXTURE_2D, colorTexture);
         glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
         glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Swapchains are single-sampled, see GetSupportedSwapchainSampleCount.
+        const GLint samples = 1;
+        const DepthKey key{width, height, GL_DEPTH24_STENCIL8, samples};
+        const size_t depthBytes = static_cast<size_t>(width) * height * samples * 4;
+
+        auto pooledIt = m_depthPool.find(key);
+        if (pooledIt != m_depthPool.end()) {
+            depthBuffer = pooledIt->second;
+        } else {
+            glGenRenderbuffers(1, &depthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            m_depthPool.insert(std::make_pair(key, depthBuffer));
+            m_depthPoolBytes += depthBytes;
+        }
 
-        uint32_t depthTexture;
-        glGenTextures(1, &depthTexture);
-        glBindTexture(GL_TEXTURE_2D, depthTexture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-
-        m_colorToDepthMap.insert(std::make_pair(colorTexture, depthTexture));
+        m_depthMatchedImages++;
+        m_depthUnpooledBytes += depthBytes;
+        Log::Write(Log::Level::Info, Fmt("Depth pool: %zu color images share %zu depth buffers (%.1f MB instead of %.1f MB)",
+                                         m_depthMatchedImages, m_depthPool.size(), m_depthPoolBytes / (1024.0 * 1024.0),
+                                         m_depthUnpooledBytes / (1024.0 * 1024.0)));
 
-        return depthTexture;
+        return depthBuffer;
     }
 
-    void RenderView(const XrCompositionLayerProjectionView& layerView, const XrSwapchainImageBaseHeader* swapchainImage,
+    void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t swapchainIndex, uint32_t imageIndex,
                     int64_t swapchainFormat, const std::vector<Cube>& cubes) override {
         CHECK(layerView.subImage.imageArrayIndex == 0);  // Texture arrays not supported.
         UNUSED_PARM(swapchainFormat);                    // Not used in this function for now.
 
         glBindFramebuffer(GL_FRAMEBUFFER, m_swapchainFramebuffer);
 
-        const uint32_t colorTexture = reinterpret_cast<const XrSwapchainImageOpenGLKHR*>(swapchainImage)->image;
+        const uint32_t colorTexture = m_swapchainImages[swapchainIndex].images[imageIndex].image;
 
         glViewport(static_cast<GLint>(layerView.subImage.imageRect.offset.x),
                    static_cast<GLint>(layerView.subImage.imageRect.offset.y),
@@ -320,19 +500,16 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
         glEnable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
 
-        const uint32_t depthTexture = GetDepthTexture(colorTexture);
+        const uint32_t depthBuffer = GetDepthBuffer(swapchainIndex, imageIndex);
 
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
 
         // Clear swapchain and depth buffer.
         glClearColor(m_clearColor[0], m_clearColor[1], m_clearColor[2], m_clearColor[3]);
         glClearDepth(1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        // Set shaders and uniform variables.
-        glUseProgram(m_program);
-
         const auto& pose = layerView.pose;
         XrMatrix4x4f proj;
         XrMatrix4x4f_CreateProjectionFov(&proj, GRAPHICS_OPENGL, layerView.fov, 0.05f, 100.0f);
@@ -346,6 +523,58 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
         // Set cube primitive data.
         glBindVertexArray(m_vao);
 
+        if (m_multiDrawProgram != 0) {
+            RenderMultiDrawIndirect(vp, cubes);
+        } else {
+            RenderEachCube(vp, cubes);
+        }
+
+        glBindVertexArray(0);
+        glUseProgram(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Submit every cube with a single glMultiDrawElementsIndirect call.
+    void RenderMultiDrawIndirect(const XrMatrix4x4f& vp, const std::vector<Cube>& cubes) {
+        if (cubes.empty()) {
+            return;
+        }
+        ReserveDrawCapacity(cubes.size());
+
+        m_drawCommands.clear();
+        m_drawData.clear();
+        for (const Cube& cube : cubes) {
+            CHECK(cube.Mesh < m_meshes.size());
+            const MeshRange& mesh = m_meshes[cube.Mesh];
+            const GLuint drawIndex = static_cast<GLuint>(m_drawCommands.size());
+            m_drawCommands.push_back(DrawElementsIndirectCommand{mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, drawIndex});
+
+            XrMatrix4x4f model;
+            XrMatrix4x4f_CreateTranslationRotationScale(&model, &cube.Pose.position, &cube.Pose.orientation, &cube.Scale);
+            XrMatrix4x4f mvp;
+            XrMatrix4x4f_Multiply(&mvp, &vp, &model);
+            m_drawData.push_back(mvp);
+        }
+
+        // Orphan and refill both buffers so the driver never waits on the previous eye's draw.
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_drawCommands.size() * sizeof(DrawElementsIndirectCommand), m_drawCommands.data(),
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawData.size() * sizeof(XrMatrix4x4f), m_drawData.data(), GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_drawDataBuffer);
+
+        glUseProgram(m_multiDrawProgram);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, static_cast<GLsizei>(m_drawCommands.size()), 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    void RenderEachCube(const XrMatrix4x4f& vp, const std::vector<Cube>& cubes) {
+        // Set shaders and uniform variables.
+        glUseProgram(m_program);
+
         // Render each cube
         for (const Cube& cube : cubes) {
             // Compute the model-view-projection transform and set it..
@@ -355,13 +584,12 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
             XrMatrix4x4f_Multiply(&mvp, &vp, &model);
             glUniformMatrix4fv(m_modelViewProjectionUniformLocation, 1, GL_FALSE, reinterpret_cast<const GLfloat*>(&mvp));
 
-            // Draw the cube.
-            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(ArraySize(Geometry::c_cubeIndices)), GL_UNSIGNED_SHORT, nullptr);
+            // Draw the cube's mesh from the shared buffers.
+            CHECK(cube.Mesh < m_meshes.size());
+            const MeshRange& mesh = m_meshes[cube.Mesh];
+            glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(mesh.indexCount), GL_UNSIGNED_SHORT,
+                                     reinterpret_cast<const void*>(mesh.firstIndex * sizeof(unsigned short)), mesh.baseVertex);
         }
-
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
     uint32_t GetSupportedSwapchainSampleCount(const XrViewConfigurationView&) override { return 1; }
@@ -383,18 +611,41 @@ struct OpenGLGraphicsPlugin : public IGraphicsPlugin {
 #error Platform not supported
 #endif
 
-    std::list<std::vector<XrSwapchainImageOpenGLKHR>> m_swapchainImageBuffers;
+    // The image structs of one AllocateSwapchainImageStructs call and the pooled depth buffer matched with each image,
+    // 0 until the image is first rendered. Indexed by swapchainIndex.
+    struct SwapchainImages {
+        std::vector<XrSwapchainImageOpenGLKHR> images;
+        std::vector<uint32_t> depthBuffers;
+    };
+    std::vector<SwapchainImages> m_swapchainImages;
     GLuint m_swapchainFramebuffer{0};
     GLuint m_program{0};
     GLint m_modelViewProjectionUniformLocation{0};
     GLint m_vertexAttribCoords{0};
     GLint m_vertexAttribColor{0};
     GLuint m_vao{0};
-    GLuint m_cubeVertexBuffer{0};
-    GLuint m_cubeIndexBuffer{0};
-
-    // Map color buffer to associated depth buffer. This map is populated on demand.
-    std::map<uint32_t, uint32_t> m_colorToDepthMap;
+    GLuint m_meshVertexBuffer{0};
+    GLuint m_meshIndexBuffer{0};
+    size_t m_meshVertexCount{0};
+    size_t m_meshIndexCount{0};
+    std::vector<MeshRange> m_meshes;
+
+    // Multi-draw-indirect path, only created on GL 4.3+.
+    GLuint m_multiDrawProgram{0};
+    GLint m_vertexAttribDrawIndex{0};
+    GLuint m_drawIndexBuffer{0};
+    GLuint m_drawCommandBuffer{0};
+    GLuint m_drawDataBuffer{0};
+    size_t m_drawCapacity{0};
+    std::vector<DrawElementsIndirectCommand> m_drawCommands;
+    std::vector<XrMatrix4x4f> m_drawData;
+
+    // Depth buffers keyed by (width, height, format, samples), shared by every color buffer with those properties.
+    using DepthKey = std::tuple<GLint, GLint, GLenum, GLint>;
+    std::map<DepthKey, uint32_t> m_depthPool;
+    size_t m_depthPoolBytes{0};
+    size_t m_depthUnpooledBytes{0};
+    size_t m_depthMatchedImages{0};
     std::array<float, 4> m_clearColor;
 };
 }  // namespace
@@ -7,6 +7,8 @@
 #include "geometry.h"
 #include "graphicsplugin.h"
 #include "options.h"
+#include <map>
+#include <tuple>
 
 #ifdef XR_USE_GRAPHICS_API_OPENGL_ES
 
@@ -68,9 +70,9 @@ struct OpenGLESGraphicsPlugin : public IGraphicsPlugin {
             glDeleteBuffers(1, &m_cubeIndexBuffer);
         }
 
-        for (auto& colorToDepth : m_colorToDepthMap) {
-            if (colorToDepth.second != 0) {
-                glDeleteTextures(1, &colorToDepth.second);
+        for (auto& pooledDepth : m_depthPool) {
+            if (pooledDepth.second != 0) {
+                glDeleteRenderbuffers(1, &pooledDepth.second);
             }
         }
 
@@ -229,7 +231,7 @@ struct OpenGLESGraphicsPlugin : public IGraphicsPlugin {
     }
 
     std::vector<XrSwapchainImageBaseHeader*> AllocateSwapchainImageStructs(
-        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/) override {
+        uint32_t capacity, const XrSwapchainCreateInfo& /*swapchainCreateInfo*/, uint32_t* swapchainIndex) override {
         // Allocate and initialize the buffer of image structs (must be sequential in memory for xrEnumerateSwapchainImages).
         // Return back an array of pointers to each swapchain image struct so the consumer doesn't need to know the type/size.
         std::vector<XrSwapchainImageOpenGLESKHR> swapchainImageBuffer(capacity, {XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR});
@@ -238,49 +240,66 @@ struct OpenGLESGraphicsPlugin : public IGraphicsPlugin {
             swapchainImageBase.push_back(reinterpret_cast<XrSwapchainImageBaseHeader*>(&image));
         }
 
-        // Keep the buffer alive by moving it into the list of buffers.
-        m_swapchainImageBuffers.push_back(std::move(swapchainImageBuffer));
+        // Keep the buffer alive by moving it into the list of buffers. A moved vector keeps its storage, so the pointers
+        // stay valid when m_swapchainImages grows.
+        *swapchainIndex = static_cast<uint32_t>(m_swapchainImages.size());
+        m_swapchainImages.push_back({std::move(swapchainImageBuffer), std::vector<uint32_t>(capacity, 0)});
 
         return swapchainImageBase;
     }
 
-    uint32_t GetDepthTexture(uint32_t colorTexture) {
-        // If a depth-stencil view has already been created for this back-buffer, use it.
-        auto depthBufferIt = m_colorToDepthMap.find(colorTexture);
-        if (depthBufferIt != m_colorToDepthMap.end()) {
-            return depthBufferIt->second;
+    uint32_t GetDepthBuffer(uint32_t swapchainIndex, uint32_t imageIndex) {
+        // If this back-buffer has already been matched with a pooled depth buffer, use it.
+        SwapchainImages& swapchain = m_swapchainImages[swapchainIndex];
+        uint32_t& depthBuffer = swapchain.depthBuffers[imageIndex];
+        if (depthBuffer != 0) {
+            return depthBuffer;
         }
+        const uint32_t colorTexture = swapchain.images[imageIndex].image;
 
-        // This back-buffer has no corresponding depth-stencil texture, so create one with matching dimensions.
-
+        // Depth is cleared at the start of every view and never read back, so all back-buffers with matching dimensions can
+        // share one renderbuffer instead of each owning a full-resolution depth texture.
         GLint width;
         GLint height;
         glBindTexture(GL_TEXTURE_2D, colorTexture);
         glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
         glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Swapchains are single-sampled, see GetSupportedSwapchainSampleCount.
+        const GLint samples = 1;
+        const DepthKey key{width, height, GL_DEPTH24_STENCIL8, samples};
+        const size_t depthBytes = static_cast<size_t>(width) * height * samples * 4;
+
+        auto pooledIt = m_depthPool.find(key);
+        if (pooledIt != m_depthPool.end()) {
+            depthBuffer = pooledIt->second;
+        } else {
+            glGenRenderbuffers(1, &depthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            m_depthPool.insert(std::make_pair(key, depthBuffer));
+            m_depthPoolBytes += depthBytes;
+        }
 
-        uint32_t depthTexture;
-        glGenTextures(1, &depthTexture);
-        glBindTexture(GL_TEXTURE_2D, depthTexture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
-
-        m_colorToDepthMap.insert(std::make_pair(colorTexture, depthTexture));
+        m_depthMatchedImages++;
+        m_depthUnpooledBytes += depthBytes;
+        Log::Write(Log::Level::Info, Fmt("Depth pool: %zu color images share %zu depth buffers (%.1f MB instead of %.1f MB)",
+                                         m_depthMatchedImages, m_depthPool.size(), m_depthPoolBytes / (1024.0 * 1024.0),
+                                         m_depthUnpooledBytes / (1024.0 * 1024.0)));
 
-        return depthTexture;
+        return depthBuffer;
     }
 
-    void RenderView(const XrCompositionLayerProjectionView& layerView, const XrSwapchainImageBaseHeader* swapchainImage,
+    void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t swapchainIndex, uint32_t imageIndex,
                     int64_t swapchainFormat, const std::vector<Cube>& cubes) override {
         CHECK(layerView.subImage.imageArrayIndex == 0);  // Texture arrays not supported.
         UNUSED_PARM(swapchainFormat);                    // Not used in this function for now.
 
         glBindFramebuffer(GL_FRAMEBUFFER, m_swapchainFramebuffer);
 
-        const uint32_t colorTexture = reinterpret_cast<const XrSwapchainImageOpenGLESKHR*>(swapchainImage)->image;
+        const uint32_t colorTexture = m_swapchainImages[swapchainIndex].images[imageIndex].image;
 
         glViewport(static_cast<GLint>(layerView.subImage.imageRect.offset.x),
                    static_cast<GLint>(layerView.subImage.imageRect.offset.y),
@@ -292,10 +311,10 @@ struct OpenGLESGraphicsPlugin : public IGraphicsPlugin {
         glEnable(GL_CULL_FACE);
         glEnable(GL_DEPTH_TEST);
 
-        const uint32_t depthTexture = GetDepthTexture(colorTexture);
+        const uint32_t depthBuffer = GetDepthBuffer(swapchainIndex, imageIndex);
 
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
 
         // Clear swapchain and depth buffer.
         glClearColor(m_clearColor[0], m_clearColor[1], m_clearColor[2], m_clearColor[3]);
@@ -345,7 +364,13 @@ struct OpenGLESGraphicsPlugin : public IGraphicsPlugin {
     XrGraphicsBindingOpenGLESAndroidKHR m_graphicsBinding{XR_TYPE_GRAPHICS_BINDING_OPENGL_ES_ANDROID_KHR};
 #endif
 
-    std::list<std::vector<XrSwapchainImageOpenGLESKHR>> m_swapchainImageBuffers;
+    // The image structs of one AllocateSwapchainImageStructs call and the pooled depth buffer matched with each image,
+    // 0 until the image is first rendered. Indexed by swapchainIndex.
+    struct SwapchainImages {
+        std::vector<XrSwapchainImageOpenGLESKHR> images;
+        std::vector<uint32_t> depthBuffers;
+    };
+    std::vector<SwapchainImages> m_swapchainImages;
     GLuint m_swapchainFramebuffer{0};
     GLuint m_program{0};
     GLint m_modelViewProjectionUniformLocation{0};
@@ -356,8 +381,12 @@ struct OpenGLESGraphicsPlugin : public IGraphicsPlugin {
     GLuint m_cubeIndexBuffer{0};
     GLint m_contextApiMajorVersion{0};
 
-    // Map color buffer to associated depth buffer. This map is populated on demand.
-    std::map<uint32_t, uint32_t> m_colorToDepthMap;
+    // Depth buffers keyed by (width, height, format, samples), shared by every color buffer with those properties.
+    using DepthKey = std::tuple<GLint, GLint, GLenum, GLint>;
+    std::map<DepthKey, uint32_t> m_depthPool;
+    size_t m_depthPoolBytes{0};
+    size_t m_depthUnpooledBytes{0};
+    size_t m_depthMatchedImages{0};
     std::array<float, 4> m_clearColor;
 };
 }  // namespace
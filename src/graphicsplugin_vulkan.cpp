@@ -11,6 +11,8 @@
 #ifdef XR_USE_GRAPHICS_API_VULKAN
 #include <common/vulkan_debug_object_namer.hpp>
 #include <common/xr_linear.h>
+#include <deque>
+#include <vector>
 
 #ifdef USE_ONLINE_VULKAN_SHADERC
 #include <shaderc/shaderc.hpp>
@@ -457,10 +459,10 @@ struct VertexBufferBase {
 
    protected:
     VkDevice m_vkDevice{VK_NULL_HANDLE};
-    void AllocateBufferMemory(VkBuffer buf, VkDeviceMemory* mem) const {
+    void AllocateBufferMemory(VkBuffer buf, VkDeviceMemory* mem, VkFlags flags = MemoryAllocator::defaultFlags) const {
         VkMemoryRequirements memReq = {};
         vkGetBufferMemoryRequirements(m_vkDevice, buf, &memReq);
-        m_memAllocator->Allocate(memReq, mem);
+        m_memAllocator->Allocate(memReq, mem, flags);
     }
 
    private:
@@ -470,18 +472,19 @@ struct VertexBufferBase {
 // VertexBuffer template to wrap the indices and vertices
 template <typename T>
 struct VertexBuffer : public VertexBufferBase {
-    bool Create(uint32_t idxCount, uint32_t vtxCount) {
+    // UpdateIndices/UpdateVertices need host visible memory; device local buffers are filled through a TransferUploader.
+    bool Create(uint32_t idxCount, uint32_t vtxCount, VkFlags memFlags = MemoryAllocator::defaultFlags) {
         VkBufferCreateInfo bufInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
-        bufInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        bufInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
         bufInfo.size = sizeof(uint16_t) * idxCount;
         CHECK_VKCMD(vkCreateBuffer(m_vkDevice, &bufInfo, nullptr, &idxBuf));
-        AllocateBufferMemory(idxBuf, &idxMem);
+        AllocateBufferMemory(idxBuf, &idxMem, memFlags);
         CHECK_VKCMD(vkBindBufferMemory(m_vkDevice, idxBuf, idxMem, 0));
 
-        bufInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        bufInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
         bufInfo.size = sizeof(T) * vtxCount;
         CHECK_VKCMD(vkCreateBuffer(m_vkDevice, &bufInfo, nullptr, &vtxBuf));
-        AllocateBufferMemory(vtxBuf, &vtxMem);
+        AllocateBufferMemory(vtxBuf, &vtxMem, memFlags);
         CHECK_VKCMD(vkBindBufferMemory(m_vkDevice, vtxBuf, vtxMem, 0));
 
         bindDesc.binding = 0;
@@ -512,6 +515,296 @@ struct VertexBuffer : public VertexBufferBase {
     }
 };
 
+// TransferUploader - copy buffer and image contents on the transfer queue so large uploads overlap with rendering.
+// Each upload is its own submission identified by a ticket. The transfer queue signals the ticket on a timeline semaphore
+// (or a per-upload fence without VK_KHR_timeline_semaphore). Once it has completed, AcquireCompleted() records the
+// matching queue family ownership acquire into the graphics command buffer, after which the resource may be used there.
+struct TransferUploader {
+    TransferUploader() = default;
+
+    TransferUploader(const TransferUploader&) = delete;
+    TransferUploader& operator=(const TransferUploader&) = delete;
+    TransferUploader(TransferUploader&&) = delete;
+    TransferUploader& operator=(TransferUploader&&) = delete;
+
+    ~TransferUploader() {
+        if (m_vkDevice != nullptr) {
+            if (m_queue != VK_NULL_HANDLE) {
+                vkQueueWaitIdle(m_queue);
+            }
+            for (Upload& upload : m_uploads) {
+                Release(upload);
+            }
+            if (m_timeline != VK_NULL_HANDLE) {
+                vkDestroySemaphore(m_vkDevice, m_timeline, nullptr);
+            }
+            if (m_pool != VK_NULL_HANDLE) {
+                vkDestroyCommandPool(m_vkDevice, m_pool, nullptr);
+            }
+        }
+        m_uploads.clear();
+        m_timeline = VK_NULL_HANDLE;
+        m_pool = VK_NULL_HANDLE;
+        m_queue = VK_NULL_HANDLE;
+        m_vkDevice = nullptr;
+    }
+
+    void Init(const VulkanDebugObjectNamer& namer, VkDevice device, const MemoryAllocator* memAllocator, VkQueue transferQueue,
+              uint32_t transferQueueFamilyIndex, uint32_t graphicsQueueFamilyIndex, bool timelineSemaphoreEnabled) {
+        m_vkDevice = device;
+        m_namer = &namer;
+        m_memAllocator = memAllocator;
+        m_queue = transferQueue;
+        m_transferQueueFamilyIndex = transferQueueFamilyIndex;
+        m_graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+
+        VkCommandPoolCreateInfo cmdPoolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        cmdPoolInfo.queueFamilyIndex = m_transferQueueFamilyIndex;
+        CHECK_VKCMD(vkCreateCommandPool(m_vkDevice, &cmdPoolInfo, nullptr, &m_pool));
+        CHECK_VKCMD(namer.SetName(VK_OBJECT_TYPE_COMMAND_POOL, (uint64_t)m_pool, "hello_xr transfer command pool"));
+
+        if (timelineSemaphoreEnabled) {
+            m_vkGetSemaphoreCounterValueKHR =
+                (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(m_vkDevice, "vkGetSemaphoreCounterValueKHR");
+        }
+        if (m_vkGetSemaphoreCounterValueKHR != nullptr) {
+            VkSemaphoreTypeCreateInfoKHR typeInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR};
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+            typeInfo.initialValue = 0;
+            VkSemaphoreCreateInfo semInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &typeInfo};
+            CHECK_VKCMD(vkCreateSemaphore(m_vkDevice, &semInfo, nullptr, &m_timeline));
+            CHECK_VKCMD(namer.SetName(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)m_timeline, "hello_xr transfer timeline semaphore"));
+        }
+
+        Log::Write(Log::Level::Info,
+                   Fmt("Transfer uploads on queue family %d (%s), completion by %s", m_transferQueueFamilyIndex,
+                       NeedsOwnershipTransfer() ? "dedicated" : "shared with graphics",
+                       m_timeline != VK_NULL_HANDLE ? "timeline semaphore" : "fence"));
+    }
+
+    // Copy data into dst, starting at offset 0. dstStage/dstAccess describe the first use on the graphics queue.
+    uint64_t UploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStage,
+                          VkAccessFlags dstAccess) {
+        Upload& upload = BeginUpload(data, size);
+
+        VkBufferCopy region{0, 0, size};
+        vkCmdCopyBuffer(upload.cmd, upload.staging, dst, 1, &region);
+
+        VkBufferMemoryBarrier& barrier = upload.bufferBarrier;
+        barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        barrier.buffer = dst;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        if (NeedsOwnershipTransfer()) {
+            barrier.srcQueueFamilyIndex = m_transferQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = m_graphicsQueueFamilyIndex;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(upload.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                                 &barrier, 0, nullptr);
+            // The acquire half only makes the data visible; the release above already made it available.
+            barrier.srcAccessMask = 0;
+        } else {
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        barrier.dstAccessMask = dstAccess;
+        upload.dstStage = dstStage;
+
+        return EndUpload(upload);
+    }
+
+    // Copy tightly packed texel data into mip 0 / layer 0 of dst, which ends up in finalLayout.
+    uint64_t UploadImage(VkImage dst, VkImageAspectFlags aspect, VkExtent3D extent, const void* data, VkDeviceSize size,
+                         VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        Upload& upload = BeginUpload(data, size);
+        upload.isImage = true;
+
+        VkImageMemoryBarrier& barrier = upload.imageBarrier;
+        barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+        barrier.image = dst;
+        barrier.subresourceRange = {aspect, 0, 1, 0, 1};
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        vkCmdPipelineBarrier(upload.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                             1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = {aspect, 0, 0, 1};
+        region.imageExtent = extent;
+        vkCmdCopyBufferToImage(upload.cmd, upload.staging, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        // The release and the acquire have to agree on the layout transition.
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = finalLayout;
+        if (NeedsOwnershipTransfer()) {
+            barrier.srcQueueFamilyIndex = m_transferQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = m_graphicsQueueFamilyIndex;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            vkCmdPipelineBarrier(upload.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                                 nullptr, 1, &barrier);
+            barrier.srcAccessMask = 0;
+        } else {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        barrier.dstAccessMask = dstAccess;
+        upload.dstStage = dstStage;
+
+        return EndUpload(upload);
+    }
+
+    // Record the acquire barriers of every upload that has finished on the transfer queue. Call on a graphics command buffer
+    // before anything that may use the uploaded resources.
+    void AcquireCompleted(VkCommandBuffer cmd) {
+        if (m_uploads.empty()) {
+            return;
+        }
+
+        uint64_t completedValue = 0;
+        if (m_timeline != VK_NULL_HANDLE) {
+            CHECK_VKCMD(m_vkGetSemaphoreCounterValueKHR(m_vkDevice, m_timeline, &completedValue));
+        }
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        VkPipelineStageFlags dstStage = 0;
+        for (auto it = m_uploads.begin(); it != m_uploads.end();) {
+            const bool completed = m_timeline != VK_NULL_HANDLE ? completedValue >= it->ticket
+                                                                 : vkGetFenceStatus(m_vkDevice, it->fence) == VK_SUCCESS;
+            if (!completed) {
+                ++it;
+                continue;
+            }
+            if (it->isImage) {
+                imageBarriers.push_back(it->imageBarrier);
+            } else {
+                bufferBarriers.push_back(it->bufferBarrier);
+            }
+            dstStage |= it->dstStage;
+            Release(*it);
+            it = m_uploads.erase(it);
+        }
+
+        if (dstStage != 0) {
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, (uint32_t)bufferBarriers.size(),
+                                 bufferBarriers.data(), (uint32_t)imageBarriers.size(), imageBarriers.data());
+        }
+    }
+
+    // True once the upload has been acquired by a graphics command buffer.
+    bool IsReady(uint64_t ticket) const {
+        if (ticket == 0 || ticket > m_lastTicket) {
+            return false;
+        }
+        return std::none_of(m_uploads.begin(), m_uploads.end(), [ticket](const Upload& upload) { return upload.ticket == ticket; });
+    }
+
+   private:
+    struct Upload {
+        uint64_t ticket{0};
+        VkCommandBuffer cmd{VK_NULL_HANDLE};
+        VkFence fence{VK_NULL_HANDLE};
+        VkBuffer staging{VK_NULL_HANDLE};
+        VkDeviceMemory stagingMem{VK_NULL_HANDLE};
+        bool isImage{false};
+        VkBufferMemoryBarrier bufferBarrier{};
+        VkImageMemoryBarrier imageBarrier{};
+        VkPipelineStageFlags dstStage{0};
+    };
+
+    VkDevice m_vkDevice{VK_NULL_HANDLE};
+    const VulkanDebugObjectNamer* m_namer{nullptr};
+    const MemoryAllocator* m_memAllocator{nullptr};
+    VkQueue m_queue{VK_NULL_HANDLE};
+    uint32_t m_transferQueueFamilyIndex{0};
+    uint32_t m_graphicsQueueFamilyIndex{0};
+    VkCommandPool m_pool{VK_NULL_HANDLE};
+    VkSemaphore m_timeline{VK_NULL_HANDLE};
+    PFN_vkGetSemaphoreCounterValueKHR m_vkGetSemaphoreCounterValueKHR{nullptr};
+    uint64_t m_lastTicket{0};
+    std::vector<Upload> m_uploads;
+
+    bool NeedsOwnershipTransfer() const { return m_transferQueueFamilyIndex != m_graphicsQueueFamilyIndex; }
+
+    Upload& BeginUpload(const void* data, VkDeviceSize size) {
+        m_uploads.emplace_back();
+        Upload& upload = m_uploads.back();
+        upload.ticket = ++m_lastTicket;
+
+        VkBufferCreateInfo bufInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+        bufInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufInfo.size = size;
+        CHECK_VKCMD(vkCreateBuffer(m_vkDevice, &bufInfo, nullptr, &upload.staging));
+        CHECK_VKCMD(m_namer->SetName(VK_OBJECT_TYPE_BUFFER, (uint64_t)upload.staging, "hello_xr staging buffer"));
+        VkMemoryRequirements memReq = {};
+        vkGetBufferMemoryRequirements(m_vkDevice, upload.staging, &memReq);
+        m_memAllocator->Allocate(memReq, &upload.stagingMem);
+        CHECK_VKCMD(vkBindBufferMemory(m_vkDevice, upload.staging, upload.stagingMem, 0));
+
+        void* map = nullptr;
+        CHECK_VKCMD(vkMapMemory(m_vkDevice, upload.stagingMem, 0, size, 0, &map));
+        memcpy(map, data, (size_t)size);
+        vkUnmapMemory(m_vkDevice, upload.stagingMem);
+
+        VkCommandBufferAllocateInfo cmdInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        cmdInfo.commandPool = m_pool;
+        cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdInfo.commandBufferCount = 1;
+        CHECK_VKCMD(vkAllocateCommandBuffers(m_vkDevice, &cmdInfo, &upload.cmd));
+
+        VkCommandBufferBeginInfo cmdBeginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        CHECK_VKCMD(vkBeginCommandBuffer(upload.cmd, &cmdBeginInfo));
+        return upload;
+    }
+
+    uint64_t EndUpload(Upload& upload) {
+        CHECK_VKCMD(vkEndCommandBuffer(upload.cmd));
+
+        VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &upload.cmd;
+
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR};
+        if (m_timeline != VK_NULL_HANDLE) {
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &upload.ticket;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &m_timeline;
+        } else {
+            VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            CHECK_VKCMD(vkCreateFence(m_vkDevice, &fenceInfo, nullptr, &upload.fence));
+        }
+        CHECK_VKCMD(vkQueueSubmit(m_queue, 1, &submitInfo, upload.fence));
+
+        return upload.ticket;
+    }
+
+    // Only valid once the transfer queue is done with the upload.
+    void Release(Upload& upload) {
+        if (upload.cmd != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(m_vkDevice, m_pool, 1, &upload.cmd);
+        }
+        if (upload.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(m_vkDevice, upload.fence, nullptr);
+        }
+        if (upload.staging != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_vkDevice, upload.staging, nullptr);
+        }
+        if (upload.stagingMem != VK_NULL_HANDLE) {
+            vkFreeMemory(m_vkDevice, upload.stagingMem, nullptr);
+        }
+        upload = {};
+    }
+};
+
 // RenderPass wrapper
 struct RenderPass {
     VkFormat colorFmt{};
@@ -719,9 +1012,17 @@ struct RenderTarget {
     VkDevice m_vkDevice{VK_NULL_HANDLE};
 };
 
+// Per-view constants, bound at set 0, binding 0 through a dynamic uniform buffer offset:
+//   layout (std140, set = 0, binding = 0) uniform ViewConstants { mat4 viewProjection; mat4 view; };
+struct ViewConstants {
+    XrMatrix4x4f ViewProjection;
+    XrMatrix4x4f View;
+};
+
 // Simple vertex MVP xform & color fragment shader layout
 struct PipelineLayout {
     VkPipelineLayout layout{VK_NULL_HANDLE};
+    VkDescriptorSetLayout viewSetLayout{VK_NULL_HANDLE};
 
     PipelineLayout() = default;
 
@@ -730,14 +1031,30 @@ struct PipelineLayout {
             if (layout != VK_NULL_HANDLE) {
                 vkDestroyPipelineLayout(m_vkDevice, layout, nullptr);
             }
+            if (viewSetLayout != VK_NULL_HANDLE) {
+                vkDestroyDescriptorSetLayout(m_vkDevice, viewSetLayout, nullptr);
+            }
         }
         layout = VK_NULL_HANDLE;
+        viewSetLayout = VK_NULL_HANDLE;
         m_vkDevice = nullptr;
     }
 
     void Create(VkDevice device) {
         m_vkDevice = device;
 
+        // Set 0: per-view constants, sub-allocated from a per-frame uniform buffer
+        VkDescriptorSetLayoutBinding viewBinding{};
+        viewBinding.binding = 0;
+        viewBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        viewBinding.descriptorCount = 1;
+        viewBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        setLayoutInfo.bindingCount = 1;
+        setLayoutInfo.pBindings = &viewBinding;
+        CHECK_VKCMD(vkCreateDescriptorSetLayout(m_vkDevice, &setLayoutInfo, nullptr, &viewSetLayout));
+
         // MVP matrix is a push_constant
         VkPushConstantRange pcr = {};
         pcr.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
@@ -745,6 +1062,8 @@ struct PipelineLayout {
         pcr.size = 4 * 4 * sizeof(float);
 
         VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pipelineLayoutCreateInfo.setLayoutCount = 1;
+        pipelineLayoutCreateInfo.pSetLayouts = &viewSetLayout;
         pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
         pipelineLayoutCreateInfo.pPushConstantRanges = &pcr;
         CHECK_VKCMD(vkCreatePipelineLayout(m_vkDevice, &pipelineLayoutCreateInfo, nullptr, &layout));
@@ -887,6 +1206,125 @@ struct Pipeline {
     VkDevice m_vkDevice{VK_NULL_HANDLE};
 };
 
+// Persistently mapped uniform buffer that a frame's constants are sub-allocated from and bound with dynamic offsets.
+// The whole buffer is recycled at once, after the command buffer that consumed it has completed.
+struct UniformBuffer {
+    VkBuffer buf{VK_NULL_HANDLE};
+    VkDeviceMemory mem{VK_NULL_HANDLE};
+    VkDeviceSize size{0};
+
+    UniformBuffer() = default;
+
+    ~UniformBuffer() {
+        if (m_vkDevice != nullptr) {
+            if (mem != VK_NULL_HANDLE && m_mapped != nullptr) {
+                vkUnmapMemory(m_vkDevice, mem);
+            }
+            if (buf != VK_NULL_HANDLE) {
+                vkDestroyBuffer(m_vkDevice, buf, nullptr);
+            }
+            if (mem != VK_NULL_HANDLE) {
+                vkFreeMemory(m_vkDevice, mem, nullptr);
+            }
+        }
+        buf = VK_NULL_HANDLE;
+        mem = VK_NULL_HANDLE;
+        m_mapped = nullptr;
+        m_vkDevice = nullptr;
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    UniformBuffer(UniformBuffer&&) = delete;
+    UniformBuffer& operator=(UniformBuffer&&) = delete;
+
+    void Create(const VulkanDebugObjectNamer& namer, VkDevice device, const MemoryAllocator* memAllocator, VkDeviceSize capacity,
+                VkDeviceSize alignment) {
+        m_vkDevice = device;
+        m_alignment = std::max<VkDeviceSize>(alignment, 1);
+        size = capacity;
+
+        VkBufferCreateInfo bufInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+        bufInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        bufInfo.size = size;
+        CHECK_VKCMD(vkCreateBuffer(m_vkDevice, &bufInfo, nullptr, &buf));
+        CHECK_VKCMD(namer.SetName(VK_OBJECT_TYPE_BUFFER, (uint64_t)buf, "hello_xr uniform buffer"));
+
+        VkMemoryRequirements memReq = {};
+        vkGetBufferMemoryRequirements(m_vkDevice, buf, &memReq);
+        memAllocator->Allocate(memReq, &mem);
+        CHECK_VKCMD(vkBindBufferMemory(m_vkDevice, buf, mem, 0));
+        CHECK_VKCMD(vkMapMemory(m_vkDevice, mem, 0, VK_WHOLE_SIZE, 0, &m_mapped));
+    }
+
+    // Start a new frame. Only valid once the GPU is done with everything pushed before.
+    void Reset() { m_head = 0; }
+
+    // Copy data into the buffer and return the dynamic offset it has to be bound at.
+    uint32_t Push(const void* data, VkDeviceSize dataSize) {
+        const VkDeviceSize offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+        if (offset + dataSize > size) {
+            THROW(Fmt("Uniform buffer exhausted: %llu bytes per frame", (unsigned long long)size));
+        }
+        memcpy(static_cast<uint8_t*>(m_mapped) + offset, data, (size_t)dataSize);
+        m_head = offset + dataSize;
+        return (uint32_t)offset;
+    }
+
+   private:
+    VkDevice m_vkDevice{VK_NULL_HANDLE};
+    VkDeviceSize m_alignment{1};
+    VkDeviceSize m_head{0};
+    void* m_mapped{nullptr};
+};
+
+// Descriptor pool whose sets are allocated once and live as long as the pool.
+struct DescriptorPool {
+    VkDescriptorPool pool{VK_NULL_HANDLE};
+
+    DescriptorPool() = default;
+
+    ~DescriptorPool() {
+        if (m_vkDevice != nullptr) {
+            if (pool != VK_NULL_HANDLE) {
+                vkDestroyDescriptorPool(m_vkDevice, pool, nullptr);
+            }
+        }
+        pool = VK_NULL_HANDLE;
+        m_vkDevice = nullptr;
+    }
+
+    DescriptorPool(const DescriptorPool&) = delete;
+    DescriptorPool& operator=(const DescriptorPool&) = delete;
+    DescriptorPool(DescriptorPool&&) = delete;
+    DescriptorPool& operator=(DescriptorPool&&) = delete;
+
+    void Create(const VulkanDebugObjectNamer& namer, VkDevice device, uint32_t maxSets) {
+        m_vkDevice = device;
+
+        VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, maxSets};
+        VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        poolInfo.maxSets = maxSets;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        CHECK_VKCMD(vkCreateDescriptorPool(m_vkDevice, &poolInfo, nullptr, &pool));
+        CHECK_VKCMD(namer.SetName(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)pool, "hello_xr descriptor pool"));
+    }
+
+    VkDescriptorSet Allocate(VkDescriptorSetLayout layout) {
+        VkDescriptorSetAllocateInfo allocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        VkDescriptorSet set{VK_NULL_HANDLE};
+        CHECK_VKCMD(vkAllocateDescriptorSets(m_vkDevice, &allocInfo, &set));
+        return set;
+    }
+
+   private:
+    VkDevice m_vkDevice{VK_NULL_HANDLE};
+};
+
 struct DepthBuffer {
     VkDeviceMemory depthMemory{VK_NULL_HANDLE};
     VkImage depthImage{VK_NULL_HANDLE};
@@ -995,14 +1433,22 @@ struct SwapchainImageContext {
     RenderPass rp{};
     Pipeline pipe{};
     CmdBuffer cmdBuffer{};
+    // Frame resources, recycled each time cmdBuffer has completed.
+    UniformBuffer uniformBuffer{};
+    // Points at the whole of uniformBuffer, each draw only binds a different dynamic offset.
+    DescriptorPool descriptorPool{};
+    VkDescriptorSet viewSet{VK_NULL_HANDLE};
     XrStructureType swapchainImageType;
 
+    static constexpr VkDeviceSize UniformBufferSize = 64 * 1024;
+
     SwapchainImageContext() = default;
 
     std::vector<XrSwapchainImageBaseHeader*> Create(const VulkanDebugObjectNamer& namer, VkDevice device, uint32_t queueFamilyIndex,
                                                     MemoryAllocator* memAllocator, uint32_t capacity,
                                                     const XrSwapchainCreateInfo& swapchainCreateInfo, const PipelineLayout& layout,
-                                                    const ShaderProgram& sp, const VertexBuffer<Geometry::Vertex>& vb) {
+                                                    const ShaderProgram& sp, const VertexBuffer<Geometry::Vertex>& vb,
+                                                    VkDeviceSize uniformBufferAlignment) {
         m_vkDevice = device;
         m_namer = namer;
 
@@ -1027,13 +1473,26 @@ struct SwapchainImageContext {
             THROW("Failed to create command buffer");
         }
 
+        uniformBuffer.Create(namer, device, memAllocator, UniformBufferSize, uniformBufferAlignment);
+        descriptorPool.Create(namer, device, 1);
+        viewSet = descriptorPool.Allocate(layout.viewSetLayout);
+        VkDescriptorBufferInfo bufferInfo{uniformBuffer.buf, 0, sizeof(ViewConstants)};
+        VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        write.dstSet = viewSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(m_vkDevice, 1, &write, 0, nullptr);
+
         return bases;
     }
 
-    uint32_t ImageIndex(const XrSwapchainImageBaseHeader* swapchainImageHeader) {
-        auto p = reinterpret_cast<const XrSwapchainImageVulkan2KHR*>(swapchainImageHeader);
-        return (uint32_t)(p - &swapchainImages[0]);
-    }
+    // Recycle the frame resources. The caller must have waited for cmdBuffer.
+    void BeginFrame() { uniformBuffer.Reset(); }
+
+    // Push the view constants. Returns the dynamic offset to bind viewSet with.
+    uint32_t PushViewConstants(const ViewConstants& constants) { return uniformBuffer.Push(&constants, sizeof(constants)); }
 
     void BindRenderTarget(uint32_t index, VkRenderPassBeginInfo* renderPassBeginInfo) {
         if (renderTarget[index].fb == VK_NULL_HANDLE) {
@@ -1354,6 +1813,7 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
 #endif
 
         std::vector<const char*> extensions;
+        bool physicalDeviceProperties2Enabled = false;
         {
             uint32_t extensionCount = 0;
             CHECK_VKCMD(vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr));
@@ -1374,6 +1834,11 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
             if (isExtSupported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)) {
                 extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
             }
+            // Required by VK_KHR_timeline_semaphore on a 1.0 instance
+            if (isExtSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+                extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                physicalDeviceProperties2Enabled = true;
+            }
             // TODO add back VK_EXT_debug_report code for compatibility with older systems? (Android)
         }
 #if defined(USE_MIRROR_WINDOW)
@@ -1448,6 +1913,20 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
             }
         }
 
+        // A transfer-only family is usually backed by a DMA engine that runs concurrently with graphics.
+        std::vector<VkDeviceQueueCreateInfo> queueInfos{queueInfo};
+        m_transferQueueFamilyIndex = m_queueFamilyIndex;
+        for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+            const VkQueueFlags flags = queueFamilyProps[i].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) != 0u && (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0u) {
+                m_transferQueueFamilyIndex = i;
+                VkDeviceQueueCreateInfo transferQueueInfo = queueInfo;
+                transferQueueInfo.queueFamilyIndex = i;
+                queueInfos.push_back(transferQueueInfo);
+                break;
+            }
+        }
+
         std::vector<const char*> deviceExtensions;
 
         VkPhysicalDeviceFeatures features{};
@@ -1457,9 +1936,29 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
         deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 #endif
 
+        // Timeline semaphores report transfer completion; without them each upload gets a fence.
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR};
+        if (physicalDeviceProperties2Enabled) {
+            uint32_t deviceExtensionCount = 0;
+            CHECK_VKCMD(vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &deviceExtensionCount, nullptr));
+            std::vector<VkExtensionProperties> availableDeviceExtensions(deviceExtensionCount);
+            CHECK_VKCMD(vkEnumerateDeviceExtensionProperties(m_vkPhysicalDevice, nullptr, &deviceExtensionCount,
+                                                             availableDeviceExtensions.data()));
+            m_timelineSemaphoreEnabled =
+                std::any_of(availableDeviceExtensions.begin(), availableDeviceExtensions.end(), [](const VkExtensionProperties& p) {
+                    return 0 == strcmp(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, p.extensionName);
+                });
+        }
+        if (m_timelineSemaphoreEnabled) {
+            deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+        }
+
         VkDeviceCreateInfo deviceInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
-        deviceInfo.queueCreateInfoCount = 1;
-        deviceInfo.pQueueCreateInfos = &queueInfo;
+        deviceInfo.pNext = m_timelineSemaphoreEnabled ? &timelineSemaphoreFeatures : nullptr;
+        deviceInfo.queueCreateInfoCount = (uint32_t)queueInfos.size();
+        deviceInfo.pQueueCreateInfos = queueInfos.data();
         deviceInfo.enabledLayerCount = 0;
         deviceInfo.ppEnabledLayerNames = nullptr;
         deviceInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
@@ -1478,6 +1977,11 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
         m_namer.Init(m_vkInstance, m_vkDevice);
 
         vkGetDeviceQueue(m_vkDevice, queueInfo.queueFamilyIndex, 0, &m_vkQueue);
+        if (m_transferQueueFamilyIndex != m_queueFamilyIndex) {
+            vkGetDeviceQueue(m_vkDevice, m_transferQueueFamilyIndex, 0, &m_vkTransferQueue);
+        } else {
+            m_vkTransferQueue = m_vkQueue;
+        }
 
         m_memAllocator.Init(m_vkPhysicalDevice, m_vkDevice);
 
@@ -1537,15 +2041,26 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
 
         m_pipelineLayout.Create(m_vkDevice);
 
+        VkPhysicalDeviceProperties physicalDeviceProperties{};
+        vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &physicalDeviceProperties);
+        m_uniformBufferAlignment = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+
         static_assert(sizeof(Geometry::Vertex) == 24, "Unexpected Vertex size");
         m_drawBuffer.Init(m_vkDevice, &m_memAllocator,
                           {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Geometry::Vertex, Position)},
                            {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Geometry::Vertex, Color)}});
         uint32_t numCubeIdicies = sizeof(Geometry::c_cubeIndices) / sizeof(Geometry::c_cubeIndices[0]);
         uint32_t numCubeVerticies = sizeof(Geometry::c_cubeVertices) / sizeof(Geometry::c_cubeVertices[0]);
-        m_drawBuffer.Create(numCubeIdicies, numCubeVerticies);
-        m_drawBuffer.UpdateIndices(Geometry::c_cubeIndices, numCubeIdicies, 0);
-        m_drawBuffer.UpdateVertices(Geometry::c_cubeVertices, numCubeVerticies, 0);
+        m_drawBuffer.Create(numCubeIdicies, numCubeVerticies, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        // The cube is streamed into device local memory; RenderView skips it until the upload has landed.
+        m_uploader.Init(m_namer, m_vkDevice, &m_memAllocator, m_vkTransferQueue, m_transferQueueFamilyIndex, m_queueFamilyIndex,
+                        m_timelineSemaphoreEnabled);
+        m_drawBufferUploads = {
+            m_uploader.UploadBuffer(m_drawBuffer.idxBuf, Geometry::c_cubeIndices, sizeof(Geometry::c_cubeIndices),
+                                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT),
+            m_uploader.UploadBuffer(m_drawBuffer.vtxBuf, Geometry::c_cubeVertices, sizeof(Geometry::c_cubeVertices),
+                                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT)};
 
 #if defined(USE_MIRROR_WINDOW)
         m_swapchain.Create(m_vkInstance, m_vkPhysicalDevice, m_vkDevice, m_graphicsBinding.queueFamilyIndex);
@@ -1579,39 +2094,36 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
     }
 
     std::vector<XrSwapchainImageBaseHeader*> AllocateSwapchainImageStructs(
-        uint32_t capacity, const XrSwapchainCreateInfo& swapchainCreateInfo) override {
+        uint32_t capacity, const XrSwapchainCreateInfo& swapchainCreateInfo, uint32_t* swapchainIndex) override {
         // Allocate and initialize the buffer of image structs (must be sequential in memory for xrEnumerateSwapchainImages).
         // Return back an array of pointers to each swapchain image struct so the consumer doesn't need to know the type/size.
         // Keep the buffer alive by adding it into the list of buffers.
+        *swapchainIndex = static_cast<uint32_t>(m_swapchainImageContexts.size());
         m_swapchainImageContexts.emplace_back(GetSwapchainImageType());
         SwapchainImageContext& swapchainImageContext = m_swapchainImageContexts.back();
 
-        std::vector<XrSwapchainImageBaseHeader*> bases =
-            swapchainImageContext.Create(m_namer, m_vkDevice, m_queueFamilyIndex, &m_memAllocator, capacity, swapchainCreateInfo,
-                                         m_pipelineLayout, m_shaderProgram, m_drawBuffer);
-
-        // Map every swapchainImage base pointer to this context
-        for (auto& base : bases) {
-            m_swapchainImageContextMap[base] = &swapchainImageContext;
-        }
-
-        return bases;
+        return swapchainImageContext.Create(m_namer, m_vkDevice, m_queueFamilyIndex, &m_memAllocator, capacity,
+                                            swapchainCreateInfo, m_pipelineLayout, m_shaderProgram, m_drawBuffer,
+                                            m_uniformBufferAlignment);
     }
 
-    void RenderView(const XrCompositionLayerProjectionView& layerView, const XrSwapchainImageBaseHeader* swapchainImage,
+    void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t swapchainIndex, uint32_t imageIndex,
                     int64_t /*swapchainFormat*/, const std::vector<Cube>& cubes) override {
         CHECK(layerView.subImage.imageArrayIndex == 0);  // Texture arrays not supported.
 
-        auto swapchainContext = m_swapchainImageContextMap[swapchainImage];
-        uint32_t imageIndex = swapchainContext->ImageIndex(swapchainImage);
+        auto swapchainContext = &m_swapchainImageContexts[swapchainIndex];
 
         // Note: this needs to be modified to avoid blocking on the CmdBuffer fence between multiple views of the same frame, if
         // Texture arrays are supported.
         CmdBuffer& cmdBuffer = swapchainContext->cmdBuffer;
         cmdBuffer.Wait();
         cmdBuffer.Reset();
+        swapchainContext->BeginFrame();
         cmdBuffer.Begin();
 
+        // Take ownership of whatever the transfer queue has finished since the last view.
+        m_uploader.AcquireCompleted(cmdBuffer.buf);
+
         // Ensure depth is in the right layout
         swapchainContext->depthBuffer.TransitionLayout(&cmdBuffer, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 
@@ -1650,8 +2162,19 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
         XrMatrix4x4f vp;
         XrMatrix4x4f_Multiply(&vp, &proj, &view);
 
-        // Render each cube
+        // Bind the per-view constants.
+        const ViewConstants viewConstants{vp, view};
+        const uint32_t viewConstantsOffset = swapchainContext->PushViewConstants(viewConstants);
+        vkCmdBindDescriptorSets(cmdBuffer.buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.layout, 0, 1,
+                                &swapchainContext->viewSet, 1, &viewConstantsOffset);
+
+        // Render each cube, once the cube mesh has arrived from the transfer queue
+        const bool drawBufferReady = m_uploader.IsReady(m_drawBufferUploads[0]) && m_uploader.IsReady(m_drawBufferUploads[1]);
         for (const Cube& cube : cubes) {
+            if (!drawBufferReady) {
+                break;
+            }
+
             // Compute the model-view-projection transform and push it.
             XrMatrix4x4f model;
             XrMatrix4x4f_CreateTranslationRotationScale(&model, &cube.Pose.position, &cube.Pose.orientation, &cube.Scale);
@@ -1684,8 +2207,8 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
 
    protected:
     XrGraphicsBindingVulkan2KHR m_graphicsBinding{XR_TYPE_GRAPHICS_BINDING_VULKAN2_KHR};
-    std::list<SwapchainImageContext> m_swapchainImageContexts;
-    std::map<const XrSwapchainImageBaseHeader*, SwapchainImageContext*> m_swapchainImageContextMap;
+    // Indexed by swapchainIndex. A deque, so the image structs of earlier swapchains do not move.
+    std::deque<SwapchainImageContext> m_swapchainImageContexts;
 
     VkInstance m_vkInstance{VK_NULL_HANDLE};
     VkPhysicalDevice m_vkPhysicalDevice{VK_NULL_HANDLE};
@@ -1693,13 +2216,19 @@ struct VulkanGraphicsPlugin : public IGraphicsPlugin {
     VulkanDebugObjectNamer m_namer{};
     uint32_t m_queueFamilyIndex = 0;
     VkQueue m_vkQueue{VK_NULL_HANDLE};
+    uint32_t m_transferQueueFamilyIndex = 0;
+    VkQueue m_vkTransferQueue{VK_NULL_HANDLE};
+    bool m_timelineSemaphoreEnabled{false};
     VkSemaphore m_vkDrawDone{VK_NULL_HANDLE};
 
     MemoryAllocator m_memAllocator{};
     ShaderProgram m_shaderProgram{};
     CmdBuffer m_cmdBuffer{};
     PipelineLayout m_pipelineLayout{};
+    VkDeviceSize m_uniformBufferAlignment{256};
     VertexBuffer<Geometry::Vertex> m_drawBuffer{};
+    TransferUploader m_uploader{};
+    std::array<uint64_t, 2> m_drawBufferUploads{};
     std::array<float, 4> m_clearColor;
 
 #if defined(USE_MIRROR_WINDOW)
@@ -4,6 +4,7 @@
 
 const std = @import("std");
 const Options = @import("Options.zig");
+const GraphicsPlugin = @import("GraphicsPlugin.zig");
 const GraphicsPluginOpengl = @import("GraphicsPluginOpengl.zig");
 const GraphicsPluginD3D11 = @import("GraphicsPluginD3D11.zig");
 const OpenXrProgram = @import("OpenXrProgram.zig");
@@ -13,6 +14,20 @@ const xr_gen = @import("openxr");
 const xr = xr_gen.c;
 const Scene = @import("Scene.zig");
 const PassThrough = @import("PassThrough.zig");
+const GlUploader = @import("GlUploader.zig");
+const LateLatch = @import("LateLatch.zig");
+const DynamicResolution = @import("DynamicResolution.zig");
+const GpuTimer = @import("GpuTimer.zig");
+const Startup = @import("Startup.zig");
+const QuadLayer = @import("QuadLayer.zig");
+const geometry = @import("geometry.zig");
+const xr_linear = @import("xr_linear.zig");
+const InputSampler = @import("InputSampler.zig");
+const HandMesh = @import("HandMesh.zig");
+const HandTrackingService = @import("HandTrackingService.zig");
+const EnvironmentDepth = @import("EnvironmentDepth.zig");
+const SceneModel = @import("SceneModel.zig");
+const RenderVariant = @import("RenderVariant.zig");
 
 const GraphicsRendererGlad = @import("GraphicsRendererGlad.zig");
 const GraphicsRendererSokol = @import("GraphicsRendererSokol.zig");
@@ -53,6 +68,257 @@ pub fn logFn(
     std.debug.print("{s}{s}{s}0m\n", .{ begin, &buf.buffer, CSI });
 }
 
+// Static content for a quad layer: a cube seen from a fixed camera, rendered once.
+const QuadPanel = struct {
+    renderer: *GraphicsRendererGlad,
+    viewProjection: xr_linear.Matrix4x4f,
+    cubes: [1]geometry.Cube = .{.{
+        .Pose = geometry.XrPosef_RotateCCWAboutYAxis(std.math.pi / 4.0, .{ .x = 0, .y = 0, .z = 0 }),
+        .Scale = .{ .x = 1, .y = 1, .z = 1 },
+    }},
+
+    fn render(
+        ctx: ?*anyopaque,
+        images: GraphicsPlugin.SwapchainImages,
+        image_index: u32,
+        image: GraphicsPlugin.SwapchainImage,
+        width: u32,
+        height: u32,
+    ) void {
+        const self: *@This() = @ptrCast(@alignCast(ctx));
+        switch (image) {
+            .OpenGL => |gl| {
+                // Replaces the frame's instances, hands and scene meshes, which the views have already drawn.
+                self.renderer.uploadInstances(&self.cubes);
+                self.renderer.setHandSkins(.{ null, null });
+                self.renderer.setSceneMeshes(&.{});
+                self.renderer.setOcclusion(null);
+                self.renderer.render(
+                    .{ .images = images, .index = image_index, .texture = gl.image },
+                    null,
+                    @intCast(width),
+                    @intCast(height),
+                    .{
+                        .offset = .{ .x = 0, .y = 0 },
+                        .extent = .{ .width = @intCast(width), .height = @intCast(height) },
+                    },
+                    .{ 0.2, 0.2, 0.3, 1 },
+                    self.viewProjection,
+                );
+            },
+            else => {},
+        }
+    }
+};
+
+// The objects of one session that the frame loop works with.
+const Session = struct {
+    program: *OpenXrProgram,
+    opengl: *GraphicsPluginOpengl,
+    space: xr.XrSpace,
+    scene: *Scene,
+    inputSampler: ?*InputSampler,
+    handService: *HandTrackingService,
+    sceneModel: ?*SceneModel,
+    environmentDepth: ?EnvironmentDepth,
+    passthroughLayer: xr.XrPassthroughLayerFB,
+    renderer: *GraphicsRendererGlad,
+    dynamicResolution: *?DynamicResolution,
+    gpuTimer: *GpuTimer,
+    projectionLayerViews: *std.array_list.Managed(xr.XrCompositionLayerProjectionView),
+    startup: *Startup,
+};
+
+// Runs frames until quit, a restart or the session exits. Instantiated per RenderVariant.
+fn frameLoop(comptime variant: RenderVariant, session: Session, quit: *const bool, requestRestart: *bool) !void {
+    const program = session.program;
+    const opengl = session.opengl;
+    const space = session.space;
+    const scene = session.scene;
+    const inputSampler = session.inputSampler;
+    const handService = session.handService;
+    const sceneModel = session.sceneModel;
+    const environmentDepth = session.environmentDepth;
+    const renderer = session.renderer;
+    const dynamicResolution = session.dynamicResolution;
+    const gpuTimer = session.gpuTimer;
+    const projectionLayerViews = session.projectionLayerViews;
+    const startup = session.startup;
+
+    while (!quit.*) {
+        var exitRenderLoop = false;
+        try program.pollEvents(&exitRenderLoop, requestRestart);
+        if (exitRenderLoop) {
+            break;
+        }
+        if (program.takeReferenceSpaceChange()) |changeTime| {
+            scene.onReferenceSpaceChange(changeTime);
+        }
+
+        if (program.sessionRunning) {
+            const frame_state = try program.waitFrame();
+            // Before input polling, so the worker locates the hands while this thread polls.
+            handService.request(frame_state.predictedDisplayTime);
+            if (inputSampler) |sampler| {
+                sampler.updateInput(&program.input);
+            } else {
+                try program.input.pollActions(program.session);
+            }
+            try program.beginFrame();
+            try projectionLayerViews.resize(0);
+            if (frame_state.shouldRender == xr.XR_TRUE) {
+                //
+                const view_state = try program.locateView(space, frame_state.predictedDisplayTime);
+                if ((view_state.viewStateFlags & xr.XR_VIEW_STATE_POSITION_VALID_BIT) != 0 and
+                    (view_state.viewStateFlags & xr.XR_VIEW_STATE_ORIENTATION_VALID_BIT) != 0)
+                {
+                    // render
+                    // try xr_util.assert(viewCountOutput == self.views.items.len);
+                    // try xr_util.assert(viewCountOutput == self.configViews.items.len);
+                    // try xr_util.assert(viewCountOutput == self.swapchains.items.len);
+                    try scene.update(
+                        space,
+                        &program.input,
+                        frame_state.predictedDisplayTime,
+                    );
+
+                    try projectionLayerViews.resize(2);
+                    // Both views draw the same instances, only the objects that changed are uploaded.
+                    renderer.uploadStore(&scene.store);
+                    renderer.setHandSkins(scene.handSkins);
+                    renderer.setSceneMeshes(if (sceneModel) |model| model.meshes.items else &.{});
+                    const depthFrame: ?EnvironmentDepth.Frame = if (environmentDepth) |depth|
+                        depth.acquire(program.graphics, space, frame_state.predictedDisplayTime) catch |e| blk: {
+                            std.log.err("environment depth: {s}", .{@errorName(e)});
+                            break :blk null;
+                        }
+                    else
+                        null;
+
+                    if (dynamicResolution.*) |*controller| {
+                        if (gpuTimer.poll()) |gpuTime| {
+                            controller.update(gpuTime, frame_state.predictedDisplayPeriod);
+                        }
+                    }
+                    gpuTimer.begin();
+
+                    // Render view to the appropriate part of the swapchain image.
+                    for (program.views.items, program.swapchains.items, 0..) |view, viewSwapchain, i| {
+                        // Each view has a separate swapchain which is acquired, rendered to, and released.
+                        var acquireInfo = xr.XrSwapchainImageAcquireInfo{
+                            .type = xr.XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO,
+                        };
+                        var swapchainImageIndex: u32 = undefined;
+                        try xr_result.check(xr.xrAcquireSwapchainImage(
+                            viewSwapchain.handle,
+                            &acquireInfo,
+                            &swapchainImageIndex,
+                        ));
+                        var waitInfo = xr.XrSwapchainImageWaitInfo{
+                            .type = xr.XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO,
+                            .timeout = xr.XR_INFINITE_DURATION,
+                        };
+                        try xr_result.check(xr.xrWaitSwapchainImage(viewSwapchain.handle, &waitInfo));
+                        const depthTexture: ?GraphicsPlugin.SwapchainTexture = if (try program.acquireDepthImageIndex(i)) |depthImageIndex|
+                            opengl.swapchainTexture(viewSwapchain.depthImages, depthImageIndex)
+                        else
+                            null;
+
+                        const imageRect: xr.XrRect2Di = if (dynamicResolution.*) |controller|
+                            controller.imageRect(viewSwapchain.width, viewSwapchain.height)
+                        else
+                            .{
+                                .offset = .{ .x = 0, .y = 0 },
+                                .extent = .{
+                                    .width = @intCast(viewSwapchain.width),
+                                    .height = @intCast(viewSwapchain.height),
+                                },
+                            };
+
+                        // composition
+                        projectionLayerViews.items[i] = .{
+                            .type = xr.XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW,
+                            .pose = view.pose,
+                            .fov = view.fov,
+                            .subImage = .{
+                                .swapchain = viewSwapchain.handle,
+                                .imageRect = imageRect,
+                            },
+                        };
+
+                        // render
+                        renderer.setOcclusion(if (depthFrame) |frame| frame.occlusion(i) else null);
+                        const colorTexture = opengl.swapchainTexture(viewSwapchain.images, swapchainImageIndex);
+                        if (variant.lateLatch) {
+                            const slot = renderer.renderLateLatched(
+                                colorTexture,
+                                depthTexture,
+                                @intCast(viewSwapchain.width),
+                                @intCast(viewSwapchain.height),
+                                imageRect,
+                                comptime variant.clearColor(),
+                                LateLatch.Block.init(
+                                    GraphicsPluginOpengl.calcViewProjectionMatrix(view.fov, view.pose),
+                                    .{ .{}, .{} },
+                                ),
+                            ).?;
+
+                            // late latch: the draws are queued but not yet run, so locate again for the
+                            // same display time and overwrite the poses they will read.
+                            const late_view_state = try program.locateView(space, frame_state.predictedDisplayTime);
+                            if ((late_view_state.viewStateFlags & xr.XR_VIEW_STATE_POSITION_VALID_BIT) != 0 and
+                                (late_view_state.viewStateFlags & xr.XR_VIEW_STATE_ORIENTATION_VALID_BIT) != 0)
+                            {
+                                const late_view = program.views.items[i];
+                                renderer.latch(slot, LateLatch.Block.init(
+                                    GraphicsPluginOpengl.calcViewProjectionMatrix(late_view.fov, late_view.pose),
+                                    scene.latchHands(space, &program.input, frame_state.predictedDisplayTime),
+                                ));
+                                // The compositor reprojects from the pose the image was rendered with.
+                                projectionLayerViews.items[i].pose = late_view.pose;
+                                projectionLayerViews.items[i].fov = late_view.fov;
+                            }
+                        } else {
+                            renderer.render(
+                                colorTexture,
+                                depthTexture,
+                                @intCast(viewSwapchain.width),
+                                @intCast(viewSwapchain.height),
+                                imageRect,
+                                comptime variant.clearColor(),
+                                GraphicsPluginOpengl.calcViewProjectionMatrix(view.fov, view.pose),
+                            );
+                        }
+
+                        // commit
+                        const releaseInfo = xr.XrSwapchainImageReleaseInfo{
+                            .type = xr.XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
+                        };
+                        try xr_result.check(xr.xrReleaseSwapchainImage(viewSwapchain.handle, &releaseInfo));
+                        try program.releaseDepthImage(i, &projectionLayerViews.items[i]);
+                    }
+                    gpuTimer.end();
+                }
+            }
+            // Only dirty panels render; the rest are already in their static swapchains.
+            try program.updateQuadLayers();
+            try program.endFrame(
+                space,
+                frame_state.predictedDisplayTime,
+                projectionLayerViews.items,
+                session.passthroughLayer,
+            );
+            if (!startup.reported and frame_state.shouldRender == xr.XR_TRUE) {
+                startup.mark("first frame");
+                startup.report();
+            }
+        } else {
+            // Throttle loop since xrWaitFrame won't be called.
+            std.Thread.sleep(std.time.ns_per_ms * 250);
+        }
+    }
+}
+
 pub fn main() !void {
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.detectLeaks();
@@ -83,28 +349,40 @@ pub fn main() !void {
     var key_polling = KeyPolling{};
     try key_polling.spawn();
 
+    // The graphics device, the uploader and the renderer survive a restart. Only the OpenXR
+    // instance, session and the swapchain-bound objects are created again, so recovering from an
+    // instance or session loss does not recompile shaders or re-upload geometry.
+    var graphicsPlugin = switch (options.GraphicsPlugin) {
+        .D3D11 => try GraphicsPluginD3D11.init(allocator),
+        .OpenGL => try GraphicsPluginOpengl.init(allocator),
+        else => @panic("not impl"),
+    };
+    defer graphicsPlugin.deinit();
+
+    // Created after the first initializeDevice, which makes the GL context current.
+    var uploader: ?*GlUploader = null;
+    defer if (uploader) |u| u.destroy();
+    var warmRenderer: ?GraphicsRendererGlad = null;
+    defer if (warmRenderer) |*r| r.deinit();
+
+    // Reported after the first frame of the first pass. Restarts are warm and not timed.
+    var startup = Startup.init();
+
     var requestRestart = true;
     while (!key_polling.quitKeyPressed and requestRestart) {
         requestRestart = false;
 
-        // Create graphics API implementation.
-        var graphicsPlugin = switch (options.GraphicsPlugin) {
-            .D3D11 => try GraphicsPluginD3D11.init(allocator),
-            .OpenGL => try GraphicsPluginOpengl.init(allocator),
-            else => @panic("not impl"),
-        };
-        defer graphicsPlugin.deinit();
-
         // Initialize the OpenXR program.
         var program = OpenXrProgram.init(allocator, options, graphicsPlugin);
         defer program.deinit();
 
-        try program.createInstance(
+        try startup.run("instance", OpenXrProgram.createInstance, .{
+            &program,
             &xr_util.REQUIRED_EXTENSIONS,
             null,
-        );
+        });
 
-        program.initializeSystem() catch |e| {
+        startup.run("system", OpenXrProgram.initializeSystem, .{&program}) catch |e| {
             switch (e) {
                 xr_result.Error.XR_ERROR_FORM_FACTOR_UNAVAILABLE => {
                     std.log.warn("{s}: VR DEVICE not ready", .{@errorName(e)});
@@ -118,17 +396,75 @@ pub fn main() !void {
 
         try options.setEnvironmentBlendMode(try program.getPreferredBlendMode());
 
-        try program.initializeDevice();
-        try program.initializeSession();
-        try program.createSwapchains();
+        try startup.run("device", OpenXrProgram.initializeDevice, .{&program});
+
+        // Textures and buffers are uploaded on a loader thread with a context shared with the render context.
+        if (uploader == null and options.GraphicsPlugin == .OpenGL) {
+            const opengl: *GraphicsPluginOpengl = @ptrCast(@alignCast(graphicsPlugin.ptr));
+            uploader = try GlUploader.create(allocator, try opengl.createSharedContext());
+        }
+
+        try startup.run("session", OpenXrProgram.initializeSession, .{&program});
+        try startup.run("swapchains", OpenXrProgram.createSwapchains, .{&program});
 
         const referenceSpaceCreateInfo = try Scene.getXrReferenceSpaceCreateInfo(options.AppSpace);
         var space: xr.XrSpace = null;
         try xr_result.check(xr.xrCreateReferenceSpace(program.session, &referenceSpaceCreateInfo, &space));
-
-        var scene = try Scene.init(allocator, program.instance, program.session);
+        defer _ = xr.xrDestroySpace(space);
+
+        var scene = try Scene.init(
+            allocator,
+            program.instance,
+            program.session,
+            referenceSpaceCreateInfo.referenceSpaceType,
+            program.isExtensionEnabled(HandMesh.EXTENSION_NAME),
+        );
         defer scene.deinit();
 
+        // With --inputrate the actions are synced on the sampler thread instead of per frame.
+        const inputSampler: ?*InputSampler = if (options.InputRate == 0)
+            null
+        else if (!program.isExtensionEnabled(InputSampler.CLOCK_EXTENSION_NAME)) blk: {
+            std.log.warn("input sampler: {s} not supported", .{InputSampler.CLOCK_EXTENSION_NAME});
+            break :blk null;
+        } else try InputSampler.create(
+            allocator,
+            program.instance,
+            program.session,
+            &program.input,
+            space,
+            scene.handTrackers(),
+            options.InputRate,
+        );
+        defer if (inputSampler) |sampler| sampler.destroy(allocator);
+
+        // Both hands are located on a worker, the frame takes the newest result.
+        const handService = try HandTrackingService.create(allocator, scene.handTrackers(), space);
+        defer handService.destroy(allocator);
+        scene.handService = handService;
+
+        // The room meshes are loaded in the background, for the hand rays and drawn over passthrough.
+        const sceneModel: ?*SceneModel = for (SceneModel.EXTENSION_NAMES) |name| {
+            if (!program.isExtensionEnabled(name)) {
+                break null;
+            }
+        } else SceneModel.create(
+            allocator,
+            program.instance,
+            program.session,
+            referenceSpaceCreateInfo.referenceSpaceType,
+            uploader,
+        ) catch |e| blk: {
+            std.log.warn("scene model: {s}", .{@errorName(e)});
+            break :blk null;
+        };
+        defer if (sceneModel) |model| {
+            program.sceneModel = null;
+            model.destroy();
+        };
+        program.sceneModel = sceneModel;
+        scene.sceneModel = sceneModel;
+
         if (try PassThrough.systemSupportsPassthrough(program.instance, program.systemId)) {
             std.log.info("Passthrough supported", .{});
         } else {
@@ -137,111 +473,84 @@ pub fn main() !void {
         var passthrough = try PassThrough.init(program.instance, program.session);
         defer passthrough.deinit();
 
-        // var renderer = try GraphicsRendererSokol.init(allocator);
-        var renderer = GraphicsRendererGlad.init(allocator);
-        defer renderer.deinit();
-
-        var projectionLayerViews = std.array_list.Managed(xr.XrCompositionLayerProjectionView).init(allocator);
-        defer projectionLayerViews.deinit();
+        // The real world occludes the cubes where the runtime provides its depth.
+        var environmentDepth: ?EnvironmentDepth = if (program.isExtensionEnabled(EnvironmentDepth.EXTENSION_NAME))
+            EnvironmentDepth.init(program.instance, program.session, &program.graphics) catch |e| blk: {
+                std.log.warn("environment depth: {s}", .{@errorName(e)});
+                break :blk null;
+            }
+        else
+            null;
+        defer if (environmentDepth) |*depth| depth.deinit(program.graphics);
 
-        while (!key_polling.quitKeyPressed) {
-            var exitRenderLoop = false;
-            try program.pollEvents(&exitRenderLoop, &requestRestart);
-            if (exitRenderLoop) {
-                break;
+        // var renderer = try GraphicsRendererSokol.init(allocator);
+        if (warmRenderer == null) {
+            warmRenderer = startup.run("renderer", GraphicsRendererGlad.init, .{allocator});
+            if (options.LateLatch) {
+                warmRenderer.?.enableLateLatch();
             }
+        }
+        const renderer = &warmRenderer.?;
+        defer renderer.releaseSwapchainImages();
+        defer renderer.releaseSceneMeshes();
+        renderer.loadHandMeshes(scene.handMeshes);
+
+        // A panel off to the left is composited by the runtime and costs nothing per frame.
+        var panel = QuadPanel{
+            .renderer = renderer,
+            .viewProjection = program.graphics.calcViewProjectionMatrix(.{
+                .angleLeft = -std.math.pi / 6.0,
+                .angleRight = std.math.pi / 6.0,
+                .angleUp = std.math.pi / 6.0,
+                .angleDown = -std.math.pi / 6.0,
+            }, geometry.XrPosef_Translation(.{ .x = 0, .y = 0, .z = 3 })),
+        };
+        if (options.GraphicsPlugin == .OpenGL) {
+            _ = try program.addQuadLayer(.{
+                .width = 512,
+                .height = 512,
+                .space = space,
+                .pose = geometry.XrPosef_RotateCCWAboutYAxis(std.math.pi / 6.0, .{ .x = -1, .y = 0, .z = -2 }),
+                .size = .{ .width = 0.5, .height = 0.5 },
+                .ctx = &panel,
+                .render = QuadPanel.render,
+            });
+        }
 
-            if (program.sessionRunning) {
-                // program.pollActions();
-                const frame_state = try program.beginFrame();
-                try projectionLayerViews.resize(0);
-                if (frame_state.shouldRender == xr.XR_TRUE) {
-                    //
-                    const view_state = try program.locateView(space, frame_state.predictedDisplayTime);
-                    if ((view_state.viewStateFlags & xr.XR_VIEW_STATE_POSITION_VALID_BIT) != 0 and
-                        (view_state.viewStateFlags & xr.XR_VIEW_STATE_ORIENTATION_VALID_BIT) != 0)
-                    {
-                        // render
-                        // try xr_util.assert(viewCountOutput == self.views.items.len);
-                        // try xr_util.assert(viewCountOutput == self.configViews.items.len);
-                        // try xr_util.assert(viewCountOutput == self.swapchains.items.len);
-                        const cubes = try scene.update(
-                            space,
-                            &program.input,
-                            frame_state.predictedDisplayTime,
-                        );
-
-                        try projectionLayerViews.resize(2);
-
-                        // Render view to the appropriate part of the swapchain image.
-                        for (program.views.items, program.swapchains.items, 0..) |view, viewSwapchain, i| {
-                            // Each view has a separate swapchain which is acquired, rendered to, and released.
-                            var acquireInfo = xr.XrSwapchainImageAcquireInfo{
-                                .type = xr.XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO,
-                            };
-                            var swapchainImageIndex: u32 = undefined;
-                            try xr_result.check(xr.xrAcquireSwapchainImage(
-                                viewSwapchain.handle,
-                                &acquireInfo,
-                                &swapchainImageIndex,
-                            ));
-                            var waitInfo = xr.XrSwapchainImageWaitInfo{
-                                .type = xr.XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO,
-                                .timeout = xr.XR_INFINITE_DURATION,
-                            };
-                            try xr_result.check(xr.xrWaitSwapchainImage(viewSwapchain.handle, &waitInfo));
-
-                            // composition
-                            projectionLayerViews.items[i] = .{
-                                .type = xr.XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW,
-                                .pose = view.pose,
-                                .fov = view.fov,
-                                .subImage = .{
-                                    .swapchain = viewSwapchain.handle,
-                                    .imageRect = .{
-                                        .offset = .{ .x = 0, .y = 0 },
-                                        .extent = .{
-                                            .width = @intCast(viewSwapchain.width),
-                                            .height = @intCast(viewSwapchain.height),
-                                        },
-                                    },
-                                },
-                            };
+        // Without --dynamicresolution the swapchains are recommended sized and always fully used.
+        var dynamicResolution: ?DynamicResolution = if (options.DynamicResolution) DynamicResolution.init(
+            @as(f32, @floatFromInt(program.swapchains.items[0].recommendedWidth)) /
+                @as(f32, @floatFromInt(program.swapchains.items[0].width)),
+        ) else null;
+        var gpuTimer = GpuTimer.init();
+        defer gpuTimer.deinit();
 
-                            // render
-                            switch (program.graphics.getSwapchainImage(
-                                viewSwapchain.handle,
-                                swapchainImageIndex,
-                            )) {
-                                .OpenGL => |image| renderer.render(
-                                    image.image,
-                                    @intCast(viewSwapchain.width),
-                                    @intCast(viewSwapchain.height),
-                                    .{0, 0, 0, 0},
-                                    program.graphics.calcViewProjectionMatrix(view.fov, view.pose),
-                                    cubes,
-                                ),
-                                else => unreachable,
-                            }
+        var projectionLayerViews = std.array_list.Managed(xr.XrCompositionLayerProjectionView).init(allocator);
+        defer projectionLayerViews.deinit();
 
-                            // commit
-                            const releaseInfo = xr.XrSwapchainImageReleaseInfo{
-                                .type = xr.XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO,
-                            };
-                            try xr_result.check(xr.xrReleaseSwapchainImage(viewSwapchain.handle, &releaseInfo));
-                        }
-                    }
-                }
-                try program.endFrame(
-                    space,
-                    frame_state.predictedDisplayTime,
-                    projectionLayerViews.items,
-                    passthrough.passthrough_layer,
-                );
-            } else {
-                // Throttle loop since xrWaitFrame won't be called.
-                std.Thread.sleep(std.time.ns_per_ms * 250);
-            }
-        }
+        // Chosen once per session, each variant has its own copy of the frame loop.
+        const variant = try RenderVariant.select(
+            options,
+            renderer.lateLatch != null,
+            passthrough.passthrough_layer != null,
+        );
+        std.log.info("render variant: {s}, late latch {}", .{ @tagName(variant.blend), variant.lateLatch });
+        const session = Session{
+            .program = &program,
+            .opengl = @ptrCast(@alignCast(graphicsPlugin.ptr)),
+            .space = space,
+            .scene = &scene,
+            .inputSampler = inputSampler,
+            .handService = handService,
+            .sceneModel = sceneModel,
+            .environmentDepth = environmentDepth,
+            .passthroughLayer = passthrough.passthrough_layer,
+            .renderer = renderer,
+            .dynamicResolution = &dynamicResolution,
+            .gpuTimer = &gpuTimer,
+            .projectionLayerViews = &projectionLayerViews,
+            .startup = &startup,
+        };
+        try variant.dispatch(frameLoop, .{ session, &key_polling.quitKeyPressed, &requestRestart });
     }
 }
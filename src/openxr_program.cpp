@@ -10,6 +10,7 @@
 #include "platformplugin.h"
 #include "graphicsplugin.h"
 #include "openxr_program.h"
+#include "geometry.h"
 #include <common/xr_linear.h>
 #include <array>
 #include <cmath>
@@ -304,6 +305,9 @@ void OpenXrProgram::InitializeDevice() {
     // The graphics API can initialize the graphics device now that the systemId and instance
     // handle are available.
     m_graphicsPlugin->InitializeDevice(m_instance, m_systemId);
+
+    m_handMesh = m_graphicsPlugin->AddMesh(Geometry::c_pyramidVertices, ArraySize(Geometry::c_pyramidVertices),
+                                           Geometry::c_pyramidIndices, ArraySize(Geometry::c_pyramidIndices));
 }
 
 void OpenXrProgram::LogReferenceSpaces() {
@@ -635,16 +639,14 @@ void OpenXrProgram::CreateSwapchains() {
             swapchain.height = swapchainCreateInfo.height;
             CHECK_XRCMD(xrCreateSwapchain(m_session, &swapchainCreateInfo, &swapchain.handle));
 
-            m_swapchains.push_back(swapchain);
-
             uint32_t imageCount;
             CHECK_XRCMD(xrEnumerateSwapchainImages(swapchain.handle, 0, &imageCount, nullptr));
             // XXX This should really just return XrSwapchainImageBaseHeader*
             std::vector<XrSwapchainImageBaseHeader*> swapchainImages =
-                m_graphicsPlugin->AllocateSwapchainImageStructs(imageCount, swapchainCreateInfo);
+                m_graphicsPlugin->AllocateSwapchainImageStructs(imageCount, swapchainCreateInfo, &swapchain.imagesIndex);
             CHECK_XRCMD(xrEnumerateSwapchainImages(swapchain.handle, imageCount, &imageCount, swapchainImages[0]));
 
-            m_swapchainImages.insert(std::make_pair(swapchain.handle, std::move(swapchainImages)));
+            m_swapchains.push_back(swapchain);
         }
     }
 }
@@ -914,7 +916,7 @@ bool OpenXrProgram::RenderLayer(XrTime predictedDisplayTime, std::vector<XrCompo
             if ((spaceLocation.locationFlags & XR_SPACE_LOCATION_POSITION_VALID_BIT) != 0 &&
                 (spaceLocation.locationFlags & XR_SPACE_LOCATION_ORIENTATION_VALID_BIT) != 0) {
                 float scale = 0.1f * m_input.handScale[hand];
-                cubes.push_back(Cube{spaceLocation.pose, {scale, scale, scale}});
+                cubes.push_back(Cube{spaceLocation.pose, {scale, scale, scale}, m_handMesh});
             }
         } else {
             // Tracking loss is expected when the hand is not active so only log a message
@@ -947,8 +949,8 @@ bool OpenXrProgram::RenderLayer(XrTime predictedDisplayTime, std::vector<XrCompo
         projectionLayerViews[i].subImage.imageRect.offset = {0, 0};
         projectionLayerViews[i].subImage.imageRect.extent = {viewSwapchain.width, viewSwapchain.height};
 
-        const XrSwapchainImageBaseHeader* const swapchainImage = m_swapchainImages[viewSwapchain.handle][swapchainImageIndex];
-        m_graphicsPlugin->RenderView(projectionLayerViews[i], swapchainImage, m_colorSwapchainFormat, cubes);
+        m_graphicsPlugin->RenderView(projectionLayerViews[i], viewSwapchain.imagesIndex, swapchainImageIndex,
+                                     m_colorSwapchainFormat, cubes);
 
         XrSwapchainImageReleaseInfo releaseInfo{XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO};
         CHECK_XRCMD(xrReleaseSwapchainImage(viewSwapchain.handle, &releaseInfo));
@@ -11,6 +11,8 @@ struct Swapchain {
     XrSwapchain handle;
     int32_t width;
     int32_t height;
+    // From IGraphicsPlugin::AllocateSwapchainImageStructs.
+    uint32_t imagesIndex;
 };
 
 namespace Side {
@@ -43,11 +45,12 @@ struct OpenXrProgram {
 
     std::vector<XrViewConfigurationView> m_configViews;
     std::vector<Swapchain> m_swapchains;
-    std::map<XrSwapchain, std::vector<XrSwapchainImageBaseHeader*>> m_swapchainImages;
     std::vector<XrView> m_views;
     int64_t m_colorSwapchainFormat{-1};
 
     std::vector<XrSpace> m_visualizedSpaces;
+    // Cube::Mesh of the hands, registered with the graphics plugin.
+    uint32_t m_handMesh{0};
 
     // Application's current lifecycle state according to the runtime
     XrSessionState m_sessionState{XR_SESSION_STATE_UNKNOWN};
@@ -0,0 +1,183 @@
+// Values addressed by generational handles, stored densely by slot index.
+//
+// A lookup is an index and a generation compare, no hashing. Removed slots go to a free list and
+// are reused by insert with the generation bumped, so a handle kept past its remove, e.g. by an
+// object from before a restart, resolves to null instead of to whatever took its slot.
+const std = @import("std");
+
+pub const Handle = packed struct(u64) {
+    index: u32,
+    generation: u32,
+};
+
+pub fn SlotMap(comptime T: type) type {
+    return struct {
+        const Slot = struct {
+            value: T = undefined,
+            generation: u32 = 0,
+            alive: bool = false,
+        };
+
+        slots: std.array_list.Managed(Slot),
+        free: std.array_list.Managed(u32),
+
+        pub fn init(allocator: std.mem.Allocator) @This() {
+            return .{
+                .slots = .init(allocator),
+                .free = .init(allocator),
+            };
+        }
+
+        pub fn deinit(self: *@This()) void {
+            self.slots.deinit();
+            self.free.deinit();
+        }
+
+        pub fn insert(self: *@This(), value: T) !Handle {
+            const index = self.free.pop() orelse blk: {
+                try self.free.ensureTotalCapacity(self.slots.items.len + 1);
+                try self.slots.append(.{});
+                break :blk @as(u32, @intCast(self.slots.items.len - 1));
+            };
+            const slot = &self.slots.items[index];
+            slot.value = value;
+            slot.alive = true;
+            return .{ .index = index, .generation = slot.generation };
+        }
+
+        pub fn get(self: @This(), handle: Handle) ?*T {
+            if (handle.index >= self.slots.items.len) {
+                return null;
+            }
+            const slot = &self.slots.items[handle.index];
+            if (!slot.alive or slot.generation != handle.generation) {
+                return null;
+            }
+            return &slot.value;
+        }
+
+        // The removed value, for the caller to free. null for a stale handle.
+        pub fn remove(self: *@This(), handle: Handle) ?T {
+            const value = (self.get(handle) orelse return null).*;
+            const slot = &self.slots.items[handle.index];
+            slot.alive = false;
+            slot.generation +%= 1;
+            // Capacity for every slot is reserved by insert.
+            self.free.appendAssumeCapacity(handle.index);
+            return value;
+        }
+
+        pub const Iterator = struct {
+            slots: []Slot,
+            index: usize = 0,
+
+            pub fn next(self: *@This()) ?*T {
+                while (self.index < self.slots.len) {
+                    const slot = &self.slots[self.index];
+                    self.index += 1;
+                    if (slot.alive) {
+                        return &slot.value;
+                    }
+                }
+                return null;
+            }
+        };
+
+        // The live values, in slot order.
+        pub fn iterator(self: @This()) Iterator {
+            return .{ .slots = self.slots.items };
+        }
+    };
+}
+
+// Values per image of the swapchains whose image structs a SlotMap holds, stored densely by the
+// handle's slot index and the image index. A slot taken over by a newer generation has the values
+// of the old one released on the next put, so nothing made for a destroyed swapchain is returned.
+pub fn ImageTable(comptime T: type, comptime release: fn (T) void) type {
+    return struct {
+        const Row = struct {
+            generation: u32 = 0,
+            values: std.ArrayListUnmanaged(?T) = .empty,
+        };
+
+        allocator: std.mem.Allocator,
+        rows: std.ArrayListUnmanaged(Row) = .empty,
+
+        pub fn init(allocator: std.mem.Allocator) @This() {
+            return .{ .allocator = allocator };
+        }
+
+        pub fn deinit(self: *@This()) void {
+            self.clear();
+            for (self.rows.items) |*row| {
+                row.values.deinit(self.allocator);
+            }
+            self.rows.deinit(self.allocator);
+        }
+
+        pub fn get(self: @This(), handle: Handle, image: u32) ?T {
+            const value = self.getPtr(handle, image) orelse return null;
+            return value.*;
+        }
+
+        // Valid until the next put.
+        pub fn getPtr(self: @This(), handle: Handle, image: u32) ?*T {
+            if (handle.index >= self.rows.items.len) {
+                return null;
+            }
+            const row = self.rows.items[handle.index];
+            if (row.generation != handle.generation or image >= row.values.items.len) {
+                return null;
+            }
+            if (row.values.items[image]) |*value| {
+                return value;
+            }
+            return null;
+        }
+
+        pub fn put(self: *@This(), handle: Handle, image: u32, value: T) !void {
+            if (handle.index >= self.rows.items.len) {
+                try self.rows.appendNTimes(self.allocator, .{}, handle.index + 1 - self.rows.items.len);
+            }
+            const row = &self.rows.items[handle.index];
+            if (row.generation != handle.generation) {
+                releaseRow(row);
+                row.generation = handle.generation;
+            }
+            if (image >= row.values.items.len) {
+                try row.values.appendNTimes(self.allocator, null, image + 1 - row.values.items.len);
+            }
+            if (row.values.items[image]) |old| {
+                release(old);
+            }
+            row.values.items[image] = value;
+        }
+
+        // Release every value, e.g. before the swapchains are destroyed.
+        pub fn clear(self: *@This()) void {
+            for (self.rows.items) |*row| {
+                releaseRow(row);
+            }
+        }
+
+        // Number of values held.
+        pub fn count(self: @This()) usize {
+            var n: usize = 0;
+            for (self.rows.items) |row| {
+                for (row.values.items) |value| {
+                    n += @intFromBool(value != null);
+                }
+            }
+            return n;
+        }
+
+        fn releaseRow(row: *Row) void {
+            for (row.values.items) |value| {
+                if (value) |v| {
+                    release(v);
+                }
+            }
+            row.values.clearRetainingCapacity();
+        }
+    };
+}
@@ -1,5 +1,6 @@
 #define XR_USE_PLATFORM_ANDROID 1
 #define XR_USE_GRAPHICS_API_OPENGL_ES 1
+#define XR_USE_TIMESPEC 1
 #include <openxr/openxr.h>
 
 #include <EGL/egl.h>
@@ -11,6 +12,7 @@
 #include <android/native_window.h>
 #include <android/native_activity.h>
 #include <jni.h>
+#include <time.h>
 #include <sys/system_properties.h>
 
 #include <openxr/openxr_platform.h>
@@ -4,10 +4,13 @@ const c = @import("c");
 const xr_result = @import("xr_result.zig");
 const xr_util = @import("xr_util.zig");
 
+// When reuseWindow is set the context of a previous instance is kept and only checked against the
+// requirements of the new one.
 pub fn initializeDevice(
     instance: c.XrInstance,
     systemId: c.XrSystemId,
     window: *c.ksGpuWindow,
+    reuseWindow: bool,
 ) !void {
     var pfnGetOpenGLGraphicsRequirementsKHR: c.PFN_xrGetOpenGLGraphicsRequirementsKHR = null;
     try xr_result.check(c.xrGetInstanceProcAddr(
@@ -26,24 +29,8 @@ pub fn initializeDevice(
     ));
 
     // Initialize the gl extensions. Note we have to open a window.
-    var driverInstance = c.ksDriverInstance{};
-    var queueInfo = c.ksGpuQueueInfo{};
-    const colorFormat = c.KS_GPU_SURFACE_COLOR_FORMAT_B8G8R8A8;
-    const depthFormat = c.KS_GPU_SURFACE_DEPTH_FORMAT_D24;
-    const sampleCount = c.KS_GPU_SAMPLE_COUNT_1;
-    if (!c.ksGpuWindow_Create(
-        window,
-        &driverInstance,
-        &queueInfo,
-        0,
-        colorFormat,
-        depthFormat,
-        sampleCount,
-        640,
-        480,
-        false,
-    )) {
-        xr_util.my_panic("Unable to create GL context", .{});
+    if (!reuseWindow) {
+        createWindow(window);
     }
 
     var major: c_int = 0;
@@ -96,6 +83,45 @@ pub fn initializeDevice(
     }
 }
 
+fn createWindow(window: *c.ksGpuWindow) void {
+    var driverInstance = c.ksDriverInstance{};
+    var queueInfo = c.ksGpuQueueInfo{};
+    const colorFormat = c.KS_GPU_SURFACE_COLOR_FORMAT_B8G8R8A8;
+    const depthFormat = c.KS_GPU_SURFACE_DEPTH_FORMAT_D24;
+    const sampleCount = c.KS_GPU_SAMPLE_COUNT_1;
+    if (!c.ksGpuWindow_Create(
+        window,
+        &driverInstance,
+        &queueInfo,
+        0,
+        colorFormat,
+        depthFormat,
+        sampleCount,
+        640,
+        480,
+        false,
+    )) {
+        xr_util.my_panic("Unable to create GL context", .{});
+    }
+}
+
+pub fn selectDepthSwapchainFormat(runtimeFormats: []i64) ?i64 {
+    // In order of preference. Attached as GL_DEPTH_ATTACHMENT, so no stencil formats.
+    const SupportedDepthSwapchainFormats = [_]i64{
+        c.GL_DEPTH_COMPONENT24,
+        c.GL_DEPTH_COMPONENT32F,
+        c.GL_DEPTH_COMPONENT16,
+    };
+
+    for (SupportedDepthSwapchainFormats) |supported| {
+        if (std.mem.indexOfScalar(i64, runtimeFormats, supported) != null) {
+            return supported;
+        }
+    }
+
+    return null;
+}
+
 pub fn selectColorSwapchainFormat(runtimeFormats: []i64) ?i64 {
     // List of supported color swapchain formats.
     const SupportedColorSwapchainFormats = [_]i64{
@@ -1,5 +1,10 @@
+const std = @import("std");
 const c = @import("c");
 
+// A matrix column, or one component of four instances in the batch functions.
+const Vec4 = @Vector(4, f32);
+const LANES = 4;
+
 pub const GraphicsAPI = enum {
     VULKAN,
     OPENGL,
@@ -42,6 +47,27 @@ pub const Matrix4x4f = struct {
         return result;
     }
 
+    // multiply on columns. Same operations in the same order, so the results are identical.
+    pub fn multiplySimd(a: @This(), b: @This()) @This() {
+        const a0 = a.column(0);
+        const a1 = a.column(1);
+        const a2 = a.column(2);
+        const a3 = a.column(3);
+        var result = @This(){};
+        inline for (0..4) |i| {
+            const col = a0 * @as(Vec4, @splat(b.m[i * 4])) +
+                a1 * @as(Vec4, @splat(b.m[i * 4 + 1])) +
+                a2 * @as(Vec4, @splat(b.m[i * 4 + 2])) +
+                a3 * @as(Vec4, @splat(b.m[i * 4 + 3]));
+            result.m[i * 4 ..][0..4].* = col;
+        }
+        return result;
+    }
+
+    fn column(self: @This(), i: usize) Vec4 {
+        return self.m[i * 4 ..][0..4].*;
+    }
+
     // Calculates the inverse of a rigid body transform.
     pub fn invertRigidBody(src: @This()) @This() {
         var result = @This(){};
@@ -170,6 +196,82 @@ pub const Matrix4x4f = struct {
         return translationMatrix.multiply(rotationMatrix.multiply(scaleMatrix));
     }
 
+    // createTranslationRotationScale without the two matrix products: the rotation columns are
+    // scaled and the translation is the last column.
+    pub fn createTranslationRotationScaleSimd(
+        translation: c.XrVector3f,
+        rotation: c.XrQuaternionf,
+        scale: c.XrVector3f,
+    ) @This() {
+        var result = createFromQuaternionSimd(rotation);
+        result.m[0..4].* = result.column(0) * @as(Vec4, @splat(scale.x));
+        result.m[4..8].* = result.column(1) * @as(Vec4, @splat(scale.y));
+        result.m[8..12].* = result.column(2) * @as(Vec4, @splat(scale.z));
+        result.m[12..16].* = Vec4{ translation.x, translation.y, translation.z, 1.0 };
+        return result;
+    }
+
+    // createTranslationRotationScale for four instances at once, a lane per instance.
+    pub fn createTranslationRotationScale4(
+        translations: [LANES]c.XrVector3f,
+        rotations: [LANES]c.XrQuaternionf,
+        scales: [LANES]c.XrVector3f,
+    ) [LANES]@This() {
+        var qx: Vec4 = undefined;
+        var qy: Vec4 = undefined;
+        var qz: Vec4 = undefined;
+        var qw: Vec4 = undefined;
+        var sx: Vec4 = undefined;
+        var sy: Vec4 = undefined;
+        var sz: Vec4 = undefined;
+        inline for (0..LANES) |lane| {
+            qx[lane] = rotations[lane].x;
+            qy[lane] = rotations[lane].y;
+            qz[lane] = rotations[lane].z;
+            qw[lane] = rotations[lane].w;
+            sx[lane] = scales[lane].x;
+            sy[lane] = scales[lane].y;
+            sz[lane] = scales[lane].z;
+        }
+
+        const x2 = qx + qx;
+        const y2 = qy + qy;
+        const z2 = qz + qz;
+
+        const xx2 = qx * x2;
+        const yy2 = qy * y2;
+        const zz2 = qz * z2;
+
+        const yz2 = qy * z2;
+        const wx2 = qw * x2;
+        const xy2 = qx * y2;
+        const wz2 = qw * z2;
+        const xz2 = qx * z2;
+        const wy2 = qw * y2;
+
+        const one: Vec4 = @splat(1.0);
+        const m0 = (one - yy2 - zz2) * sx;
+        const m1 = (xy2 + wz2) * sx;
+        const m2 = (xz2 - wy2) * sx;
+        const m4 = (xy2 - wz2) * sy;
+        const m5 = (one - xx2 - zz2) * sy;
+        const m6 = (yz2 + wx2) * sy;
+        const m8 = (xz2 + wy2) * sz;
+        const m9 = (yz2 - wx2) * sz;
+        const m10 = (one - xx2 - yy2) * sz;
+
+        var result: [LANES]@This() = undefined;
+        inline for (&result, translations, 0..) |*matrix, t, lane| {
+            matrix.m = .{
+                m0[lane], m1[lane], m2[lane],  0.0,
+                m4[lane], m5[lane], m6[lane],  0.0,
+                m8[lane], m9[lane], m10[lane], 0.0,
+                t.x,      t.y,      t.z,       1.0,
+            };
+        }
+        return result;
+    }
+
     // Creates a scale matrix.
     pub fn createScale(x: f32, y: f32, z: f32) @This() {
         return .{
@@ -222,6 +324,33 @@ pub const Matrix4x4f = struct {
         return result;
     }
 
+    // createFromQuaternion with the products taken four at a time.
+    pub fn createFromQuaternionSimd(quat: c.XrQuaternionf) @This() {
+        const q = Vec4{ quat.x, quat.y, quat.z, quat.w };
+        // x2, y2 and z2 times each of x, y, z, w.
+        const x = q * @as(Vec4, @splat(quat.x + quat.x));
+        const y = q * @as(Vec4, @splat(quat.y + quat.y));
+        const z = q * @as(Vec4, @splat(quat.z + quat.z));
+        const xx2 = x[0];
+        const xy2 = y[0];
+        const xz2 = z[0];
+        const yy2 = y[1];
+        const yz2 = z[1];
+        const zz2 = z[2];
+        const wx2 = x[3];
+        const wy2 = y[3];
+        const wz2 = z[3];
+
+        return .{
+            .m = .{
+                1.0 - yy2 - zz2, xy2 + wz2,       xz2 - wy2,       0.0,
+                xy2 - wz2,       1.0 - xx2 - zz2, yz2 + wx2,       0.0,
+                xz2 + wy2,       yz2 - wx2,       1.0 - xx2 - yy2, 0.0,
+                0.0,             0.0,             0.0,             1.0,
+            },
+        };
+    }
+
     // Creates a translation matrix.
     pub fn createTranslation(x: f32, y: f32, z: f32) @This() {
         return .{
@@ -234,3 +363,176 @@ pub const Matrix4x4f = struct {
         };
     }
 };
+
+pub const Transform = struct {
+    pose: c.XrPosef,
+    scale: c.XrVector3f,
+};
+
+// Model matrices for index aligned items, four per step. transform reads an item's pose and
+// scale, so callers batch their own structs without copying them into arrays first. The scalar
+// Matrix4x4f.createTranslationRotationScale stays as the reference the batch is checked against.
+pub fn createTranslationRotationScaleBatch(
+    comptime T: type,
+    items: []const T,
+    comptime transform: fn (T) Transform,
+    out: []Matrix4x4f,
+) void {
+    std.debug.assert(out.len == items.len);
+    var i: usize = 0;
+    while (i + LANES <= items.len) : (i += LANES) {
+        var translations: [LANES]c.XrVector3f = undefined;
+        var rotations: [LANES]c.XrQuaternionf = undefined;
+        var scales: [LANES]c.XrVector3f = undefined;
+        for (&translations, &rotations, &scales, items[i..][0..LANES]) |*t, *r, *s, item| {
+            const lane = transform(item);
+            t.* = lane.pose.position;
+            r.* = lane.pose.orientation;
+            s.* = lane.scale;
+        }
+        out[i..][0..LANES].* = Matrix4x4f.createTranslationRotationScale4(translations, rotations, scales);
+    }
+    for (items[i..], out[i..]) |item, *matrix| {
+        const tail = transform(item);
+        matrix.* = Matrix4x4f.createTranslationRotationScaleSimd(tail.pose.position, tail.pose.orientation, tail.scale);
+    }
+}
+
+pub fn vector3fLerp(a: c.XrVector3f, b: c.XrVector3f, fraction: f32) c.XrVector3f {
+    return .{
+        .x = a.x + fraction * (b.x - a.x),
+        .y = a.y + fraction * (b.y - a.y),
+        .z = a.z + fraction * (b.z - a.z),
+    };
+}
+
+// Normalized linear interpolation along the shorter arc. Close enough to a slerp for the small
+// angles between neighbouring samples.
+pub fn quaternionfLerp(a: c.XrQuaternionf, b: c.XrQuaternionf, fraction: f32) c.XrQuaternionf {
+    const s: f32 = if (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0) -1 else 1;
+    const r = c.XrQuaternionf{
+        .x = a.x + fraction * (s * b.x - a.x),
+        .y = a.y + fraction * (s * b.y - a.y),
+        .z = a.z + fraction * (s * b.z - a.z),
+        .w = a.w + fraction * (s * b.w - a.w),
+    };
+    const length = @sqrt(r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w);
+    return .{ .x = r.x / length, .y = r.y / length, .z = r.z / length, .w = r.w / length };
+}
+
+pub fn posefLerp(a: c.XrPosef, b: c.XrPosef, fraction: f32) c.XrPosef {
+    return .{
+        .orientation = quaternionfLerp(a.orientation, b.orientation, fraction),
+        .position = vector3fLerp(a.position, b.position, fraction),
+    };
+}
+
+const TestRandom = struct {
+    prng: std.Random.DefaultPrng = .init(0x5eed),
+
+    fn float(self: *@This(), min: f32, max: f32) f32 {
+        return min + (max - min) * self.prng.random().float(f32);
+    }
+
+    fn vector(self: *@This(), min: f32, max: f32) c.XrVector3f {
+        return .{ .x = self.float(min, max), .y = self.float(min, max), .z = self.float(min, max) };
+    }
+
+    fn quaternion(self: *@This()) c.XrQuaternionf {
+        const q = c.XrQuaternionf{ .x = self.float(-1, 1), .y = self.float(-1, 1), .z = self.float(-1, 1), .w = self.float(-1, 1) };
+        const length = @sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        return .{ .x = q.x / length, .y = q.y / length, .z = q.z / length, .w = q.w / length };
+    }
+
+    // Translations of several meters and non-uniform, non-unit scales.
+    fn transform(self: *@This()) Transform {
+        return .{
+            .pose = .{ .orientation = self.quaternion(), .position = self.vector(-10, 10) },
+            .scale = self.vector(0.1, 3),
+        };
+    }
+
+    fn matrix(self: *@This()) Matrix4x4f {
+        var result: Matrix4x4f = undefined;
+        for (&result.m) |*v| {
+            v.* = self.float(-2, 2);
+        }
+        return result;
+    }
+};
+
+fn expectMatrixApproxEq(expected: Matrix4x4f, actual: Matrix4x4f) !void {
+    for (expected.m, actual.m) |e, a| {
+        try std.testing.expectApproxEqAbs(e, a, 1e-5 * @max(1.0, @abs(e)));
+    }
+}
+
+fn identityTransform(transform: Transform) Transform {
+    return transform;
+}
+
+test "multiplySimd matches multiply" {
+    var random = TestRandom{};
+    for (0..64) |_| {
+        const a = random.matrix();
+        const b = random.matrix();
+        try expectMatrixApproxEq(a.multiply(b), a.multiplySimd(b));
+    }
+}
+
+test "createFromQuaternionSimd matches createFromQuaternion" {
+    var random = TestRandom{};
+    for (0..64) |_| {
+        const q = random.quaternion();
+        try expectMatrixApproxEq(Matrix4x4f.createFromQuaternion(q), Matrix4x4f.createFromQuaternionSimd(q));
+    }
+}
+
+test "createTranslationRotationScaleSimd matches createTranslationRotationScale" {
+    var random = TestRandom{};
+    for (0..64) |_| {
+        const t = random.transform();
+        try expectMatrixApproxEq(
+            Matrix4x4f.createTranslationRotationScale(t.pose.position, t.pose.orientation, t.scale),
+            Matrix4x4f.createTranslationRotationScaleSimd(t.pose.position, t.pose.orientation, t.scale),
+        );
+    }
+}
+
+test "createTranslationRotationScale4 matches createTranslationRotationScale per lane" {
+    var random = TestRandom{};
+    for (0..16) |_| {
+        var translations: [LANES]c.XrVector3f = undefined;
+        var rotations: [LANES]c.XrQuaternionf = undefined;
+        var scales: [LANES]c.XrVector3f = undefined;
+        for (&translations, &rotations, &scales) |*translation, *rotation, *scale| {
+            const t = random.transform();
+            translation.* = t.pose.position;
+            rotation.* = t.pose.orientation;
+            scale.* = t.scale;
+        }
+        const batch = Matrix4x4f.createTranslationRotationScale4(translations, rotations, scales);
+        for (batch, translations, rotations, scales) |matrix, translation, rotation, scale| {
+            try expectMatrixApproxEq(Matrix4x4f.createTranslationRotationScale(translation, rotation, scale), matrix);
+        }
+    }
+}
+
+test "createTranslationRotationScaleBatch matches createTranslationRotationScale with tails" {
+    var random = TestRandom{};
+    var transforms: [13]Transform = undefined;
+    for (&transforms) |*t| {
+        t.* = random.transform();
+    }
+    // Lengths around each multiple of four, so every tail length runs.
+    for ([_]usize{ 0, 1, 2, 3, 4, 5, 7, 8, 9, 11, 12, 13 }) |len| {
+        var out: [transforms.len]Matrix4x4f = undefined;
+        createTranslationRotationScaleBatch(Transform, transforms[0..len], identityTransform, out[0..len]);
+        for (transforms[0..len], out[0..len]) |t, matrix| {
+            try expectMatrixApproxEq(
+                Matrix4x4f.createTranslationRotationScale(t.pose.position, t.pose.orientation, t.scale),
+                matrix,
+            );
+        }
+    }
+}
@@ -8,13 +8,32 @@ pub const REQUIRED_EXTENSIONS = [_][]const u8{
     c.XR_FB_TRIANGLE_MESH_EXTENSION_NAME,
     // handtracking
     c.XR_EXT_HAND_TRACKING_EXTENSION_NAME,
-    // c.XR_FB_HAND_TRACKING_MESH_EXTENSION_NAME,
     // c.XR_FB_HAND_TRACKING_AIM_EXTENSION_NAME,
     // c.XR_FB_HAND_TRACKING_CAPSULES_EXTENSION_NAME,
 };
 
-pub const REQUIRED_EXTENSIONS_ANDROID = [_][]const u8{
+// Enabled when the runtime supports them. Check with OpenXrProgram.isExtensionEnabled.
+pub const OPTIONAL_EXTENSIONS = [_][]const u8{
+    c.XR_FB_SPACE_WARP_EXTENSION_NAME,
+    c.XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME,
+    c.XR_FB_DISPLAY_REFRESH_RATE_EXTENSION_NAME,
     c.XR_EXT_PERFORMANCE_SETTINGS_EXTENSION_NAME,
+    c.XR_FB_HAND_TRACKING_MESH_EXTENSION_NAME,
+    c.XR_META_ENVIRONMENT_DEPTH_EXTENSION_NAME,
+    // SceneModel.EXTENSION_NAMES.
+    c.XR_FB_SPATIAL_ENTITY_EXTENSION_NAME,
+    c.XR_FB_SPATIAL_ENTITY_QUERY_EXTENSION_NAME,
+    c.XR_FB_SPATIAL_ENTITY_CONTAINER_EXTENSION_NAME,
+    c.XR_FB_SCENE_EXTENSION_NAME,
+    c.XR_META_SPATIAL_ENTITY_MESH_EXTENSION_NAME,
+    // XrTime from the platform clock, for InputSampler.
+} ++ if (builtin.os.tag == .windows) [_][]const u8{
+    c.XR_KHR_WIN32_CONVERT_PERFORMANCE_COUNTER_TIME_EXTENSION_NAME,
+} else [_][]const u8{
+    c.XR_KHR_CONVERT_TIMESPEC_TIME_EXTENSION_NAME,
+};
+
+pub const REQUIRED_EXTENSIONS_ANDROID = [_][]const u8{
     c.XR_KHR_ANDROID_THREAD_SETTINGS_EXTENSION_NAME,
 };
 